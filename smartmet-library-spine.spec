@@ -45,6 +45,7 @@ BuildRequires: libconfig17-devel >= 1.7.3
 BuildRequires: double-conversion-devel
 BuildRequires: libicu-devel
 BuildRequires: libbacktrace-devel
+BuildRequires: libzstd-devel
 BuildRequires: make
 BuildRequires: mariadb-devel
 BuildRequires: fontconfig-devel
@@ -97,6 +98,7 @@ Requires: jsoncpp >= 1.8.4
 Requires: libconfig17 >= 1.7.3
 Requires: libicu
 Requires: libbacktrace
+Requires: libzstd
 Requires: double-conversion
 Requires: smartmet-library-gis >= 26.7.14
 Requires: smartmet-library-macgyver >= 26.7.9
@@ -1,13 +1,25 @@
 #include "AccessLogger.h"
 #include "Convenience.h"
-#include <iostream>
-#include <filesystem>
+#include <boost/algorithm/string/replace.hpp>
 #include <fmt/format.h>
 #include <macgyver/Exception.h>
 #include <macgyver/StringConversion.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace
 {
+// Write the batch once it grows this large even if more requests are queued
+constexpr std::size_t max_batch_size = 1024 * 1024;
+
 std::string makeAccessLogFileName(const std::string& resource, const std::string& accessLogDir)
 {
   try
@@ -38,68 +50,253 @@ std::string makeAccessLogFileName(const std::string& resource, const std::string
   }
 }
 
-std::unique_ptr<std::ofstream> makeAccessLogFile(const std::string& resource,
-                                                 const std::string& accessLogDir)
+std::string errorString(int theErrno)
+{
+  char err_msg[128];
+  return strerror_r(theErrno, err_msg, sizeof(err_msg));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Cache for the formatted second part of a timestamp
+ *
+ * Requests written in the same batch usually end within the same second,
+ * so we format the date and time only once per second and append the
+ * fractional seconds separately.
+ */
+// ----------------------------------------------------------------------
+
+class TimestampCache
+{
+ public:
+  void format(std::string& theResult, const Fmi::DateTime& theTime)
+  {
+    const auto usecs = theTime.time_of_day().total_microseconds() % 1000000;
+    const Fmi::DateTime second = theTime - Fmi::Microseconds(static_cast<int>(usecs));
+
+    if (!itsSecond || *itsSecond != second)
+    {
+      itsSecond = second;
+      itsPrefix = Fmi::to_iso_extended_string(second);
+    }
+
+    theResult = itsPrefix;
+    if (usecs != 0)
+      fmt::format_to(std::back_inserter(theResult), ".{:06d}", usecs);
+  }
+
+ private:
+  std::optional<Fmi::DateTime> itsSecond;
+  std::string itsPrefix;
+};
+
+}  // namespace
+
+namespace SmartMet
+{
+namespace Spine
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Bounded multi-producer single-consumer queue of requests
+ *
+ * Based on Dmitry Vyukov's bounded MPMC queue: each cell has a sequence
+ * number telling whether it is free for the producer or ready for the
+ * consumer at the current position. Producers never wait, a full queue
+ * simply rejects the request.
+ */
+// ----------------------------------------------------------------------
+
+class AccessLogger::Queue
+{
+ public:
+  explicit Queue(std::size_t theCapacity)
+  {
+    std::size_t capacity = 2;
+    while (capacity < theCapacity)
+      capacity *= 2;
+
+    itsMask = capacity - 1;
+    itsCells.reset(new Cell[capacity]);
+    for (std::size_t i = 0; i < capacity; i++)
+      itsCells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  std::size_t capacity() const { return itsMask + 1; }
+
+  std::size_t size() const
+  {
+    const auto tail = itsTail.load(std::memory_order_relaxed);
+    const auto head = itsHead.load(std::memory_order_relaxed);
+    return (head > tail ? head - tail : 0);
+  }
+
+  bool push(LoggedRequest&& theRequest)
+  {
+    auto pos = itsHead.load(std::memory_order_relaxed);
+    while (true)
+    {
+      auto& cell = itsCells[pos & itsMask];
+      const auto seq = cell.sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0)
+      {
+        if (itsHead.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        {
+          // The slot is ours, it must be released even if the move fails
+          bool ok = true;
+          try
+          {
+            cell.request.emplace(std::move(theRequest));
+          }
+          catch (...)
+          {
+            ok = false;
+          }
+          cell.sequence.store(pos + 1, std::memory_order_release);
+          return ok;
+        }
+      }
+      else if (diff < 0)
+        return false;  // full
+      else
+        pos = itsHead.load(std::memory_order_relaxed);
+    }
+  }
+
+  // Consumer side, only the writer thread may call this
+  template <typename Function>
+  bool pop(Function&& theFunction)
+  {
+    const auto pos = itsTail.load(std::memory_order_relaxed);
+    auto& cell = itsCells[pos & itsMask];
+    if (cell.sequence.load(std::memory_order_acquire) != pos + 1)
+      return false;  // empty
+
+    if (cell.request)
+    {
+      theFunction(*cell.request);
+      cell.request.reset();
+    }
+
+    itsTail.store(pos + 1, std::memory_order_relaxed);
+    cell.sequence.store(pos + itsMask + 1, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  struct Cell
+  {
+    std::atomic<std::size_t> sequence{0};
+    std::optional<LoggedRequest> request;
+  };
+
+  std::unique_ptr<Cell[]> itsCells;
+  std::size_t itsMask = 0;
+  alignas(64) std::atomic<std::size_t> itsHead{0};
+  alignas(64) std::atomic<std::size_t> itsTail{0};
+};
+
+AccessLogger::AccessLogger(std::string resource,
+                           std::string accessLogDir,
+                           const AccessLogOptions& options)
+    : itsResource(std::move(resource)),
+      itsLoggingDir(std::move(accessLogDir)),
+      itsFileName(::makeAccessLogFileName(itsResource, itsLoggingDir)),
+      itsOptions(options),
+      itsQueue(std::make_unique<Queue>(std::max(16U, options.queue_size)))
+{
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Open the log file, creating the directory if necessary
+ */
+// ----------------------------------------------------------------------
+
+void AccessLogger::open()
 {
   try
   {
     // Create the log directory if it is missing
-    if (!std::filesystem::exists(accessLogDir))
+    if (!std::filesystem::exists(itsLoggingDir))
     {
       std::cout << SmartMet::Spine::log_time_str() << " creating access log directory "
-                << accessLogDir << std::endl;
-      std::filesystem::create_directories(accessLogDir);
+                << itsLoggingDir << std::endl;
+      std::filesystem::create_directories(itsLoggingDir);
     }
 
     // Error if the path is not a directory
-    if (!std::filesystem::is_directory(accessLogDir))
-      throw std::runtime_error("Access log path '" + accessLogDir + "' is not a directory");
-
-    // Otherwise create a log file in the directory
-    std::string path = ::makeAccessLogFileName(resource, accessLogDir);
+    if (!std::filesystem::is_directory(itsLoggingDir))
+      throw std::runtime_error("Access log path '" + itsLoggingDir + "' is not a directory");
 
-    std::unique_ptr<std::ofstream> file(new std::ofstream());
-    const auto flags = file->exceptions();
-    file->exceptions(std::ofstream::failbit | std::ofstream::badbit);
-    try // Open the file
+    int fd = ::open(itsFileName.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
     {
-      file->open(path, std::ofstream::out | std::ofstream::app);
-    }
-    catch (const std::system_error& e)
-    {
-      char err_msg[128];
-      Fmi::Exception error(BCP, "Could not open access log file: " + path);
-      error.addParameter("Reason", strerror_r(errno, err_msg, sizeof(err_msg)));
+      Fmi::Exception error(BCP, "Could not open access log file: " + itsFileName);
+      error.addParameter("Reason", errorString(errno));
       throw error;
     }
 
-    file->exceptions(flags);
-
-    return file;
+    struct stat st;
+    itsFileSize = (fstat(fd, &st) == 0 ? st.st_size : 0);
+    itsFileOpened = std::chrono::steady_clock::now();
+    itsFd = fd;
   }
   catch (...)
   {
     throw Fmi::Exception::Trace(BCP, "Operation failed!");
   }
 }
-}  // namespace
 
-namespace SmartMet
-{
-namespace Spine
-{
-AccessLogger::AccessLogger(std::string resource, std::string accessLogDir)
-    : itsResource(std::move(resource)), itsLoggingDir(std::move(accessLogDir))
+// ----------------------------------------------------------------------
+/*!
+ * \brief Close the log file
+ */
+// ----------------------------------------------------------------------
+
+void AccessLogger::close()
 {
+  if (itsFd >= 0)
+  {
+    ::close(itsFd);
+    itsFd = -1;
+  }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Start accepting requests
+ *
+ * The writer thread is started only once, it opens the file itself.
+ */
+// ----------------------------------------------------------------------
+
 void AccessLogger::start()
 {
   try
   {
-    itsFileHandle = ::makeAccessLogFile(itsResource, itsLoggingDir);
+    std::lock_guard<std::mutex> lock(itsStartStopMutex);
+    itsEnabled = true;
+    if (itsIsRunning)
+      return;
 
+    itsStopRequested = false;
     itsIsRunning = true;
+    itsWriterThread = std::thread(&AccessLogger::run, this);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void AccessLogger::pause()
+{
+  try
+  {
+    itsEnabled = false;
+    flush();
   }
   catch (...)
   {
@@ -111,8 +308,20 @@ void AccessLogger::stop()
 {
   try
   {
-    if (itsFileHandle && itsFileHandle->is_open())
-      itsFileHandle->close();
+    std::lock_guard<std::mutex> lock(itsStartStopMutex);
+    itsEnabled = false;
+    if (!itsIsRunning)
+      return;
+
+    {
+      std::lock_guard<std::mutex> wakeup_lock(itsWakeupMutex);
+      itsStopRequested = true;
+    }
+    itsWakeup.notify_one();
+
+    // The writer thread drains the queue and closes the file before exiting
+    if (itsWriterThread.joinable())
+      itsWriterThread.join();
 
     itsIsRunning = false;
   }
@@ -135,30 +344,31 @@ AccessLogger::~AccessLogger()
 }
 
 void AccessLogger::log(const LoggedRequest& theRequest)
+{
+  // Copy only if the request will be queued
+  if (itsEnabled)
+    log(LoggedRequest(theRequest));
+}
+
+void AccessLogger::log(LoggedRequest&& theRequest)
 {
   try
   {
-    if (!itsIsRunning || !itsFileHandle)
+    if (!itsEnabled)
+    {
+      // Trying to log into a paused or stopped logger
+      return;
+    }
+
+    if (!itsQueue->push(std::move(theRequest)))
     {
-      // Trying to log into a stopped logger
+      ++itsDropped;
       return;
     }
 
-    const std::string msg =
-      fmt::format("{} - - [{}] \"{} {} HTTP/{}\" {} [{}] {} {} {} {}\n",
-                  theRequest.getIP(),
-                  Fmi::to_iso_extended_string(theRequest.getRequestEndTime()),
-                  theRequest.getMethod(),
-                  theRequest.getRequestString(),
-                  theRequest.getVersion(),
-                  theRequest.getStatus(),
-                  Fmi::to_iso_extended_string(theRequest.getRequestStartTime()),
-                  theRequest.getAccessDuration().total_milliseconds(),
-                  theRequest.getContentLength(),
-                  theRequest.getETag(),
-                  theRequest.getApiKey());
-
-    *itsFileHandle << msg;
+    // Wake up the writer early if the queue is filling up
+    if (itsQueue->size() >= itsQueue->capacity() / 2 && !itsFlushRequested.exchange(true))
+      flush();
   }
   catch (...)
   {
@@ -170,8 +380,11 @@ void AccessLogger::flush()
 {
   try
   {
-    if (itsFileHandle)
-      itsFileHandle->flush();
+    {
+      std::lock_guard<std::mutex> lock(itsWakeupMutex);
+      itsFlushRequested = true;
+    }
+    itsWakeup.notify_one();
   }
   catch (...)
   {
@@ -179,5 +392,227 @@ void AccessLogger::flush()
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether the log file should be rotated
+ */
+// ----------------------------------------------------------------------
+
+bool AccessLogger::rotationNeeded() const
+{
+  if (itsOptions.rotate_size_mb > 0 &&
+      itsFileSize >= static_cast<std::uint64_t>(itsOptions.rotate_size_mb) * 1024 * 1024)
+    return true;
+
+  if (itsOptions.rotate_interval > 0 &&
+      std::chrono::steady_clock::now() - itsFileOpened >=
+          std::chrono::seconds(itsOptions.rotate_interval))
+    return true;
+
+  return false;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Rename the current log file with a timestamp suffix and reopen
+ *
+ * Called by the writer thread between batches, queued requests simply
+ * go into the new file.
+ */
+// ----------------------------------------------------------------------
+
+void AccessLogger::rotate()
+{
+  try
+  {
+    close();
+
+    const std::string stamp = Fmi::to_iso_string(Fmi::SecondClock::local_time());
+    std::string target = itsFileName + "." + stamp;
+    for (int i = 1; std::filesystem::exists(target); i++)
+      target = itsFileName + "." + stamp + "-" + std::to_string(i);
+
+    std::error_code ec;
+    std::filesystem::rename(itsFileName, target, ec);
+    if (ec)
+      std::cerr << log_time_str() << " failed to rotate access log " << itsFileName << ": "
+                << ec.message() << std::endl;
+    else
+      ++itsRotations;
+
+    open();
+  }
+  catch (...)
+  {
+    // Reopening is retried before the next write
+    std::cerr << Fmi::Exception::Trace(BCP, "Access log rotation failed").getStackTrace()
+              << std::endl;
+    itsFileOpened = std::chrono::steady_clock::now();
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write a batch of formatted requests with a single write call
+ *
+ * Partial writes are completed, on errors the requests in the batch are
+ * counted as dropped. Errors are reported only once until writing
+ * succeeds again to avoid flooding the console.
+ */
+// ----------------------------------------------------------------------
+
+bool AccessLogger::write(const std::string& theBuffer, std::size_t theCount)
+{
+  if (itsFd < 0)
+  {
+    try
+    {
+      open();
+    }
+    catch (...)
+    {
+      if (!itsWriteFailed)
+        std::cerr << Fmi::Exception::Trace(BCP, "Failed to reopen access log").getStackTrace()
+                  << std::endl;
+      itsWriteFailed = true;
+      itsDropped += theCount;
+      return false;
+    }
+  }
+
+  const char* ptr = theBuffer.data();
+  std::size_t remaining = theBuffer.size();
+  while (remaining > 0)
+  {
+    const auto n = ::write(itsFd, ptr, remaining);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      if (!itsWriteFailed)
+        std::cerr << log_time_str() << " failed to write access log " << itsFileName << ": "
+                  << errorString(errno) << std::endl;
+      itsWriteFailed = true;
+      itsDropped += theCount;
+      return false;
+    }
+    ptr += n;
+    remaining -= n;
+  }
+
+  itsWriteFailed = false;
+  itsFileSize += theBuffer.size();
+  itsBytes += theBuffer.size();
+  itsWritten += theCount;
+  ++itsBatches;
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The writer thread
+ */
+// ----------------------------------------------------------------------
+
+void AccessLogger::run()
+{
+  try
+  {
+    const auto interval = std::chrono::milliseconds(std::max(1U, itsOptions.flush_interval_ms));
+
+    TimestampCache end_cache;
+    TimestampCache start_cache;
+    std::string end_stamp;
+    std::string start_stamp;
+    std::string buffer;
+    buffer.reserve(max_batch_size + 4096);
+    std::size_t count = 0;
+
+    auto format = [&](const LoggedRequest& theRequest)
+    {
+      end_cache.format(end_stamp, theRequest.getRequestEndTime());
+      start_cache.format(start_stamp, theRequest.getRequestStartTime());
+
+      fmt::format_to(std::back_inserter(buffer),
+                     "{} - - [{}] \"{} {} HTTP/{}\" {} [{}] {} {} {} {}\n",
+                     theRequest.getIP(),
+                     end_stamp,
+                     theRequest.getMethod(),
+                     theRequest.getRequestString(),
+                     theRequest.getVersion(),
+                     theRequest.getStatus(),
+                     start_stamp,
+                     theRequest.getAccessDuration().total_milliseconds(),
+                     theRequest.getContentLength(),
+                     theRequest.getETag(),
+                     theRequest.getApiKey());
+      ++count;
+    };
+
+    // Rotation happens only between batches so that no line is split
+    auto write_batch = [&]()
+    {
+      if (rotationNeeded())
+        rotate();
+      write(buffer, count);
+      buffer.clear();
+      count = 0;
+    };
+
+    while (true)
+    {
+      {
+        std::unique_lock<std::mutex> lock(itsWakeupMutex);
+        itsWakeup.wait_for(lock, interval, [this] { return itsStopRequested || itsFlushRequested; });
+        itsFlushRequested = false;
+      }
+
+      const bool stopping = itsStopRequested;
+
+      while (itsQueue->pop(format))
+      {
+        if (buffer.size() >= max_batch_size)
+          write_batch();
+      }
+
+      if (count > 0)
+        write_batch();
+      else if (itsFd >= 0 && rotationNeeded())
+        rotate();
+
+      // The file is reopened by the next write once logging is resumed
+      if (stopping || !itsEnabled)
+        close();
+
+      if (stopping)
+        break;
+    }
+  }
+  catch (...)
+  {
+    std::cerr << Fmi::Exception::Trace(BCP, "Access log writer thread failed").getStackTrace()
+              << std::endl;
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return writer statistics
+ */
+// ----------------------------------------------------------------------
+
+AccessLogger::Statistics AccessLogger::getStatistics() const
+{
+  Statistics stats;
+  stats.running = itsEnabled;
+  stats.queued = itsQueue->size();
+  stats.written = itsWritten;
+  stats.dropped = itsDropped;
+  stats.bytes = itsBytes;
+  stats.rotations = itsRotations;
+  stats.batches = itsBatches;
+  return stats;
+}
+
 }  // namespace Spine
 }  // namespace SmartMet
@@ -1,37 +1,118 @@
 #pragma once
 #include "LoggedRequest.h"
-#include <fstream>
-#include <list>
+#include "Options.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 
 namespace SmartMet
 {
 namespace Spine
 {
 // AccessLogger handles a file for access logs and rotation
+//
+// log() only moves the request into a bounded queue and returns, a
+// dedicated writer thread formats the queued requests in batches and
+// writes each batch with a single write call. If the writer cannot keep
+// up (for example because the disk stalls) the queue fills up and further
+// requests are counted as dropped instead of blocking the caller.
+//
+// The writer thread rotates the file by size and/or age between batches,
+// hence no queued entries are lost in the rotation. It also opens and
+// closes the file, and stays alive while logging is paused so that
+// toggling logging never waits for it.
+
 class AccessLogger
 {
  public:
-  AccessLogger(std::string resource, std::string accessLogDir);
+  struct Statistics
+  {
+    bool running = false;
+    std::size_t queued = 0;        // requests waiting for the writer thread
+    std::uint64_t written = 0;     // requests written to disk
+    std::uint64_t dropped = 0;     // requests dropped due to a full queue or a write error
+    std::uint64_t bytes = 0;       // bytes written to disk
+    std::uint64_t rotations = 0;   // number of file rotations
+    std::uint64_t batches = 0;     // number of write calls
+  };
+
+  AccessLogger(std::string resource,
+               std::string accessLogDir,
+               const AccessLogOptions& options = AccessLogOptions());
 
   ~AccessLogger();
 
+  AccessLogger(const AccessLogger& other) = delete;
+  AccessLogger(AccessLogger&& other) = delete;
+  AccessLogger& operator=(const AccessLogger& other) = delete;
+  AccessLogger& operator=(AccessLogger&& other) = delete;
+
+  // Never blocks on I/O
   void log(const LoggedRequest& theRequest);
+  void log(LoggedRequest&& theRequest);
 
+  // Start accepting requests, starting the writer thread if necessary
   void start();
 
+  // Stop accepting requests. The writer thread writes the queued requests
+  // and closes the file, but keeps running. Does not wait.
+  void pause();
+
+  // Write all queued requests, stop the writer thread and close the file
   void stop();
 
+  // Ask the writer thread to write all queued requests now. Does not wait.
   void flush();
 
+  Statistics getStatistics() const;
+
+  const std::string& getFileName() const { return itsFileName; }
+
  private:
+  class Queue;
+
+  void run();
+  void open();
+  void close();
+  void rotate();
+  bool rotationNeeded() const;
+  bool write(const std::string& theBuffer, std::size_t theCount);
+
   std::string itsResource;
 
   std::string itsLoggingDir;
 
-  std::unique_ptr<std::ofstream> itsFileHandle;
+  std::string itsFileName;
+
+  AccessLogOptions itsOptions;
+
+  std::unique_ptr<Queue> itsQueue;
+
+  // Owned by the writer thread while it is running
+  int itsFd = -1;
+  std::uint64_t itsFileSize = 0;
+  std::chrono::steady_clock::time_point itsFileOpened;
+  bool itsWriteFailed = false;
+
+  std::thread itsWriterThread;
+  std::mutex itsStartStopMutex;
+  std::mutex itsWakeupMutex;
+  std::condition_variable itsWakeup;
+  std::atomic<bool> itsIsRunning{false};  // the writer thread is running
+  std::atomic<bool> itsEnabled{false};    // requests are accepted
+  std::atomic<bool> itsStopRequested{false};
+  std::atomic<bool> itsFlushRequested{false};
 
-  bool itsIsRunning = false;
+  std::atomic<std::uint64_t> itsWritten{0};
+  std::atomic<std::uint64_t> itsDropped{0};
+  std::atomic<std::uint64_t> itsBytes{0};
+  std::atomic<std::uint64_t> itsRotations{0};
+  std::atomic<std::uint64_t> itsBatches{0};
 };
 
 }  // namespace Spine
@@ -7,7 +7,7 @@ namespace Spine
 {
 namespace
 {
-MutexType myMutex;
+NamedMutexType myMutex{"ActiveBackends"};
 }
 
 // ----------------------------------------------------------------------
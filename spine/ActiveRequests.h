@@ -45,7 +45,7 @@ class ActiveRequests
   std::size_t counter() const;  // how many requests have completed
 
  private:
-  mutable MutexType itsMutex;
+  mutable NamedMutexType itsMutex{"ActiveRequests"};
   std::atomic<std::size_t> itsStartedCounter{0};   // number of started requests
   std::atomic<std::size_t> itsFinishedCounter{0};  // number of completed requests
   Requests itsRequests;
@@ -0,0 +1,346 @@
+#include "BackendCircuitBreaker.h"
+#include <macgyver/Exception.h>
+
+namespace SmartMet
+{
+namespace Spine
+{
+namespace
+{
+// Upper limit for remembered admissions per backend
+const std::size_t max_admitted = 10000;
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Construct from options
+ */
+// ----------------------------------------------------------------------
+
+BackendCircuitBreaker::BackendCircuitBreaker(const Options& theOptions) : itsOptions(theOptions)
+{
+  if (itsOptions.enabled &&
+      (itsOptions.failure_threshold == 0 || itsOptions.probes == 0 ||
+       itsOptions.success_threshold == 0 || itsOptions.probe_seconds == 0))
+    throw Fmi::Exception(BCP, "Circuit breaker thresholds must be > 0")
+        .addParameter("failure_threshold", std::to_string(itsOptions.failure_threshold))
+        .addParameter("probes", std::to_string(itsOptions.probes))
+        .addParameter("success_threshold", std::to_string(itsOptions.success_threshold))
+        .addParameter("probe_seconds", std::to_string(itsOptions.probe_seconds));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Name of a breaker state for admin output
+ */
+// ----------------------------------------------------------------------
+
+std::string BackendCircuitBreaker::stateName(State theState)
+{
+  switch (theState)
+  {
+    case State::Closed:
+      return "closed";
+    case State::Open:
+      return "open";
+    case State::HalfOpen:
+      return "half-open";
+  }
+  return "unknown";
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find the breaker of a backend, or nullptr if there is none
+ */
+// ----------------------------------------------------------------------
+
+BackendCircuitBreaker::BreakerPtr BackendCircuitBreaker::find(const std::string& theHost,
+                                                              int thePort) const
+{
+  ReadLock lock(itsMutex);
+  auto pos = itsBreakers.find(Backend(theHost, thePort));
+  if (pos == itsBreakers.end())
+    return {};
+  return pos->second;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find the breaker of a backend, creating it if necessary
+ */
+// ----------------------------------------------------------------------
+
+BackendCircuitBreaker::BreakerPtr BackendCircuitBreaker::findOrCreate(const std::string& theHost,
+                                                                      int thePort)
+{
+  auto breaker = find(theHost, thePort);
+  if (breaker)
+    return breaker;
+
+  WriteLock lock(itsMutex);
+  auto& ptr = itsBreakers[Backend(theHost, thePort)];
+  if (!ptr)
+    ptr = std::make_shared<Breaker>();
+  return ptr;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Open the breaker
+ *
+ * Calls still in flight are forgotten, their outcomes will be ignored.
+ */
+// ----------------------------------------------------------------------
+
+void BackendCircuitBreaker::trip(Breaker& theBreaker, Clock::time_point theTime) const
+{
+  theBreaker.state = State::Open;
+  theBreaker.since = theTime;
+  theBreaker.admitted.clear();
+  theBreaker.probe_successes = 0;
+  ++theBreaker.trips;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Close the breaker
+ *
+ * Probes still in flight are counted as normal calls when they finish.
+ */
+// ----------------------------------------------------------------------
+
+void BackendCircuitBreaker::close(Breaker& theBreaker, Clock::time_point theTime) const
+{
+  theBreaker.state = State::Closed;
+  theBreaker.since = theTime;
+  theBreaker.probe_successes = 0;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether an open breaker is still in its cool-down period
+ */
+// ----------------------------------------------------------------------
+
+bool BackendCircuitBreaker::coolingDown(const Breaker& theBreaker,
+                                        Clock::time_point theTime) const
+{
+  return theTime - theBreaker.since < std::chrono::seconds(itsOptions.open_seconds);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether the oldest probe of a half-open breaker has timed out
+ */
+// ----------------------------------------------------------------------
+
+bool BackendCircuitBreaker::probeExpired(const Breaker& theBreaker,
+                                         Clock::time_point theTime) const
+{
+  return (theBreaker.state == State::HalfOpen && !theBreaker.admitted.empty() &&
+          theTime - theBreaker.admitted.front() >= std::chrono::seconds(itsOptions.probe_seconds));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Ask permission to send a request to a backend
+ */
+// ----------------------------------------------------------------------
+
+bool BackendCircuitBreaker::allow(const std::string& theHost, int thePort)
+{
+  if (!itsOptions.enabled)
+    return true;
+
+  auto ptr = findOrCreate(theHost, thePort);
+  auto& breaker = *ptr;
+
+  const auto now = Clock::now();
+
+  std::lock_guard<std::mutex> lock(breaker.mutex);
+
+  if (breaker.state == State::Open)
+  {
+    if (coolingDown(breaker, now))
+      return false;
+    breaker.state = State::HalfOpen;
+    breaker.since = now;
+    breaker.probe_successes = 0;
+  }
+
+  if (breaker.state == State::HalfOpen)
+  {
+    // A probe which never finished is a failed probe
+    if (probeExpired(breaker, now))
+    {
+      ++breaker.failures;
+      ++breaker.consecutive_failures;
+      trip(breaker, now);
+      return false;
+    }
+    if (breaker.admitted.size() >= itsOptions.probes)
+      return false;
+  }
+
+  // Protect against callers which never report the outcome
+  if (breaker.admitted.size() >= max_admitted)
+    breaker.admitted.pop_front();
+
+  breaker.admitted.push_back(now);
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether a request would be allowed without reserving a probe
+ *
+ * A half-open breaker whose probe has timed out is reported available so
+ * that the next allow() call gets to reopen it.
+ */
+// ----------------------------------------------------------------------
+
+bool BackendCircuitBreaker::available(const std::string& theHost, int thePort) const
+{
+  if (!itsOptions.enabled)
+    return true;
+
+  auto ptr = find(theHost, thePort);
+  if (!ptr)
+    return true;
+
+  const auto& breaker = *ptr;
+  const auto now = Clock::now();
+
+  std::lock_guard<std::mutex> lock(breaker.mutex);
+  switch (breaker.state)
+  {
+    case State::Closed:
+      return true;
+    case State::Open:
+      return !coolingDown(breaker, now);
+    case State::HalfOpen:
+      return (probeExpired(breaker, now) || breaker.admitted.size() < itsOptions.probes);
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Record the outcome of a backend request
+ */
+// ----------------------------------------------------------------------
+
+void BackendCircuitBreaker::record(const std::string& theHost,
+                                   int thePort,
+                                   bool theError,
+                                   std::optional<std::chrono::microseconds> theLatency)
+{
+  if (!itsOptions.enabled)
+    return;
+
+  auto ptr = find(theHost, thePort);
+  if (!ptr)
+    return;
+
+  auto& breaker = *ptr;
+  const auto now = Clock::now();
+
+  std::lock_guard<std::mutex> lock(breaker.mutex);
+
+  // Ignore calls which were not admitted, or were forgotten when the breaker opened
+  if (breaker.admitted.empty())
+    return;
+
+  const auto admitted = breaker.admitted.front();
+  breaker.admitted.pop_front();
+
+  bool failed = theError;
+  if (!failed && itsOptions.slow_call_ms > 0)
+  {
+    const auto latency =
+        (theLatency ? *theLatency
+                    : std::chrono::duration_cast<std::chrono::microseconds>(now - admitted));
+    failed = (latency > std::chrono::milliseconds(itsOptions.slow_call_ms));
+  }
+
+  if (failed)
+  {
+    ++breaker.failures;
+    ++breaker.consecutive_failures;
+  }
+  else
+    breaker.consecutive_failures = 0;
+
+  switch (breaker.state)
+  {
+    case State::Closed:
+    {
+      if (breaker.consecutive_failures >= itsOptions.failure_threshold)
+        trip(breaker, now);
+      break;
+    }
+    case State::HalfOpen:
+    {
+      if (failed)
+        trip(breaker, now);
+      else if (++breaker.probe_successes >= itsOptions.success_threshold)
+        close(breaker, now);
+      break;
+    }
+    case State::Open:
+    {
+      // Cannot happen, opening the breaker forgets the admitted calls
+      break;
+    }
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remove a breaker. Ignore request if there is no such breaker
+ */
+// ----------------------------------------------------------------------
+
+void BackendCircuitBreaker::remove(const std::string& theHost, int thePort)
+{
+  WriteLock lock(itsMutex);
+  itsBreakers.erase(Backend(theHost, thePort));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return a snapshot of all breakers
+ */
+// ----------------------------------------------------------------------
+
+BackendCircuitBreaker::Status BackendCircuitBreaker::status() const
+{
+  Status ret;
+
+  const auto now = Clock::now();
+
+  ReadLock lock(itsMutex);
+  ret.reserve(itsBreakers.size());
+  for (const auto& item : itsBreakers)
+  {
+    const auto& breaker = *item.second;
+    std::lock_guard<std::mutex> breaker_lock(breaker.mutex);
+    Info info;
+    info.host = item.first.first;
+    info.port = item.first.second;
+    info.state = breaker.state;
+    info.consecutive_failures = breaker.consecutive_failures;
+    info.admitted = static_cast<unsigned int>(breaker.admitted.size());
+    info.probes = (breaker.state == State::HalfOpen ? info.admitted : 0);
+    info.probe_successes = breaker.probe_successes;
+    info.failures = breaker.failures;
+    info.trips = breaker.trips;
+    info.age = now - breaker.since;
+    ret.push_back(info);
+  }
+  return ret;
+}
+
+}  // namespace Spine
+}  // namespace SmartMet
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "Thread.h"
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Spine
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Circuit breakers for backend servers
+ *
+ * Each backend (host, port) has a breaker with three states:
+ *
+ *   closed    - requests flow normally. Consecutive failures are counted
+ *               and once they reach the threshold the breaker opens.
+ *   open      - requests are refused until the cool-down period is over,
+ *               after which the breaker becomes half-open.
+ *   half-open - a limited number of probe requests are let through. If
+ *               enough of them succeed the breaker closes, a single
+ *               failure opens it again for another cool-down period.
+ *               A probe which has not finished within the probe timeout
+ *               counts as a failure.
+ *
+ * Outcomes are reported from the backend connection finished hooks: a
+ * final status other than StreamerStatus::EXIT_OK or a response slower
+ * than the configured slow call limit counts as a failure.
+ *
+ * Only calls admitted by allow() are counted. The breaker remembers the
+ * admission times of the calls in flight, and record() matches outcomes
+ * to them in admission order. Outcomes with no admitted call to match,
+ * for example late responses to calls sent before the breaker opened,
+ * are ignored. When the caller does not measure the latency, the time
+ * since the matched admission is used for the slow call check.
+ *
+ * All operations are no-ops (and allow() always succeeds) when the
+ * breakers have not been enabled in the configuration.
+ */
+// ----------------------------------------------------------------------
+
+class BackendCircuitBreaker
+{
+ public:
+  // Configured via the "circuitbreaker" group in the server configuration
+  struct Options
+  {
+    bool enabled = false;
+    unsigned int failure_threshold = 5;  // consecutive failures which open the breaker
+    unsigned int open_seconds = 30;      // cool-down before probing a failed backend
+    unsigned int probes = 1;             // simultaneous probe requests when half-open
+    unsigned int success_threshold = 2;  // successful probes needed to close the breaker
+    unsigned int slow_call_ms = 0;       // slower responses count as failures, 0 = disabled
+    unsigned int probe_seconds = 30;     // unfinished probes older than this count as failures
+  };
+
+  enum class State
+  {
+    Closed,
+    Open,
+    HalfOpen
+  };
+
+  // Snapshot of the state of one breaker
+  struct Info
+  {
+    std::string host;
+    int port = 0;
+    State state = State::Closed;
+    unsigned int consecutive_failures = 0;
+    unsigned int admitted = 0;  // admitted calls in flight, including probes
+    unsigned int probes = 0;
+    unsigned int probe_successes = 0;
+    std::uint64_t failures = 0;
+    std::uint64_t trips = 0;
+    std::chrono::steady_clock::duration age{};  // time spent in the current state
+  };
+
+  using Status = std::vector<Info>;
+
+  BackendCircuitBreaker() = default;
+  explicit BackendCircuitBreaker(const Options& theOptions);
+  BackendCircuitBreaker(const BackendCircuitBreaker& other) = delete;
+  BackendCircuitBreaker(BackendCircuitBreaker&& other) = delete;
+  BackendCircuitBreaker& operator=(const BackendCircuitBreaker& other) = delete;
+  BackendCircuitBreaker& operator=(BackendCircuitBreaker&& other) = delete;
+
+  bool enabled() const { return itsOptions.enabled; }
+
+  // Ask permission to send a request. A successful call must be followed by record().
+  // In half-open state this reserves a probe slot which is released when the outcome
+  // is recorded or the probe times out.
+  bool allow(const std::string& theHost, int thePort);
+
+  // Would a request be allowed? Does not reserve a probe slot.
+  bool available(const std::string& theHost, int thePort) const;
+
+  // Record the outcome of a request admitted by allow()
+  void record(const std::string& theHost,
+              int thePort,
+              bool theError,
+              std::optional<std::chrono::microseconds> theLatency = std::nullopt);
+
+  // Forget a backend (for example when it is removed from the cluster)
+  void remove(const std::string& theHost, int thePort);
+
+  Status status() const;
+
+  static std::string stateName(State theState);
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Breaker
+  {
+    mutable std::mutex mutex;  // guards all the members below
+    State state = State::Closed;
+    Clock::time_point since = Clock::now();
+    std::deque<Clock::time_point> admitted;  // admission times of calls in flight
+    unsigned int consecutive_failures = 0;
+    unsigned int probe_successes = 0;
+    std::uint64_t failures = 0;
+    std::uint64_t trips = 0;
+  };
+
+  using Backend = std::pair<std::string, int>;
+  using BreakerPtr = std::shared_ptr<Breaker>;
+
+  BreakerPtr find(const std::string& theHost, int thePort) const;
+  BreakerPtr findOrCreate(const std::string& theHost, int thePort);
+
+  void trip(Breaker& theBreaker, Clock::time_point theTime) const;
+  void close(Breaker& theBreaker, Clock::time_point theTime) const;
+  bool coolingDown(const Breaker& theBreaker, Clock::time_point theTime) const;
+  bool probeExpired(const Breaker& theBreaker, Clock::time_point theTime) const;
+
+  Options itsOptions;
+
+  // The map is modified only when a backend is seen for the first time or removed
+  mutable NamedMutexType itsMutex{"BackendCircuitBreaker"};
+  std::map<Backend, BreakerPtr> itsBreakers;
+};
+
+}  // namespace Spine
+}  // namespace SmartMet
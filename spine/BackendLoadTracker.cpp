@@ -0,0 +1,299 @@
+#include "BackendLoadTracker.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+#include <random>
+
+namespace SmartMet
+{
+namespace Spine
+{
+namespace
+{
+// Lock free EWMA update. A zero average is taken to mean "no samples yet",
+// in which case the first sample is used as is.
+void update_ewma(std::atomic<double>& theAverage, double theSample, double theAlpha)
+{
+  double old_value = theAverage.load(std::memory_order_relaxed);
+  double new_value = 0;
+  do
+  {
+    new_value = (old_value == 0 ? theSample : old_value + theAlpha * (theSample - old_value));
+  } while (!theAverage.compare_exchange_weak(old_value, new_value, std::memory_order_relaxed));
+}
+
+// Upper limit for remembered start times per backend
+const std::size_t max_started = 10000;
+
+std::mt19937& random_generator()
+{
+  thread_local std::mt19937 generator{std::random_device{}()};
+  return generator;
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Construct with non-default options
+ */
+// ----------------------------------------------------------------------
+
+BackendLoadTracker::BackendLoadTracker(const Options& theOptions) : itsOptions(theOptions)
+{
+  if (itsOptions.alpha <= 0 || itsOptions.alpha > 1)
+    throw Fmi::Exception(BCP, "Backend load EWMA smoothing factor must be in range (0,1]")
+        .addParameter("alpha", std::to_string(itsOptions.alpha));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find the entry for a backend, or nullptr if there is none
+ */
+// ----------------------------------------------------------------------
+
+BackendLoadTracker::EntryPtr BackendLoadTracker::find(const std::string& theHost,
+                                                      int thePort) const
+{
+  ReadLock lock(itsMutex);
+  auto pos = itsBackends.find(Backend(theHost, thePort));
+  if (pos == itsBackends.end())
+    return {};
+  return pos->second;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find the entry for a backend, creating it if necessary
+ */
+// ----------------------------------------------------------------------
+
+BackendLoadTracker::EntryPtr BackendLoadTracker::findOrCreate(const std::string& theHost,
+                                                              int thePort)
+{
+  auto entry = find(theHost, thePort);
+  if (entry)
+    return entry;
+
+  WriteLock lock(itsMutex);
+  auto& ptr = itsBackends[Backend(theHost, thePort)];
+  if (!ptr)
+    ptr = std::make_shared<Entry>();
+  return ptr;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Start a request
+ */
+// ----------------------------------------------------------------------
+
+void BackendLoadTracker::start(const std::string& theHost, int thePort)
+{
+  auto entry = findOrCreate(theHost, thePort);
+  ++entry->inflight;
+
+  std::lock_guard<std::mutex> lock(entry->mutex);
+  // Protect against callers which never report the outcome
+  if (entry->started.size() >= max_started)
+    entry->started.pop_front();
+  entry->started.push_back(std::chrono::steady_clock::now());
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Stop a request
+ */
+// ----------------------------------------------------------------------
+
+void BackendLoadTracker::stop(const std::string& theHost, int thePort)
+{
+  auto entry = find(theHost, thePort);
+  if (!entry)
+    return;
+
+  // Safety check against unbalanced calls, as in ActiveBackends
+  long n = entry->inflight.load();
+  while (n > 0 && !entry->inflight.compare_exchange_weak(n, n - 1))
+  {
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Reset the in-flight count of a backend
+ */
+// ----------------------------------------------------------------------
+
+void BackendLoadTracker::reset(const std::string& theHost, int thePort)
+{
+  auto entry = find(theHost, thePort);
+  if (!entry)
+    return;
+
+  entry->inflight = 0;
+  std::lock_guard<std::mutex> lock(entry->mutex);
+  entry->started.clear();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Forget a backend. Ignore request if there is no such backend
+ */
+// ----------------------------------------------------------------------
+
+void BackendLoadTracker::remove(const std::string& theHost, int thePort)
+{
+  WriteLock lock(itsMutex);
+  itsBackends.erase(Backend(theHost, thePort));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Record the outcome of a finished backend request
+ */
+// ----------------------------------------------------------------------
+
+void BackendLoadTracker::finished(const std::string& theHost,
+                                  int thePort,
+                                  bool theError,
+                                  std::optional<std::chrono::microseconds> theLatency)
+{
+  auto entry = findOrCreate(theHost, thePort);
+
+  {
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    if (!entry->started.empty())
+    {
+      if (!theLatency)
+        theLatency = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - entry->started.front());
+      entry->started.pop_front();
+    }
+  }
+
+  ++entry->requests;
+  if (theError)
+    ++entry->errors;
+
+  // The error rate starts from zero, hence we cannot use the zero-means-empty
+  // convention of update_ewma for it
+  double old_rate = entry->error_rate.load(std::memory_order_relaxed);
+  const double sample = (theError ? 1.0 : 0.0);
+  while (!entry->error_rate.compare_exchange_weak(
+      old_rate, old_rate + itsOptions.alpha * (sample - old_rate), std::memory_order_relaxed))
+  {
+  }
+
+  if (theLatency)
+  {
+    // Make sure a genuine zero latency sample does not reset the average
+    const double ms = std::max(0.001, theLatency->count() / 1000.0);
+    update_ewma(entry->latency_ms, ms, itsOptions.alpha);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Load score of a backend entry
+ *
+ * The expected wait for a new request is roughly the latency times the
+ * number of requests queued in front of it. Errors inflate the score so
+ * that a backend failing fast does not attract even more traffic.
+ */
+// ----------------------------------------------------------------------
+
+double BackendLoadTracker::score(const Entry& theEntry) const
+{
+  double latency = theEntry.latency_ms.load(std::memory_order_relaxed);
+  if (latency == 0)
+    latency = itsOptions.default_latency_ms;
+
+  const auto inflight = static_cast<double>(std::max(0L, theEntry.inflight.load()));
+  const double errors = theEntry.error_rate.load(std::memory_order_relaxed);
+
+  return latency * (inflight + 1) * (1 + itsOptions.error_penalty * errors);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Load score of a backend, lower is better
+ */
+// ----------------------------------------------------------------------
+
+double BackendLoadTracker::score(const std::string& theHost, int thePort) const
+{
+  auto entry = find(theHost, thePort);
+  if (entry)
+    return score(*entry);
+
+  // Unknown backends are assumed to be idle
+  return itsOptions.default_latency_ms;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Choose a backend using the power of two choices
+ */
+// ----------------------------------------------------------------------
+
+std::optional<std::size_t> BackendLoadTracker::pick(const Backends& theCandidates) const
+{
+  try
+  {
+    const auto n = theCandidates.size();
+    if (n == 0)
+      return {};
+    if (n == 1)
+      return 0;
+
+    auto& gen = random_generator();
+    std::uniform_int_distribution<std::size_t> first_dist(0, n - 1);
+    std::uniform_int_distribution<std::size_t> second_dist(0, n - 2);
+
+    const auto i = first_dist(gen);
+    auto j = second_dist(gen);
+    if (j >= i)
+      ++j;  // two distinct candidates
+
+    const auto& a = theCandidates[i];
+    const auto& b = theCandidates[j];
+
+    return (score(b.first, b.second) < score(a.first, a.second) ? j : i);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return a snapshot of all backends
+ */
+// ----------------------------------------------------------------------
+
+BackendLoadTracker::Status BackendLoadTracker::status() const
+{
+  Status ret;
+
+  ReadLock lock(itsMutex);
+  ret.reserve(itsBackends.size());
+  for (const auto& item : itsBackends)
+  {
+    const auto& entry = *item.second;
+    Load load;
+    load.host = item.first.first;
+    load.port = item.first.second;
+    load.inflight = entry.inflight;
+    load.latency_ms = entry.latency_ms;
+    load.error_rate = entry.error_rate;
+    load.requests = entry.requests;
+    load.errors = entry.errors;
+    load.score = score(entry);
+    ret.push_back(load);
+  }
+  return ret;
+}
+
+}  // namespace Spine
+}  // namespace SmartMet
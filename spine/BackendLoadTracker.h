@@ -0,0 +1,127 @@
+#pragma once
+
+#include "Thread.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Spine
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Track the load of backend servers for least-loaded routing
+ *
+ * Unlike ActiveBackends, which only counts in-flight requests, this
+ * tracker also keeps an exponentially weighted moving average (EWMA)
+ * of the response latency and of the error rate for each backend.
+ *
+ * The map of backends is guarded by a shared mutex which is taken in
+ * exclusive mode only when a new backend is seen for the first time
+ * or when one is removed. The counters are atomics on the per-backend
+ * entries. The start times of the requests in flight are kept in a
+ * queue behind a per-backend mutex, held only for a push or a pop.
+ *
+ * When the caller does not measure the latency of a finished request,
+ * it is taken as the time since the oldest unfinished start. Matching
+ * requests in start order gives the right average even when requests
+ * finish out of order.
+ *
+ * pick() implements the "power of two choices" algorithm: two random
+ * candidates are compared and the one with the lower load score wins.
+ * This avoids the herd behaviour of always choosing the single least
+ * loaded backend while still steering work away from a struggling one.
+ */
+// ----------------------------------------------------------------------
+
+class BackendLoadTracker
+{
+ public:
+  struct Options
+  {
+    double alpha = 0.2;              // EWMA smoothing factor for new samples (0..1]
+    double default_latency_ms = 50;  // assumed latency for backends with no samples yet
+    double error_penalty = 10;       // score multiplier per unit of error rate
+  };
+
+  // Snapshot of the state of one backend
+  struct Load
+  {
+    std::string host;
+    int port = 0;
+    long inflight = 0;
+    double latency_ms = 0;  // EWMA, 0 if no samples yet
+    double error_rate = 0;  // EWMA of failure indicator, 0..1
+    std::uint64_t requests = 0;
+    std::uint64_t errors = 0;
+    double score = 0;
+  };
+
+  using Backend = std::pair<std::string, int>;
+  using Backends = std::vector<Backend>;
+  using Status = std::vector<Load>;
+
+  BackendLoadTracker() = default;
+  explicit BackendLoadTracker(const Options& theOptions);
+  BackendLoadTracker(const BackendLoadTracker& other) = delete;
+  BackendLoadTracker(BackendLoadTracker&& other) = delete;
+  BackendLoadTracker& operator=(const BackendLoadTracker& other) = delete;
+  BackendLoadTracker& operator=(BackendLoadTracker&& other) = delete;
+
+  void start(const std::string& theHost, int thePort);
+  void stop(const std::string& theHost, int thePort);
+  void reset(const std::string& theHost, int thePort);
+  void remove(const std::string& theHost, int thePort);
+
+  // Record the outcome of a finished request. Without a measured latency the
+  // time since the oldest unfinished start() of the backend is used. The
+  // error rate is updated in any case.
+  void finished(const std::string& theHost,
+                int thePort,
+                bool theError,
+                std::optional<std::chrono::microseconds> theLatency = std::nullopt);
+
+  // Power of two choices. Returns the index of the chosen candidate, or
+  // nothing if the candidate list is empty.
+  std::optional<std::size_t> pick(const Backends& theCandidates) const;
+
+  // Load score of a backend, lower is better
+  double score(const std::string& theHost, int thePort) const;
+
+  Status status() const;
+
+ private:
+  struct Entry
+  {
+    std::mutex mutex;  // guards started
+    std::deque<std::chrono::steady_clock::time_point> started;
+    std::atomic<long> inflight{0};
+    std::atomic<double> latency_ms{0};
+    std::atomic<double> error_rate{0};
+    std::atomic<std::uint64_t> requests{0};
+    std::atomic<std::uint64_t> errors{0};
+  };
+
+  using EntryPtr = std::shared_ptr<Entry>;
+
+  EntryPtr find(const std::string& theHost, int thePort) const;
+  EntryPtr findOrCreate(const std::string& theHost, int thePort);
+  double score(const Entry& theEntry) const;
+
+  Options itsOptions;
+
+  mutable NamedMutexType itsMutex{"BackendLoadTracker"};
+  std::map<Backend, EntryPtr> itsBackends;
+};
+
+}  // namespace Spine
+}  // namespace SmartMet
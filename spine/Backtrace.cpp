@@ -1,9 +1,17 @@
 #include "Backtrace.h"
 #include <backtrace.h>
 
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <sstream>
+#include <cerrno>
 #include <cxxabi.h>
+#include <dlfcn.h>
+#include <sys/syscall.h>
+#include <ucontext.h>
+#include <unistd.h>
 #include <fmt/format.h>
 
 using SmartMet::Spine::Backtrace;
@@ -45,6 +53,153 @@ std::string Backtrace::make_backtrace()  noexcept
     return Backtrace::data.out.str();
 }
 
+namespace
+{
+// Frames further apart than this are taken to be garbage
+const std::uintptr_t max_frame_distance = 1024 * 1024;
+
+// Readability is checked with the smallest page size in use
+const std::uintptr_t check_page_size = 4096;
+
+// Test whether a word can be read without faulting. rt_sigprocmask copies
+// the new mask from user space before validating 'how', hence it fails
+// with EFAULT for unreadable memory and with EINVAL otherwise. The caller
+// must preserve errno.
+bool readable(std::uintptr_t address) noexcept
+{
+    const long ret = syscall(SYS_rt_sigprocmask, ~0, reinterpret_cast<void*>(address), nullptr, 8);
+    return !(ret == -1 && errno == EFAULT);
+}
+
+void silent_error_callback(void* /* data */, const char* /* msg */, int /* errnum */) noexcept
+{
+}
+
+std::string demangle(const char* function)
+{
+    int status = 0;
+    char* demangled = __cxxabiv1::__cxa_demangle(function, nullptr, nullptr, &status);
+    if (status != 0 || demangled == nullptr)
+    {
+        free(demangled);
+        return function;
+    }
+    std::string ret(demangled);
+    free(demangled);
+    return ret;
+}
+
+int symbolize_pcinfo_callback(
+    void* data, std::uintptr_t /* pc */, const char* /* filename */, int /* lineno */,
+    const char* function) noexcept
+try
+{
+    if (function)
+        static_cast<std::vector<std::string>*>(data)->push_back(demangle(function));
+    return 0;
+}
+catch (...)
+{
+    return 1;
+}
+
+void symbolize_syminfo_callback(
+    void* data, std::uintptr_t /* pc */, const char* symname, std::uintptr_t /* symval */,
+    std::uintptr_t /* symsize */) noexcept
+try
+{
+    if (symname)
+        static_cast<std::vector<std::string>*>(data)->push_back(demangle(symname));
+}
+catch (...)
+{
+}
+
+}  // namespace
+
+__attribute__((no_sanitize("address")))
+int Backtrace::capture(std::uintptr_t* pcs, int maxFrames, const void* context) noexcept
+{
+    if (maxFrames <= 0 || context == nullptr)
+        return 0;
+
+    const auto* uc = static_cast<const ucontext_t*>(context);
+#if defined(__x86_64__)
+    const auto pc = static_cast<std::uintptr_t>(uc->uc_mcontext.gregs[REG_RIP]);
+    auto fp = static_cast<std::uintptr_t>(uc->uc_mcontext.gregs[REG_RBP]);
+    auto sp = static_cast<std::uintptr_t>(uc->uc_mcontext.gregs[REG_RSP]);
+#elif defined(__aarch64__)
+    const auto pc = static_cast<std::uintptr_t>(uc->uc_mcontext.pc);
+    auto fp = static_cast<std::uintptr_t>(uc->uc_mcontext.regs[29]);
+    auto sp = static_cast<std::uintptr_t>(uc->uc_mcontext.sp);
+#else
+    return 0;
+#endif
+
+    int n = 0;
+    pcs[n++] = pc;
+
+    // Each frame holds the caller's frame pointer followed by the return address
+    std::uintptr_t checked = 0;  // last page known to be readable
+    while (n < maxFrames)
+    {
+        if (fp < sp || fp - sp > max_frame_distance || fp % sizeof(std::uintptr_t) != 0)
+            break;
+
+        const auto first = fp / check_page_size;
+        const auto last = (fp + 2 * sizeof(std::uintptr_t) - 1) / check_page_size;
+        if (first != checked && !readable(fp))
+            break;
+        if (last != first && !readable(fp + sizeof(std::uintptr_t)))
+            break;
+        checked = last;
+
+        const auto* frame = reinterpret_cast<const std::uintptr_t*>(fp);
+        const auto next = frame[0];
+        const auto ret = frame[1];
+        if (ret == 0)
+            break;
+
+        // Point into the call instruction as the unwinder does
+        pcs[n++] = ret - 1;
+
+        if (next <= fp)
+            break;
+        sp = fp;
+        fp = next;
+    }
+    return n;
+}
+
+std::vector<std::string> Backtrace::symbolize(std::uintptr_t pc)
+{
+    // capture has already adjusted return addresses to point into the call
+    std::vector<std::string> ret;
+    auto* state = reinterpret_cast<backtrace_state*>(instance.bt_state);
+
+    // Debug info gives inlined functions too, the symbol table only the outermost one
+    backtrace_pcinfo(state, pc, &symbolize_pcinfo_callback, &silent_error_callback, &ret);
+    if (ret.empty())
+        backtrace_syminfo(state, pc, &symbolize_syminfo_callback, &silent_error_callback, &ret);
+    if (ret.empty())
+    {
+        // Exported symbols of shared libraries without debug info
+        Dl_info info;
+        const bool found = (dladdr(reinterpret_cast<void*>(pc), &info) != 0);
+        if (found && info.dli_sname)
+            ret.push_back(demangle(info.dli_sname));
+        else if (found && info.dli_fname)
+        {
+            // Name only the library for local symbols, as perf does
+            const char* slash = strrchr(info.dli_fname, '/');
+            ret.push_back(fmt::format("[{}]", slash ? slash + 1 : info.dli_fname));
+        }
+        else
+            ret.push_back(fmt::format("0x{:x}", pc));
+    }
+    return ret;
+}
+
 void Backtrace::backtrace_error_callback(void* data, const char* msg, int errnum) noexcept
 try
 {
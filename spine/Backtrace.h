@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <string>
 #include <sstream>
+#include <vector>
 
 namespace SmartMet
 {
@@ -21,6 +22,18 @@ public:
     Backtrace& operator=(Backtrace&&) = delete;
 
     static std::string make_backtrace() noexcept;
+
+    // Store up to maxFrames program counters of the stack interrupted by a
+    // signal, given the ucontext_t passed to an SA_SIGINFO handler. Walks
+    // the frame pointer chain without locks, allocations or the unwinder,
+    // and is hence async-signal-safe. Every frame is checked to be readable
+    // first. Code built without frame pointers yields truncated stacks.
+    static int capture(std::uintptr_t* pcs, int maxFrames, const void* context) noexcept;
+
+    // Function names for a program counter returned by capture, innermost
+    // inlined function first
+    static std::vector<std::string> symbolize(std::uintptr_t pc);
+
 private:
     static Backtrace instance;
 
@@ -133,7 +133,7 @@ class CRSRegistry
                                   const std::type_info& actual_type,
                                   const std::type_info& expected_type) __attribute__((noreturn));
 
-  mutable SmartMet::Spine::MutexType rw_lock;
+  mutable SmartMet::Spine::NamedMutexType rw_lock{"CRSRegistry"};
   std::map<std::string, MapEntry> crs_map;
 };
 
@@ -0,0 +1,356 @@
+#include "CacheCompressor.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <zdict.h>
+#include <zstd.h>
+
+namespace SmartMet
+{
+namespace Spine
+{
+namespace
+{
+enum ValueType : char
+{
+  Raw = 0,
+  Plain = 1,
+  WithDictionary = 2
+};
+
+const char magic[3] = {'S', 'M', 'Z'};
+
+// Samples longer than this are truncated for training
+const std::size_t max_sample_size = 64 * 1024;
+
+std::size_t thread_cpu_ns()
+{
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<std::size_t>(ts.tv_sec) * 1000000000UL + static_cast<std::size_t>(ts.tv_nsec);
+}
+
+bool has_header(std::string_view theStored)
+{
+  return theStored.size() >= CacheCompressor::header_size &&
+         theStored.compare(0, 3, magic, 3) == 0 && theStored[3] >= Raw &&
+         theStored[3] <= WithDictionary;
+}
+
+// zstd contexts are not thread safe, each thread gets its own
+struct Contexts
+{
+  ZSTD_CCtx* cctx = ZSTD_createCCtx();
+  ZSTD_DCtx* dctx = ZSTD_createDCtx();
+  ~Contexts()
+  {
+    ZSTD_freeCCtx(cctx);
+    ZSTD_freeDCtx(dctx);
+  }
+};
+
+Contexts& contexts()
+{
+  thread_local Contexts ctx;
+  return ctx;
+}
+
+}  // namespace
+
+struct CacheCompressor::Dictionary
+{
+  std::string data;
+  unsigned id = 0;
+  ZSTD_CDict* cdict = nullptr;
+  ZSTD_DDict* ddict = nullptr;
+
+  Dictionary(std::string theData, int theLevel) : data(std::move(theData))
+  {
+    id = ZDICT_getDictID(data.data(), data.size());
+    cdict = ZSTD_createCDict(data.data(), data.size(), theLevel);
+    ddict = ZSTD_createDDict(data.data(), data.size());
+  }
+
+  ~Dictionary()
+  {
+    ZSTD_freeCDict(cdict);
+    ZSTD_freeDDict(ddict);
+  }
+
+  bool valid() const { return id != 0 && cdict != nullptr && ddict != nullptr; }
+};
+
+CacheCompressor::CacheCompressor(int theLevel,
+                                 bool theDictionary,
+                                 std::filesystem::path theDictionaryFile)
+    : itsLevel(theLevel),
+      itsUseDictionary(theDictionary),
+      itsDictionaryFile(std::move(theDictionaryFile))
+{
+  try
+  {
+    // Values stored earlier may need the dictionary even if new values
+    // are compressed without one
+    if (!itsDictionaryFile.empty())
+    {
+      std::ifstream in(itsDictionaryFile, std::ios::binary);
+      if (in)
+      {
+        std::string data{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+        auto dict = std::make_shared<const Dictionary>(std::move(data), itsLevel);
+        if (dict->valid())
+        {
+          std::atomic_store(&itsDictionary, dict);
+          return;
+        }
+      }
+    }
+
+    itsTraining = itsUseDictionary;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+CacheCompressor::~CacheCompressor()
+{
+  if (itsTrainingThread.joinable())
+    itsTrainingThread.join();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Compress a value, storing it raw if compression does not help
+ */
+// ----------------------------------------------------------------------
+
+std::shared_ptr<std::string> CacheCompressor::compress(std::string_view theValue,
+                                                       bool theDictionary)
+{
+  try
+  {
+    const auto start = thread_cpu_ns();
+
+    std::shared_ptr<const Dictionary> dict;
+    if (theDictionary && itsUseDictionary)
+    {
+      dict = std::atomic_load(&itsDictionary);
+      if (!dict && itsTraining)
+        sample(theValue);
+    }
+
+    auto ret = std::make_shared<std::string>(magic, 3);
+    ret->resize(header_size + ZSTD_compressBound(theValue.size()));
+
+    auto& ctx = contexts();
+    std::size_t n = 0;
+    if (dict)
+    {
+      n = ZSTD_compress_usingCDict(
+          ctx.cctx, ret->data() + header_size, ret->size() - header_size, theValue.data(),
+          theValue.size(), dict->cdict);
+      (*ret)[3] = WithDictionary;
+    }
+    else
+    {
+      n = ZSTD_compressCCtx(ctx.cctx, ret->data() + header_size, ret->size() - header_size,
+                            theValue.data(), theValue.size(), itsLevel);
+      (*ret)[3] = Plain;
+    }
+
+    if (ZSTD_isError(n) || n >= theValue.size())
+    {
+      ret->resize(header_size);
+      (*ret)[3] = Raw;
+      ret->append(theValue.data(), theValue.size());
+    }
+    else
+      ret->resize(header_size + n);
+
+    ++itsCompressions;
+    itsRawBytes += theValue.size();
+    itsStoredBytes += ret->size();
+    itsCompressNs += thread_cpu_ns() - start;
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+std::shared_ptr<std::string> CacheCompressor::decompress(std::string_view theStored)
+{
+  try
+  {
+    if (!has_header(theStored))
+      return std::make_shared<std::string>(theStored);
+
+    const auto type = theStored[3];
+    const auto payload = theStored.substr(header_size);
+
+    if (type == Raw)
+      return std::make_shared<std::string>(payload);
+
+    const auto start = thread_cpu_ns();
+
+    const auto size = ZSTD_getFrameContentSize(payload.data(), payload.size());
+    if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN)
+      return {};
+
+    auto ret = std::make_shared<std::string>();
+    ret->resize(size);
+
+    auto& ctx = contexts();
+    std::size_t n = 0;
+    if (type == WithDictionary)
+    {
+      auto dict = std::atomic_load(&itsDictionary);
+      if (!dict || ZSTD_getDictID_fromFrame(payload.data(), payload.size()) != dict->id)
+        return {};
+      n = ZSTD_decompress_usingDDict(
+          ctx.dctx, ret->data(), ret->size(), payload.data(), payload.size(), dict->ddict);
+    }
+    else
+      n = ZSTD_decompressDCtx(ctx.dctx, ret->data(), ret->size(), payload.data(), payload.size());
+
+    if (ZSTD_isError(n) || n != size)
+      return {};
+
+    ++itsDecompressions;
+    itsDecompressNs += thread_cpu_ns() - start;
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+bool CacheCompressor::decodable(std::string_view theStored) const
+{
+  if (!usesDictionary(theStored))
+    return true;
+  const auto payload = theStored.substr(header_size);
+  auto dict = std::atomic_load(&itsDictionary);
+  return dict && ZSTD_getDictID_fromFrame(payload.data(), payload.size()) == dict->id;
+}
+
+bool CacheCompressor::encoded(std::string_view theStored)
+{
+  return has_header(theStored);
+}
+
+bool CacheCompressor::usesDictionary(std::string_view theStored)
+{
+  return has_header(theStored) && theStored[3] == WithDictionary;
+}
+
+bool CacheCompressor::plainFrame(std::string_view theStored, std::string_view& theFrame)
+{
+  if (!has_header(theStored) || theStored[3] != Plain)
+    return false;
+  theFrame = theStored.substr(header_size);
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Collect a training sample, training once enough are available
+ *
+ * Training takes a while, hence it runs in a background thread instead
+ * of delaying the request which happened to provide the last sample.
+ */
+// ----------------------------------------------------------------------
+
+void CacheCompressor::sample(std::string_view theValue)
+{
+  std::unique_lock<std::mutex> lock(itsTrainingMutex, std::try_to_lock);
+  if (!lock.owns_lock() || !itsTraining)
+    return;
+
+  const auto n = std::min(theValue.size(), max_sample_size);
+  itsSamples.append(theValue.data(), n);
+  itsSampleSizes.push_back(n);
+
+  if (itsSampleSizes.size() < training_samples && itsSamples.size() < training_bytes)
+    return;
+
+  itsTraining = false;
+  itsTrainingThread = std::thread(
+      &CacheCompressor::train, this, std::move(itsSamples), std::move(itsSampleSizes));
+  itsSamples.clear();
+  itsSampleSizes.clear();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Train and publish the dictionary. Compression continues
+ *        without a dictionary if training fails.
+ */
+// ----------------------------------------------------------------------
+
+void CacheCompressor::train(const std::string& theSamples, const std::vector<std::size_t>& theSizes)
+{
+  try
+  {
+    std::string data(dictionary_capacity, '\0');
+    const auto n = ZDICT_trainFromBuffer(data.data(),
+                                         data.size(),
+                                         theSamples.data(),
+                                         theSizes.data(),
+                                         static_cast<unsigned>(theSizes.size()));
+    if (ZDICT_isError(n))
+      return;
+    data.resize(n);
+
+    auto dict = std::make_shared<const Dictionary>(data, itsLevel);
+    if (!dict->valid())
+      return;
+
+    // The dictionary must be saved before any value using it is stored
+    if (!itsDictionaryFile.empty())
+    {
+      auto tmp = itsDictionaryFile;
+      tmp += ".tmp";
+      std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+      out.write(data.data(), static_cast<std::streamsize>(data.size()));
+      out.close();
+      std::error_code ec;
+      if (!out)
+        return;
+      std::filesystem::rename(tmp, itsDictionaryFile, ec);
+      if (ec)
+        return;
+    }
+
+    std::atomic_store(&itsDictionary, dict);
+  }
+  catch (...)
+  {
+    std::cerr << Fmi::Exception::Trace(BCP, "Cache dictionary training failed!").getStackTrace();
+  }
+}
+
+CacheCompressor::Statistics CacheCompressor::statistics() const
+{
+  Statistics ret;
+  ret.compressions = itsCompressions;
+  ret.decompressions = itsDecompressions;
+  ret.raw_bytes = itsRawBytes;
+  ret.stored_bytes = itsStoredBytes;
+  ret.compress_ns = itsCompressNs;
+  ret.decompress_ns = itsDecompressNs;
+  auto dict = std::atomic_load(&itsDictionary);
+  ret.dictionary_size = (dict ? dict->data.size() : 0);
+  ret.ratio = (ret.stored_bytes > 0 ? double(ret.raw_bytes) / ret.stored_bytes : 1.0);
+  return ret;
+}
+
+}  // namespace Spine
+}  // namespace SmartMet
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Spine
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief zstd compression of SmartMetCache values
+ *
+ * Stored values start with a four byte header "SMZ" + type, where the
+ * type tells whether the rest is raw (compression did not help), a
+ * plain zstd frame, or a zstd frame requiring the dictionary. Values
+ * without the header are taken to be raw, for example files written
+ * before compression was enabled.
+ *
+ * Optionally a dictionary is trained from the first values stored,
+ * which helps with small, similar documents. Values stored before the
+ * dictionary exists are compressed without it. Since HTTP clients do
+ * not have the dictionary, only plain frames can be served to them
+ * as is with Content-Encoding: zstd.
+ *
+ * Training runs in a background thread, values are compressed without
+ * the dictionary until it is ready.
+ *
+ * If a dictionary file is given, a trained dictionary is saved there
+ * and loaded by the next process so that persistent values remain
+ * readable. The file is loaded for decoding even if new values are
+ * compressed without a dictionary. A value which cannot be decoded is
+ * treated as a miss.
+ */
+// ----------------------------------------------------------------------
+
+class CacheCompressor
+{
+ public:
+  struct Statistics
+  {
+    std::size_t compressions = 0;
+    std::size_t decompressions = 0;
+    std::size_t raw_bytes = 0;       // bytes given for compression
+    std::size_t stored_bytes = 0;    // bytes produced by compression
+    std::size_t compress_ns = 0;     // thread CPU time spent compressing
+    std::size_t decompress_ns = 0;   // thread CPU time spent decompressing
+    std::size_t dictionary_size = 0;
+    double ratio = 1.0;              // raw_bytes / stored_bytes
+    std::size_t effective_capacity = 0;  // memory cache budget times ratio, set by SmartMetCache
+  };
+
+  static constexpr std::size_t header_size = 4;
+  static constexpr std::size_t dictionary_capacity = 32 * 1024;
+  static constexpr std::size_t training_samples = 200;
+  static constexpr std::size_t training_bytes = 4 * 1024 * 1024;
+
+  CacheCompressor(int theLevel, bool theDictionary, std::filesystem::path theDictionaryFile = {});
+  ~CacheCompressor();
+
+  CacheCompressor(const CacheCompressor&) = delete;
+  CacheCompressor& operator=(const CacheCompressor&) = delete;
+
+  // Encode a value for storage. Without the dictionary the result can be
+  // decoded by any process.
+  std::shared_ptr<std::string> compress(std::string_view theValue, bool theDictionary = true);
+
+  // Decode a stored value, nullptr if it cannot be decoded
+  std::shared_ptr<std::string> decompress(std::string_view theStored);
+
+  // Test whether this process can decode a stored value
+  bool decodable(std::string_view theStored) const;
+
+  // Test whether a stored value has the header, values without one are
+  // used as is
+  static bool encoded(std::string_view theStored);
+
+  // Test whether a stored value requires the dictionary
+  static bool usesDictionary(std::string_view theStored);
+
+  // The zstd frame of a stored value if clients can decode it as is
+  static bool plainFrame(std::string_view theStored, std::string_view& theFrame);
+
+  Statistics statistics() const;
+
+ private:
+  struct Dictionary;
+
+  void sample(std::string_view theValue);
+  void train(const std::string& theSamples, const std::vector<std::size_t>& theSizes);
+
+  const int itsLevel;
+  const bool itsUseDictionary;
+  const std::filesystem::path itsDictionaryFile;
+
+  std::shared_ptr<const Dictionary> itsDictionary;  // atomic access
+
+  std::mutex itsTrainingMutex;
+  std::atomic<bool> itsTraining{false};
+  std::string itsSamples;
+  std::vector<std::size_t> itsSampleSizes;
+  std::thread itsTrainingThread;
+
+  std::atomic<std::size_t> itsCompressions{0};
+  std::atomic<std::size_t> itsDecompressions{0};
+  std::atomic<std::size_t> itsRawBytes{0};
+  std::atomic<std::size_t> itsStoredBytes{0};
+  std::atomic<std::size_t> itsCompressNs{0};
+  std::atomic<std::size_t> itsDecompressNs{0};
+};
+
+}  // namespace Spine
+}  // namespace SmartMet
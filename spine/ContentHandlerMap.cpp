@@ -127,6 +127,20 @@ try
     "serviceinfo",
     AdminRequestAccess::Public,
     std::bind(&ContentHandlerMap::serviceInfoRequest, this, p::_1, p::_2), "Get info about available services");
+
+  addAdminTableRequestHandler(
+    NoTarget{},
+    "accesslogs",
+    AdminRequestAccess::Private,
+    std::bind(&ContentHandlerMap::accessLogStatsRequest, this, p::_1, p::_2),
+    "Get access log writer statistics");
+
+  addAdminTableRequestHandler(
+    NoTarget{},
+    "requestlogs",
+    AdminRequestAccess::Private,
+    std::bind(&ContentHandlerMap::requestLogStatsRequest, this, p::_1, p::_2),
+    "Get memory usage of the in-memory request logs");
 }
 catch (...)
 {
@@ -182,6 +196,7 @@ try
       new HandlerView(
         theHandler,
         itsOptions.accesslogdir,
+        itsOptions.accesslog,
         accessLogName,
         itsOptions.otel));
   }
@@ -252,6 +267,7 @@ try
                                                        isPrivate,
                                                        supportedPostContentTypes,
                                                        itsOptions.accesslogdir,
+                                                       itsOptions.accesslog,
                                                        itsOptions.otel));
 
   if (handlesUriPrefix)
@@ -472,6 +488,117 @@ catch (...)
   throw Fmi::Exception::Trace(BCP, "Operation failed!");
 }
 
+std::map<std::string, ServiceStats::Summary> ContentHandlerMap::getServiceStats(
+    const std::string& thePlugin) const
+try
+{
+  const std::string pluginNameInLowerCase = Fmi::ascii_tolower_copy(thePlugin);
+  std::map<std::string, ServiceStats::Summary> result;
+  ReadLock lock(itsContentMutex);
+  for (const auto& handler : itsHandlers)
+  {
+    if (pluginNameInLowerCase == "all" ||
+        pluginNameInLowerCase == Fmi::ascii_tolower_copy(handler.second->getPluginName()))
+      result.emplace(handler.first, handler.second->getServiceStats().summary());
+  }
+  return result;
+}
+catch (...)
+{
+  throw Fmi::Exception::Trace(BCP, "Operation failed!");
+}
+
+std::map<std::string, std::map<std::string, PhaseStats::Totals>> ContentHandlerMap::getPhaseStats(
+    const std::string& thePlugin) const
+try
+{
+  const std::string pluginNameInLowerCase = Fmi::ascii_tolower_copy(thePlugin);
+  std::map<std::string, std::map<std::string, PhaseStats::Totals>> result;
+  ReadLock lock(itsContentMutex);
+  for (const auto& handler : itsHandlers)
+  {
+    if (pluginNameInLowerCase == "all" ||
+        pluginNameInLowerCase == Fmi::ascii_tolower_copy(handler.second->getPluginName()))
+    {
+      auto totals = handler.second->getPhaseStats().totals();
+      if (!totals.empty())
+        result.emplace(handler.first, std::move(totals));
+    }
+  }
+  return result;
+}
+catch (...)
+{
+  throw Fmi::Exception::Trace(BCP, "Operation failed!");
+}
+
+bool ContentHandlerMap::isAdminAuthenticated(const HTTP::Request& theRequest) const
+{
+  try
+  {
+    if (!itsAdminHandlerInfo || !itsAdminHandlerInfo->itsAdminAuthenticationCallback ||
+        !theRequest.getHeader("Authorization"))
+      return false;
+
+    // The callback fills in a 401 response on failure, which we do not need
+    HTTP::Response response;
+    return itsAdminHandlerInfo->itsAdminAuthenticationCallback(theRequest, response);
+  }
+  catch (...)
+  {
+    // A corrupt Authorization header is not an error here
+    return false;
+  }
+}
+
+std::map<std::string, LatencyStats::Snapshots> ContentHandlerMap::getLatencyStats(
+    const std::string& thePlugin, LatencyStats::Window theWindow) const
+try
+{
+  const std::string pluginNameInLowerCase = Fmi::ascii_tolower_copy(thePlugin);
+  std::map<std::string, LatencyStats::Snapshots> result;
+  ReadLock lock(itsContentMutex);
+  for (const auto& handler : itsHandlers)
+  {
+    if (pluginNameInLowerCase == "all" ||
+        pluginNameInLowerCase == Fmi::ascii_tolower_copy(handler.second->getPluginName()))
+    {
+      auto snapshots = handler.second->getLatencyStats().snapshot(theWindow);
+      if (!snapshots.empty())
+        result.emplace(handler.first, std::move(snapshots));
+    }
+  }
+  return result;
+}
+catch (...)
+{
+  throw Fmi::Exception::Trace(BCP, "Operation failed!");
+}
+
+std::map<std::string, LatencyStats::Cumulatives> ContentHandlerMap::getLatencyCumulatives(
+    const std::string& thePlugin) const
+try
+{
+  const std::string pluginNameInLowerCase = Fmi::ascii_tolower_copy(thePlugin);
+  std::map<std::string, LatencyStats::Cumulatives> result;
+  ReadLock lock(itsContentMutex);
+  for (const auto& handler : itsHandlers)
+  {
+    if (pluginNameInLowerCase == "all" ||
+        pluginNameInLowerCase == Fmi::ascii_tolower_copy(handler.second->getPluginName()))
+    {
+      auto cumulatives = handler.second->getLatencyStats().cumulative();
+      if (!cumulatives.empty())
+        result.emplace(handler.first, std::move(cumulatives));
+    }
+  }
+  return result;
+}
+catch (...)
+{
+  throw Fmi::Exception::Trace(BCP, "Operation failed!");
+}
+
 SmartMet::Spine::AccessLogStruct ContentHandlerMap::getLoggedRequests(const std::string& thePlugin) const
 try
 {
@@ -1409,6 +1536,104 @@ catch (...)
   throw Fmi::Exception::Trace(BCP, "Operation failed!");
 }
 
+std::unique_ptr<Table> ContentHandlerMap::accessLogStatsRequest(
+    Reactor&,
+    const HTTP::Request&) const
+try
+{
+  std::unique_ptr<Table> result(new SmartMet::Spine::Table);
+  result->setTitle("Access log writers");
+  result->setNames(
+      {"Handler", "Running", "Queued", "Written", "Dropped", "Bytes", "Writes", "Rotations"});
+
+  int row = 0;
+  auto add_row = [&result, &row](const std::string& name, const HandlerView& handler)
+  {
+    const auto stats = handler.getAccessLogStatistics();
+    if (!stats)
+      return;
+    result->set(0, row, name);
+    result->set(1, row, (stats->running ? "yes" : "no"));
+    result->set(2, row, Fmi::to_string(stats->queued));
+    result->set(3, row, Fmi::to_string(stats->written));
+    result->set(4, row, Fmi::to_string(stats->dropped));
+    result->set(5, row, Fmi::to_string(stats->bytes));
+    result->set(6, row, Fmi::to_string(stats->batches));
+    result->set(7, row, Fmi::to_string(stats->rotations));
+    row++;
+  };
+
+  ReadLock lock(itsContentMutex);
+  for (const auto& item : itsHandlers)
+    add_row(item.first, *item.second);
+  if (itsCatchNoMatchHandler)
+    add_row("<nomatch>", *itsCatchNoMatchHandler);
+
+  return result;
+}
+catch (...)
+{
+  throw Fmi::Exception::Trace(BCP, "Operation failed!");
+}
+
+std::unique_ptr<Table> ContentHandlerMap::requestLogStatsRequest(
+    Reactor&,
+    const HTTP::Request&) const
+try
+{
+  std::unique_ptr<Table> result(new SmartMet::Spine::Table);
+  result->setTitle("Request logs");
+  result->setNames({"Handler",
+                    "Records",
+                    "Capacity",
+                    "TextBytes",
+                    "TextCapacity",
+                    "Interned",
+                    "UsedMB",
+                    "ReservedMB",
+                    "Dropped",
+                    "Overwritten"});
+
+  const double mb = 1024.0 * 1024.0;
+  std::size_t total_used = 0;
+  std::size_t total_reserved = 0;
+
+  int row = 0;
+  auto add_row = [&](const std::string& name, const HandlerView& handler)
+  {
+    const auto stats = handler.getRequestLogStatistics();
+    result->set(0, row, name);
+    result->set(1, row, Fmi::to_string(stats.records));
+    result->set(2, row, Fmi::to_string(stats.capacity));
+    result->set(3, row, Fmi::to_string(stats.text_bytes));
+    result->set(4, row, Fmi::to_string(stats.text_capacity));
+    result->set(5, row, Fmi::to_string(stats.interned));
+    result->set(6, row, Fmi::to_string("%.1f", stats.used_bytes / mb));
+    result->set(7, row, Fmi::to_string("%.1f", stats.reserved_bytes / mb));
+    result->set(8, row, Fmi::to_string(stats.dropped));
+    result->set(9, row, Fmi::to_string(stats.overwritten));
+    total_used += stats.used_bytes;
+    total_reserved += stats.reserved_bytes;
+    row++;
+  };
+
+  ReadLock lock(itsContentMutex);
+  for (const auto& item : itsHandlers)
+    add_row(item.first, *item.second);
+  if (itsCatchNoMatchHandler)
+    add_row("<nomatch>", *itsCatchNoMatchHandler);
+
+  result->set(0, row, "Total");
+  result->set(6, row, Fmi::to_string("%.1f", total_used / mb));
+  result->set(7, row, Fmi::to_string("%.1f", total_reserved / mb));
+
+  return result;
+}
+catch (...)
+{
+  throw Fmi::Exception::Trace(BCP, "Operation failed!");
+}
+
 Reactor* ContentHandlerMap::getReactor()
 {
   // Currently Reactor is class derived from ContentHandlerMap
@@ -228,6 +228,34 @@ public:
     */
     AccessLogStruct getLoggedRequests(const std::string& thePlugin) const;
 
+    /*
+    * @brief Get pre-aggregated request counters of handlers of the given plugin ("all" for all)
+    */
+    std::map<std::string, ServiceStats::Summary> getServiceStats(const std::string& thePlugin) const;
+
+    /*
+    * @brief Get latency histograms of handlers of the given plugin ("all" for all)
+    */
+    std::map<std::string, LatencyStats::Snapshots> getLatencyStats(
+        const std::string& thePlugin, LatencyStats::Window theWindow) const;
+
+    /*
+    * @brief Get latency counts since start of handlers of the given plugin ("all" for all)
+    */
+    std::map<std::string, LatencyStats::Cumulatives> getLatencyCumulatives(
+        const std::string& thePlugin) const;
+
+    /*
+    * @brief Get request phase totals of handlers of the given plugin ("all" for all)
+    */
+    std::map<std::string, std::map<std::string, PhaseStats::Totals>> getPhaseStats(
+        const std::string& thePlugin) const;
+
+    /*
+    * @brief Check whether the request carries valid admin credentials
+    */
+    bool isAdminAuthenticated(const HTTP::Request& theRequest) const;
+
     /**
      * @brief Get the plugin name for the given URI
      *
@@ -467,6 +495,14 @@ private:
             Reactor&,
             const HTTP::Request&);
 
+    std::unique_ptr<Table> accessLogStatsRequest(
+            Reactor&,
+            const HTTP::Request&) const;
+
+    std::unique_ptr<Table> requestLogStatsRequest(
+            Reactor&,
+            const HTTP::Request&) const;
+
 private:
 
     Reactor* getReactor();
@@ -602,8 +638,8 @@ private:
      */
     std::map<std::string, std::shared_ptr<IPFilter::IPFilter>> itsIPFilters;
 
-    mutable MutexType itsContentMutex;
-    mutable MutexType itsLoggingMutex;
+    mutable NamedMutexType itsContentMutex{"ContentHandlerMap::content"};
+    mutable NamedMutexType itsLoggingMutex{"ContentHandlerMap::logging"};
 
     Fmi::DateTime itsLogLastCleaned;
     std::shared_ptr<boost::thread> itsLogCleanerThread;
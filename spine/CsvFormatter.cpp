@@ -73,65 +73,88 @@ bool looks_number(const std::string& theValue)
   }
 }
 
-}  // namespace
-
 // ----------------------------------------------------------------------
 /*!
- * \brief Format a 2D table
+ * \brief Formats the header and then the rows on demand
  */
 // ----------------------------------------------------------------------
 
-std::string CsvFormatter::format(const Table& theTable,
-                                 const TableFormatter::Names& theNames,
-                                 const HTTP::Request& theReq,
-                                 const TableFormatterOptions& /* theConfig */) const
+class CsvCursor : public TableFormatter::Cursor
 {
-  try
+ public:
+  CsvCursor(const Table& theTable,
+            const TableFormatter::Names& theNames,
+            const HTTP::Request& theReq)
+      : itsTable(theTable),
+        itsNames(theTable.getNames(theNames, false)),
+        itsCols(theTable.columns()),
+        itsRows(theTable.rows()),
+        itsRow(itsRows.begin())
   {
-    std::string miss = "NaN";
     auto missing = theReq.getParameter("missingtext");
     if (!!missing)
-      miss = *missing;
+      itsMissing = *missing;
+  }
 
-    Table::Indexes cols = theTable.columns();
-    Table::Indexes rows = theTable.rows();
+  bool next(std::string& theOutput, std::size_t theChunkSize) override;
 
-    std::string out;
-    out.reserve(TableFormatter::default_minimum_size);
+ private:
+  void header(std::string& out) const;
 
-    // First the header row
-    const auto& names = theTable.getNames(theNames, false);
+  const Table& itsTable;
+  const TableFormatter::Names& itsNames;
+  const Table::Indexes itsCols;
+  const Table::Indexes itsRows;
+  Table::Indexes::const_iterator itsRow;
+  std::string itsMissing = "NaN";
+  bool itsStarted = false;
+};
 
-    const std::set<std::size_t> cols_set = theTable.columns();
-    if (cols_set.empty() && !names.empty())
+void CsvCursor::header(std::string& out) const
+{
+  if (itsCols.empty() && !itsNames.empty())
+  {
+    out += "\"" + ba::join(itsNames, "\",\"") + "\"";
+  }
+  else
+  {
+    std::size_t col = 0;
+    for (const auto& nam : itsCols)
     {
-      out += "\"" + ba::join(names, "\",\"") + "\"";
+      const std::string& name = nam >= itsNames.size() ? "" : itsNames[nam];
+      if (col++ > 0)
+        out += ',';
+      out += escape_csv(name);
     }
-    else
+  }
+  out += "\n";
+}
+
+bool CsvCursor::next(std::string& theOutput, std::size_t theChunkSize)
+{
+  try
+  {
+    std::string& out = theOutput;
+    const auto start = out.size();
+
+    if (!itsStarted)
     {
-      for (const auto& nam : theTable.columns())
-      {
-        const std::string& name = nam >= names.size() ? "" : names[nam];
-        if (!out.empty())
-          out += ',';
-        out += escape_csv(name);
-      }
+      header(out);
+      itsStarted = true;
     }
-    out += "\n";
-
-    // Then the data
 
-    for (std::size_t j : rows)
+    for (; itsRow != itsRows.end() && out.size() - start < theChunkSize; ++itsRow)
     {
+      const std::size_t j = *itsRow;
       std::size_t col = 0;
-      for (std::size_t i : cols)
+      for (std::size_t i : itsCols)
       {
         if (col++ > 0)
           out += ',';
 
-        const auto& value = theTable.get(i, j);
+        const auto& value = itsTable.get(i, j);
         if (value.empty())
-          out += escape_csv(miss);
+          out += escape_csv(itsMissing);
         else if (looks_number(value))
           out += value;
         else
@@ -140,6 +163,32 @@ std::string CsvFormatter::format(const Table& theTable,
       out += "\n";
     }
 
+    return itsRow != itsRows.end();
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Format a 2D table
+ */
+// ----------------------------------------------------------------------
+
+std::string CsvFormatter::format(const Table& theTable,
+                                 const TableFormatter::Names& theNames,
+                                 const HTTP::Request& theReq,
+                                 const TableFormatterOptions& /* theConfig */) const
+{
+  try
+  {
+    std::string out;
+    out.reserve(default_minimum_size);
+    CsvCursor(theTable, theNames, theReq).next(out, std::string::npos);
     return out;
   }
   catch (...)
@@ -148,6 +197,28 @@ std::string CsvFormatter::format(const Table& theTable,
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Format a 2D table on demand
+ */
+// ----------------------------------------------------------------------
+
+std::unique_ptr<TableFormatter::Cursor> CsvFormatter::cursor(
+    const Table& theTable,
+    const TableFormatter::Names& theNames,
+    const HTTP::Request& theReq,
+    const TableFormatterOptions& /* theConfig */) const
+{
+  try
+  {
+    return std::make_unique<CsvCursor>(theTable, theNames, theReq);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 }  // namespace Spine
 }  // namespace SmartMet
 
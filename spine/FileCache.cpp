@@ -3,19 +3,328 @@
 #include "FileCache.h"
 #include <macgyver/Exception.h>
 #include <macgyver/FileSystem.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
 #include <fstream>
+#include <iostream>
+#include <mutex>
+#include <poll.h>
+#include <set>
+#include <thread>
+#include <unistd.h>
 
 namespace SmartMet
 {
 namespace Spine
 {
+namespace
+{
+// Any change to a file which may change its contents or modification time
+const std::uint32_t watch_mask = IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE |
+                                 IN_MOVED_FROM | IN_MOVED_TO | IN_MOVE_SELF | IN_ONLYDIR;
+
+std::shared_ptr<const std::string> read_file(const std::filesystem::path& thePath)
+{
+  std::ifstream in(thePath.c_str());
+  if (!in)
+    throw Fmi::Exception(BCP, "Failed to open '" + thePath.string() + "' for reading!");
+
+  return std::make_shared<const std::string>(std::istreambuf_iterator<char>(in),
+                                             std::istreambuf_iterator<char>());
+}
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The inotify instance and thread shared by all caches
+ *
+ * Directories are watched once, however many caches are interested in
+ * them, and the events are passed to all of those caches. The events
+ * are dispatched while holding the lock, so that a cache cannot be
+ * destroyed while it is being invalidated. Caches never call the
+ * watcher while holding their own lock.
+ */
+// ----------------------------------------------------------------------
+
+class FileCache::Watcher
+{
+ public:
+  static Watcher& instance()
+  {
+    static Watcher watcher;
+    return watcher;
+  }
+
+  ~Watcher();
+
+  Watcher(const Watcher&) = delete;
+  Watcher& operator=(const Watcher&) = delete;
+
+  // Register a cache, false if inotify is not available
+  bool subscribe(FileCache* theCache);
+  void unsubscribe(FileCache* theCache);
+
+  // Watch a directory for the cache, false if not possible
+  bool watch(const std::filesystem::path& theDirectory, FileCache* theCache);
+
+ private:
+  Watcher() = default;
+
+  struct Directory
+  {
+    std::vector<std::filesystem::path> paths;
+    std::set<FileCache*> caches;
+  };
+
+  bool start();
+  void dispatch(const inotify_event& theEvent);
+  void operate();
+
+  std::mutex itsMutex;
+  int itsInotify = -1;
+  int itsWakeup = -1;
+  bool itsFailed = false;
+  std::thread itsThread;
+  std::set<FileCache*> itsCaches;
+
+  // inotify watch descriptors and the directories they were added for
+  std::unordered_map<std::filesystem::path, int, PathHash> itsWatches;
+  std::unordered_map<int, Directory> itsDirectories;
+};
+
+FileCache::Watcher::~Watcher()
+{
+  if (itsThread.joinable())
+  {
+    const std::uint64_t one = 1;
+    if (write(itsWakeup, &one, sizeof(one)) == sizeof(one))
+      itsThread.join();
+    else
+      itsThread.detach();  // cannot happen unless the counter overflows
+  }
+  if (itsInotify >= 0)
+    close(itsInotify);
+  if (itsWakeup >= 0)
+    close(itsWakeup);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Start watching on first use. Caller holds the lock.
+ */
+// ----------------------------------------------------------------------
+
+bool FileCache::Watcher::start()
+{
+  if (itsFailed)
+    return false;
+  if (itsThread.joinable())
+    return true;
+
+  itsInotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (itsInotify >= 0)
+    itsWakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+  if (itsInotify < 0 || itsWakeup < 0)
+  {
+    if (itsInotify >= 0)
+      close(itsInotify);
+    itsInotify = -1;
+    itsFailed = true;
+    return false;
+  }
+
+  itsThread = std::thread(&Watcher::operate, this);
+  return true;
+}
+
+bool FileCache::Watcher::subscribe(FileCache* theCache)
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  if (!start())
+    return false;
+  itsCaches.insert(theCache);
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Unregister a cache, removing the watches no longer needed
+ *
+ * The descriptor of a removed watch is not reused immediately, hence
+ * the IN_IGNORED event which follows is simply not recognized.
+ */
+// ----------------------------------------------------------------------
+
+void FileCache::Watcher::unsubscribe(FileCache* theCache)
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  itsCaches.erase(theCache);
+
+  for (auto it = itsDirectories.begin(); it != itsDirectories.end();)
+  {
+    it->second.caches.erase(theCache);
+    if (!it->second.caches.empty())
+    {
+      ++it;
+      continue;
+    }
+    for (const auto& dir : it->second.paths)
+      itsWatches.erase(dir);
+    inotify_rm_watch(itsInotify, it->first);
+    it = itsDirectories.erase(it);
+  }
+}
+
+bool FileCache::Watcher::watch(const std::filesystem::path& theDirectory, FileCache* theCache)
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  if (itsFailed || itsInotify < 0)
+    return false;
+
+  auto pos = itsWatches.find(theDirectory);
+  if (pos != itsWatches.end())
+  {
+    itsDirectories[pos->second].caches.insert(theCache);
+    return true;
+  }
+
+  const int wd = inotify_add_watch(
+      itsInotify, theDirectory.empty() ? "." : theDirectory.c_str(), watch_mask);
+  if (wd < 0)
+    return false;
+
+  // Differently spelled paths to the same directory share the descriptor
+  itsWatches[theDirectory] = wd;
+  auto& dir = itsDirectories[wd];
+  dir.paths.push_back(theDirectory);
+  dir.caches.insert(theCache);
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Pass an inotify event to the caches watching the directory
+ */
+// ----------------------------------------------------------------------
+
+void FileCache::Watcher::dispatch(const inotify_event& theEvent)
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+
+  // Events were lost, nothing can be trusted
+  if (theEvent.mask & IN_Q_OVERFLOW)
+  {
+    for (auto* cache : itsCaches)
+      cache->invalidateAll(false);
+    return;
+  }
+
+  auto pos = itsDirectories.find(theEvent.wd);
+  if (pos == itsDirectories.end())
+    return;
+
+  // The directory was removed, renamed or unmounted. A renamed directory
+  // is still watched under its new name, hence the watch is removed.
+  const bool removed = ((theEvent.mask & (IN_IGNORED | IN_MOVE_SELF)) != 0);
+  const std::string name = (theEvent.len > 0 ? std::string(theEvent.name) : std::string());
+
+  for (auto* cache : pos->second.caches)
+    cache->invalidate(pos->second.paths, name, removed);
+
+  if (removed)
+  {
+    for (const auto& dir : pos->second.paths)
+      itsWatches.erase(dir);
+    if (theEvent.mask & IN_MOVE_SELF)
+      inotify_rm_watch(itsInotify, theEvent.wd);
+    itsDirectories.erase(pos);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Process inotify events until the program exits
+ */
+// ----------------------------------------------------------------------
+
+void FileCache::Watcher::operate()
+{
+  try
+  {
+    alignas(inotify_event) char buffer[64 * 1024];
+
+    while (true)
+    {
+      pollfd fds[2] = {{itsInotify, POLLIN, 0}, {itsWakeup, POLLIN, 0}};
+      if (poll(fds, 2, -1) < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        throw Fmi::Exception(BCP, "poll failed on inotify descriptor");
+      }
+
+      if (fds[1].revents != 0)
+        return;
+
+      while (true)
+      {
+        const auto n = read(itsInotify, buffer, sizeof(buffer));
+        if (n <= 0)
+          break;
+
+        for (ssize_t pos = 0; pos < n;)
+        {
+          const auto* event = reinterpret_cast<const inotify_event*>(buffer + pos);
+          dispatch(*event);
+          pos += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+        }
+      }
+    }
+  }
+  catch (...)
+  {
+    // Without the watcher nothing can be trusted to stay valid
+    {
+      std::lock_guard<std::mutex> lock(itsMutex);
+      itsFailed = true;
+      for (auto* cache : itsCaches)
+        cache->invalidateAll(true);
+      itsWatches.clear();
+      itsDirectories.clear();
+    }
+    std::cerr << Fmi::Exception::Trace(BCP, "FileCache watcher failed!").getStackTrace();
+  }
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Constructor
+ *
+ * If inotify is not available the cache falls back to modification
+ * time checks only.
  */
 // ----------------------------------------------------------------------
 
-FileCache::FileCache(std::chrono::seconds theMaxCheckAge) : itsMaxCheckAge(theMaxCheckAge) {}
+FileCache::FileCache(std::chrono::seconds theMaxCheckAge, bool theWatchFlag, bool theKeepContents)
+    : itsMaxCheckAge(theMaxCheckAge), itsWatchFlag(theWatchFlag), itsKeepContents(theKeepContents)
+{
+  try
+  {
+    if (itsWatchFlag)
+      itsWatching = Watcher::instance().subscribe(this);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+FileCache::~FileCache()
+{
+  if (itsWatchFlag)
+    Watcher::instance().unsubscribe(this);
+}
 
 // ----------------------------------------------------------------------
 /*!
@@ -29,20 +338,67 @@ void FileCache::setMaxCheckAge(std::chrono::seconds theMaxCheckAge)
   itsMaxCheckAge = theMaxCheckAge;
 }
 
+void FileCache::setMaxWatchedCheckAge(std::chrono::seconds theMaxCheckAge)
+{
+  WriteLock lock(itsMutex);
+  itsMaxWatchedCheckAge = theMaxCheckAge;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find a cache entry which can be used without touching the disk
+ */
+// ----------------------------------------------------------------------
+
+const FileCache::FileContents* FileCache::find(const std::filesystem::path& thePath,
+                                               std::chrono::steady_clock::time_point now) const
+{
+  auto iter = itsCache.find(thePath);
+  if (iter == itsCache.end())
+    return nullptr;
+  const auto maxage = (iter->second.watched ? itsMaxWatchedCheckAge : itsMaxCheckAge);
+  if (now - iter->second.checked_time < maxage)
+    return &iter->second;
+  return nullptr;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Watch the directory containing the file
+ */
+// ----------------------------------------------------------------------
+
+bool FileCache::watch(const std::filesystem::path& thePath) const
+{
+  if (!itsWatching)
+    return false;
+
+  // Changes to the target of a link are not seen in this directory
+  std::error_code ec;
+  if (std::filesystem::is_symlink(thePath, ec))
+    return false;
+
+  return Watcher::instance().watch(thePath.parent_path(), const_cast<FileCache*>(this));
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief (Re)validate the cache entry for the given path
  *
  * Stats the file and either refreshes the check time of an unchanged
  * cached entry, or reads the file contents and (re)inserts them. Reading
- * the file is done without holding a lock. The returned contents are a
- * copy so they remain valid after the lock is released.
+ * the file is done without holding a lock. The directory is watched
+ * before the file is read so that no change can go unnoticed, and the
+ * entry is marked watched only if no invalidation occurred meanwhile.
  */
 // ----------------------------------------------------------------------
 
 FileCache::FileContents FileCache::refresh(const std::filesystem::path& thePath,
                                            std::chrono::steady_clock::time_point now) const
 {
+  const auto invalidations = itsInvalidations.load();
+  const bool watched = watch(thePath);
+
   // Modification time, tolerating a missing file. A missing/unreadable file is
   // cached as a negative result (modification_time == 0) so that repeated
   // modification-time checks (ETag/hash calculation) are throttled exactly like
@@ -53,39 +409,38 @@ FileCache::FileContents FileCache::refresh(const std::filesystem::path& thePath,
   if (ec)
     mtime = 0;
 
-  if (mtime == 0)
-  {
-    FileContents missing(0, now, std::string());
-    WriteLock lock(itsMutex);
-    itsCache[thePath] = missing;
-    return missing;
-  }
-
   // If the file has not changed, just refresh the check time and reuse the contents
   {
     WriteLock lock(itsMutex);
     auto iter = itsCache.find(thePath);
-    if (iter != itsCache.end() && mtime == iter->second.modification_time)
+    if (iter != itsCache.end() && mtime == iter->second.modification_time &&
+        (iter->second.content || !itsKeepContents || mtime == 0))
     {
       iter->second.checked_time = now;
+      iter->second.watched = (watched && itsInvalidations == invalidations);
       return iter->second;
     }
   }
 
-  // No active lock while we read the file contents
+  if (mtime == 0)
+  {
+    FileContents missing(0, now, nullptr);
+    missing.version = ++itsVersions;
+    WriteLock lock(itsMutex);
+    missing.watched = (watched && itsInvalidations == invalidations);
+    itsCache[thePath] = missing;
+    return missing;
+  }
 
-  std::string content;
-  std::ifstream in(thePath.c_str());
-  if (!in)
-    throw Fmi::Exception(BCP, "Failed to open '" + thePath.string() + "' for reading!");
+  // No active lock while we read the file contents
 
-  content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  FileContents contents(mtime, now, (itsKeepContents ? read_file(thePath) : nullptr));
+  contents.version = ++itsVersions;
 
   // Now insert the value into the cache and return it
-
-  FileContents contents(mtime, now, std::move(content));
   {
     WriteLock lock(itsMutex);
+    contents.watched = (watched && itsInvalidations == invalidations);
     itsCache[thePath] = contents;
   }
   return contents;
@@ -97,21 +452,27 @@ FileCache::FileContents FileCache::refresh(const std::filesystem::path& thePath,
  */
 // ----------------------------------------------------------------------
 
-std::string FileCache::get(const std::filesystem::path& thePath) const
+std::shared_ptr<const std::string> FileCache::get(const std::filesystem::path& thePath) const
 {
   try
   {
     const auto now = std::chrono::steady_clock::now();
 
-    // Fast path: return the cached contents if the last check is recent enough
+    if (!itsKeepContents)
+    {
+      if (lookup(thePath).modification_time == 0)
+        throw Fmi::Exception(BCP, "Failed to open '" + thePath.string() + "' for reading!");
+      return read_file(thePath);
+    }
+
+    // Fast path: return the cached contents if the entry is watched or checked recently
     {
       ReadLock lock(itsMutex);
-      auto iter = itsCache.find(thePath);
-      if (iter != itsCache.end() && now - iter->second.checked_time < itsMaxCheckAge)
+      if (const auto* contents = find(thePath, now))
       {
-        if (iter->second.modification_time == 0)
+        if (contents->modification_time == 0)
           throw Fmi::Exception(BCP, "Failed to open '" + thePath.string() + "' for reading!");
-        return iter->second.content;
+        return contents->content;
       }
     }
 
@@ -141,18 +502,28 @@ std::size_t FileCache::last_modified(const std::filesystem::path& thePath) const
 {
   try
   {
-    const auto now = std::chrono::steady_clock::now();
+    return lookup(thePath).modification_time;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
 
-    // Fast path: return the cached modification time if the last check is recent enough
-    {
-      ReadLock lock(itsMutex);
-      auto iter = itsCache.find(thePath);
-      if (iter != itsCache.end() && now - iter->second.checked_time < itsMaxCheckAge)
-        return iter->second.modification_time;
-    }
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get a number which changes whenever the file changes
+ *
+ * Returns 0 for a missing file.
+ */
+// ----------------------------------------------------------------------
 
-    // The check has expired (or the file is not cached): validate against the disk
-    return refresh(thePath, now).modification_time;
+std::uint64_t FileCache::version(const std::filesystem::path& thePath) const
+{
+  try
+  {
+    const auto contents = lookup(thePath);
+    return (contents.modification_time == 0 ? 0 : contents.version);
   }
   catch (...)
   {
@@ -160,5 +531,66 @@ std::size_t FileCache::last_modified(const std::filesystem::path& thePath) const
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get the cache entry, validating it against the disk if needed
+ */
+// ----------------------------------------------------------------------
+
+FileCache::FileContents FileCache::lookup(const std::filesystem::path& thePath) const
+{
+  const auto now = std::chrono::steady_clock::now();
+
+  // Fast path: return the cached entry if it is watched or checked recently
+  {
+    ReadLock lock(itsMutex);
+    if (const auto* contents = find(thePath, now))
+      return *contents;
+  }
+
+  // The check has expired (or the file is not cached): validate against the disk
+  return refresh(thePath, now);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Drop the cache entries affected by an inotify event
+ */
+// ----------------------------------------------------------------------
+
+void FileCache::invalidate(const std::vector<std::filesystem::path>& theDirectories,
+                           const std::string& theName,
+                           bool theWatchRemoved)
+{
+  WriteLock lock(itsMutex);
+  ++itsInvalidations;
+
+  if (!theName.empty())
+  {
+    for (const auto& dir : theDirectories)
+      itsCache.erase(dir / theName);
+  }
+
+  if (theWatchRemoved)
+  {
+    for (auto it = itsCache.begin(); it != itsCache.end();)
+    {
+      bool affected = false;
+      for (const auto& dir : theDirectories)
+        affected |= (it->first.parent_path() == dir);
+      it = (affected ? itsCache.erase(it) : std::next(it));
+    }
+  }
+}
+
+void FileCache::invalidateAll(bool theStopWatching)
+{
+  if (theStopWatching)
+    itsWatching = false;
+  WriteLock lock(itsMutex);
+  ++itsInvalidations;
+  itsCache.clear();
+}
+
 }  // namespace Spine
 }  // namespace SmartMet
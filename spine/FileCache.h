@@ -6,27 +6,46 @@
  * are never expired from the cache: once a file has been read, its
  * contents are kept until they are observed to have changed on disk.
  *
- * To avoid a stat() call on every access, the file modification time is
- * only re-checked once the previous check is older than a configurable
- * maximum age (default 10 seconds). Within that window the cached
- * contents and modification time are returned without touching the disk.
- * The window bounds the staleness: a file modified on disk is picked up
- * after at most the maximum check age.
+ * The directories of cached files are watched with inotify, and an
+ * entry is dropped as soon as its file is written, replaced, removed or
+ * touched. Hence watched entries are returned without touching the
+ * disk, and changes are seen immediately. All caches share a single
+ * inotify instance and watcher thread.
  *
- * Files may be accessed from multiple threads. We do not return
- * references since a value may be replaced by a new insertion into the
- * cache. We do not return a shared pointer either, since the value is
- * almost always going to be copied into a CDT structure anyway.
+ * Some changes are not seen by inotify: replacing an ancestor
+ * directory, switching a symbolic link to a directory, or changes made
+ * by other NFS clients. Watched entries are therefore still re-checked
+ * once the previous check is older than a longer maximum age (default
+ * 60 seconds), which bounds the staleness in those cases.
+ *
+ * Files which cannot be watched (symbolic links, inotify limits reached,
+ * watching disabled) fall back to re-checking the modification time once
+ * the previous check is older than a configurable maximum age (default
+ * 10 seconds). The window bounds the staleness: a file modified on disk
+ * is picked up after at most the maximum check age.
+ *
+ * Files may be accessed from multiple threads. The contents are returned
+ * as shared pointers, which remain valid even if the file is reloaded,
+ * so a cache hit costs only a reference count increment.
+ *
+ * A cache constructed without keeping contents tracks only the state of
+ * the files. get() then reads the file every time, and version() tells
+ * whether it has changed. This suits users which keep a derived value,
+ * such as parsed JSON, and would otherwise hold the text twice.
  */
 // ======================================================================
 
 #pragma once
 
 #include "Thread.h"
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
-#include <map>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace SmartMet
 {
@@ -35,38 +54,94 @@ namespace Spine
 class FileCache
 {
  public:
-  explicit FileCache(std::chrono::seconds theMaxCheckAge = std::chrono::seconds(10));
+  explicit FileCache(std::chrono::seconds theMaxCheckAge = std::chrono::seconds(10),
+                     bool theWatchFlag = true,
+                     bool theKeepContents = true);
+  ~FileCache();
 
-  std::string get(const std::filesystem::path& thePath) const;
+  FileCache(const FileCache&) = delete;
+  FileCache& operator=(const FileCache&) = delete;
+
+  std::shared_ptr<const std::string> get(const std::filesystem::path& thePath) const;
   std::size_t last_modified(const std::filesystem::path& thePath) const;
 
+  // Number which changes whenever the file is seen to change, 0 if the file is missing
+  std::uint64_t version(const std::filesystem::path& thePath) const;
+
   // Set the maximum age of a modification time check before the file is stat'd again
   void setMaxCheckAge(std::chrono::seconds theMaxCheckAge);
 
+  // Set the maximum age of a modification time check of a watched file
+  void setMaxWatchedCheckAge(std::chrono::seconds theMaxCheckAge);
+
+  // True if file changes are watched with inotify
+  bool watching() const { return itsWatching; }
+
  private:
+  class Watcher;
+
   struct FileContents
   {
     std::time_t modification_time = 0;
     std::chrono::steady_clock::time_point checked_time;
-    std::string content;
+    std::shared_ptr<const std::string> content;
+    std::uint64_t version = 0;
+    bool watched = false;  // dropped by the watcher when the file changes
 
     FileContents() = default;
     FileContents(std::time_t theTime,
                  std::chrono::steady_clock::time_point theChecked,
-                 std::string theContent)
+                 std::shared_ptr<const std::string> theContent)
         : modification_time(theTime), checked_time(theChecked), content(std::move(theContent))
     {
     }
   };
 
+  struct PathHash
+  {
+    std::size_t operator()(const std::filesystem::path& thePath) const
+    {
+      return std::filesystem::hash_value(thePath);
+    }
+  };
+
+  // Look up a valid cache entry. Caller holds the lock.
+  const FileContents* find(const std::filesystem::path& thePath,
+                           std::chrono::steady_clock::time_point now) const;
+
   // (Re)validate the cache entry for thePath, reading the file if needed, and return it
   FileContents refresh(const std::filesystem::path& thePath,
                        std::chrono::steady_clock::time_point now) const;
 
-  using Cache = std::map<std::filesystem::path, FileContents>;
-  mutable MutexType itsMutex;
+  // The entry for thePath, refreshed if the previous check is too old
+  FileContents lookup(const std::filesystem::path& thePath) const;
+
+  // Watch the directory of the file, false if not possible
+  bool watch(const std::filesystem::path& thePath) const;
+
+  // Called by the watcher when a file in the given directories changes. If
+  // the watch itself is gone, all entries in the directories are dropped.
+  void invalidate(const std::vector<std::filesystem::path>& theDirectories,
+                  const std::string& theName,
+                  bool theWatchRemoved);
+
+  // Called by the watcher when events were lost or watching failed
+  void invalidateAll(bool theStopWatching);
+
+  using Cache = std::unordered_map<std::filesystem::path, FileContents, PathHash>;
+  mutable NamedMutexType itsMutex{"FileCache"};
   mutable Cache itsCache;
   std::chrono::steady_clock::duration itsMaxCheckAge;
+  std::chrono::steady_clock::duration itsMaxWatchedCheckAge = std::chrono::seconds(60);
+
+  const bool itsWatchFlag;
+  const bool itsKeepContents;
+  std::atomic<bool> itsWatching{false};
+  mutable std::atomic<std::uint64_t> itsVersions{0};
+
+  // Incremented on every invalidation, so that a file read while its
+  // entry was invalidated is not marked watched
+  std::atomic<std::size_t> itsInvalidations{0};
 
 };  // class FileCache
 
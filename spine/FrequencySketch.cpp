@@ -0,0 +1,123 @@
+#include "FrequencySketch.h"
+#include <macgyver/Exception.h>
+
+namespace SmartMet
+{
+namespace Spine
+{
+namespace
+{
+const std::uint64_t seeds[4] = {
+    0x97CB3127D5A5E43BULL, 0xAB9E6C4F3D1A8B27ULL, 0xC2B2AE3D27D4EB4FULL, 0x9E3779B97F4A7C15ULL};
+
+std::uint64_t mix(std::uint64_t x) noexcept
+{
+  // splitmix64 finalizer
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+  return x;
+}
+
+// Counter i of a key lives in the i'th quarter of its word
+unsigned shift(unsigned i, std::uint64_t h) noexcept
+{
+  return (i * 4 + static_cast<unsigned>(h >> 62)) * 4;
+}
+
+}  // namespace
+
+FrequencySketch::FrequencySketch(std::size_t theExpectedEntries)
+{
+  try
+  {
+    std::size_t width = 16;
+    while (width < theExpectedEntries)
+      width *= 2;
+    itsMask = width - 1;
+    itsSampleSize = 10 * width;
+    itsTable.reset(new std::atomic<std::uint64_t>[width]);
+    for (std::size_t i = 0; i < width; i++)
+      itsTable[i].store(0, std::memory_order_relaxed);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void FrequencySketch::increment(std::uint64_t theKey) noexcept
+{
+  const auto hash = mix(theKey);
+  bool added = false;
+
+  for (unsigned i = 0; i < 4; i++)
+  {
+    const auto h = mix(hash + seeds[i]);
+    auto& word = itsTable[h & itsMask];
+    const auto offset = shift(i, h);
+
+    auto value = word.load(std::memory_order_relaxed);
+    while (((value >> offset) & 0xf) < max_frequency)
+    {
+      if (word.compare_exchange_weak(
+              value, value + (std::uint64_t{1} << offset), std::memory_order_relaxed))
+      {
+        added = true;
+        break;
+      }
+    }
+  }
+
+  if (added && itsAdditions.fetch_add(1, std::memory_order_relaxed) + 1 >= itsSampleSize)
+    reset();
+}
+
+unsigned FrequencySketch::frequency(std::uint64_t theKey) const noexcept
+{
+  const auto hash = mix(theKey);
+  unsigned ret = max_frequency;
+
+  for (unsigned i = 0; i < 4; i++)
+  {
+    const auto h = mix(hash + seeds[i]);
+    const auto value = itsTable[h & itsMask].load(std::memory_order_relaxed);
+    const auto count = static_cast<unsigned>((value >> shift(i, h)) & 0xf);
+    if (count < ret)
+      ret = count;
+  }
+  return ret;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Halve all counters. Only one thread does the aging at a time.
+ */
+// ----------------------------------------------------------------------
+
+void FrequencySketch::reset() noexcept
+{
+  std::unique_lock<std::mutex> lock(itsResetMutex, std::try_to_lock);
+  if (!lock.owns_lock())
+    return;
+
+  if (itsAdditions.load(std::memory_order_relaxed) < itsSampleSize)
+    return;
+
+  for (std::size_t i = 0; i <= itsMask; i++)
+  {
+    auto value = itsTable[i].load(std::memory_order_relaxed);
+    while (!itsTable[i].compare_exchange_weak(
+        value, (value >> 1) & 0x7777777777777777ULL, std::memory_order_relaxed))
+    {
+    }
+  }
+
+  itsAdditions.store(itsSampleSize / 2, std::memory_order_relaxed);
+  itsResets.fetch_add(1, std::memory_order_relaxed);
+}
+
+}  // namespace Spine
+}  // namespace SmartMet
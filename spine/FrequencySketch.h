@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace SmartMet
+{
+namespace Spine
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Approximate access frequencies for TinyLFU cache admission
+ *
+ * A count-min sketch of 4-bit counters packed sixteen to a 64-bit word.
+ * Each key has four counters in four independently hashed words, and
+ * the estimate is the smallest of the four. Once the number of
+ * increments reaches ten times the number of words, all counters are
+ * halved so that the estimates follow changes in popularity.
+ *
+ * The counters are updated with atomic operations without locking.
+ * Concurrent aging may lose some increments, which only makes the
+ * estimates slightly smaller.
+ */
+// ----------------------------------------------------------------------
+
+class FrequencySketch
+{
+ public:
+  static constexpr unsigned max_frequency = 15;
+
+  explicit FrequencySketch(std::size_t theExpectedEntries);
+
+  FrequencySketch(const FrequencySketch&) = delete;
+  FrequencySketch& operator=(const FrequencySketch&) = delete;
+
+  void increment(std::uint64_t theKey) noexcept;
+  unsigned frequency(std::uint64_t theKey) const noexcept;
+
+  // Number of times the counters have been halved
+  std::size_t resets() const noexcept { return itsResets.load(std::memory_order_relaxed); }
+
+ private:
+  void reset() noexcept;
+
+  std::size_t itsMask = 0;
+  std::size_t itsSampleSize = 0;
+  std::unique_ptr<std::atomic<std::uint64_t>[]> itsTable;
+  std::atomic<std::size_t> itsAdditions{0};
+  std::atomic<std::size_t> itsResets{0};
+  std::mutex itsResetMutex;
+};
+
+}  // namespace Spine
+}  // namespace SmartMet
@@ -973,6 +973,13 @@ std::size_t Request::getParameterCount() const
   return itsParameters.size();
 }
 
+std::pmr::memory_resource* Request::getMemoryResource() const
+{
+  if (!itsArena)
+    itsArena = std::make_shared<RequestArena>();
+  return itsArena->resource();
+}
+
 Request::~Request() = default;
 
 Response::Response(HeaderMap headerMap,
@@ -1081,6 +1088,23 @@ void Response::setStreamCompletionHandler(StreamCompletionHandler handler)
   itsStreamCompletionHandler = std::move(handler);
 }
 
+void Response::addStreamCompletionHandler(StreamCompletionHandler handler)
+{
+  if (!itsStreamCompletionHandler)
+  {
+    itsStreamCompletionHandler = std::move(handler);
+    return;
+  }
+
+  itsStreamCompletionHandler =
+      [first = std::move(itsStreamCompletionHandler), second = std::move(handler)](
+          const Response& response, std::size_t bytesSent)
+  {
+    first(response, bytesSent);
+    second(response, bytesSent);
+  };
+}
+
 bool Response::hasStreamCompletionHandler() const
 {
   return static_cast<bool>(itsStreamCompletionHandler);
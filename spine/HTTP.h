@@ -6,6 +6,8 @@
 // ----------------------------------------------------------------------
 #pragma once
 
+#include "PhaseTimer.h"
+#include "RequestArena.h"
 #include <boost/algorithm/string.hpp>
 #include <boost/logic/tribool.hpp>
 #include <optional>
@@ -521,6 +523,40 @@ class Request : public Message
   // ----------------------------------------------------------------------
   boost::asio::const_buffer contentToBuffer() override;
 
+  // ----------------------------------------------------------------------
+  /*!
+   * \brief Phase durations of this request
+   *
+   * Mutable so that handlers receiving a const request can record their
+   * own phases such as engine fetches or formatting.
+   */
+  // ----------------------------------------------------------------------
+  PhaseTimer& getPhaseTimer() const { return itsPhaseTimer; }
+
+  // ----------------------------------------------------------------------
+  /*!
+   * \brief Memory resource for allocations freed when the request ends
+   *
+   * For example
+   *
+   *   Spine::Table table(theRequest.getMemoryResource());
+   *   std::pmr::vector<double> values(theRequest.getMemoryResource());
+   *
+   * The arena is created on first use and is not thread safe. Nothing
+   * allocated from it may be referenced by the response content, a
+   * cache or any other object outliving the request.
+   *
+   * The arena saves allocator calls rather than time: the blocks beyond
+   * the first are requested from the heap for each request, and large
+   * ones are mapped anew by glibc malloc.
+   */
+  // ----------------------------------------------------------------------
+  std::pmr::memory_resource* getMemoryResource() const;
+
+  // A copy of a request shares the arena of the original. A copy used in
+  // another thread must detach itself to get an arena of its own.
+  void detachMemoryResource() { itsArena.reset(); }
+
   ~Request() override;
 
  protected:
@@ -535,6 +571,10 @@ class Request : public Message
   std::string itsClientIP;
 
   bool itsHasParsedPostData = false;
+
+  mutable PhaseTimer itsPhaseTimer;
+
+  mutable std::shared_ptr<RequestArena> itsArena;
 };
 
 class Response : public Message
@@ -706,6 +746,8 @@ class Response : public Message
   // ----------------------------------------------------------------------
   using StreamCompletionHandler = std::function<void(const Response&, std::size_t bytesSent)>;
   void setStreamCompletionHandler(StreamCompletionHandler handler);
+  // Run the given handler after the current one, if any
+  void addStreamCompletionHandler(StreamCompletionHandler handler);
   bool hasStreamCompletionHandler() const;
   void runStreamCompletionHandler(std::size_t bytesSent);
 
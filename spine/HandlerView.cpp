@@ -1,13 +1,18 @@
 #include "HandlerView.h"
 #include "Convenience.h"
 #include "FmiApiKey.h"
+#include "MallocStats.h"
+#include "OTelMetricsExporter.h"
 #include "Reactor.h"
 #include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <ctime>
 #include <filesystem>
 #include <functional>
 #include <iostream>
 #include <iterator>
+#include <random>
 #include <string>
 #include <vector>
 #include <macgyver/DateTime.h>
@@ -19,27 +24,28 @@ using namespace std::literals;
 
 namespace
 {
-bool isNotOld(const Fmi::DateTime& target, const SmartMet::Spine::LoggedRequest& compare)
+// CPU time consumed by the calling thread
+std::chrono::microseconds thread_cpu_time()
 {
-  return compare.getRequestEndTime() > target;
+  struct timespec ts
+  {
+  };
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return std::chrono::seconds(ts.tv_sec) + std::chrono::microseconds(ts.tv_nsec / 1000);
 }
 
-// Returns the iterator of the first request that has not yet been
-// flushed to disk. The marker convention is: ``end()`` means "no
-// entry has been flushed yet" (std::list iterators have no
-// "before-begin" position so we use end() as the sentinel).
-SmartMet::Spine::LogListType::iterator firstUnflushed(
-    SmartMet::Spine::LogListType& log,
-    SmartMet::Spine::LogListType::iterator marker)
+std::chrono::microseconds to_microseconds(const Fmi::TimeDuration& theDuration)
 {
-  if (marker == log.end())
-    return log.begin();
-  return std::next(marker);
+  return std::chrono::microseconds(theDuration.total_microseconds());
 }
 
-}  // namespace
+// Request log size in bytes from the option in megabytes
+std::size_t text_capacity(const SmartMet::Spine::AccessLogOptions& theOptions)
+{
+  return static_cast<std::size_t>(theOptions.text_mb) * 1024 * 1024;
+}
 
-namespace p = std::placeholders;
+}  // namespace
 
 namespace SmartMet
 {
@@ -53,15 +59,16 @@ HandlerView::HandlerView(ContentHandler theHandler,
                          bool isprivate,
                          const std::set<std::string>& supportedPostContexts,
                          const std::string& accessLogDir,
+                         const AccessLogOptions& accessLogOptions,
                          const OTelOptions& otelOptions)
     : itsHandler(std::move(theHandler)),
       itsIpFilter(std::move(theIpFilter)),
       itsPlugin(thePlugin),
       itsResource(theResource),
       itsPrivate(isprivate),
+      itsRequestLog(accessLogOptions.records, text_capacity(accessLogOptions)),
       isLogging(loggingStatus),
-      itsLastFlushedRequest(itsRequestLog.begin()),
-      itsAccessLog(new AccessLogger(theResource, accessLogDir)),
+      itsAccessLog(new AccessLogger(theResource, accessLogDir, accessLogOptions)),
       itsOTelLog(otelOptions.enabled ? std::make_unique<OTelLogger>(theResource, otelOptions)
                                      : nullptr),
       checkPostContentType(true)
@@ -90,13 +97,14 @@ HandlerView::HandlerView(ContentHandler theHandler,
 HandlerView::HandlerView(
     ContentHandler theHandler,
     const std::string& accessLogDir,
+    const AccessLogOptions& accessLogOptions,
     const std::optional<std::string>& name,
     const OTelOptions& otelOptions)
 
     : itsHandler(std::move(theHandler)),
       itsIsCatchNoMatch(true),
+      itsRequestLog(accessLogOptions.records, text_capacity(accessLogOptions)),
       isLogging(name.has_value()),
-      itsLastFlushedRequest(itsRequestLog.begin()),
       itsOTelLog(otelOptions.enabled ? std::make_unique<OTelLogger>(
                                            name.value_or("default-handler"), otelOptions)
                                      : nullptr),
@@ -104,7 +112,7 @@ HandlerView::HandlerView(
 {
   if (name)
   {
-    itsAccessLog = std::make_unique<AccessLogger>(*name, accessLogDir);
+    itsAccessLog = std::make_unique<AccessLogger>(*name, accessLogDir, accessLogOptions);
     itsAccessLog->start();
   }
   if (itsOTelLog)
@@ -136,18 +144,37 @@ bool HandlerView::handle(Reactor& theReactor,
 
     if ((!isLogging || !itsAccessLog) && !itsOTelLog)
     {
-      // No logging of any kind — take the fast path
+      // No logging of any kind — take the fast path. Only the
+      // statistics counters are updated.
+      const auto start = std::chrono::steady_clock::now();
+      const auto cpu_start = thread_cpu_time();
+      const auto alloc_start = getThreadAllocatedBytes();
+      auto& phases = theRequest.getPhaseTimer();
+      phases.add("queue",
+                 std::chrono::duration_cast<std::chrono::microseconds>(start - phases.created()));
       auto key = theReactor.insertActiveRequest(theRequest);
       try
       {
+        auto handler_phase = phases.start("handler");
         itsHandler(theReactor, theRequest, theResponse);
+        handler_phase.stop();
         theReactor.removeActiveRequest(key, theResponse.getStatus());
       }
       catch (...)
       {
         theReactor.removeActiveRequest(key, theResponse.getStatus());
+        addServiceStats(theResponse,
+                        start,
+                        thread_cpu_time() - cpu_start,
+                        getThreadAllocatedBytes() - alloc_start);
+        finishPhases(theReactor, theRequest, theResponse);
         throw;
       }
+      addServiceStats(theResponse,
+                      start,
+                      thread_cpu_time() - cpu_start,
+                      getThreadAllocatedBytes() - alloc_start);
+      finishPhases(theReactor, theRequest, theResponse);
     }
     else
     {
@@ -241,10 +268,17 @@ bool HandlerView::handle(Reactor& theReactor,
       };
       ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_before);
       auto before = Fmi::MicrosecClock::universal_time();
+      const auto alloc_before = getThreadAllocatedBytes();
+
+      auto& phases = theRequest.getPhaseTimer();
+      phases.add("queue",
+                 std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - phases.created()));
 
       std::exception_ptr error;
       try
       {
+        auto handler_phase = phases.start("handler");
         itsHandler(theReactor, theRequest, theResponse);
       }
       catch (boost::thread_interrupted&)
@@ -258,6 +292,7 @@ bool HandlerView::handle(Reactor& theReactor,
       }
       auto accessDuration = Fmi::MicrosecClock::universal_time() - before;
       ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_after);
+      const auto allocatedBytes = getThreadAllocatedBytes() - alloc_before;
       theReactor.removeActiveRequest(key, theResponse.getStatus());
 
       // Convert the timespec delta to a Fmi::TimeDuration. Carry the
@@ -294,14 +329,15 @@ bool HandlerView::handle(Reactor& theReactor,
         const std::string ip     = theRequest.getClientIP();
         const std::string method = theRequest.getMethodString();
         theResponse.setStreamCompletionHandler(
-            [this, uri, ip, method, apikeyStr, before, cpuDuration](const HTTP::Response& response,
-                                                                    std::size_t bytesSent)
+            [this, uri, ip, method, apikeyStr, before, cpuDuration, allocatedBytes](
+                const HTTP::Response& response, std::size_t bytesSent)
             {
               const auto totalDuration = Fmi::MicrosecClock::universal_time() - before;
               auto etag = response.getHeader("ETag");
               appendLoggedRequest(uri,
                                   totalDuration,
                                   cpuDuration,
+                                  allocatedBytes,
                                   response.getStatusString(),
                                   ip,
                                   method,
@@ -317,6 +353,7 @@ bool HandlerView::handle(Reactor& theReactor,
         appendLoggedRequest(theRequest.getURI(),
                             accessDuration,
                             cpuDuration,
+                            allocatedBytes,
                             theResponse.getStatusString(),
                             theRequest.getClientIP(),
                             theRequest.getMethodString(),
@@ -326,6 +363,8 @@ bool HandlerView::handle(Reactor& theReactor,
                             apikeyStr);
       }
 
+      finishPhases(theReactor, theRequest, theResponse);
+
       if (error)
         std::rethrow_exception(error);
     }
@@ -351,62 +390,33 @@ void HandlerView::setLogging(bool newStatus)
       return;
     }
 
-    // Snapshot of pending entries to flush, captured under the lock
-    // and written to disk after we drop it. Same lock-vs-IO split
-    // as cleanLog / flushLog: a high-traffic log queue can take
-    // seconds to flush; holding the WriteLock for that long stalls
-    // every concurrent request handler waiting to enqueue its own
-    // log entry (HandlerView::handle, line 262).
-    std::vector<LoggedRequest> to_flush;
-    LogListType cleared_owner;  // takes ownership of the cleared queue
-    bool transitioned_off = false;
-
-    {
-      WriteLock lock(itsLoggingMutex);
-
-      const bool previousStatus = isLogging;
-      isLogging = newStatus;
+    WriteLock lock(itsLoggingMutex);
 
-      if (isLogging == previousStatus)
-      {
-        // No change in status, simply return.
-        return;
-      }
+    const bool previousStatus = isLogging;
+    isLogging = newStatus;
 
-      if (!isLogging)
-      {
-        // True -> false: snapshot pending entries for one final
-        // flush, then move the in-memory queue into a local list
-        // so its destructors run AFTER the lock is released.
-        auto first = firstUnflushed(itsRequestLog, itsLastFlushedRequest);
-        if (first != itsRequestLog.end())
-          to_flush.assign(first, itsRequestLog.end());
-        cleared_owner.splice(cleared_owner.end(), itsRequestLog);
-        itsLastFlushedRequest = itsRequestLog.end();
-        transitioned_off = true;
-      }
-      else
-      {
-        // False -> true: nothing to flush; reset the marker and
-        // (re-)open the on-disk file. itsAccessLog->start() opens
-        // an ofstream which is a quick syscall but does no I/O
-        // beyond create-if-missing, so it stays under the lock.
-        itsLastFlushedRequest = itsRequestLog.end();
-        itsAccessLog->start();
-      }
+    if (isLogging == previousStatus)
+    {
+      // No change in status, simply return.
+      return;
     }
 
-    if (!to_flush.empty())
+    if (!isLogging)
     {
-      for (const auto& r : to_flush)
-        itsAccessLog->log(r);
-      itsAccessLog->flush();
-      if (itsOTelLog)
-        itsOTelLog->flush();
+      // True -> false: empty the in-memory log. Clearing only moves
+      // the ring positions, but not while a LogRange is reading the
+      // records. In that case cleanLog clears the log later. The
+      // writer thread writes the queued requests and closes the file.
+      if (itsLogReaderCount == 0)
+        itsRequestLog.clear();
+      itsAccessLog->pause();
+    }
+    else
+    {
+      // False -> true: the writer thread reopens the file, it is
+      // started only if logging was initially disabled.
+      itsAccessLog->start();
     }
-    if (transitioned_off)
-      itsAccessLog->stop();
-    // cleared_owner destructs here, outside the lock.
   }
   catch (...)
   {
@@ -466,84 +476,30 @@ bool HandlerView::getLogging() const
 }
 
 // Periodic cleaner driven from ContentHandlerMap::cleanLog (every
-// 5 s). The previous implementation held the WriteLock for the
-// duration of (a) the disk flush — slow, sometimes seconds under
-// concurrent reader load — and (b) the destruction of N
-// LoggedRequest objects (each carrying ~10 std::string members).
-// Both are now off the critical path.
-//
-// Phase A: under a brief WriteLock, copy entries pending flush into
-//          a local vector and advance ``itsLastFlushedRequest``.
-//          The lock is released immediately afterwards.
-// Phase B: write the local vector to disk with NO LOCK HELD.
-//          Concurrent request handlers can ``push_back`` freely.
-// Phase C: under another brief WriteLock, splice the to-be-purged
-//          prefix into a local list. Drop the lock. The local
-//          list destructs outside the critical section so request
-//          handlers don't queue behind N std::string frees.
+// 5 s). Requests are passed to the access log writer as they finish,
+// hence flushing only wakes up the writer thread. The purge is done
+// under a brief WriteLock, it only moves the ring tail and nothing is
+// deallocated.
 void HandlerView::cleanLog(const Fmi::DateTime& minTime, bool flush)
 {
   try
   {
-    // ----- Phase A: snapshot entries pending flush -----
-    std::vector<LoggedRequest> to_flush;
-    if (flush && itsAccessLog)
-    {
-      WriteLock lock(itsLoggingMutex);
-      auto first = firstUnflushed(itsRequestLog, itsLastFlushedRequest);
-      if (first != itsRequestLog.end())
-      {
-        to_flush.assign(first, itsRequestLog.end());
-        itsLastFlushedRequest = std::prev(itsRequestLog.end());
-      }
-    }
-
-    // ----- Phase B: disk I/O outside the lock -----
-    if (!to_flush.empty())
-    {
-      for (const auto& r : to_flush)
-        itsAccessLog->log(r);
-      itsAccessLog->flush();
-      if (itsOTelLog)
-        itsOTelLog->flush();
-    }
+    if (flush)
+      flushLog();
 
-    // ----- Phase C: purge old entries; destructors run unlocked -----
-    LogListType erased_owner;
-    {
-      WriteLock lock(itsLoggingMutex);
-
-      // Skip the purge if a LogRange (?what=lastrequests) is in
-      // flight; it holds raw iterators we mustn't invalidate. The
-      // entries will be picked up on the next cycle.
-      if (itsLogReaderCount != 0)
-        return;
+    WriteLock lock(itsLoggingMutex);
 
-      auto purge_end = std::find_if(itsRequestLog.begin(),
-                                     itsRequestLog.end(),
-                                     std::bind(isNotOld, minTime, p::_1));
+    // Skip the purge if a LogRange (?what=lastrequests) is in
+    // flight; it reads records we mustn't release for reuse. The
+    // entries will be picked up on the next cycle.
+    if (itsLogReaderCount != 0)
+      return;
 
-      if (purge_end != itsRequestLog.begin())
-      {
-        // After Phase A, ``itsLastFlushedRequest`` points to the
-        // most recent entry. If we are erasing every entry
-        // (purge_end == end()), the marker becomes invalid; reset
-        // to end(). Otherwise the most recent entry survives and
-        // the iterator remains valid (std::list iterator stability).
-        if (purge_end == itsRequestLog.end())
-          itsLastFlushedRequest = itsRequestLog.end();
-
-        // splice() transfers nodes between lists in O(N) (size
-        // bookkeeping) without allocating, copying, or destructing.
-        // The destructors then fire when ``erased_owner`` goes out
-        // of scope below — outside the WriteLock.
-        erased_owner.splice(erased_owner.end(),
-                             itsRequestLog,
-                             itsRequestLog.begin(),
-                             purge_end);
-      }
-    }
-    // erased_owner destructs here, outside the lock.
+    // A log disabled while it was being read is cleared here
+    if (!isLogging)
+      itsRequestLog.clear();
+    else
+      itsRequestLog.purge(minTime);
   }
   catch (...)
   {
@@ -554,6 +510,7 @@ void HandlerView::cleanLog(const Fmi::DateTime& minTime, bool flush)
 void HandlerView::appendLoggedRequest(const std::string& uri,
                                       Fmi::TimeDuration accessDuration,
                                       Fmi::TimeDuration cpuDuration,
+                                      std::uint64_t allocatedBytes,
                                       const std::string& status,
                                       const std::string& ip,
                                       const std::string& method,
@@ -564,31 +521,62 @@ void HandlerView::appendLoggedRequest(const std::string& uri,
 {
   try
   {
-    WriteLock lock(itsLoggingMutex);
+    addStatistics(std::atoi(status.c_str()),
+                  to_microseconds(accessDuration),
+                  to_microseconds(cpuDuration),
+                  allocatedBytes);
 
-    // Build the LoggedRequest used by both file access log and OTel.
     // requestEndTime is taken now, i.e. at handler return for normal
     // responses and at stream completion for deferred streamed ones.
-    const LoggedRequest logged(uri,
-                               Fmi::MicrosecClock::local_time(),
-                               accessDuration,
-                               cpuDuration,
-                               status,
-                               ip,
-                               method,
-                               version,
-                               contentLength,
-                               etag,
-                               apikey);
-
-    // isLogging may have changed since the request started.
-    if (isLogging)
-      itsRequestLog.push_back(logged);
+    const auto endTime = Fmi::MicrosecClock::local_time();
+
+    bool logging = false;
+    {
+      WriteLock lock(itsLoggingMutex);
+
+      // isLogging may have changed since the request started. Old records
+      // may be overwritten only if nobody is reading them. Requests missing
+      // from the in-memory log are still written to the access log.
+      logging = isLogging;
+      if (logging)
+        itsRequestLog.append(uri,
+                             endTime,
+                             accessDuration,
+                             cpuDuration,
+                             status,
+                             ip,
+                             method,
+                             version,
+                             contentLength,
+                             etag,
+                             apikey,
+                             itsLogReaderCount == 0);
+    }
+
+    const bool accessLogging = (logging && itsAccessLog);
+    if (!accessLogging && !itsOTelLog)
+      return;
+
+    LoggedRequest request(uri,
+                          endTime,
+                          accessDuration,
+                          cpuDuration,
+                          status,
+                          ip,
+                          method,
+                          version,
+                          contentLength,
+                          etag,
+                          apikey);
 
     // OTel export is independent of file logging toggle.
     // BatchSpanProcessor queues the span internally and returns immediately.
     if (itsOTelLog)
-      itsOTelLog->log(logged);
+      itsOTelLog->log(request);
+
+    // Only queues the request for the writer thread, no I/O here
+    if (accessLogging)
+      itsAccessLog->log(std::move(request));
   }
   catch (...)
   {
@@ -596,32 +584,17 @@ void HandlerView::appendLoggedRequest(const std::string& uri,
   }
 }
 
-// Operator-driven flush (e.g. handler destructor on shutdown). Same
-// lock-vs-IO split as cleanLog's Phase A + B; no purge phase.
+// Operator-driven flush (e.g. handler destructor on shutdown). The
+// requests are already queued for the writer thread, which is asked to
+// write them now.
 void HandlerView::flushLog()
 {
   try
   {
-    std::vector<LoggedRequest> to_flush;
-    {
-      WriteLock lock(itsLoggingMutex);
-      if (itsAccessLog == nullptr)
-        return;
-      auto first = firstUnflushed(itsRequestLog, itsLastFlushedRequest);
-      if (first != itsRequestLog.end())
-      {
-        to_flush.assign(first, itsRequestLog.end());
-        itsLastFlushedRequest = std::prev(itsRequestLog.end());
-      }
-    }
-    if (!to_flush.empty())
-    {
-      for (const auto& r : to_flush)
-        itsAccessLog->log(r);
+    if (itsAccessLog)
       itsAccessLog->flush();
-      if (itsOTelLog)
-        itsOTelLog->flush();
-    }
+    if (itsOTelLog)
+      itsOTelLog->flush();
   }
   catch (...)
   {
@@ -636,6 +609,100 @@ LogRange HandlerView::getLoggedRequests()
   return {itsRequestLog, this};
 }
 
+// Count a request handled on the fast path. Streamed responses are
+// counted once streaming has finished, as in the logging path.
+void HandlerView::addServiceStats(HTTP::Response& theResponse,
+                                  std::chrono::steady_clock::time_point theStart,
+                                  std::chrono::microseconds theCpuTime,
+                                  std::uint64_t theAllocatedBytes)
+{
+  if (theResponse.hasStreamContent())
+  {
+    theResponse.setStreamCompletionHandler(
+        [this, theStart, theCpuTime, theAllocatedBytes](const HTTP::Response& response,
+                                                        std::size_t /* bytes */)
+        {
+          addStatistics(static_cast<int>(response.getStatus()),
+                        std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - theStart),
+                        theCpuTime,
+                        theAllocatedBytes);
+        });
+  }
+  else
+  {
+    addStatistics(static_cast<int>(theResponse.getStatus()),
+                  std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - theStart),
+                  theCpuTime,
+                  theAllocatedBytes);
+  }
+}
+
+// Sampling uses a per-thread generator to avoid contention. Admin clients
+// opt in with an X-Server-Timing request header, and only then are their
+// credentials checked.
+void HandlerView::finishPhases(const Reactor& theReactor,
+                               const HTTP::Request& theRequest,
+                               HTTP::Response& theResponse)
+{
+  const auto& timer = theRequest.getPhaseTimer();
+  const auto& options = theReactor.getOptions().servertiming;
+
+  if (options.enabled)
+  {
+    thread_local std::minstd_rand generator{std::random_device{}()};
+    const bool sampled = (options.sample_rate > 0 &&
+                          std::uniform_real_distribution<double>(0, 1)(generator) <
+                              options.sample_rate);
+
+    const bool requested = (!sampled && options.admin && theRequest.getHeader("X-Server-Timing") &&
+                            theReactor.isAdminAuthenticated(theRequest));
+
+    if (sampled || requested)
+      theResponse.setHeader("Server-Timing", timer.serverTiming());
+  }
+
+  itsPhaseStats.add(timer.phases());
+
+  // Time spent streaming the response after the handler returned
+  if (theResponse.hasStreamContent())
+  {
+    const auto end = std::chrono::steady_clock::now();
+    theResponse.addStreamCompletionHandler(
+        [this, end](const HTTP::Response& /* response */, std::size_t /* bytes */)
+        {
+          itsPhaseStats.add({PhaseTimer::Phase{
+              "stream",
+              std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - end)}});
+        });
+  }
+}
+
+void HandlerView::addStatistics(int theStatus,
+                                std::chrono::microseconds theDuration,
+                                std::chrono::microseconds theCpuTime,
+                                std::uint64_t theAllocatedBytes)
+{
+  itsServiceStats.add(theDuration, theCpuTime, theAllocatedBytes);
+  itsLatencyStats.add(theStatus, theDuration, theCpuTime);
+  OTelMetricsExporter::recordRequest(itsResource, theStatus, theDuration, theCpuTime);
+}
+
+RequestLog::Statistics HandlerView::getRequestLogStatistics() const
+{
+  ReadLock lock(itsLoggingMutex);
+  return itsRequestLog.getStatistics();
+}
+
+std::optional<AccessLogger::Statistics> HandlerView::getAccessLogStatistics() const
+{
+  if (!itsAccessLog)
+    return {};
+  return itsAccessLog->getStatistics();
+}
+
 void HandlerView::releaseLogRange()
 {
   --itsLogReaderCount;
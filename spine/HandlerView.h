@@ -3,16 +3,22 @@
 #include "AccessLogger.h"
 #include "HTTP.h"
 #include "IPFilter.h"
+#include "LatencyStats.h"
 #include "LogRange.h"
 #include "OTelLogger.h"
 #include "OTelOptions.h"
+#include "PhaseStats.h"
+#include "RequestLog.h"
+#include "ServiceStats.h"
 #include "SmartMetPlugin.h"
 #include "Thread.h"
+#include <chrono>
 #include <functional>
 #include <memory>
 #include <optional>
 #include <set>
 #include <string>
+#include <vector>
 
 namespace SmartMet
 {
@@ -37,11 +43,13 @@ class HandlerView
               bool isprivate,
               const std::set<std::string>& supportedPostContexts,
               const std::string& accessLogDir,
+              const AccessLogOptions& accessLogOptions,
               const OTelOptions& otelOptions);
 
   // CatchNoMatch handler
   explicit HandlerView(ContentHandler theHandler,
               const std::string& accessLogDir,
+              const AccessLogOptions& accessLogOptions,
               const std::optional<std::string>& accessLogName,
               const OTelOptions& otelOptions);
 
@@ -86,6 +94,21 @@ class HandlerView
   // Get logged requests
   LogRange getLoggedRequests();
 
+  // Get access log writer statistics, empty if there is no access log
+  std::optional<AccessLogger::Statistics> getAccessLogStatistics() const;
+
+  // Get memory usage of the in-memory request log
+  RequestLog::Statistics getRequestLogStatistics() const;
+
+  // Request counters for ?what=servicestats, kept even when logging is disabled
+  const ServiceStats& getServiceStats() const { return itsServiceStats; }
+
+  // Latency histograms per status class, kept even when logging is disabled
+  const LatencyStats& getLatencyStats() const { return itsLatencyStats; }
+
+  // Request phase totals, kept even when logging is disabled
+  const PhaseStats& getPhaseStats() const { return itsPhaseStats; }
+
   // Relase a log range
   void releaseLogRange();
 
@@ -101,14 +124,15 @@ class HandlerView
   const std::string& getResource() const;
 
  private:
-  // Assemble a LoggedRequest from its fields and append it to the in-memory
-  // request log (when logging is enabled) and the OTel trace export. Takes
+  // Append a finished request to the in-memory request log and the access
+  // log writer (when logging is enabled) and the OTel trace export. Takes
   // itsLoggingMutex internally. Used both for the immediate (non-streamed)
   // logging path and, deferred, for streamed responses once the connection
   // layer reports the actual number of body bytes streamed.
   void appendLoggedRequest(const std::string& uri,
                            Fmi::TimeDuration accessDuration,
                            Fmi::TimeDuration cpuDuration,
+                           std::uint64_t allocatedBytes,
                            const std::string& status,
                            const std::string& ip,
                            const std::string& method,
@@ -117,6 +141,23 @@ class HandlerView
                            const std::string& etag,
                            const std::string& apikey);
 
+  // Update the service statistics on the fast path
+  void addServiceStats(HTTP::Response& theResponse,
+                       std::chrono::steady_clock::time_point theStart,
+                       std::chrono::microseconds theCpuTime,
+                       std::uint64_t theAllocatedBytes);
+
+  // Aggregate the request phases and add the Server-Timing header if requested
+  void finishPhases(const Reactor& theReactor,
+                    const HTTP::Request& theRequest,
+                    HTTP::Response& theResponse);
+
+  // Count a finished request into the counters and latency histograms
+  void addStatistics(int theStatus,
+                     std::chrono::microseconds theDuration,
+                     std::chrono::microseconds theCpuTime,
+                     std::uint64_t theAllocatedBytes);
+
   // The actual handler functor
   const ContentHandler itsHandler;
 
@@ -136,10 +177,19 @@ class HandlerView
   const bool itsPrivate = false;
 
   // The request log for this handler
-  LogListType itsRequestLog;
+  RequestLog itsRequestLog;
+
+  // Pre-aggregated request counters
+  ServiceStats itsServiceStats;
+
+  // Wall clock and CPU time histograms
+  LatencyStats itsLatencyStats;
+
+  // Request phase totals
+  PhaseStats itsPhaseStats;
 
   // Mutex for logging operations
-  mutable MutexType itsLoggingMutex;
+  mutable NamedMutexType itsLoggingMutex{"HandlerView::logging"};
 
   // Flag to see if logging is on
   bool isLogging = false;
@@ -147,9 +197,6 @@ class HandlerView
   // How many LogRanges are in use
   std::atomic<int> itsLogReaderCount{0};
 
-  // Iterator to point to the last request flushed to disk
-  LogListType::iterator itsLastFlushedRequest;
-
   // Handle for access log file
   std::unique_ptr<AccessLogger> itsAccessLog;
 
@@ -161,7 +161,8 @@ std::map<std::string, Json::Value> parse_substitutions(const HTTP::ParamMap& the
 void JSON::preprocess(Json::Value& theJson,
                       const std::string& theRootPath,
                       const std::string& thePath,
-                      const JsonCache& theJsonCache)
+                      const JsonCache& theJsonCache,
+                      JsonCache::Dependencies* theDependencies)
 {
   try
   {
@@ -178,7 +179,7 @@ void JSON::preprocess(Json::Value& theJson,
           // 1) Check from path
           json_file = thePath + "/" + filename;
           // If file not found, check from theRootPath
-          if (!std::filesystem::exists(json_file))
+          if (!theJsonCache.exists(json_file, theDependencies))
             filename.insert(filename.begin(), '/');
         }
         // Check from theRootPath
@@ -186,11 +187,11 @@ void JSON::preprocess(Json::Value& theJson,
         {
           // 1) Check from root-path
           json_file = theRootPath + filename;
-          if (!std::filesystem::exists(json_file))
+          if (!theJsonCache.exists(json_file, theDependencies))
           {
             // 2) Check from root-path/resources/layers
             json_file = theRootPath + "/resources/layers" + filename;
-            if (!std::filesystem::exists(json_file))
+            if (!theJsonCache.exists(json_file, theDependencies))
             {
               // 3) Check from root-path/resources
               json_file = theRootPath + "/resources" + filename;
@@ -199,10 +200,10 @@ void JSON::preprocess(Json::Value& theJson,
         }
 
         // Replace old contents
-        theJson = theJsonCache.get(json_file);
+        theJson = *theJsonCache.get(json_file, theDependencies);
 
         // TODO(mheiskan): should we prevent infinite recursion?
-        preprocess(theJson, theRootPath, thePath, theJsonCache);
+        preprocess(theJson, theRootPath, thePath, theJsonCache, theDependencies);
       }
     }
 
@@ -210,7 +211,7 @@ void JSON::preprocess(Json::Value& theJson,
     else if (theJson.isArray())
     {
       for (auto& json : theJson)
-        preprocess(json, theRootPath, thePath, theJsonCache);
+        preprocess(json, theRootPath, thePath, theJsonCache, theDependencies);
     }
     // Seek deeper in objects
     else if (theJson.isObject())
@@ -218,7 +219,7 @@ void JSON::preprocess(Json::Value& theJson,
       const auto members = theJson.getMemberNames();
       for (const auto& name : members)
       {
-        preprocess(theJson[name], theRootPath, thePath, theJsonCache);
+        preprocess(theJson[name], theRootPath, thePath, theJsonCache, theDependencies);
       }
     }
   }
@@ -6,6 +6,7 @@
 
 #pragma once
 #include "HTTP.h"
+#include "JsonCache.h"
 #include <json/json.h>
 #include <macgyver/Exception.h>
 #include <macgyver/TimeParser.h>
@@ -17,8 +18,6 @@ namespace SmartMet
 {
 namespace Spine
 {
-class JsonCache;
-
 namespace JSON
 {
 // void substitute json-includes and references from query string options
@@ -27,11 +26,13 @@ void replaceReferences(Json::Value& theJson,
                        const std::string& thePrefix = "",
                        bool theCaseIsInsensitive = true);
 
-// expand includes in the Json ("json:file/name.json")
+// expand includes in the Json ("json:file/name.json"), optionally recording
+// the files used. See also JsonCache::getPreprocessed.
 void preprocess(Json::Value& theJson,
                 const std::string& theRootPath,
                 const std::string& thePath,
-                const JsonCache& theJsonCache);
+                const JsonCache& theJsonCache,
+                JsonCache::Dependencies* theDependencies = nullptr);
 
 // expand references in the Json ("path:name1.name2[0].parameter")
 void dereference(Json::Value& theJson);
@@ -1,25 +1,50 @@
 // ======================================================================
 
 #include "JsonCache.h"
-#include <boost/filesystem/operations.hpp>
-#include <boost/functional/hash.hpp>
+#include "Json.h"
 #include <macgyver/Exception.h>
-#include <macgyver/FileSystem.h>
-#include <fstream>
-#include <stdexcept>
+#include <algorithm>
+#include <chrono>
 
 namespace SmartMet
 {
 namespace Spine
 {
+namespace
+{
+std::int64_t now()
+{
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+// Drop the least recently used entries until the cache fits. Called with
+// the write lock held, only when inserting.
+template <typename Cache>
+void shrink(Cache& theCache, std::size_t theMaxSize)
+{
+  while (!theCache.empty() && theCache.size() > theMaxSize)
+  {
+    auto oldest = std::min_element(theCache.begin(),
+                                   theCache.end(),
+                                   [](const auto& a, const auto& b)
+                                   { return a.second->used < b.second->used; });
+    theCache.erase(oldest);
+  }
+}
+}  // namespace
+
 // ----------------------------------------------------------------------
 /*!
- * \brief Construct JSON cache element
+ * \brief Constructor
+ *
+ * The file cache tracks changes only, the text is not kept since it is
+ * needed only for parsing.
  */
 // ----------------------------------------------------------------------
 
-JsonCache::Data::Data(std::time_t theTime, Json::Value theJson)
-    : modification_time(theTime), json(std::move(theJson))
+JsonCache::JsonCache(std::size_t theMaxSize)
+    : itsMaxSize(std::max<std::size_t>(1, theMaxSize)),
+      itsFileCache(std::chrono::seconds(10), true, false)
 {
 }
 
@@ -27,61 +52,152 @@ JsonCache::Data::Data(std::time_t theTime, Json::Value theJson)
 /*!
  * \brief Get file JSON contents
  *
- * Note: Returns a deep copy
+ * Note: The value is shared, copy it before modifying it
  */
 // ----------------------------------------------------------------------
 
-Json::Value JsonCache::get(const std::filesystem::path& thePath) const
+std::shared_ptr<const Json::Value> JsonCache::get(const std::filesystem::path& thePath,
+                                                  Dependencies* theDependencies) const
 {
   try
   {
-    std::time_t mtime = Fmi::last_write_time(thePath);
+    const auto version = itsFileCache.version(thePath);
+    if (version == 0)
+      throw Fmi::Exception(BCP, "Failed to open '" + thePath.string() + "' for reading!");
 
-    std::size_t hash = std::filesystem::hash_value(thePath);
+    if (theDependencies)
+      theDependencies->emplace_back(thePath, version);
 
     // Try using the cache with a lock first
     {
       ReadLock lock{itsMutex};
-      auto iter = itsCache.find(hash);
-      if (iter != itsCache.end())
+      auto iter = itsCache.find(thePath);
+      if (iter != itsCache.end() && iter->second->version == version)
       {
-        if (mtime == iter->second.modification_time)
-          return iter->second.json;
+        iter->second->used = now();
+        return iter->second->json;
       }
     }
 
-    // No active lock while we read the file contents
-
-    std::string content;
-    std::ifstream in{thePath.c_str()};
-    if (!in)
-      throw Fmi::Exception{BCP,
-                           "Failed to open '" + std::string(thePath.c_str()) + "' for reading!"};
+    // Read and parse the JSON without a lock. Should the file change
+    // meanwhile, its version changes too and it will be parsed again.
 
-    content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
-
-    // Parse the JSON
+    auto source = itsFileCache.get(thePath);
 
     Json::Reader reader;
     Json::Value json;
-    bool json_ok = reader.parse(content, json);
+    bool json_ok = reader.parse(*source, json);
     if (!json_ok)
       throw Fmi::Exception{
           BCP, "Failed to parse '" + thePath.string() + "': " + reader.getFormattedErrorMessages()};
 
     // Now insert the value into the cache and return it
 
-    Data data{mtime, json};
+    auto data = std::make_shared<Data>();
+    data->version = version;
+    data->json = std::make_shared<const Json::Value>(std::move(json));
+    data->used = now();
 
     WriteLock lock{itsMutex};
-    itsCache[hash] = data;
-    return json;
+    itsCache[thePath] = data;
+    shrink(itsCache, itsMaxSize);
+    return data->json;
   }
   catch (...)
   {
     throw Fmi::Exception::Trace(BCP, "Operation failed!");
   }
-}  // namespace Spine
+}
+
+bool JsonCache::exists(const std::filesystem::path& thePath, Dependencies* theDependencies) const
+{
+  try
+  {
+    const bool ok = (itsFileCache.version(thePath) != 0);
+    if (!ok && theDependencies)
+      theDependencies->emplace_back(thePath, 0);
+    return ok;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether the recorded dependencies are unchanged
+ *
+ * Must be called without the lock, the file cache may access the disk.
+ */
+// ----------------------------------------------------------------------
+
+bool JsonCache::valid(const Dependencies& theDependencies) const
+{
+  try
+  {
+    for (const auto& dependency : theDependencies)
+    {
+      if (itsFileCache.version(dependency.first) != dependency.second)
+        return false;
+    }
+    return true;
+  }
+  catch (...)
+  {
+    return false;
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get file JSON contents with json: includes expanded
+ *
+ * The result is cached per file and include paths, and rebuilt only if
+ * one of the files it was built from changes, or a missing include
+ * candidate appears.
+ */
+// ----------------------------------------------------------------------
+
+std::shared_ptr<const Json::Value> JsonCache::getPreprocessed(const std::filesystem::path& theFile,
+                                                              const std::string& theRootPath,
+                                                              const std::string& thePath) const
+{
+  try
+  {
+    const std::string key = theFile.string() + '\n' + theRootPath + '\n' + thePath;
+
+    std::shared_ptr<const Preprocessed> cached;
+    {
+      ReadLock lock{itsMutex};
+      auto iter = itsPreprocessedCache.find(key);
+      if (iter != itsPreprocessedCache.end())
+        cached = iter->second;
+    }
+
+    if (cached && valid(cached->dependencies))
+    {
+      cached->used = now();
+      return cached->json;
+    }
+
+    auto preprocessed = std::make_shared<Preprocessed>();
+    Json::Value json = *get(theFile, &preprocessed->dependencies);
+    JSON::preprocess(json, theRootPath, thePath, *this, &preprocessed->dependencies);
+
+    preprocessed->json = std::make_shared<const Json::Value>(std::move(json));
+    preprocessed->used = now();
+
+    WriteLock lock{itsMutex};
+    itsPreprocessedCache[key] = preprocessed;
+    shrink(itsPreprocessedCache, itsMaxSize);
+    return preprocessed->json;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
 
 }  // namespace Spine
 }  // namespace SmartMet
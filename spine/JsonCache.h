@@ -1,16 +1,40 @@
 // ======================================================================
 /*!
- * \brief Generic file content cache
+ * \brief Cache of parsed and preprocessed JSON files
+ *
+ * The parsed values are shared, a cache hit only increments a reference
+ * count. A caller which needs to modify a value must make its own copy
+ * (Json::Value json = *cache.get(path)).
+ *
+ * The files are tracked by a FileCache, which watches them for changes
+ * but does not keep their text: only the parsed values are kept. A
+ * parsed value is reused as long as the file version it was parsed
+ * from is current.
+ *
+ * Preprocessed values (json: includes expanded) record the version of
+ * every file read and every missing include candidate checked while
+ * resolving the includes. The value is rebuilt if any of them changes.
+ * The versions are checked without holding the cache lock, since
+ * checking may need to access the disk.
+ *
+ * Both caches are bounded in the number of entries, the least recently
+ * used entry is dropped when a new one does not fit.
  */
 // ======================================================================
 
 #pragma once
 
+#include "FileCache.h"
 #include "Thread.h"
+#include <atomic>
+#include <cstdint>
 #include <filesystem>
 #include <json/json.h>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace SmartMet
 {
@@ -19,22 +43,56 @@ namespace Spine
 class JsonCache
 {
  public:
-  // Always return a copy
-  Json::Value get(const std::filesystem::path& thePath) const;
+  // Files and their versions used, 0 for files found missing
+  using Dependencies = std::vector<std::pair<std::filesystem::path, std::uint64_t>>;
+
+  explicit JsonCache(std::size_t theMaxSize = 1000);
+
+  // Shared value, copy it to modify it
+  std::shared_ptr<const Json::Value> get(const std::filesystem::path& thePath,
+                                         Dependencies* theDependencies = nullptr) const;
+
+  // Test whether a file exists, missing files are recorded as dependencies
+  bool exists(const std::filesystem::path& thePath, Dependencies* theDependencies = nullptr) const;
+
+  // JSON with includes expanded, see JSON::preprocess
+  std::shared_ptr<const Json::Value> getPreprocessed(const std::filesystem::path& theFile,
+                                                     const std::string& theRootPath,
+                                                     const std::string& thePath) const;
 
  private:
   struct Data
   {
-    std::time_t modification_time = 0;
-    Json::Value json;
+    std::uint64_t version = 0;
+    std::shared_ptr<const Json::Value> json;
+    mutable std::atomic<std::int64_t> used{0};  // for LRU eviction
+  };
 
-    Data() = default;
-    Data(std::time_t theTime, Json::Value theJson);
+  struct Preprocessed
+  {
+    Dependencies dependencies;
+    std::shared_ptr<const Json::Value> json;
+    mutable std::atomic<std::int64_t> used{0};
   };
 
-  using Cache = std::unordered_map<std::size_t, Data>;
-  mutable MutexType itsMutex;
-  mutable Cache itsCache;
+  struct PathHash
+  {
+    std::size_t operator()(const std::filesystem::path& thePath) const
+    {
+      return std::filesystem::hash_value(thePath);
+    }
+  };
+
+  bool valid(const Dependencies& theDependencies) const;
+
+  std::size_t itsMaxSize;
+  FileCache itsFileCache;
+
+  mutable NamedMutexType itsMutex{"JsonCache"};
+  mutable std::unordered_map<std::filesystem::path, std::shared_ptr<const Data>, PathHash>
+      itsCache;
+  mutable std::unordered_map<std::string, std::shared_ptr<const Preprocessed>>
+      itsPreprocessedCache;
 
 };  // class JsonCache
 
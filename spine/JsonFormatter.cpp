@@ -16,8 +16,11 @@
 #include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <list>
 #include <set>
+#include <string_view>
+#include <vector>
 
 namespace SmartMet
 {
@@ -33,20 +36,19 @@ namespace
  */
 // ----------------------------------------------------------------------
 
-std::string escape_json(const std::string& s)
+void append_json(std::string& out, const std::string& s)
 {
-  std::string out = "\"";
+  out += '"';
   for (auto c : s)
   {
     if (c == '"' || c == '\\' || ('\x00' <= c && c <= '\x1f'))
     {
-      out += fmt::format("\\u{:04x}", static_cast<int>(c));
+      fmt::format_to(std::back_inserter(out), "\\u{:04x}", static_cast<int>(c));
     }
     else
       out += c;
   }
   out += '"';
-  return out;
 }
 
 // ----------------------------------------------------------------------
@@ -127,113 +129,219 @@ std::list<std::string> parse_attributes(const std::string& theStr)
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Format recursion
+ * \brief Formats the rows on demand
+ *
+ * The rows are grouped recursively by the unique values of the given
+ * attributes. The recursion is kept in an explicit stack of groups so
+ * that formatting can pause after any row. The rows of a group are
+ * released once it has been formatted.
  */
 // ----------------------------------------------------------------------
 
-std::string format_recursively(const Table& theTable,
-                               const TableFormatter::Names& theNames,
-                               const HTTP::Request& theReq,
-                               Table::Indexes& theCols,
-                               const Table::Indexes& theRows,
-                               std::list<std::string>& theAttributes)
+using Rows = std::vector<std::size_t>;
+
+class JsonCursor : public TableFormatter::Cursor
+{
+ public:
+  JsonCursor(const Table& theTable,
+             const TableFormatter::Names& theNames,
+             const HTTP::Request& theReq);
+
+  bool next(std::string& theOutput, std::size_t theChunkSize) override;
+
+ private:
+  // Rows with the same values in the grouping columns so far. Groups
+  // deeper than the attributes are formatted as arrays of rows, the
+  // others as objects keyed by the unique values of the next attribute.
+  struct Group
+  {
+    explicit Group(Rows theRows) : rows(std::move(theRows)) {}
+
+    Rows rows;
+    Rows::const_iterator row;
+    std::size_t column = 0;
+    std::set<std::string_view> values;
+    std::set<std::string_view>::const_iterator value;
+    std::size_t count = 0;
+    bool open = false;
+  };
+
+  void push(Rows theRows);
+  void pop();
+  bool leaf() const { return itsGroups.size() > itsAttributes.size(); }
+  void format_row(std::string& out, std::size_t j) const;
+
+  const Table& itsTable;
+  const TableFormatter::Names& itsNames;
+  std::vector<std::string> itsAttributes;
+  Table::Indexes itsCols;
+  std::vector<Group> itsGroups;
+  bool itsStarted = false;
+};
+
+JsonCursor::JsonCursor(const Table& theTable,
+                       const TableFormatter::Names& theNames,
+                       const HTTP::Request& theReq)
+    : itsTable(theTable),
+      itsNames(theTable.getNames(theNames, true)),
+      itsCols(theTable.columns())
 {
   try
   {
-    std::string out;
-    out.reserve(TableFormatter::default_minimum_size);
-
-    const std::string miss = "null";
-    if (theAttributes.empty())
-    {
-      // Format the json always as an array
-      out += '[';
-      std::size_t row = 0;
-      for (std::size_t j : theRows)
-      {
-        if (row++ > 0)
-          out += ',';
-
-        out += "{";
+    std::string givenatts;
+    auto attribs = theReq.getParameter("attributes");
+    if (!attribs)
+      givenatts = "";
+    else
+      givenatts = *attribs;
 
-        std::size_t col = 0;
-        for (std::size_t i : theCols)
-        {
-          if (col++ > 0)
-            out += ',';
+    // Repeated attributes have no effect
+    for (const auto& attribute : parse_attributes(givenatts))
+      if (std::find(itsAttributes.begin(), itsAttributes.end(), attribute) == itsAttributes.end())
+        itsAttributes.push_back(attribute);
 
-          const std::string& name = theNames[i];
-          out += '"';
-          out += name;
-          out += '"';
+    // The iterators of the groups must not be moved
+    itsGroups.reserve(itsAttributes.size() + 1);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
 
-          out += ':';
-
-          const auto& value = theTable.get(i, j);
-          if (value.empty())
-            out += miss;
-          else if (value == "nan" || value == "NaN")  // nan is not allowed in JSON
-            out += "null";
-          else if (looks_number(value))
-            out += value;
-          else
-            out += escape_json(value);
-        }
-        out += '}';
-      }
+// Start a group, which removes its attribute column from the output
+void JsonCursor::push(Rows theRows)
+{
+  itsGroups.emplace_back(std::move(theRows));
+  auto& group = itsGroups.back();
+  group.row = group.rows.begin();
 
-      out += ']';
-    }
-    else
+  if (!leaf())
+  {
+    // The table is not modified during formatting, hence views to the
+    // cells stay valid.
+    group.column = find_name(itsAttributes[itsGroups.size() - 1], itsNames);
+    for (std::size_t j : group.rows)
     {
-      // Find the ordinal of the attribute
-      std::string attribute = theAttributes.front();
-      theAttributes.pop_front();
-      std::size_t nam = find_name(attribute, theNames);
+      const auto& value = itsTable.get(group.column, j);
+      if (!value.empty())
+        group.values.insert(value);
+    }
+    itsCols.erase(group.column);
+  }
+  group.value = group.values.begin();
+}
 
-      // Collect unique values in the attribute column
+// Finish a group, which restores its attribute column
+void JsonCursor::pop()
+{
+  if (!leaf())
+    itsCols.insert(itsGroups.back().column);
+  itsGroups.pop_back();
+}
 
-      std::set<std::string> values;
-      for (std::size_t j : theRows)
-      {
-        const auto& value = theTable.get(nam, j);
-        if (!value.empty())
-          values.insert(value);
-      }
+void JsonCursor::format_row(std::string& out, std::size_t j) const
+{
+  const std::string miss = "null";
+
+  out += "{";
 
-      // Remove the attribute column temporarily
+  std::size_t col = 0;
+  for (std::size_t i : itsCols)
+  {
+    if (col++ > 0)
+      out += ',';
+
+    const std::string& name = itsNames[i];
+    out += '"';
+    out += name;
+    out += '"';
+
+    out += ':';
+
+    const auto& value = itsTable.get(i, j);
+    if (value.empty())
+      out += miss;
+    else if (value == "nan" || value == "NaN")  // nan is not allowed in JSON
+      out += "null";
+    else if (looks_number(value))
+      out += value;
+    else
+      append_json(out, value);
+  }
+  out += '}';
+}
 
-      theCols.erase(nam);
-      theAttributes.remove(attribute);
+bool JsonCursor::next(std::string& theOutput, std::size_t theChunkSize)
+{
+  try
+  {
+    std::string& out = theOutput;
+    const auto start = out.size();
 
-      // Process unique attribute values one at a time
+    if (!itsStarted)
+    {
+      const Table::Indexes all_rows = itsTable.rows();
+      push(Rows(all_rows.begin(), all_rows.end()));
+      itsStarted = true;
+    }
 
-      out += '{';
+    while (!itsGroups.empty() && out.size() - start < theChunkSize)
+    {
+      auto& group = itsGroups.back();
 
-      int att = 0;
-      for (const std::string& v : values)
+      if (leaf())
       {
-        if (att++ > 0)
-          out += ',';
-        Table::Indexes rows;
-        for (std::size_t j : theRows)
+        // Format the json always as an array
+        if (!group.open)
+          out += '[';
+        group.open = true;
+
+        if (group.row == group.rows.end())
         {
-          if (theTable.get(nam, j) == v)
-            rows.insert(j);
+          out += ']';
+          pop();
+        }
+        else
+        {
+          if (group.count++ > 0)
+            out += ',';
+          format_row(out, *group.row++);
         }
-        out += '"';
-        out += v;
-        out += "\":";
-        out += format_recursively(theTable, theNames, theReq, theCols, rows, theAttributes);
       }
-      out += '}';
+      else
+      {
+        // Process unique attribute values one at a time
+        if (!group.open)
+          out += '{';
+        group.open = true;
 
-      // Restore the attribute column
+        if (group.value == group.values.end())
+        {
+          out += '}';
+          pop();
+        }
+        else
+        {
+          if (group.count++ > 0)
+            out += ',';
 
-      theCols.insert(nam);
-      theAttributes.push_front(attribute);
+          const auto v = *group.value++;
+          Rows rows;
+          for (std::size_t j : group.rows)
+          {
+            if (itsTable.get(group.column, j) == v)
+              rows.push_back(j);
+          }
+          out += '"';
+          out += v;
+          out += "\":";
+          push(std::move(rows));  // invalidates group
+        }
+      }
     }
-    return out;
+
+    return !itsGroups.empty();
   }
   catch (...)
   {
@@ -256,21 +364,32 @@ std::string JsonFormatter::format(const Table& theTable,
 {
   try
   {
-    std::string givenatts;
-    auto attribs = theReq.getParameter("attributes");
-    if (!attribs)
-      givenatts = "";
-    else
-      givenatts = *attribs;
-
-    std::list<std::string> atts = parse_attributes(givenatts);
-
-    Table::Indexes cols = theTable.columns();
-    Table::Indexes rows = theTable.rows();
+    std::string out;
+    out.reserve(default_minimum_size);
+    JsonCursor(theTable, theNames, theReq).next(out, std::string::npos);
+    return out;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
 
-    const auto& names = theTable.getNames(theNames, true);
+// ----------------------------------------------------------------------
+/*!
+ * \brief Format a 2D table on demand
+ */
+// ----------------------------------------------------------------------
 
-    return format_recursively(theTable, names, theReq, cols, rows, atts);
+std::unique_ptr<TableFormatter::Cursor> JsonFormatter::cursor(
+    const Table& theTable,
+    const TableFormatter::Names& theNames,
+    const HTTP::Request& theReq,
+    const TableFormatterOptions& /* theConfig */) const
+{
+  try
+  {
+    return std::make_unique<JsonCursor>(theTable, theNames, theReq);
   }
   catch (...)
   {
@@ -21,6 +21,11 @@ class JsonFormatter : public TableFormatter
                      const HTTP::Request& theReq,
                      const TableFormatterOptions& theConfig) const override;
 
+  std::unique_ptr<Cursor> cursor(const Table& theTable,
+                                 const TableFormatter::Names& theNames,
+                                 const HTTP::Request& theReq,
+                                 const TableFormatterOptions& theConfig) const override;
+
   std::string mimetype() const override { return "application/json"; }
 };
 
@@ -0,0 +1,271 @@
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <cmath>
+
+namespace SmartMet
+{
+namespace Spine
+{
+namespace
+{
+constexpr std::int64_t sub_bucket_count = std::int64_t(1) << LatencyHistogram::sub_bucket_bits;
+constexpr std::int64_t max_value = (std::int64_t(1) << LatencyHistogram::max_value_bits) - 1;
+
+std::int64_t seconds_since_epoch(LatencyHistogram::Clock::time_point theTime)
+{
+  return std::chrono::duration_cast<std::chrono::seconds>(theTime.time_since_epoch()).count();
+}
+
+// Position of the most significant bit
+unsigned int msb(std::uint64_t theValue)
+{
+  return 63 - static_cast<unsigned int>(__builtin_clzll(theValue));
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Bucket of a duration in microseconds
+ */
+// ----------------------------------------------------------------------
+
+std::size_t LatencyHistogram::bucketIndex(std::int64_t theValue)
+{
+  const auto value = std::clamp<std::int64_t>(theValue, 0, max_value);
+  if (value < sub_bucket_count)
+    return static_cast<std::size_t>(value);
+
+  const auto shift = msb(value) - sub_bucket_bits;
+  const auto offset = (value >> shift) & (sub_bucket_count - 1);
+  return static_cast<std::size_t>(((shift + 1) << sub_bucket_bits) + offset);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Largest duration counted into the given bucket
+ */
+// ----------------------------------------------------------------------
+
+std::int64_t LatencyHistogram::bucketUpperBound(std::size_t theIndex)
+{
+  const auto index = static_cast<std::int64_t>(theIndex);
+  if (index < sub_bucket_count)
+    return index;
+
+  const auto shift = (index >> sub_bucket_bits) - 1;
+  const auto offset = index & (sub_bucket_count - 1);
+  const auto lower = (sub_bucket_count + offset) << shift;
+  return lower + (std::int64_t(1) << shift) - 1;
+}
+
+LatencyHistogram::Snapshot& LatencyHistogram::Snapshot::operator+=(const Snapshot& theOther)
+{
+  for (std::size_t i = 0; i < bucket_count; i++)
+    itsCounts[i] += theOther.itsCounts[i];
+  itsCount += theOther.itsCount;
+  itsMax = std::max(itsMax, theOther.itsMax);
+  return *this;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Duration below which the given fraction (0-1) of requests finished
+ *
+ * Returns the upper bound of the bucket the percentile falls into, but
+ * never more than the largest recorded duration.
+ */
+// ----------------------------------------------------------------------
+
+std::chrono::microseconds LatencyHistogram::Snapshot::percentile(double theFraction) const
+{
+  if (itsCount == 0)
+    return std::chrono::microseconds(0);
+
+  const auto fraction = std::clamp(theFraction, 0.0, 1.0);
+  const auto rank =
+      std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(fraction * itsCount)));
+
+  std::uint64_t sum = 0;
+  for (std::size_t i = 0; i < bucket_count; i++)
+  {
+    sum += itsCounts[i];
+    if (sum >= rank)
+      return std::chrono::microseconds(std::min(bucketUpperBound(i), itsMax));
+  }
+  return max();
+}
+
+LatencyHistogram::Slot::Slot()
+{
+  // std::atomic is not value initialized before C++20
+  for (auto& count : counts)
+    count.store(0, std::memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Count a duration into a slot, resetting it first if it is for an older period
+ */
+// ----------------------------------------------------------------------
+
+void LatencyHistogram::Slot::add(std::int64_t thePeriod,
+                                 std::size_t theIndex,
+                                 std::int64_t theValue)
+{
+  auto old_period = period.load(std::memory_order_acquire);
+  while (old_period < thePeriod)
+  {
+    if (period.compare_exchange_weak(old_period, thePeriod, std::memory_order_acq_rel))
+    {
+      for (auto& count : counts)
+        count.store(0, std::memory_order_relaxed);
+      max.store(0, std::memory_order_relaxed);
+      break;
+    }
+  }
+
+  // A delayed update for a period which has already been recycled
+  if (old_period > thePeriod)
+    return;
+
+  counts[theIndex].fetch_add(1, std::memory_order_relaxed);
+
+  auto old_max = max.load(std::memory_order_relaxed);
+  while (old_max < theValue &&
+         !max.compare_exchange_weak(old_max, theValue, std::memory_order_relaxed))
+  {
+  }
+}
+
+template <std::size_t N>
+void LatencyHistogram::add(std::array<Slot, N>& theSlots,
+                           std::int64_t thePeriod,
+                           std::size_t theIndex,
+                           std::int64_t theValue)
+{
+  theSlots[thePeriod % N].add(thePeriod, theIndex, theValue);
+}
+
+// Merge the slots of the given periods (last - N, last]
+template <std::size_t N>
+void LatencyHistogram::merge(const std::array<Slot, N>& theSlots,
+                             std::int64_t theLastPeriod,
+                             Snapshot& theSnapshot)
+{
+  const auto n = static_cast<std::int64_t>(N);
+  for (const auto& slot : theSlots)
+  {
+    const auto period = slot.period.load(std::memory_order_acquire);
+    if (period > theLastPeriod - n && period <= theLastPeriod)
+    {
+      for (std::size_t i = 0; i < bucket_count; i++)
+      {
+        const auto count = slot.counts[i].load(std::memory_order_relaxed);
+        theSnapshot.itsCounts[i] += count;
+        theSnapshot.itsCount += count;
+      }
+      theSnapshot.itsMax = std::max(theSnapshot.itsMax, slot.max.load(std::memory_order_relaxed));
+    }
+  }
+}
+
+LatencyHistogram::Cumulative& LatencyHistogram::Cumulative::operator+=(const Cumulative& theOther)
+{
+  for (std::size_t i = 0; i < counts.size(); i++)
+    counts[i] += theOther.counts[i];
+  count += theOther.count;
+  sum += theOther.sum;
+  return *this;
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+  for (auto& count : itsCumulativeCounts)
+    count.store(0, std::memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Count a finished request
+ */
+// ----------------------------------------------------------------------
+
+void LatencyHistogram::add(std::chrono::microseconds theDuration)
+{
+  add(theDuration, Clock::now());
+}
+
+void LatencyHistogram::add(std::chrono::microseconds theDuration, Clock::time_point theTime)
+{
+  const auto second = seconds_since_epoch(theTime);
+  const auto value = std::clamp<std::int64_t>(theDuration.count(), 0, max_value);
+  const auto index = bucketIndex(value);
+
+  add(itsMinute, second / 10, index, value);
+  add(itsHour, second / 600, index, value);
+  add(itsDay, second / 3600, index, value);
+
+  // First bound not smaller than the value, or the overflow bucket
+  const auto bound =
+      std::lower_bound(cumulative_bounds.begin(), cumulative_bounds.end(), value);
+  itsCumulativeCounts[static_cast<std::size_t>(bound - cumulative_bounds.begin())].fetch_add(
+      1, std::memory_order_relaxed);
+  itsCumulativeSum.fetch_add(value, std::memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Merge the slots of the given window
+ */
+// ----------------------------------------------------------------------
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot(Window theWindow) const
+{
+  return snapshot(theWindow, Clock::now());
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot(Window theWindow,
+                                                      Clock::time_point theTime) const
+{
+  const auto second = seconds_since_epoch(theTime);
+
+  Snapshot ret;
+  switch (theWindow)
+  {
+    case Window::Minute:
+      merge(itsMinute, second / 10, ret);
+      break;
+    case Window::Hour:
+      merge(itsHour, second / 600, ret);
+      break;
+    case Window::Day:
+      merge(itsDay, second / 3600, ret);
+      break;
+  }
+  return ret;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Counts since construction
+ *
+ * The total count is the sum of the bucket counts so that the two are
+ * always consistent, the sum may include a few more or less requests.
+ */
+// ----------------------------------------------------------------------
+
+LatencyHistogram::Cumulative LatencyHistogram::cumulative() const
+{
+  Cumulative ret;
+  for (std::size_t i = 0; i < ret.counts.size(); i++)
+  {
+    ret.counts[i] = itsCumulativeCounts[i].load(std::memory_order_relaxed);
+    ret.count += ret.counts[i];
+  }
+  ret.sum = std::chrono::microseconds(itsCumulativeSum.load(std::memory_order_relaxed));
+  return ret;
+}
+
+}  // namespace Spine
+}  // namespace SmartMet
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace SmartMet
+{
+namespace Spine
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Lock free log-linear latency histogram with rolling windows
+ *
+ * Durations are counted in microseconds into HDR style buckets: values
+ * below 16 us have their own bucket, above that every power of two is
+ * split into 16 linear sub-buckets. The relative error of a reported
+ * percentile is hence at most 1/16. Durations above 2^36 us (about 19
+ * hours) are counted into the last bucket.
+ *
+ * Each window is a ring of slots: the last minute consists of six
+ * 10 second slots, the last hour of six 10 minute slots and the last day
+ * of 24 hourly slots. As in ServiceStats, the windows are slot aligned
+ * and a slot is reset by the first thread which notices it belongs to an
+ * older period.
+ *
+ * In addition, counts since construction are kept in a few fixed buckets
+ * which are exported as Prometheus histograms. Unlike the windows they
+ * never decrease.
+ */
+// ----------------------------------------------------------------------
+
+class LatencyHistogram
+{
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  enum class Window
+  {
+    Minute,
+    Hour,
+    Day
+  };
+
+  static constexpr unsigned int sub_bucket_bits = 4;
+  static constexpr unsigned int max_value_bits = 36;
+  static constexpr std::size_t bucket_count =
+      (max_value_bits - sub_bucket_bits + 1) << sub_bucket_bits;
+
+  // Upper bounds of the cumulative buckets in microseconds, 1 ms - 60 s
+  static constexpr std::array<std::int64_t, 15> cumulative_bounds = {
+      1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000,
+      500000, 1000000, 2500000, 5000000, 10000000, 30000000, 60000000};
+
+  // ----------------------------------------------------------------------
+  /*!
+   * \brief Merged counts of a window
+   */
+  // ----------------------------------------------------------------------
+
+  class Snapshot
+  {
+   public:
+    Snapshot& operator+=(const Snapshot& theOther);
+
+    std::uint64_t count() const { return itsCount; }
+    std::chrono::microseconds max() const { return std::chrono::microseconds(itsMax); }
+    std::chrono::microseconds percentile(double theFraction) const;
+
+   private:
+    friend class LatencyHistogram;
+    std::array<std::uint64_t, bucket_count> itsCounts{};
+    std::uint64_t itsCount = 0;
+    std::int64_t itsMax = 0;
+  };
+
+  // ----------------------------------------------------------------------
+  /*!
+   * \brief Counts since construction
+   */
+  // ----------------------------------------------------------------------
+
+  struct Cumulative
+  {
+    // Count of each bound and of longer durations, not accumulated over the bounds
+    std::array<std::uint64_t, cumulative_bounds.size() + 1> counts{};
+    std::uint64_t count = 0;
+    std::chrono::microseconds sum{0};
+
+    Cumulative& operator+=(const Cumulative& theOther);
+  };
+
+  LatencyHistogram();
+
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  void add(std::chrono::microseconds theDuration);
+  void add(std::chrono::microseconds theDuration, Clock::time_point theTime);
+
+  Snapshot snapshot(Window theWindow) const;
+  Snapshot snapshot(Window theWindow, Clock::time_point theTime) const;
+
+  Cumulative cumulative() const;
+
+  static std::size_t bucketIndex(std::int64_t theValue);
+  static std::int64_t bucketUpperBound(std::size_t theIndex);
+
+ private:
+  struct Slot
+  {
+    std::atomic<std::int64_t> period{-1};  // period number the slot is for
+    std::atomic<std::int64_t> max{0};
+    std::array<std::atomic<std::uint32_t>, bucket_count> counts;
+
+    Slot();
+    void add(std::int64_t thePeriod, std::size_t theIndex, std::int64_t theValue);
+  };
+
+  template <std::size_t N>
+  static void add(std::array<Slot, N>& theSlots,
+                  std::int64_t thePeriod,
+                  std::size_t theIndex,
+                  std::int64_t theValue);
+
+  template <std::size_t N>
+  static void merge(const std::array<Slot, N>& theSlots,
+                    std::int64_t theLastPeriod,
+                    Snapshot& theSnapshot);
+
+  std::array<Slot, 6> itsMinute;
+  std::array<Slot, 6> itsHour;
+  std::array<Slot, 24> itsDay;
+
+  std::array<std::atomic<std::uint64_t>, cumulative_bounds.size() + 1> itsCumulativeCounts;
+  std::atomic<std::int64_t> itsCumulativeSum{0};
+};
+
+}  // namespace Spine
+}  // namespace SmartMet
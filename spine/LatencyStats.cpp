@@ -0,0 +1,138 @@
+#include "LatencyStats.h"
+#include <memory>
+
+namespace SmartMet
+{
+namespace Spine
+{
+namespace
+{
+const char* const class_names[] = {"other", "1xx", "2xx", "3xx", "4xx", "5xx"};
+
+std::size_t status_class(int theStatus)
+{
+  if (theStatus < 100 || theStatus > 599)
+    return 0;
+  return static_cast<std::size_t>(theStatus / 100);
+}
+
+}  // namespace
+
+const char* LatencyStats::statusClassName(int theStatus)
+{
+  return class_names[status_class(theStatus)];
+}
+
+LatencyStats::Snapshot& LatencyStats::Snapshot::operator+=(const Snapshot& theOther)
+{
+  wall += theOther.wall;
+  cpu += theOther.cpu;
+  return *this;
+}
+
+LatencyStats::LatencyStats()
+{
+  for (auto& ptr : itsClasses)
+    ptr.store(nullptr, std::memory_order_relaxed);
+}
+
+LatencyStats::~LatencyStats()
+{
+  for (auto& ptr : itsClasses)
+    delete ptr.load(std::memory_order_acquire);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Histograms of a status class, allocated on first use
+ */
+// ----------------------------------------------------------------------
+
+LatencyStats::Histograms& LatencyStats::histograms(std::size_t theClass)
+{
+  auto* ptr = itsClasses[theClass].load(std::memory_order_acquire);
+  if (ptr != nullptr)
+    return *ptr;
+
+  auto tmp = std::make_unique<Histograms>();
+  if (itsClasses[theClass].compare_exchange_strong(ptr, tmp.get(), std::memory_order_acq_rel))
+    return *tmp.release();
+
+  // Another thread won the race
+  return *ptr;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Count a finished request
+ */
+// ----------------------------------------------------------------------
+
+void LatencyStats::add(int theStatus,
+                       std::chrono::microseconds theDuration,
+                       std::chrono::microseconds theCpuDuration)
+{
+  add(theStatus, theDuration, theCpuDuration, Clock::now());
+}
+
+void LatencyStats::add(int theStatus,
+                       std::chrono::microseconds theDuration,
+                       std::chrono::microseconds theCpuDuration,
+                       Clock::time_point theTime)
+{
+  auto& h = histograms(status_class(theStatus));
+  h.wall.add(theDuration, theTime);
+  h.cpu.add(theCpuDuration, theTime);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Snapshots of the status classes seen so far
+ */
+// ----------------------------------------------------------------------
+
+LatencyStats::Snapshots LatencyStats::snapshot(Window theWindow) const
+{
+  return snapshot(theWindow, Clock::now());
+}
+
+LatencyStats::Snapshots LatencyStats::snapshot(Window theWindow, Clock::time_point theTime) const
+{
+  Snapshots ret;
+  for (std::size_t i = 0; i < itsClasses.size(); i++)
+  {
+    const auto* ptr = itsClasses[i].load(std::memory_order_acquire);
+    if (ptr != nullptr)
+    {
+      auto& snapshot = ret[class_names[i]];
+      snapshot.wall = ptr->wall.snapshot(theWindow, theTime);
+      snapshot.cpu = ptr->cpu.snapshot(theWindow, theTime);
+    }
+  }
+  return ret;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Counts since start of the status classes seen so far
+ */
+// ----------------------------------------------------------------------
+
+LatencyStats::Cumulatives LatencyStats::cumulative() const
+{
+  Cumulatives ret;
+  for (std::size_t i = 0; i < itsClasses.size(); i++)
+  {
+    const auto* ptr = itsClasses[i].load(std::memory_order_acquire);
+    if (ptr != nullptr)
+    {
+      auto& cumulative = ret[class_names[i]];
+      cumulative.wall = ptr->wall.cumulative();
+      cumulative.cpu = ptr->cpu.cumulative();
+    }
+  }
+  return ret;
+}
+
+}  // namespace Spine
+}  // namespace SmartMet
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "LatencyHistogram.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+
+namespace SmartMet
+{
+namespace Spine
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Wall clock and CPU time histograms of a handler per status class
+ *
+ * The histograms of a status class are allocated when the first response
+ * of that class is counted, hence a handler which only ever answers 2xx
+ * pays only for one pair of histograms.
+ */
+// ----------------------------------------------------------------------
+
+class LatencyStats
+{
+ public:
+  using Clock = LatencyHistogram::Clock;
+  using Window = LatencyHistogram::Window;
+
+  struct Snapshot
+  {
+    LatencyHistogram::Snapshot wall;
+    LatencyHistogram::Snapshot cpu;
+
+    Snapshot& operator+=(const Snapshot& theOther);
+  };
+
+  // Snapshots by status class: "1xx", ..., "5xx" or "other"
+  using Snapshots = std::map<std::string, Snapshot>;
+
+  struct Cumulative
+  {
+    LatencyHistogram::Cumulative wall;
+    LatencyHistogram::Cumulative cpu;
+  };
+
+  // Counts since start by status class
+  using Cumulatives = std::map<std::string, Cumulative>;
+
+  LatencyStats();
+  ~LatencyStats();
+
+  LatencyStats(const LatencyStats&) = delete;
+  LatencyStats& operator=(const LatencyStats&) = delete;
+
+  void add(int theStatus,
+           std::chrono::microseconds theDuration,
+           std::chrono::microseconds theCpuDuration);
+  void add(int theStatus,
+           std::chrono::microseconds theDuration,
+           std::chrono::microseconds theCpuDuration,
+           Clock::time_point theTime);
+
+  Snapshots snapshot(Window theWindow) const;
+  Snapshots snapshot(Window theWindow, Clock::time_point theTime) const;
+
+  Cumulatives cumulative() const;
+
+  // "1xx", ..., "5xx" or "other"
+  static const char* statusClassName(int theStatus);
+
+ private:
+  struct Histograms
+  {
+    LatencyHistogram wall;
+    LatencyHistogram cpu;
+  };
+
+  Histograms& histograms(std::size_t theClass);
+
+  // Index 0 is for statuses outside 100-599, for example when no response was set
+  std::array<std::atomic<Histograms*>, 6> itsClasses;
+};
+
+}  // namespace Spine
+}  // namespace SmartMet
@@ -10,24 +10,27 @@ LogRange::~LogRange()
   itsHandlerView->releaseLogRange();  // decrements reader count
 }
 
-LogRange::LogRange(const LogListType& theLog, HandlerView* theHandler)
-    : itsBegin(theLog.begin()), itsEnd(theLog.end()), itsHandlerView(theHandler)
+LogRange::LogRange(const RequestLog& theLog, HandlerView* theHandler)
+    : itsLog(&theLog), itsBegin(theLog.begin()), itsEnd(theLog.end()), itsHandlerView(theHandler)
 {
 }
 
 LogRange::LogRange(const LogRange& theOther)
-    : itsBegin(theOther.itsBegin), itsEnd(theOther.itsEnd), itsHandlerView(theOther.itsHandlerView)
+    : itsLog(theOther.itsLog),
+      itsBegin(theOther.itsBegin),
+      itsEnd(theOther.itsEnd),
+      itsHandlerView(theOther.itsHandlerView)
 {
   itsHandlerView->lockLogRange();
 }
 
 LogRange::const_iterator LogRange::begin() const
 {
-  return itsBegin;
+  return {itsLog, itsBegin};
 }
 LogRange::const_iterator LogRange::end() const
 {
-  return itsEnd;
+  return {itsLog, itsEnd};
 }
 
 }  // namespace Spine
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "LoggedRequest.h"
+#include "RequestLog.h"
+#include <cstddef>
+#include <iterator>
 #include <map>
 #include <string>
 
@@ -17,19 +20,61 @@ class LogRange
 {
  public:
   ~LogRange();
-  LogRange(const LogListType& theLog, HandlerView* theHandler);
+  LogRange(const RequestLog& theLog, HandlerView* theHandler);
 
   LogRange(const LogRange& theOther);
   LogRange() = delete;
 
-  using const_iterator = LogListType::const_iterator;
+  // The log stores compact records, dereferencing rebuilds the request.
+  // The accessors for times and durations are cheap.
+  class const_iterator
+  {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = LoggedRequest;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = LoggedRequest;
+
+    const_iterator(const RequestLog* theLog, RequestLog::Position thePos)
+        : itsLog(theLog), itsPos(thePos)
+    {
+    }
+
+    LoggedRequest operator*() const { return itsLog->get(itsPos); }
+
+    const_iterator& operator++()
+    {
+      ++itsPos;
+      return *this;
+    }
+
+    const_iterator operator++(int)
+    {
+      auto tmp = *this;
+      ++itsPos;
+      return tmp;
+    }
+
+    bool operator==(const const_iterator& theOther) const { return itsPos == theOther.itsPos; }
+    bool operator!=(const const_iterator& theOther) const { return itsPos != theOther.itsPos; }
+
+    Fmi::DateTime getRequestEndTime() const { return itsLog->getRequestEndTime(itsPos); }
+    Fmi::TimeDuration getAccessDuration() const { return itsLog->getAccessDuration(itsPos); }
+    Fmi::TimeDuration getCpuDuration() const { return itsLog->getCpuDuration(itsPos); }
+
+   private:
+    const RequestLog* itsLog;
+    RequestLog::Position itsPos;
+  };
 
   const_iterator begin() const;
   const_iterator end() const;
 
  private:
-  const LogListType::const_iterator itsBegin;
-  const LogListType::const_iterator itsEnd;
+  const RequestLog* itsLog = nullptr;
+  const RequestLog::Position itsBegin;
+  const RequestLog::Position itsEnd;
   HandlerView* itsHandlerView = nullptr;
 };
 
@@ -1,7 +1,10 @@
 #include "MallocStats.h"
 
 #include <dlfcn.h>
+#include <unistd.h>
 
+#include <cstdint>
+#include <fstream>
 #include <mutex>
 #include <sstream>
 #include <string>
@@ -30,6 +33,38 @@ using je_malloc_stats_print_t = void (*)(void (*)(void*, const char*),
 using mi_stats_print_out_t = void (*)(void (*)(const char*, void* /*arg*/),
                                       void* /*arg*/);
 
+// jemalloc's generic control interface, used for the numeric
+// `stats.*` counters. Same symbol naming caveat as above.
+using je_mallctl_t = int (*)(const char* /*name*/,
+                             void* /*oldp*/,
+                             std::size_t* /*oldlenp*/,
+                             void* /*newp*/,
+                             std::size_t /*newlen*/);
+
+std::size_t je_stat(je_mallctl_t mallctl, const char* name)
+{
+  std::size_t value = 0;
+  std::size_t len = sizeof(value);
+  if (mallctl(name, &value, &len, nullptr, 0) != 0)
+    return 0;
+  return value;
+}
+
+// Address of the calling thread's allocation counter, or nullptr if
+// the allocator does not provide one. The address stays valid for
+// the lifetime of the thread.
+const std::uint64_t* je_thread_allocatedp() noexcept
+{
+  static const auto mallctl = reinterpret_cast<je_mallctl_t>(dlsym(RTLD_DEFAULT, "mallctl"));
+  if (!mallctl)
+    return nullptr;
+  std::uint64_t* ptr = nullptr;
+  std::size_t len = sizeof(ptr);
+  if (mallctl("thread.allocatedp", &ptr, &len, nullptr, 0) != 0)
+    return nullptr;
+  return ptr;
+}
+
 // Aggregator written into by both jemalloc's and mimalloc's
 // callbacks. Lives on the calling thread's stack; the callbacks
 // run synchronously from inside the print function so no
@@ -103,5 +138,69 @@ std::string getMallocStats(const std::string& opts)
          + getMallocAllocator() + "\"}";
 }
 
+MemoryStats getMemoryStats()
+{
+  MemoryStats stats;
+
+  try
+  {
+    // statm: size resident shared text lib data dt, in pages
+    std::ifstream statm("/proc/self/statm");
+    std::size_t size = 0;
+    std::size_t resident = 0;
+    if (statm >> size >> resident)
+      stats.rss = resident * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  }
+  catch (...)
+  {
+    // Never throws, the figure is just left zero
+  }
+
+  // The stats.* counters are snapshots which are refreshed by
+  // writing to "epoch"
+  if (auto* mallctl = reinterpret_cast<je_mallctl_t>(dlsym(RTLD_DEFAULT, "mallctl")))
+  {
+    std::uint64_t epoch = 1;
+    std::size_t len = sizeof(epoch);
+    mallctl("epoch", &epoch, &len, &epoch, len);
+
+    stats.allocated = je_stat(mallctl, "stats.allocated");
+    stats.active = je_stat(mallctl, "stats.active");
+    stats.resident = je_stat(mallctl, "stats.resident");
+    stats.mapped = je_stat(mallctl, "stats.mapped");
+    stats.retained = je_stat(mallctl, "stats.retained");
+  }
+
+  return stats;
+}
+
+std::uint64_t getThreadAllocatedBytes() noexcept
+{
+  thread_local const std::uint64_t* counter = je_thread_allocatedp();
+  return counter ? *counter : 0;
+}
+
+void releaseFreeMemory() noexcept
+{
+  // jemalloc: purge the dirty pages of all arenas. 4096 is
+  // MALLCTL_ARENAS_ALL, which is not available without the header.
+  if (auto* mallctl = reinterpret_cast<je_mallctl_t>(dlsym(RTLD_DEFAULT, "mallctl")))
+  {
+    mallctl("arena.4096.purge", nullptr, nullptr, nullptr, 0);
+    return;
+  }
+
+  using mi_collect_t = void (*)(bool /*force*/);
+  if (auto* mi_collect = reinterpret_cast<mi_collect_t>(dlsym(RTLD_DEFAULT, "mi_collect")))
+  {
+    mi_collect(true);
+    return;
+  }
+
+  using malloc_trim_t = int (*)(std::size_t /*pad*/);
+  if (auto* malloc_trim = reinterpret_cast<malloc_trim_t>(dlsym(RTLD_DEFAULT, "malloc_trim")))
+    malloc_trim(0);
+}
+
 }  // namespace Spine
 }  // namespace SmartMet
@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 namespace SmartMet
@@ -38,5 +40,35 @@ std::string getMallocAllocator();
 /// detected. Never throws.
 std::string getMallocStats(const std::string& opts = "J");
 
+/// Process memory figures in bytes for metrics export. `rss` is read
+/// from /proc/self/statm, the remaining fields come from jemalloc's
+/// `stats.*` mallctl counters and are zero for other allocators.
+struct MemoryStats
+{
+  std::size_t rss = 0;
+  std::size_t allocated = 0;
+  std::size_t active = 0;
+  std::size_t resident = 0;
+  std::size_t mapped = 0;
+  std::size_t retained = 0;
+};
+
+/// Never throws. Refreshes jemalloc's statistics epoch, which is
+/// cheap compared to a full malloc_stats_print dump.
+MemoryStats getMemoryStats();
+
+/// Bytes allocated by the calling thread since it started, from
+/// jemalloc's `thread.allocatedp` counter. Per-request allocation is
+/// the difference of two calls. The counter address is resolved once
+/// per thread, after which a call is a single load. Returns zero for
+/// other allocators. Never throws.
+std::uint64_t getThreadAllocatedBytes() noexcept;
+
+/// Return freed memory to the operating system so that it shows up
+/// in the RSS: purges all jemalloc arenas, forces a mimalloc collect
+/// or calls glibc's malloc_trim. May take a while for large heaps.
+/// Never throws.
+void releaseFreeMemory() noexcept;
+
 }  // namespace Spine
 }  // namespace SmartMet
@@ -0,0 +1,51 @@
+#include "MappedFile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace SmartMet
+{
+namespace Spine
+{
+std::shared_ptr<const MappedFile> MappedFile::open(const std::filesystem::path& thePath)
+{
+  const int fd = ::open(thePath.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return {};
+
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+  {
+    ::close(fd);
+    return {};
+  }
+
+  const auto size = static_cast<std::size_t>(st.st_size);
+
+  // Empty files cannot be mapped
+  void* ptr = nullptr;
+  if (size > 0)
+  {
+    ptr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED)
+    {
+      ::close(fd);
+      return {};
+    }
+  }
+
+  // The mapping does not need the descriptor
+  ::close(fd);
+
+  return std::shared_ptr<const MappedFile>(new MappedFile(static_cast<const char*>(ptr), size));
+}
+
+MappedFile::~MappedFile()
+{
+  if (itsData != nullptr)
+    munmap(const_cast<char*>(itsData), itsSize);
+}
+
+}  // namespace Spine
+}  // namespace SmartMet
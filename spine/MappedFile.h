@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+
+namespace SmartMet
+{
+namespace Spine
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Read only memory mapping of a whole file
+ *
+ * The mapping stays valid even if the file is removed or replaced by
+ * renaming another file over it, hence cached files can be served
+ * without copying them while the cache is being cleaned up.
+ */
+// ----------------------------------------------------------------------
+
+class MappedFile
+{
+ public:
+  // Returns nullptr if the file cannot be opened or mapped
+  static std::shared_ptr<const MappedFile> open(const std::filesystem::path& thePath);
+
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* data() const noexcept { return itsData; }
+  std::size_t size() const noexcept { return itsSize; }
+  std::string_view view() const noexcept { return {itsData, itsSize}; }
+
+ private:
+  MappedFile(const char* theData, std::size_t theSize) : itsData(theData), itsSize(theSize) {}
+
+  const char* itsData = nullptr;
+  std::size_t itsSize = 0;
+};
+
+}  // namespace Spine
+}  // namespace SmartMet
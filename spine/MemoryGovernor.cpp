@@ -0,0 +1,501 @@
+#include "MemoryGovernor.h"
+#include "MallocStats.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace SmartMet
+{
+namespace Spine
+{
+namespace
+{
+// Path of this process in a cgroup hierarchy, empty if not found. An empty
+// controller name selects the cgroup v2 unified hierarchy.
+std::string cgroup_path(const std::string& theController)
+{
+  std::ifstream in("/proc/self/cgroup");
+  std::string line;
+  while (std::getline(in, line))
+  {
+    // hierarchy-ID:controller-list:path
+    const auto first = line.find(':');
+    if (first == std::string::npos)
+      continue;
+    const auto second = line.find(':', first + 1);
+    if (second == std::string::npos)
+      continue;
+
+    std::istringstream controllers(line.substr(first + 1, second - first - 1));
+    if (theController.empty())
+    {
+      if (second == first + 1)
+        return line.substr(second + 1);
+      continue;
+    }
+
+    std::string controller;
+    while (std::getline(controllers, controller, ','))
+      if (controller == theController)
+        return line.substr(second + 1);
+  }
+  return {};
+}
+
+// cgroup v2 directory of this process, empty if not found
+std::string cgroup_directory()
+{
+  const auto path = cgroup_path("");
+  if (path.empty())
+    return {};
+  return "/sys/fs/cgroup" + path;
+}
+
+// Smallest limit set on the group or its ancestors, 0 if none. cgroup v2
+// reports no limit as "max", v1 as a page aligned LONG_MAX.
+std::size_t hierarchy_limit(const std::string& theRoot,
+                            std::string thePath,
+                            const std::string& theFile)
+{
+  std::size_t ret = 0;
+  while (true)
+  {
+    std::ifstream in(theRoot + thePath + "/" + theFile);
+    std::string value;
+    if (in >> value && value != "max")
+    {
+      const std::size_t limit = std::stoull(value);
+      if (limit < (std::size_t(1) << 60) && (ret == 0 || limit < ret))
+        ret = limit;
+    }
+
+    if (thePath.empty() || thePath == "/")
+      return ret;
+    const auto pos = thePath.rfind('/');
+    thePath.resize(pos == std::string::npos ? 0 : pos);
+  }
+}
+
+// Memory limit in bytes, 0 if unlimited or unknown
+std::size_t cgroup_limit()
+{
+  const auto v2 = cgroup_path("");
+  if (!v2.empty())
+  {
+    const auto limit = hierarchy_limit("/sys/fs/cgroup", v2, "memory.max");
+    if (limit > 0)
+      return limit;
+  }
+
+  // cgroup v1. Inside a container the group path may not be visible under
+  // the mount point, in which case the walk ends with the mounted root.
+  return hierarchy_limit("/sys/fs/cgroup/memory", cgroup_path("memory"), "memory.limit_in_bytes");
+}
+
+// Parse "some avg10=1.23 avg60=..." and "full avg10=..." lines
+void read_psi(const std::string& theFile, MemoryGovernor::Pressure& thePressure)
+{
+  std::ifstream in(theFile);
+  std::string line;
+  while (std::getline(in, line))
+  {
+    std::istringstream fields(line);
+    std::string kind;
+    std::string avg10;
+    if (!(fields >> kind >> avg10) || avg10.compare(0, 6, "avg10=") != 0)
+      continue;
+    const double value = std::stod(avg10.substr(6));
+    if (kind == "some")
+      thePressure.psi_some = value;
+    else if (kind == "full")
+      thePressure.psi_full = value;
+  }
+}
+
+}  // namespace
+
+MemoryGovernor& MemoryGovernor::instance()
+{
+  static MemoryGovernor governor;
+  return governor;
+}
+
+MemoryGovernor::~MemoryGovernor()
+{
+  stop();
+}
+
+MemoryGovernor::Registration::~Registration()
+{
+  if (itsGovernor)
+    itsGovernor->remove(itsId);
+}
+
+MemoryGovernor::Registration::Registration(Registration&& theOther) noexcept
+    : itsGovernor(theOther.itsGovernor), itsId(theOther.itsId)
+{
+  theOther.itsGovernor = nullptr;
+}
+
+MemoryGovernor::Registration& MemoryGovernor::Registration::operator=(
+    Registration&& theOther) noexcept
+{
+  if (this != &theOther)
+  {
+    if (itsGovernor)
+      itsGovernor->remove(itsId);
+    itsGovernor = theOther.itsGovernor;
+    itsId = theOther.itsId;
+    theOther.itsGovernor = nullptr;
+  }
+  return *this;
+}
+
+MemoryGovernor::Registration MemoryGovernor::add(const std::string& theName,
+                                                 BytesFunction theBytes,
+                                                 ShrinkFunction theShrink,
+                                                 StatsFunction theStats)
+{
+  try
+  {
+    if (!theBytes || !theShrink)
+      throw Fmi::Exception(BCP, "Memory governor requires size and shrink functions")
+          .addParameter("Cache", theName);
+
+    Cache cache;
+    cache.name = theName;
+    cache.bytes = std::move(theBytes);
+    cache.shrink = std::move(theShrink);
+    cache.stats = std::move(theStats);
+    if (cache.stats)
+    {
+      const auto stats = cache.stats();
+      cache.hits = stats.hits;
+      cache.misses = stats.misses;
+    }
+
+    std::lock_guard<std::mutex> lock(itsMutex);
+    const auto id = ++itsNextId;
+    itsCaches.emplace(id, std::make_shared<Cache>(std::move(cache)));
+    return Registration(this, id);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Unregister a cache
+ *
+ * Waits for a running relieve() to stop calling the cache functions,
+ * unless called from one of them.
+ */
+// ----------------------------------------------------------------------
+
+void MemoryGovernor::remove(std::size_t theId)
+{
+  std::unique_lock<std::mutex> lock(itsMutex);
+  itsIdle.wait(lock,
+               [this] { return !itsBusy || itsBusyThread == std::this_thread::get_id(); });
+  itsCaches.erase(theId);
+}
+
+void MemoryGovernor::start(const Options& theOptions)
+{
+  try
+  {
+    stop();
+    std::lock_guard<std::mutex> lock(itsMutex);
+    itsOptions = theOptions;
+    if (!itsOptions.enabled)
+      return;
+    itsStopFlag = false;
+    itsThread = std::thread(&MemoryGovernor::run, this);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void MemoryGovernor::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    itsStopFlag = true;
+    itsCondition.notify_all();
+  }
+  if (itsThread.joinable())
+    itsThread.join();
+}
+
+MemoryGovernor::Options MemoryGovernor::options() const
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  return itsOptions;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Measure RSS, the effective memory limit and PSI
+ *
+ * The cgroup PSI is preferred over the system wide one, since other
+ * containers should not make this process shrink its caches.
+ */
+// ----------------------------------------------------------------------
+
+MemoryGovernor::Pressure MemoryGovernor::measure() const
+{
+  Pressure ret;
+  try
+  {
+    ret.rss = getMemoryStats().rss;
+
+    const auto dir = cgroup_directory();
+    ret.limit = cgroup_limit();
+
+    const std::size_t configured = std::size_t(options().limit_mb) * 1024 * 1024;
+    if (configured > 0 && (ret.limit == 0 || configured < ret.limit))
+      ret.limit = configured;
+
+    std::ifstream test(dir + "/memory.pressure");
+    read_psi(!dir.empty() && test ? dir + "/memory.pressure" : "/proc/pressure/memory", ret);
+  }
+  catch (...)
+  {
+    // Unreadable figures are left zero, meaning no pressure
+  }
+  return ret;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Divide the excess memory among the caches and shrink them
+ *
+ * Each cache is asked to release a share of the excess proportional to
+ * bytes * (1 - hit_rate / 2), where the hit rate is measured since the
+ * previous check. A cache which is never hit thus releases twice as
+ * much per byte as a cache which is always hit.
+ *
+ * Bytes released during the settle period are subtracted from the RSS,
+ * less the part by which the RSS has already dropped. PSI averages lag
+ * too, hence PSI pressure alone does not shrink again during the period.
+ */
+// ----------------------------------------------------------------------
+
+std::vector<MemoryGovernor::Decision> MemoryGovernor::relieve(const Pressure& thePressure)
+{
+  try
+  {
+    // Take a snapshot of the registry and mark it busy so that caches are
+    // not unregistered while their functions are being called.
+
+    std::vector<CachePtr> caches;
+    Options options;
+    std::size_t credit = 0;
+
+    const auto now = std::chrono::steady_clock::now();
+    {
+      std::unique_lock<std::mutex> lock(itsMutex);
+      itsIdle.wait(lock, [this] { return !itsBusy; });
+      itsBusy = true;
+      itsBusyThread = std::this_thread::get_id();
+
+      for (const auto& item : itsCaches)
+        caches.push_back(item.second);
+      options = itsOptions;
+
+      if (itsCredit > 0 && now - itsCreditTime < std::chrono::seconds(options.settle))
+      {
+        const auto drop = (itsCreditRss > thePressure.rss ? itsCreditRss - thePressure.rss : 0);
+        itsCredit -= std::min(itsCredit, drop);
+        itsCreditRss = thePressure.rss;
+        credit = itsCredit;
+      }
+      else
+        itsCredit = 0;
+    }
+
+    std::vector<Decision> decisions;
+    try
+    {
+      decisions = shrink(thePressure, options, credit, caches);
+    }
+    catch (...)
+    {
+      std::lock_guard<std::mutex> lock(itsMutex);
+      itsBusy = false;
+      itsIdle.notify_all();
+      throw;
+    }
+
+    std::size_t released = 0;
+    for (const auto& decision : decisions)
+      released += decision.released;
+
+    // Make the freed memory visible in the RSS as soon as possible
+    if (released > 0)
+      releaseFreeMemory();
+
+    std::lock_guard<std::mutex> lock(itsMutex);
+    if (released > 0)
+    {
+      itsCredit += released;
+      itsCreditRss = thePressure.rss;
+      itsCreditTime = now;
+    }
+
+    for (const auto& decision : decisions)
+      itsHistory.push_front(decision);
+    while (itsHistory.size() > itsOptions.history)
+      itsHistory.pop_back();
+
+    itsBusy = false;
+    itsIdle.notify_all();
+    return decisions;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Decide the shares of the caches and shrink them
+ *
+ * Called by relieve() without the lock.
+ */
+// ----------------------------------------------------------------------
+
+std::vector<MemoryGovernor::Decision> MemoryGovernor::shrink(const Pressure& thePressure,
+                                                             const Options& theOptions,
+                                                             std::size_t theCredit,
+                                                             const std::vector<CachePtr>& theCaches)
+{
+  struct Candidate
+  {
+    Cache* cache;
+    std::size_t bytes;
+    double hit_rate;
+    double weight;
+  };
+
+  std::vector<Candidate> candidates;
+  std::size_t total_bytes = 0;
+  double total_weight = 0;
+
+  for (const auto& ptr : theCaches)
+  {
+    auto& cache = *ptr;
+    Candidate candidate{&cache, cache.bytes(), 0.0, 0.0};
+
+    if (cache.stats)
+    {
+      const auto stats = cache.stats();
+      const auto hits = stats.hits - std::min(stats.hits, cache.hits);
+      const auto misses = stats.misses - std::min(stats.misses, cache.misses);
+      if (hits + misses > 0)
+        candidate.hit_rate = double(hits) / double(hits + misses);
+      cache.hits = stats.hits;
+      cache.misses = stats.misses;
+    }
+
+    candidate.weight = candidate.bytes * (1.0 - candidate.hit_rate / 2);
+    total_bytes += candidate.bytes;
+    total_weight += candidate.weight;
+    candidates.push_back(candidate);
+  }
+
+  std::size_t excess = 0;
+  std::string reason;
+
+  const auto high = static_cast<std::size_t>(theOptions.high * thePressure.limit);
+  const auto target = static_cast<std::size_t>(theOptions.target * thePressure.limit);
+  const auto rss = thePressure.rss - std::min(thePressure.rss, theCredit);
+
+  if (thePressure.limit > 0 && rss > high)
+  {
+    excess = rss - target;
+    reason = "RSS " + std::to_string(thePressure.rss / 1024 / 1024) + " MB of limit " +
+             std::to_string(thePressure.limit / 1024 / 1024) + " MB";
+    if (theCredit > 0)
+      reason += ", " + std::to_string(theCredit / 1024 / 1024) + " MB being released";
+  }
+  else if (thePressure.psi_some > theOptions.psi && theCredit == 0)
+  {
+    excess = static_cast<std::size_t>(theOptions.psi_fraction * total_bytes);
+    reason = "PSI some avg10 " + std::to_string(thePressure.psi_some) + "%";
+  }
+
+  std::vector<Decision> decisions;
+  if (excess == 0 || total_weight <= 0)
+    return decisions;
+
+  const auto now = Fmi::SecondClock::universal_time();
+  for (const auto& candidate : candidates)
+  {
+    if (candidate.weight <= 0)
+      continue;
+
+    Decision decision;
+    decision.time = now;
+    decision.reason = reason;
+    decision.cache = candidate.cache->name;
+    decision.bytes = candidate.bytes;
+    decision.hit_rate = candidate.hit_rate;
+    decision.requested = std::min(
+        candidate.bytes, static_cast<std::size_t>(excess * candidate.weight / total_weight));
+
+    try
+    {
+      decision.released = candidate.cache->shrink(decision.requested);
+    }
+    catch (...)
+    {
+      std::cerr << Fmi::Exception::Trace(BCP, "Cache shrink failed")
+                       .addParameter("Cache", decision.cache)
+                       .getStackTrace();
+    }
+
+    decisions.push_back(decision);
+  }
+
+  return decisions;
+}
+
+std::vector<MemoryGovernor::Decision> MemoryGovernor::history() const
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  return {itsHistory.begin(), itsHistory.end()};
+}
+
+void MemoryGovernor::run()
+{
+  try
+  {
+    while (true)
+    {
+      {
+        std::unique_lock<std::mutex> lock(itsMutex);
+        itsCondition.wait_for(lock, std::chrono::seconds(std::max(1U, itsOptions.interval)),
+                              [this] { return itsStopFlag; });
+        if (itsStopFlag)
+          return;
+      }
+
+      relieve(measure());
+    }
+  }
+  catch (...)
+  {
+    std::cerr << Fmi::Exception::Trace(BCP, "Memory governor failed!").getStackTrace();
+  }
+}
+
+}  // namespace Spine
+}  // namespace SmartMet
@@ -0,0 +1,185 @@
+// ======================================================================
+/*!
+ * \brief Process wide memory governor for engine and plugin caches
+ *
+ * Caches register a function returning their current memory use in
+ * bytes and a shrink function which releases about the requested number
+ * of bytes. A background thread periodically measures the process RSS,
+ * the memory limit (configured or from the cgroup) and the memory
+ * pressure stall information (PSI). When the RSS exceeds the high
+ * watermark, or PSI shows memory stalls, the excess is divided among
+ * the caches in proportion to their size, weighted down by their recent
+ * hit rate, so that large caches with little value shrink the most.
+ *
+ * Freed memory does not show up in the RSS at once: the allocator may
+ * keep it, and caches may hand values to background writers. After
+ * shrinking the allocator is asked to return free memory to the system,
+ * and the released bytes are credited against the RSS for the settle
+ * period so that the next checks do not shrink the caches again for
+ * memory which is already on its way out.
+ *
+ * The decisions are kept for the ?what=memorygovernor admin table.
+ *
+ * The cache functions are called without the registry locked, so they
+ * may take their own locks and even register other caches.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <macgyver/CacheStats.h>
+#include <macgyver/DateTime.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Spine
+{
+class MemoryGovernor
+{
+ public:
+  // Configured via the "memorygovernor" group
+  struct Options
+  {
+    bool enabled = false;
+    unsigned int interval = 5;   // seconds between checks
+    unsigned int limit_mb = 0;   // 0 = cgroup limit only
+    double high = 0.90;          // shrink when RSS exceeds this fraction of the limit
+    double target = 0.80;        // down to this fraction of the limit
+    double psi = 10.0;           // shrink when memory "some" avg10 stall percentage exceeds this
+    double psi_fraction = 0.10;  // fraction of cache memory released under PSI pressure
+    unsigned int settle = 30;    // seconds the released bytes are credited against the RSS
+    unsigned int history = 100;  // decisions kept for the admin table
+  };
+
+  struct Pressure
+  {
+    std::size_t rss = 0;
+    std::size_t limit = 0;  // 0 = unlimited
+    double psi_some = 0;    // avg10 percentages
+    double psi_full = 0;
+  };
+
+  struct Decision
+  {
+    Fmi::DateTime time;
+    std::string reason;
+    std::string cache;
+    std::size_t bytes = 0;  // cache size before shrinking
+    double hit_rate = 0;    // since the previous check
+    std::size_t requested = 0;
+    std::size_t released = 0;
+  };
+
+  using BytesFunction = std::function<std::size_t()>;
+  using ShrinkFunction = std::function<std::size_t(std::size_t theBytes)>;
+  using StatsFunction = std::function<Fmi::Cache::CacheStats()>;
+
+  // Unregisters the cache when destroyed, waiting for a running check to
+  // finish calling the cache functions. The registration must therefore be
+  // destroyed before the cache: declare it after the cache it refers to, since
+  // members are destroyed in reverse order of declaration, or reset it first
+  // in the destructor. Otherwise the governor may call the functions of a
+  // partially destroyed cache.
+  class Registration
+  {
+   public:
+    Registration() = default;
+    ~Registration();
+    Registration(Registration&& theOther) noexcept;
+    Registration& operator=(Registration&& theOther) noexcept;
+    Registration(const Registration&) = delete;
+    Registration& operator=(const Registration&) = delete;
+
+   private:
+    friend class MemoryGovernor;
+    Registration(MemoryGovernor* theGovernor, std::size_t theId)
+        : itsGovernor(theGovernor), itsId(theId)
+    {
+    }
+
+    MemoryGovernor* itsGovernor = nullptr;
+    std::size_t itsId = 0;
+  };
+
+  static MemoryGovernor& instance();
+
+  MemoryGovernor() = default;
+  ~MemoryGovernor();
+  MemoryGovernor(const MemoryGovernor&) = delete;
+  MemoryGovernor& operator=(const MemoryGovernor&) = delete;
+
+  // Hit rates are taken from the statistics if given
+  Registration add(const std::string& theName,
+                   BytesFunction theBytes,
+                   ShrinkFunction theShrink,
+                   StatsFunction theStats = {});
+
+  void start(const Options& theOptions);
+  void stop();
+
+  // Current process figures
+  Pressure measure() const;
+
+  // Shrink the caches if under pressure, returns the decisions made
+  std::vector<Decision> relieve(const Pressure& thePressure);
+
+  // The latest decisions, the newest first
+  std::vector<Decision> history() const;
+
+  Options options() const;
+
+ private:
+  struct Cache
+  {
+    std::string name;
+    BytesFunction bytes;
+    ShrinkFunction shrink;
+    StatsFunction stats;
+    std::size_t hits = 0;  // at the previous check
+    std::size_t misses = 0;
+  };
+
+  using CachePtr = std::shared_ptr<Cache>;
+
+  void remove(std::size_t theId);
+  void run();
+
+  std::vector<Decision> shrink(const Pressure& thePressure,
+                               const Options& theOptions,
+                               std::size_t theCredit,
+                               const std::vector<CachePtr>& theCaches);
+
+  mutable std::mutex itsMutex;
+  Options itsOptions;
+  std::map<std::size_t, CachePtr> itsCaches;
+  std::size_t itsNextId = 0;
+  std::deque<Decision> itsHistory;
+
+  // Set while relieve() calls the cache functions without the lock
+  bool itsBusy = false;
+  std::thread::id itsBusyThread;
+  std::condition_variable itsIdle;
+
+  // Bytes released by the previous shrink which may not show in the RSS yet
+  std::size_t itsCredit = 0;
+  std::size_t itsCreditRss = 0;
+  std::chrono::steady_clock::time_point itsCreditTime;
+
+  std::condition_variable itsCondition;
+  bool itsStopFlag = false;
+  std::thread itsThread;
+};
+
+}  // namespace Spine
+}  // namespace SmartMet
@@ -1,4 +1,5 @@
 #include "OTelMetricsExporter.h"
+#include "LatencyStats.h"
 #include <macgyver/Exception.h>
 
 #ifdef SMARTMET_SPINE_OPENTELEMETRY
@@ -6,6 +7,8 @@
 // OTel Metrics API
 #include <opentelemetry/metrics/provider.h>
 #include <opentelemetry/metrics/observer_result.h>
+#include <opentelemetry/metrics/sync_instruments.h>
+#include <opentelemetry/context/context.h>
 
 // OTel Metrics SDK
 #include <opentelemetry/sdk/metrics/meter_provider.h>
@@ -29,39 +32,106 @@ using Context = SmartMet::Spine::OTelMetricsExporter::ObserveContext;
 using Attrs   = std::initializer_list<std::pair<opentelemetry::nostd::string_view,
                                                  opentelemetry::common::AttributeValue>>;
 
+const SmartMet::Spine::OTelMetricsExporter::Callbacks& callbacks(void* state)
+{
+  return static_cast<Context*>(state)->callbacks;
+}
+
+template <typename T>
+void observe(opentelemetry::metrics::ObserverResult& result, T value, Attrs attrs)
+{
+  using Result = opentelemetry::nostd::shared_ptr<opentelemetry::metrics::ObserverResultT<T>>;
+  opentelemetry::nostd::get<Result>(result)->Observe(value, attrs);
+}
+
+// ── Caches ───────────────────────────────────────────────────────────────────
+
 static void observeSize(opentelemetry::metrics::ObserverResult result, void* state)
 {
-  const auto& stats = static_cast<Context*>(state)->callback();
+  const auto& stats = callbacks(state).cacheStats();
   for (const auto& [name, s] : stats)
-    result.Observe(static_cast<int64_t>(s.size), Attrs{{"cache.name", name}});
+    observe(result, static_cast<int64_t>(s.size), Attrs{{"cache.name", name}});
 }
 
 static void observeMaxSize(opentelemetry::metrics::ObserverResult result, void* state)
 {
-  const auto& stats = static_cast<Context*>(state)->callback();
+  const auto& stats = callbacks(state).cacheStats();
   for (const auto& [name, s] : stats)
-    result.Observe(static_cast<int64_t>(s.maxsize), Attrs{{"cache.name", name}});
+    observe(result, static_cast<int64_t>(s.maxsize), Attrs{{"cache.name", name}});
 }
 
 static void observeHits(opentelemetry::metrics::ObserverResult result, void* state)
 {
-  const auto& stats = static_cast<Context*>(state)->callback();
+  const auto& stats = callbacks(state).cacheStats();
   for (const auto& [name, s] : stats)
-    result.Observe(static_cast<int64_t>(s.hits), Attrs{{"cache.name", name}});
+    observe(result, static_cast<int64_t>(s.hits), Attrs{{"cache.name", name}});
 }
 
 static void observeMisses(opentelemetry::metrics::ObserverResult result, void* state)
 {
-  const auto& stats = static_cast<Context*>(state)->callback();
+  const auto& stats = callbacks(state).cacheStats();
   for (const auto& [name, s] : stats)
-    result.Observe(static_cast<int64_t>(s.misses), Attrs{{"cache.name", name}});
+    observe(result, static_cast<int64_t>(s.misses), Attrs{{"cache.name", name}});
 }
 
 static void observeInserts(opentelemetry::metrics::ObserverResult result, void* state)
 {
-  const auto& stats = static_cast<Context*>(state)->callback();
+  const auto& stats = callbacks(state).cacheStats();
   for (const auto& [name, s] : stats)
-    result.Observe(static_cast<int64_t>(s.inserts), Attrs{{"cache.name", name}});
+    observe(result, static_cast<int64_t>(s.inserts), Attrs{{"cache.name", name}});
+}
+
+// ── Load ─────────────────────────────────────────────────────────────────────
+
+static void observeActiveRequests(opentelemetry::metrics::ObserverResult result, void* state)
+{
+  observe(result, static_cast<int64_t>(callbacks(state).load().active_requests), Attrs{});
+}
+
+static void observeActiveRequestsLimit(opentelemetry::metrics::ObserverResult result, void* state)
+{
+  observe(result, static_cast<int64_t>(callbacks(state).load().active_requests_limit), Attrs{});
+}
+
+static void observeHighLoad(opentelemetry::metrics::ObserverResult result, void* state)
+{
+  observe(result, static_cast<int64_t>(callbacks(state).load().high_load ? 1 : 0), Attrs{});
+}
+
+// ── Handlers ─────────────────────────────────────────────────────────────────
+
+static void observeRequests(opentelemetry::metrics::ObserverResult result, void* state)
+{
+  const auto stats = callbacks(state).serviceStats();
+  for (const auto& [handler, s] : stats)
+    observe(result, static_cast<int64_t>(s.total), Attrs{{"handler", handler}});
+}
+
+// ── Backends ─────────────────────────────────────────────────────────────────
+
+static void observeBackendInflight(opentelemetry::metrics::ObserverResult result, void* state)
+{
+  const auto status = callbacks(state).backends();
+  for (const auto& [host, ports] : status)
+    for (const auto& [port, count] : ports)
+      observe(result,
+              static_cast<int64_t>(count),
+              Attrs{{"backend.host", host}, {"backend.port", static_cast<int64_t>(port)}});
+}
+
+// ── Memory ───────────────────────────────────────────────────────────────────
+
+static void observeMemory(opentelemetry::metrics::ObserverResult result, void* state)
+{
+  const auto stats = callbacks(state).memory();
+  observe(result, static_cast<int64_t>(stats.rss), Attrs{{"kind", "rss"}});
+  if (stats.allocated == 0)
+    return;  // not jemalloc
+  observe(result, static_cast<int64_t>(stats.allocated), Attrs{{"kind", "allocated"}});
+  observe(result, static_cast<int64_t>(stats.active), Attrs{{"kind", "active"}});
+  observe(result, static_cast<int64_t>(stats.resident), Attrs{{"kind", "resident"}});
+  observe(result, static_cast<int64_t>(stats.mapped), Attrs{{"kind", "mapped"}});
+  observe(result, static_cast<int64_t>(stats.retained), Attrs{{"kind", "retained"}});
 }
 
 }  // namespace
@@ -72,9 +142,30 @@ namespace SmartMet
 {
 namespace Spine
 {
+#ifdef SMARTMET_SPINE_OPENTELEMETRY
+
+struct OTelMetricsExporter::Histograms
+{
+  opentelemetry::nostd::unique_ptr<opentelemetry::metrics::Histogram<double>> duration;
+  opentelemetry::nostd::unique_ptr<opentelemetry::metrics::Histogram<double>> cpu_time;
+};
+
+namespace
+{
+// Histograms of the running exporter, accessed with std::atomic_load/store
+std::shared_ptr<OTelMetricsExporter::Histograms> active_histograms;
+}  // namespace
+
+#endif  // SMARTMET_SPINE_OPENTELEMETRY
 
 OTelMetricsExporter::OTelMetricsExporter(OTelOptions options, CacheStatsCallback callback)
-    : itsOptions(std::move(options)), itsCallback(std::move(callback))
+    : itsOptions(std::move(options))
+{
+  itsCallbacks.cacheStats = std::move(callback);
+}
+
+OTelMetricsExporter::OTelMetricsExporter(OTelOptions options, Callbacks callbacks)
+    : itsOptions(std::move(options)), itsCallbacks(std::move(callbacks))
 {
 }
 
@@ -134,27 +225,74 @@ void OTelMetricsExporter::start()
     itsProvider->AddMetricReader(std::move(reader));
 
     // ── Observable instruments ────────────────────────────────────────────────
-    itsContext = std::make_shared<ObserveContext>(ObserveContext{itsCallback});
+    itsContext = std::make_shared<ObserveContext>(ObserveContext{itsCallbacks});
 
     auto meter = itsProvider->GetMeter(itsOptions.service_name, itsOptions.service_version);
+    auto* ctx_raw = itsContext.get();
 
-    itsSizeGauge    = meter->CreateInt64ObservableGauge(
-        "smartmet.cache.size",     "Current number of entries in the cache");
-    itsMaxSizeGauge = meter->CreateInt64ObservableGauge(
-        "smartmet.cache.max_size", "Configured capacity of the cache");
-    itsHitsGauge    = meter->CreateInt64ObservableGauge(
-        "smartmet.cache.hits",     "Cumulative cache hits since server start");
-    itsMissesGauge  = meter->CreateInt64ObservableGauge(
-        "smartmet.cache.misses",   "Cumulative cache misses since server start");
-    itsInsertsGauge = meter->CreateInt64ObservableGauge(
-        "smartmet.cache.inserts",  "Cumulative cache inserts since server start");
+    using Callback = opentelemetry::metrics::ObservableCallbackPtr;
+    const auto add = [this, ctx_raw](auto instrument, Callback callback)
+    {
+      instrument->AddCallback(callback, ctx_raw);
+      itsInstruments.emplace_back(std::move(instrument));
+    };
 
-    auto* ctx_raw = itsContext.get();
-    itsSizeGauge->AddCallback(observeSize,     ctx_raw);
-    itsMaxSizeGauge->AddCallback(observeMaxSize, ctx_raw);
-    itsHitsGauge->AddCallback(observeHits,     ctx_raw);
-    itsMissesGauge->AddCallback(observeMisses,  ctx_raw);
-    itsInsertsGauge->AddCallback(observeInserts, ctx_raw);
+    if (itsOptions.metrics_caches && itsCallbacks.cacheStats)
+    {
+      add(meter->CreateInt64ObservableGauge(
+              "smartmet.cache.size",     "Current number of entries in the cache"),
+          observeSize);
+      add(meter->CreateInt64ObservableGauge(
+              "smartmet.cache.max_size", "Configured capacity of the cache"),
+          observeMaxSize);
+      add(meter->CreateInt64ObservableGauge(
+              "smartmet.cache.hits",     "Cumulative cache hits since server start"),
+          observeHits);
+      add(meter->CreateInt64ObservableGauge(
+              "smartmet.cache.misses",   "Cumulative cache misses since server start"),
+          observeMisses);
+      add(meter->CreateInt64ObservableGauge(
+              "smartmet.cache.inserts",  "Cumulative cache inserts since server start"),
+          observeInserts);
+    }
+
+    if (itsOptions.metrics_load && itsCallbacks.load)
+    {
+      add(meter->CreateInt64ObservableGauge(
+              "smartmet.requests.active", "Requests currently being handled"),
+          observeActiveRequests);
+      add(meter->CreateInt64ObservableGauge(
+              "smartmet.requests.active_limit", "Current limit for active requests"),
+          observeActiveRequestsLimit);
+      add(meter->CreateInt64ObservableGauge(
+              "smartmet.load.high", "1 if the server is refusing requests due to high load"),
+          observeHighLoad);
+    }
+
+    if (itsOptions.metrics_handlers && itsCallbacks.serviceStats)
+    {
+      add(meter->CreateInt64ObservableCounter(
+              "smartmet.requests", "Requests handled since server start"),
+          observeRequests);
+
+      // Recorded by the request threads via recordRequest()
+      itsHistograms = std::make_shared<Histograms>();
+      itsHistograms->duration = meter->CreateDoubleHistogram(
+          "smartmet.request.duration", "Request wall clock time", "ms");
+      itsHistograms->cpu_time = meter->CreateDoubleHistogram(
+          "smartmet.request.cpu_time", "Request handler thread CPU time", "ms");
+      std::atomic_store(&active_histograms, itsHistograms);
+    }
+
+    if (itsOptions.metrics_backends && itsCallbacks.backends)
+      add(meter->CreateInt64ObservableGauge(
+              "smartmet.backend.inflight", "Requests in flight to the backend"),
+          observeBackendInflight);
+
+    if (itsOptions.metrics_memory && itsCallbacks.memory)
+      add(meter->CreateInt64ObservableGauge(
+              "smartmet.process.memory", "Process resident size and allocator statistics", "By"),
+          observeMemory);
 
     itsIsRunning = true;
 #endif
@@ -165,6 +303,43 @@ void OTelMetricsExporter::start()
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Record a finished request
+ *
+ * Called from the request threads. A no-op unless an exporter with
+ * handler metrics is running.
+ */
+// ----------------------------------------------------------------------
+
+void OTelMetricsExporter::recordRequest(const std::string& theHandler,
+                                        int theStatus,
+                                        std::chrono::microseconds theDuration,
+                                        std::chrono::microseconds theCpuTime)
+{
+#ifdef SMARTMET_SPINE_OPENTELEMETRY
+  const auto histograms = std::atomic_load(&active_histograms);
+  if (!histograms)
+    return;
+
+  const opentelemetry::nostd::string_view handler(theHandler.data(), theHandler.size());
+  const char* status_class = LatencyStats::statusClassName(theStatus);
+  const opentelemetry::context::Context context;
+
+  histograms->duration->Record(theDuration.count() / 1000.0,
+                               {{"handler", handler}, {"status.class", status_class}},
+                               context);
+  histograms->cpu_time->Record(theCpuTime.count() / 1000.0,
+                               {{"handler", handler}, {"status.class", status_class}},
+                               context);
+#else
+  (void)theHandler;
+  (void)theStatus;
+  (void)theDuration;
+  (void)theCpuTime;
+#endif
+}
+
 void OTelMetricsExporter::stop()
 {
   try
@@ -172,12 +347,17 @@ void OTelMetricsExporter::stop()
 #ifdef SMARTMET_SPINE_OPENTELEMETRY
     if (itsProvider)
     {
+      // Requests still being recorded keep the histograms alive
+      if (itsHistograms)
+      {
+        auto expected = itsHistograms;
+        std::atomic_compare_exchange_strong(
+            &active_histograms, &expected, std::shared_ptr<Histograms>());
+        itsHistograms.reset();
+      }
+
       // Drop observable instruments first so callbacks are unregistered
-      itsSizeGauge.reset();
-      itsMaxSizeGauge.reset();
-      itsHitsGauge.reset();
-      itsMissesGauge.reset();
-      itsInsertsGauge.reset();
+      itsInstruments.clear();
       itsContext.reset();
 
       itsProvider->ForceFlush(std::chrono::milliseconds(itsOptions.timeout_ms));
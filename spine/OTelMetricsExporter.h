@@ -1,7 +1,14 @@
 #pragma once
 
+#include "ActiveBackends.h"
+#include "MallocStats.h"
 #include "OTelOptions.h"
+#include "ServiceStats.h"
+#include <chrono>
 #include <functional>
+#include <map>
+#include <string>
+#include <vector>
 #include <macgyver/CacheStats.h>
 
 #ifdef SMARTMET_SPINE_OPENTELEMETRY
@@ -15,13 +22,14 @@ namespace Spine
 {
 
 /**
- * OTelMetricsExporter — periodically exports cache-statistics gauges via OTel Metrics.
+ * OTelMetricsExporter — periodically exports server metrics via OTel Metrics.
  *
- * The caller supplies a callback that returns the current Fmi::Cache::CacheStatistics map.
- * The PeriodicExportingMetricReader (part of the SDK) calls back into the registered
- * Observable instruments on each export cycle.
+ * The caller supplies callbacks which return the current values. The
+ * PeriodicExportingMetricReader (part of the SDK) calls back into the registered
+ * Observable instruments on each export cycle. A metric group is published only
+ * if its callback is set and its OTelOptions switch is on.
  *
- * Published metrics (all use attribute "cache.name" = <cache key>):
+ * Caches (metrics_caches), attribute "cache.name" = <cache key>:
  *
  *   smartmet.cache.size        – current number of entries
  *   smartmet.cache.max_size    – configured capacity
@@ -29,6 +37,32 @@ namespace Spine
  *   smartmet.cache.misses      – cumulative misses since start
  *   smartmet.cache.inserts     – cumulative inserts since start
  *
+ * Load (metrics_load):
+ *
+ *   smartmet.requests.active        – requests currently being handled
+ *   smartmet.requests.active_limit  – current throttling limit
+ *   smartmet.load.high              – 1 if requests are being refused
+ *
+ * Handlers (metrics_handlers), attribute "handler":
+ *
+ *   smartmet.requests              – cumulative requests since start (counter)
+ *   smartmet.request.duration      – wall clock time histogram, ms
+ *   smartmet.request.cpu_time      – handler thread CPU time histogram, ms
+ *
+ * The histograms have the additional attribute "status.class" (1xx-5xx or
+ * other) and the default bucket boundaries of the SDK (0-10000 ms). The OTel
+ * C++ API has no asynchronous histogram instrument, hence each finished
+ * request is recorded via recordRequest().
+ *
+ * Backends (metrics_backends), attributes "backend.host" and "backend.port":
+ *
+ *   smartmet.backend.inflight      – requests in flight to the backend
+ *
+ * Memory (metrics_memory), attribute "kind" = rss, allocated, active, resident,
+ * mapped or retained (the latter five only with jemalloc):
+ *
+ *   smartmet.process.memory        – bytes
+ *
  * The export interval is taken from OTelOptions::metrics_interval_s (default 60 s).
  * Set metrics_interval_s = 0 to disable metrics export entirely.
  *
@@ -39,7 +73,26 @@ class OTelMetricsExporter
  public:
   using CacheStatsCallback = std::function<Fmi::Cache::CacheStatistics()>;
 
+  struct LoadStatus
+  {
+    std::size_t active_requests = 0;
+    std::size_t active_requests_limit = 0;
+    bool high_load = false;
+  };
+
+  struct Callbacks
+  {
+    CacheStatsCallback cacheStats;
+    std::function<LoadStatus()> load;
+    std::function<std::map<std::string, ServiceStats::Summary>()> serviceStats;
+    std::function<ActiveBackends::Status()> backends;
+    std::function<MemoryStats()> memory;
+  };
+
+  // Cache statistics only
   OTelMetricsExporter(OTelOptions options, CacheStatsCallback callback);
+
+  OTelMetricsExporter(OTelOptions options, Callbacks callbacks);
   ~OTelMetricsExporter();
 
   OTelMetricsExporter(const OTelMetricsExporter&) = delete;
@@ -50,27 +103,37 @@ class OTelMetricsExporter
   void start();
   void stop();
 
+  // Record a finished request into the histograms of the running exporter, if any
+  static void recordRequest(const std::string& theHandler,
+                            int theStatus,
+                            std::chrono::microseconds theDuration,
+                            std::chrono::microseconds theCpuTime);
+
  private:
   OTelOptions itsOptions;
-  CacheStatsCallback itsCallback;
+  Callbacks itsCallbacks;
   bool itsIsRunning = false;
 
 #ifdef SMARTMET_SPINE_OPENTELEMETRY
+ public:
   // Context shared with the Observable callbacks (kept alive until stop())
   struct ObserveContext
   {
-    CacheStatsCallback callback;
+    Callbacks callbacks;
   };
+
+  // Synchronous instruments used by recordRequest()
+  struct Histograms;
+
+ private:
   std::shared_ptr<ObserveContext> itsContext;
 
   std::shared_ptr<opentelemetry::sdk::metrics::MeterProvider> itsProvider;
 
   // Observable instruments must be kept alive; destruction removes the callback.
-  std::shared_ptr<opentelemetry::metrics::ObservableInstrument> itsSizeGauge;
-  std::shared_ptr<opentelemetry::metrics::ObservableInstrument> itsMaxSizeGauge;
-  std::shared_ptr<opentelemetry::metrics::ObservableInstrument> itsHitsGauge;
-  std::shared_ptr<opentelemetry::metrics::ObservableInstrument> itsMissesGauge;
-  std::shared_ptr<opentelemetry::metrics::ObservableInstrument> itsInsertsGauge;
+  std::vector<std::shared_ptr<opentelemetry::metrics::ObservableInstrument>> itsInstruments;
+
+  std::shared_ptr<Histograms> itsHistograms;
 #endif
 };
 
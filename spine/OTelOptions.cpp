@@ -30,6 +30,11 @@ OTelOptions OTelOptions::fromConfig(const libconfig::Config& config)
       opts.batch_max_queue_size = static_cast<std::size_t>(tmp);
     cfg.lookupValue("batch_schedule_delay_ms", opts.batch_schedule_delay_ms);
     cfg.lookupValue("metrics_interval_s", opts.metrics_interval_s);
+    cfg.lookupValue("metrics_caches", opts.metrics_caches);
+    cfg.lookupValue("metrics_load", opts.metrics_load);
+    cfg.lookupValue("metrics_handlers", opts.metrics_handlers);
+    cfg.lookupValue("metrics_backends", opts.metrics_backends);
+    cfg.lookupValue("metrics_memory", opts.metrics_memory);
 
     if (cfg.exists("headers"))
     {
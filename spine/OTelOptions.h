@@ -26,6 +26,12 @@ namespace Spine
  *     batch          = true;                      # batch vs simple processor
  *     batch_max_queue_size    = 2048;
  *     batch_schedule_delay_ms = 5000;
+ *     metrics_interval_s = 60;
+ *     metrics_caches   = true;                    # smartmet.cache.*
+ *     metrics_load     = true;                    # active requests, limit, high load flag
+ *     metrics_handlers = true;                    # per-handler requests and latencies
+ *     metrics_backends = true;                    # in-flight requests per backend
+ *     metrics_memory   = true;                    # process RSS and allocator stats
  *     headers = { Authorization = "Bearer <token>"; };
  *   };
  */
@@ -49,9 +55,16 @@ struct OTelOptions
   std::size_t batch_max_queue_size = 2048;
   int batch_schedule_delay_ms = 5000;
 
-  // How often to push cache-statistics metrics (seconds).  0 = disabled.
+  // How often to push metrics (seconds).  0 = disabled.
   int metrics_interval_s = 60;
 
+  // Metric groups, each can be disabled separately
+  bool metrics_caches = true;
+  bool metrics_load = true;
+  bool metrics_handlers = true;
+  bool metrics_backends = true;
+  bool metrics_memory = true;
+
   /**
    * Parse OTelOptions from the "opentelemetry" group in a libconfig::Config.
    * Returns default-constructed (disabled) options if the group is absent.
@@ -240,6 +240,11 @@ bool Options::parseOptions(int argc, char* argv[])
     if (compresslimit < 100)
       throw Fmi::Exception(BCP, "Compression size limit below 100 makes no sense!");
 
+    if (accesslog.records == 0 || accesslog.text_mb == 0)
+      throw Fmi::Exception(BCP, "In-memory request log settings must be > 0")
+          .addParameter("Records", Fmi::to_string(accesslog.records))
+          .addParameter("Text MB", Fmi::to_string(accesslog.text_mb));
+
     if (throttle.start_limit == 0 || throttle.limit == 0 || throttle.increase_rate == 0)
       throw Fmi::Exception(BCP, "Active request settings must be > 0")
           .addParameter("Start limit", Fmi::to_string(throttle.start_limit))
@@ -316,6 +321,25 @@ void Options::parseConfig()
       lookupHostSetting(itsConfig, defaultlogging, "defaultlogging");
       lookupHostSetting(itsConfig, lazylinking, "lazylinking");
       lookupHostSetting(itsConfig, accesslogdir, "accesslogdir");
+      lookupHostSetting(itsConfig, accesslog.queue_size, "accesslog.queue_size");
+      lookupHostSetting(itsConfig, accesslog.flush_interval_ms, "accesslog.flush_interval_ms");
+      lookupHostSetting(itsConfig, accesslog.rotate_size_mb, "accesslog.rotate_size_mb");
+      lookupHostSetting(itsConfig, accesslog.rotate_interval, "accesslog.rotate_interval");
+      lookupHostSetting(itsConfig, accesslog.records, "accesslog.records");
+      lookupHostSetting(itsConfig, accesslog.text_mb, "accesslog.text_mb");
+
+      lookupHostSetting(itsConfig, servertiming.enabled, "servertiming.enabled");
+      lookupHostSetting(itsConfig, servertiming.sample_rate, "servertiming.sample_rate");
+      lookupHostSetting(itsConfig, servertiming.admin, "servertiming.admin");
+      lookupHostSetting(itsConfig, memorygovernor.enabled, "memorygovernor.enabled");
+      lookupHostSetting(itsConfig, memorygovernor.interval, "memorygovernor.interval");
+      lookupHostSetting(itsConfig, memorygovernor.limit_mb, "memorygovernor.limit_mb");
+      lookupHostSetting(itsConfig, memorygovernor.high, "memorygovernor.high");
+      lookupHostSetting(itsConfig, memorygovernor.target, "memorygovernor.target");
+      lookupHostSetting(itsConfig, memorygovernor.psi, "memorygovernor.psi");
+      lookupHostSetting(itsConfig, memorygovernor.psi_fraction, "memorygovernor.psi_fraction");
+      lookupHostSetting(itsConfig, memorygovernor.settle, "memorygovernor.settle");
+      lookupHostSetting(itsConfig, memorygovernor.history, "memorygovernor.history");
       lookupHostSetting(itsConfig, resolveClientHostName, "dns.resolve");
       lookupHostSetting(itsConfig, clientHostNameCacheSize, "dns.cachesize");
       lookupHostSetting(itsConfig, clientHostNamePositiveTtl, "dns.positivettl");
@@ -355,6 +379,16 @@ void Options::parseConfig()
       lookupHostSetting(itsConfig, fastpool.maxrequeuesize, "fastpool.maxrequeuesize");
 
       lookupHostSetting(itsConfig, new_handler, "new_handler");
+
+      lookupHostSetting(itsConfig, circuitbreaker.enabled, "circuitbreaker.enabled");
+      lookupHostSetting(
+          itsConfig, circuitbreaker.failure_threshold, "circuitbreaker.failure_threshold");
+      lookupHostSetting(itsConfig, circuitbreaker.open_seconds, "circuitbreaker.open_seconds");
+      lookupHostSetting(itsConfig, circuitbreaker.probes, "circuitbreaker.probes");
+      lookupHostSetting(
+          itsConfig, circuitbreaker.success_threshold, "circuitbreaker.success_threshold");
+      lookupHostSetting(itsConfig, circuitbreaker.slow_call_ms, "circuitbreaker.slow_call_ms");
+      lookupHostSetting(itsConfig, circuitbreaker.probe_seconds, "circuitbreaker.probe_seconds");
     }
     catch (libconfig::ParseException& e)
     {
@@ -407,10 +441,18 @@ void Options::report() const
               << "- at start\t\t\t= " << throttle.start_limit << "\n"
               << "- at slowdown\t\t\t= " << throttle.restart_limit << "\n"
               << "- increase rate\t\t\t= " << throttle.increase_rate << "\n"
+              << "Backend circuit breakers\t= " << (circuitbreaker.enabled ? "ON" : "OFF") << "\n"
               << "Port\t\t\t\t= " << port << "\n"
               << "Timeout\t\t\t\t= " << timeout << "\n"
               << "Access log directory\t\t= " << accesslogdir << "\n"
+              << "- max queue size\t\t= " << accesslog.queue_size << "\n"
+              << "- rotate size\t\t\t= " << accesslog.rotate_size_mb << " MB\n"
+              << "- rotate interval\t\t= " << accesslog.rotate_interval << "s\n"
+              << "- requests kept in memory\t= " << accesslog.records << "\n"
               << "Logs requests by default\t= " << defaultlogging << "\n"
+              << "Server-Timing header\t\t= " << (servertiming.enabled ? "ON" : "OFF") << "\n"
+              << "- sample rate\t\t\t= " << servertiming.sample_rate << "\n"
+              << "Memory governor\t\t\t= " << (memorygovernor.enabled ? "ON" : "OFF") << "\n"
               << "Resolve client host name\t= " << (resolveClientHostName ? "ON" : "OFF") << "\n"
               << "- resolver threads\t\t= " << clientHostNameThreads << "\n"
               << "- max queue size\t\t= " << clientHostNameMaxQueueSize << "\n"
@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include "BackendCircuitBreaker.h"
+#include "MemoryGovernor.h"
 #include "OTelOptions.h"
 #include <macgyver/Optional.h>
 #include <libconfig.h++>
@@ -35,6 +37,28 @@ struct ThrottleOptions
   unsigned int increase_rate = 10;  // increment current limit every 10 succesfull requests
 };
 
+// Access log writer options, configured via the "accesslog" group
+
+struct AccessLogOptions
+{
+  unsigned int queue_size = 65536;        // max requests waiting for the writer thread
+  unsigned int flush_interval_ms = 1000;  // max delay before queued requests are written
+  unsigned int rotate_size_mb = 0;        // rotate when the file grows beyond this, 0 = never
+  unsigned int rotate_interval = 0;       // rotate files older than this many seconds, 0 = never
+
+  // In-memory request log of each handler (?what=lastrequests etc)
+  unsigned int records = 65536;  // max requests kept in memory per handler
+  unsigned int text_mb = 8;     // memory reserved for URIs, ETags and API keys per handler
+};
+
+// Server-Timing response header with the request phase durations
+struct ServerTimingOptions
+{
+  bool enabled = false;
+  double sample_rate = 0.0;  // fraction of requests which get the header
+  bool admin = true;         // on request (X-Server-Timing) with valid admin credentials
+};
+
 // Storage for parsed options
 
 struct Options
@@ -78,6 +102,9 @@ struct Options
 
   ThrottleOptions throttle;
 
+  // Circuit breakers for backend servers, see BackendCircuitBreaker.h
+  BackendCircuitBreaker::Options circuitbreaker;
+
   unsigned int maxrequestsize = 131072;  // Limit incoming request sizes, 0 means unlimited
 
   // stale-while-revalidate: how long (seconds) a CDN/browser may serve a stale response while
@@ -89,6 +116,12 @@ struct Options
   unsigned int staleIfError = 86400;
 
   std::string accesslogdir{"/var/log/smartmet"};
+  AccessLogOptions accesslog;
+
+  ServerTimingOptions servertiming;
+
+  // Shrinking of registered caches under memory pressure, see MemoryGovernor.h
+  MemoryGovernor::Options memorygovernor;
 
   OTelOptions otel;
 
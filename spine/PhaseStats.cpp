@@ -0,0 +1,62 @@
+#include "PhaseStats.h"
+#include <tuple>
+
+namespace SmartMet
+{
+namespace Spine
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Counter for the named phase, created if necessary
+ *
+ * std::map nodes never move, hence the reference stays valid after
+ * the lock has been released.
+ */
+// ----------------------------------------------------------------------
+
+PhaseStats::Counter& PhaseStats::counter(const std::string& theName)
+{
+  {
+    ReadLock lock(itsMutex);
+    auto pos = itsCounters.find(theName);
+    if (pos != itsCounters.end())
+      return pos->second;
+  }
+
+  WriteLock lock(itsMutex);
+  const std::string& name = (itsCounters.size() < max_phases ? theName : "other");
+  return itsCounters.emplace(std::piecewise_construct, std::forward_as_tuple(name), std::tuple<>())
+      .first->second;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add the phases of a finished request
+ */
+// ----------------------------------------------------------------------
+
+void PhaseStats::add(const std::vector<PhaseTimer::Phase>& thePhases)
+{
+  for (const auto& phase : thePhases)
+  {
+    auto& c = counter(phase.name);
+    c.count.fetch_add(1, std::memory_order_relaxed);
+    c.microseconds.fetch_add(phase.duration.count(), std::memory_order_relaxed);
+  }
+}
+
+std::map<std::string, PhaseStats::Totals> PhaseStats::totals() const
+{
+  std::map<std::string, Totals> ret;
+  ReadLock lock(itsMutex);
+  for (const auto& item : itsCounters)
+  {
+    auto& totals = ret[item.first];
+    totals.count = item.second.count.load(std::memory_order_relaxed);
+    totals.microseconds = item.second.microseconds.load(std::memory_order_relaxed);
+  }
+  return ret;
+}
+
+}  // namespace Spine
+}  // namespace SmartMet
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "PhaseTimer.h"
+#include "Thread.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Spine
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Phase duration totals of a single handler
+ *
+ * Counters of known phases are updated under a shared lock, the
+ * exclusive lock is needed only when a new phase name is seen. The
+ * number of distinct names is limited so that a plugin generating
+ * dynamic names cannot grow the map without bound, any further names
+ * are counted as "other".
+ */
+// ----------------------------------------------------------------------
+
+class PhaseStats
+{
+ public:
+  struct Totals
+  {
+    std::uint64_t count = 0;
+    std::int64_t microseconds = 0;
+  };
+
+  static constexpr std::size_t max_phases = 64;
+
+  void add(const std::vector<PhaseTimer::Phase>& thePhases);
+
+  std::map<std::string, Totals> totals() const;
+
+ private:
+  struct Counter
+  {
+    std::atomic<std::uint64_t> count{0};
+    std::atomic<std::int64_t> microseconds{0};
+  };
+
+  Counter& counter(const std::string& theName);
+
+  mutable NamedMutexType itsMutex{"PhaseStats"};
+  std::map<std::string, Counter> itsCounters;
+};
+
+}  // namespace Spine
+}  // namespace SmartMet
@@ -0,0 +1,142 @@
+#include "PhaseTimer.h"
+#include <fmt/format.h>
+#include <iterator>
+
+namespace SmartMet
+{
+namespace Spine
+{
+namespace
+{
+// Server-Timing metric names must be HTTP tokens
+bool is_token_char(char c)
+{
+  if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
+    return true;
+  switch (c)
+  {
+    case '!':
+    case '#':
+    case '$':
+    case '%':
+    case '&':
+    case '\'':
+    case '*':
+    case '+':
+    case '-':
+    case '.':
+    case '^':
+    case '_':
+    case '`':
+    case '|':
+    case '~':
+      return true;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+PhaseTimer::Scope::Scope(PhaseTimer& theTimer, std::string theName)
+    : itsTimer(&theTimer), itsName(std::move(theName)), itsStart(Clock::now())
+{
+}
+
+PhaseTimer::Scope::Scope(Scope&& theOther) noexcept
+    : itsTimer(theOther.itsTimer), itsName(std::move(theOther.itsName)), itsStart(theOther.itsStart)
+{
+  theOther.itsTimer = nullptr;
+}
+
+PhaseTimer::Scope::~Scope()
+{
+  try
+  {
+    stop();
+  }
+  catch (...)
+  {
+    // destructor must not throw
+  }
+}
+
+void PhaseTimer::Scope::stop()
+{
+  if (itsTimer == nullptr)
+    return;
+  itsTimer->add(itsName,
+                std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - itsStart));
+  itsTimer = nullptr;
+}
+
+PhaseTimer::PhaseTimer() : itsCreated(Clock::now()) {}
+
+PhaseTimer::PhaseTimer(const PhaseTimer& theOther)
+{
+  std::lock_guard<std::mutex> lock(theOther.itsMutex);
+  itsCreated = theOther.itsCreated;
+  itsPhases = theOther.itsPhases;
+}
+
+PhaseTimer& PhaseTimer::operator=(const PhaseTimer& theOther)
+{
+  if (this != &theOther)
+  {
+    std::scoped_lock lock(itsMutex, theOther.itsMutex);
+    itsCreated = theOther.itsCreated;
+    itsPhases = theOther.itsPhases;
+  }
+  return *this;
+}
+
+PhaseTimer::Scope PhaseTimer::start(std::string theName)
+{
+  return {*this, std::move(theName)};
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add a duration to the named phase
+ */
+// ----------------------------------------------------------------------
+
+void PhaseTimer::add(const std::string& theName, std::chrono::microseconds theDuration)
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  for (auto& phase : itsPhases)
+  {
+    if (phase.name == theName)
+    {
+      phase.duration += theDuration;
+      return;
+    }
+  }
+  if (itsPhases.empty())
+    itsPhases.reserve(8);
+  itsPhases.push_back(Phase{theName, theDuration});
+}
+
+std::vector<PhaseTimer::Phase> PhaseTimer::phases() const
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  return itsPhases;
+}
+
+std::string PhaseTimer::serverTiming() const
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  std::string ret;
+  for (const auto& phase : itsPhases)
+  {
+    if (!ret.empty())
+      ret += ", ";
+    for (char c : phase.name)
+      ret += (is_token_char(c) ? c : '-');
+    fmt::format_to(std::back_inserter(ret), ";dur={:.3f}", phase.duration.count() / 1000.0);
+  }
+  return ret;
+}
+
+}  // namespace Spine
+}  // namespace SmartMet
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Spine
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Named phase durations of a single request
+ *
+ * Spine records its own stages ("queue", "handler" and "stream" for
+ * streamed responses). Plugins may add their own, for example
+ *
+ *   auto scope = theRequest.getPhaseTimer().start("fetch");
+ *   ...
+ *   scope.stop();  // or let the destructor do it
+ *
+ * Repeated phases with the same name are summed. The totals are
+ * aggregated per handler into PhaseStats and may be returned to the
+ * client in a Server-Timing header.
+ */
+// ----------------------------------------------------------------------
+
+class PhaseTimer
+{
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Phase
+  {
+    std::string name;
+    std::chrono::microseconds duration{0};
+  };
+
+  // Measures a phase until stopped or destroyed
+  class Scope
+  {
+   public:
+    Scope(PhaseTimer& theTimer, std::string theName);
+    ~Scope();
+
+    Scope(Scope&& theOther) noexcept;
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+    Scope& operator=(Scope&&) = delete;
+
+    void stop();
+
+   private:
+    PhaseTimer* itsTimer;
+    std::string itsName;
+    Clock::time_point itsStart;
+  };
+
+  PhaseTimer();
+  PhaseTimer(const PhaseTimer& theOther);
+  PhaseTimer& operator=(const PhaseTimer& theOther);
+
+  Scope start(std::string theName);
+  void add(const std::string& theName, std::chrono::microseconds theDuration);
+
+  // Time when the timer (i.e. the request) was created
+  Clock::time_point created() const { return itsCreated; }
+
+  std::vector<Phase> phases() const;
+
+  // Value for the Server-Timing response header, e.g. "queue;dur=0.05, handler;dur=12.3"
+  std::string serverTiming() const;
+
+ private:
+  mutable std::mutex itsMutex;
+  Clock::time_point itsCreated;
+  std::vector<Phase> itsPhases;
+};
+
+}  // namespace Spine
+}  // namespace SmartMet
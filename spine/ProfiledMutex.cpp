@@ -0,0 +1,129 @@
+#include "ProfiledMutex.h"
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace SmartMet
+{
+namespace Spine
+{
+namespace
+{
+// A plain mutex, MutexType itself may be profiled
+std::mutex registry_mutex;
+
+std::map<std::string, std::unique_ptr<LockStats>>& registry()
+{
+  static std::map<std::string, std::unique_ptr<LockStats>> stats;
+  return stats;
+}
+
+void update_max(std::atomic<std::int64_t>& theMax, std::int64_t theValue)
+{
+  auto old = theMax.load(std::memory_order_relaxed);
+  while (theValue > old && !theMax.compare_exchange_weak(old, theValue, std::memory_order_relaxed))
+  {
+  }
+}
+
+std::size_t bucket(std::int64_t theNanoSeconds)
+{
+  std::size_t i = 0;
+  while (theNanoSeconds > 1 && i + 1 < LockStats::bucket_count)
+  {
+    theNanoSeconds >>= 1;
+    ++i;
+  }
+  return i;
+}
+
+}  // namespace
+
+LockStats::LockStats(std::string theName) : itsName(std::move(theName)) {}
+
+LockStats& LockStats::get(const char* theName)
+{
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  auto& stats = registry()[theName];
+  if (!stats)
+    stats.reset(new LockStats(theName));
+  return *stats;
+}
+
+void LockStats::waited(std::int64_t theNanoSeconds)
+{
+  itsContended.fetch_add(1, std::memory_order_relaxed);
+  itsTotalWait.fetch_add(theNanoSeconds, std::memory_order_relaxed);
+  itsWaitBuckets[bucket(theNanoSeconds)].fetch_add(1, std::memory_order_relaxed);
+  update_max(itsMaxWait, theNanoSeconds);
+}
+
+void LockStats::held(std::int64_t theNanoSeconds)
+{
+  update_max(itsMaxHold, theNanoSeconds);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Current totals
+ *
+ * The wait percentiles are bucket upper bounds, i.e. accurate to a
+ * factor of two, and cover only the contended acquisitions.
+ */
+// ----------------------------------------------------------------------
+
+LockStats::Summary LockStats::summary() const
+{
+  Summary ret;
+  ret.name = itsName;
+  ret.instances = itsInstances.load(std::memory_order_relaxed);
+  ret.exclusive = itsExclusive.load(std::memory_order_relaxed);
+  ret.shared = itsShared.load(std::memory_order_relaxed);
+  ret.contended = itsContended.load(std::memory_order_relaxed);
+  ret.total_wait_ns = itsTotalWait.load(std::memory_order_relaxed);
+  ret.max_wait_ns = itsMaxWait.load(std::memory_order_relaxed);
+  ret.max_hold_ns = itsMaxHold.load(std::memory_order_relaxed);
+
+  std::array<std::uint64_t, bucket_count> counts;
+  std::uint64_t total = 0;
+  for (std::size_t i = 0; i < bucket_count; i++)
+    total += (counts[i] = itsWaitBuckets[i].load(std::memory_order_relaxed));
+
+  auto percentile = [&](double theFraction) -> std::int64_t
+  {
+    if (total == 0)
+      return 0;
+    const auto rank = static_cast<std::uint64_t>(theFraction * static_cast<double>(total - 1)) + 1;
+    std::uint64_t sum = 0;
+    for (std::size_t i = 0; i < bucket_count; i++)
+    {
+      sum += counts[i];
+      if (sum >= rank)
+        return std::min(std::int64_t(2) << i, ret.max_wait_ns);
+    }
+    return ret.max_wait_ns;
+  };
+
+  ret.wait_p50_ns = percentile(0.50);
+  ret.wait_p99_ns = percentile(0.99);
+  return ret;
+}
+
+std::vector<LockStats::Summary> LockStats::summaries()
+{
+  std::vector<Summary> ret;
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (const auto& item : registry())
+      ret.push_back(item.second->summary());
+  }
+  std::stable_sort(ret.begin(),
+                   ret.end(),
+                   [](const Summary& a, const Summary& b)
+                   { return a.total_wait_ns > b.total_wait_ns; });
+  return ret;
+}
+
+}  // namespace Spine
+}  // namespace SmartMet
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <boost/thread/shared_mutex.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Spine
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Acquisition statistics shared by all locks of the same name
+ *
+ * Wait times are collected into log2 nanosecond buckets. Only
+ * contended acquisitions are timed, an uncontended one is just
+ * counted. Entries are never removed from the registry, hence the
+ * references returned by get() stay valid.
+ */
+// ----------------------------------------------------------------------
+
+class LockStats
+{
+ public:
+  struct Summary
+  {
+    std::string name;
+    std::int64_t instances = 0;
+    std::uint64_t exclusive = 0;
+    std::uint64_t shared = 0;
+    std::uint64_t contended = 0;
+    std::int64_t total_wait_ns = 0;
+    std::int64_t max_wait_ns = 0;
+    std::int64_t wait_p50_ns = 0;
+    std::int64_t wait_p99_ns = 0;
+    std::int64_t max_hold_ns = 0;
+  };
+
+  static constexpr std::size_t bucket_count = 48;
+
+  static LockStats& get(const char* theName);
+
+  // All named locks, the most waited for first
+  static std::vector<Summary> summaries();
+
+  void created() { itsInstances.fetch_add(1, std::memory_order_relaxed); }
+  void destroyed() { itsInstances.fetch_sub(1, std::memory_order_relaxed); }
+
+  void acquired(bool theExclusive)
+  {
+    (theExclusive ? itsExclusive : itsShared).fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void waited(std::int64_t theNanoSeconds);
+  void held(std::int64_t theNanoSeconds);
+
+  Summary summary() const;
+
+ private:
+  explicit LockStats(std::string theName);
+
+  std::string itsName;
+  std::atomic<std::int64_t> itsInstances{0};
+  std::atomic<std::uint64_t> itsExclusive{0};
+  std::atomic<std::uint64_t> itsShared{0};
+  std::atomic<std::uint64_t> itsContended{0};
+  std::atomic<std::int64_t> itsTotalWait{0};
+  std::atomic<std::int64_t> itsMaxWait{0};
+  std::atomic<std::int64_t> itsMaxHold{0};
+  std::array<std::atomic<std::uint64_t>, bucket_count> itsWaitBuckets{};
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief boost::shared_mutex compatible mutex recording LockStats
+ *
+ * Used as MutexType when spine is compiled with
+ * SMARTMET_SPINE_LOCK_PROFILING. Exclusive hold times are measured
+ * from acquisition to release, shared holds are only counted.
+ */
+// ----------------------------------------------------------------------
+
+class ProfiledMutex
+{
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  ProfiledMutex() : ProfiledMutex("unnamed") {}
+  explicit ProfiledMutex(const char* theName) : itsStats(LockStats::get(theName))
+  {
+    itsStats.created();
+  }
+  ~ProfiledMutex() { itsStats.destroyed(); }
+
+  ProfiledMutex(const ProfiledMutex&) = delete;
+  ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+  void lock()
+  {
+    if (!itsMutex.try_lock())
+    {
+      const auto start = Clock::now();
+      itsMutex.lock();
+      itsLockedAt = Clock::now();
+      itsStats.waited(elapsed(start, itsLockedAt));
+    }
+    else
+      itsLockedAt = Clock::now();
+    itsStats.acquired(true);
+  }
+
+  bool try_lock()
+  {
+    if (!itsMutex.try_lock())
+      return false;
+    itsLockedAt = Clock::now();
+    itsStats.acquired(true);
+    return true;
+  }
+
+  void unlock()
+  {
+    const auto held = elapsed(itsLockedAt, Clock::now());
+    itsMutex.unlock();
+    itsStats.held(held);
+  }
+
+  void lock_shared()
+  {
+    if (!itsMutex.try_lock_shared())
+    {
+      const auto start = Clock::now();
+      itsMutex.lock_shared();
+      itsStats.waited(elapsed(start, Clock::now()));
+    }
+    itsStats.acquired(false);
+  }
+
+  bool try_lock_shared()
+  {
+    if (!itsMutex.try_lock_shared())
+      return false;
+    itsStats.acquired(false);
+    return true;
+  }
+
+  void unlock_shared() { itsMutex.unlock_shared(); }
+
+  void lock_upgrade()
+  {
+    if (!itsMutex.try_lock_upgrade())
+    {
+      const auto start = Clock::now();
+      itsMutex.lock_upgrade();
+      itsStats.waited(elapsed(start, Clock::now()));
+    }
+    itsStats.acquired(false);
+  }
+
+  bool try_lock_upgrade()
+  {
+    if (!itsMutex.try_lock_upgrade())
+      return false;
+    itsStats.acquired(false);
+    return true;
+  }
+
+  void unlock_upgrade() { itsMutex.unlock_upgrade(); }
+
+  void unlock_upgrade_and_lock()
+  {
+    const auto start = Clock::now();
+    itsMutex.unlock_upgrade_and_lock();
+    itsLockedAt = Clock::now();
+    itsStats.waited(elapsed(start, itsLockedAt));
+    itsStats.acquired(true);
+  }
+
+  void unlock_and_lock_upgrade()
+  {
+    const auto held = elapsed(itsLockedAt, Clock::now());
+    itsMutex.unlock_and_lock_upgrade();
+    itsStats.held(held);
+  }
+
+  void unlock_upgrade_and_lock_shared() { itsMutex.unlock_upgrade_and_lock_shared(); }
+
+  void unlock_and_lock_shared()
+  {
+    const auto held = elapsed(itsLockedAt, Clock::now());
+    itsMutex.unlock_and_lock_shared();
+    itsStats.held(held);
+  }
+
+ private:
+  static std::int64_t elapsed(Clock::time_point theStart, Clock::time_point theEnd)
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(theEnd - theStart).count();
+  }
+
+  boost::shared_mutex itsMutex;
+  LockStats& itsStats;
+  Clock::time_point itsLockedAt;  // protected by the exclusive lock
+};
+
+}  // namespace Spine
+}  // namespace SmartMet
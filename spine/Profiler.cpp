@@ -0,0 +1,241 @@
+#include "Profiler.h"
+#include "Backtrace.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <signal.h>
+#include <sys/time.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Spine
+{
+namespace
+{
+struct Sample
+{
+  std::atomic<int> depth{0};
+  std::uintptr_t pcs[Profiler::max_frames];
+};
+
+// State shared with the signal handler
+std::atomic<bool> g_active{false};
+std::atomic<int> g_inflight{0};
+std::atomic<std::size_t> g_next{0};
+Sample* g_samples = nullptr;
+std::size_t g_capacity = 0;
+
+std::mutex g_running;
+
+// Async-signal-safe: only atomics and the frame pointer walk are used
+void sigprof_handler(int /* signo */, siginfo_t* /* info */, void* context)
+{
+  const int saved_errno = errno;
+  // Sequentially consistent so that profile() either sees us in flight or we see it stopped
+  g_inflight.fetch_add(1);
+  if (g_active.load())
+  {
+    const auto index = g_next.fetch_add(1, std::memory_order_relaxed);
+    if (index < g_capacity)
+    {
+      auto& sample = g_samples[index];
+      // Start from the interrupted context, skipping this handler and the trampoline
+      const int depth = Backtrace::capture(sample.pcs, Profiler::max_frames, context);
+      sample.depth.store(depth, std::memory_order_release);
+    }
+  }
+  g_inflight.fetch_sub(1);
+  errno = saved_errno;
+}
+
+// Disable sampling and wait for handlers still running in other threads
+void deactivate()
+{
+  g_active = false;
+  while (g_inflight.load() > 0)
+    std::this_thread::yield();
+}
+
+// Put back the previous action. A signal generated just before the timer was
+// stopped may still be pending, and would terminate the process under the
+// default action. It is delivered as soon as any thread runs, hence our
+// handler, which no longer samples, is kept for a few timer periods first.
+void restore(const struct sigaction& thePrevious, unsigned theFrequency)
+{
+  std::this_thread::sleep_for(std::chrono::microseconds(2 * 1000000 / theFrequency) +
+                              std::chrono::milliseconds(10));
+  sigaction(SIGPROF, &thePrevious, nullptr);
+}
+
+void set_timer(unsigned theFrequency)
+{
+  itimerval timer{};
+  if (theFrequency > 0)
+  {
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = static_cast<suseconds_t>(1000000 / theFrequency);
+    timer.it_value = timer.it_interval;
+  }
+  if (setitimer(ITIMER_PROF, &timer, nullptr) != 0)
+    throw Fmi::Exception(BCP, "Failed to set the profiling timer");
+}
+
+// flamegraph.pl uses ';' as the frame separator and the last space before the count
+std::string frame_name(const std::string& theName)
+{
+  std::string ret = theName;
+  std::replace(ret.begin(), ret.end(), ';', ':');
+  return ret;
+}
+
+// Symbolize and fold the samples, identical stacks are summed
+std::string fold(const Sample* theSamples, std::size_t theCount)
+{
+  // Count identical program counter sequences first so that each is symbolized once
+  std::map<std::vector<std::uintptr_t>, std::size_t> stacks;
+  for (std::size_t i = 0; i < theCount; i++)
+  {
+    const int depth = theSamples[i].depth.load(std::memory_order_acquire);
+    if (depth > 0)
+      ++stacks[std::vector<std::uintptr_t>(theSamples[i].pcs, theSamples[i].pcs + depth)];
+  }
+
+  std::unordered_map<std::uintptr_t, std::string> names;
+  std::map<std::string, std::size_t> folded;
+
+  for (const auto& item : stacks)
+  {
+    std::string stack;
+    // Outermost frame first
+    for (auto pc = item.first.rbegin(); pc != item.first.rend(); ++pc)
+    {
+      auto pos = names.find(*pc);
+      if (pos == names.end())
+      {
+        // Inlined functions are listed innermost first
+        const auto functions = Backtrace::symbolize(*pc);
+        std::string name;
+        for (auto f = functions.rbegin(); f != functions.rend(); ++f)
+        {
+          if (!name.empty())
+            name += ';';
+          name += frame_name(*f);
+        }
+        pos = names.emplace(*pc, std::move(name)).first;
+      }
+      if (!stack.empty())
+        stack += ';';
+      stack += pos->second;
+    }
+    folded[stack] += item.second;
+  }
+
+  std::string ret;
+  for (const auto& item : folded)
+  {
+    ret += item.first;
+    ret += ' ';
+    ret += std::to_string(item.second);
+    ret += '\n';
+  }
+  return ret;
+}
+
+}  // namespace
+
+bool Profiler::running()
+{
+  return g_active.load(std::memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Profile the process for the given duration
+ *
+ * The buffer is sized for every CPU being busy for the full duration,
+ * up to max_samples stacks.
+ */
+// ----------------------------------------------------------------------
+
+Profiler::Result Profiler::profile(std::chrono::milliseconds theDuration, unsigned theFrequency)
+{
+  try
+  {
+    if (theDuration.count() <= 0 || theDuration > max_duration)
+      throw Fmi::Exception(BCP, "Invalid profiling duration")
+          .addParameter("milliseconds", std::to_string(theDuration.count()));
+    if (theFrequency == 0 || theFrequency > max_frequency)
+      throw Fmi::Exception(BCP, "Invalid profiling frequency")
+          .addParameter("frequency", std::to_string(theFrequency));
+
+    std::unique_lock<std::mutex> lock(g_running, std::try_to_lock);
+    if (!lock.owns_lock())
+      throw Fmi::Exception(BCP, "Profiler is already running");
+
+    const std::size_t cpus = std::max(1U, std::thread::hardware_concurrency());
+    const std::size_t expected = theDuration.count() * theFrequency * cpus / 1000 + 1;
+    const std::size_t capacity = std::min(expected, max_samples);
+
+    std::unique_ptr<Sample[]> samples(new Sample[capacity]);
+
+    g_samples = samples.get();
+    g_capacity = capacity;
+    g_next = 0;
+    g_active = true;
+
+    struct sigaction action = {};
+    action.sa_sigaction = &sigprof_handler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+
+    struct sigaction previous = {};
+    if (sigaction(SIGPROF, &action, &previous) != 0)
+    {
+      g_active = false;
+      throw Fmi::Exception(BCP, "Failed to install the SIGPROF handler");
+    }
+
+    try
+    {
+      set_timer(theFrequency);
+      std::this_thread::sleep_for(theDuration);
+      set_timer(0);
+    }
+    catch (...)
+    {
+      set_timer(0);
+      deactivate();
+      restore(previous, theFrequency);
+      throw;
+    }
+
+    deactivate();
+    restore(previous, theFrequency);
+
+    Result result;
+    const std::size_t taken = g_next.load();
+    result.samples = std::min(taken, capacity);
+    result.dropped = taken - result.samples;
+
+    g_samples = nullptr;
+    g_capacity = 0;
+
+    result.folded = fold(samples.get(), result.samples);
+    return result;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Spine
+}  // namespace SmartMet
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+namespace SmartMet
+{
+namespace Spine
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief On demand sampling CPU profiler
+ *
+ * A process wide ITIMER_PROF timer delivers SIGPROF to the threads
+ * consuming CPU, and the signal handler stores the interrupted stack
+ * into a preallocated buffer without locking or allocating memory. The
+ * stack is walked via frame pointers, since the DWARF unwinder is not
+ * async-signal-safe. Full stacks hence require building with
+ * -fno-omit-frame-pointer, otherwise they are cut at the first function
+ * without one.
+ * Symbolization and folding into the format expected by flamegraph.pl
+ * ("main;foo;bar 42") is done only once sampling has stopped.
+ *
+ * The signal handler is installed only for the duration of a profile,
+ * hence there is no cost when the profiler is not running. Only one
+ * profile may run at a time, and its duration is limited since the
+ * calling thread is blocked meanwhile.
+ */
+// ----------------------------------------------------------------------
+
+class Profiler
+{
+ public:
+  struct Result
+  {
+    std::string folded;       // folded stacks, one per line
+    std::size_t samples = 0;  // number of stored samples
+    std::size_t dropped = 0;  // samples lost due to a full buffer
+  };
+
+  static constexpr int max_frames = 64;
+  static constexpr std::size_t max_samples = 50000;
+  static constexpr unsigned max_frequency = 1000;
+  static constexpr std::chrono::seconds max_duration{30};
+
+  // Sample all threads for the given duration, blocks the calling thread meanwhile
+  static Result profile(std::chrono::milliseconds theDuration, unsigned theFrequency = 99);
+
+  static bool running();
+};
+
+}  // namespace Spine
+}  // namespace SmartMet
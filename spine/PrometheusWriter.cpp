@@ -0,0 +1,169 @@
+#include "PrometheusWriter.h"
+#include <cmath>
+#include <fmt/format.h>
+#include <iterator>
+
+namespace SmartMet
+{
+namespace Spine
+{
+namespace
+{
+// HELP text escapes backslashes and newlines
+void append_help(std::string& theBuffer, std::string_view theText)
+{
+  for (char c : theText)
+  {
+    if (c == '\\')
+      theBuffer += "\\\\";
+    else if (c == '\n')
+      theBuffer += "\\n";
+    else
+      theBuffer += c;
+  }
+}
+
+// Label values additionally escape double quotes
+void append_label_value(std::string& theBuffer, std::string_view theText)
+{
+  for (char c : theText)
+  {
+    if (c == '\\')
+      theBuffer += "\\\\";
+    else if (c == '"')
+      theBuffer += "\\\"";
+    else if (c == '\n')
+      theBuffer += "\\n";
+    else
+      theBuffer += c;
+  }
+}
+
+}  // namespace
+
+void PrometheusWriter::family(std::string_view theName,
+                              std::string_view theHelp,
+                              std::string_view theType)
+{
+  itsBuffer += "# HELP ";
+  itsBuffer += theName;
+  itsBuffer += ' ';
+  append_help(itsBuffer, theHelp);
+  itsBuffer += "\n# TYPE ";
+  itsBuffer += theName;
+  itsBuffer += ' ';
+  itsBuffer += theType;
+  itsBuffer += '\n';
+}
+
+// The le label of a histogram bucket comes last
+void PrometheusWriter::labels(Labels theLabels, std::string_view theLe)
+{
+  if (theLabels.size() == 0 && theLe.empty())
+    return;
+
+  itsBuffer += '{';
+  bool first = true;
+  for (const auto& label : theLabels)
+  {
+    if (!first)
+      itsBuffer += ',';
+    first = false;
+    itsBuffer += label.first;
+    itsBuffer += "=\"";
+    append_label_value(itsBuffer, label.second);
+    itsBuffer += '"';
+  }
+  if (!theLe.empty())
+  {
+    if (!first)
+      itsBuffer += ',';
+    itsBuffer += "le=\"";
+    itsBuffer += theLe;
+    itsBuffer += '"';
+  }
+  itsBuffer += '}';
+}
+
+void PrometheusWriter::value(double theValue)
+{
+  if (std::isnan(theValue))
+    itsBuffer += "NaN";
+  else if (std::isinf(theValue))
+    itsBuffer += (theValue > 0 ? "+Inf" : "-Inf");
+  else
+    fmt::format_to(std::back_inserter(itsBuffer), "{}", theValue);
+}
+
+void PrometheusWriter::sample(std::string_view theName, Labels theLabels, double theValue)
+{
+  itsBuffer += theName;
+  labels(theLabels);
+  itsBuffer += ' ';
+  value(theValue);
+  itsBuffer += '\n';
+}
+
+void PrometheusWriter::sample(std::string_view theName, Labels theLabels, std::uint64_t theValue)
+{
+  itsBuffer += theName;
+  labels(theLabels);
+  itsBuffer += ' ';
+  fmt::format_to(std::back_inserter(itsBuffer), "{}", theValue);
+  itsBuffer += '\n';
+}
+
+void PrometheusWriter::sample(std::string_view theName, Labels theLabels, std::int64_t theValue)
+{
+  itsBuffer += theName;
+  labels(theLabels);
+  itsBuffer += ' ';
+  fmt::format_to(std::back_inserter(itsBuffer), "{}", theValue);
+  itsBuffer += '\n';
+}
+
+void PrometheusWriter::histogram(std::string_view theName,
+                                 Labels theLabels,
+                                 const std::vector<double>& theBounds,
+                                 const std::vector<std::uint64_t>& theCounts,
+                                 double theSum)
+{
+  std::uint64_t count = 0;
+  for (std::size_t i = 0; i <= theBounds.size(); i++)
+  {
+    if (i < theCounts.size())
+      count += theCounts[i];
+
+    char le[32];
+    std::string_view bound = "+Inf";
+    if (i < theBounds.size())
+    {
+      const auto result = fmt::format_to_n(le, sizeof(le), "{}", theBounds[i]);
+      bound = std::string_view(le, result.size);
+    }
+
+    itsBuffer += theName;
+    itsBuffer += "_bucket";
+    labels(theLabels, bound);
+    itsBuffer += ' ';
+    fmt::format_to(std::back_inserter(itsBuffer), "{}", count);
+    itsBuffer += '\n';
+  }
+
+  itsBuffer += theName;
+  itsBuffer += "_sum";
+  labels(theLabels);
+  itsBuffer += ' ';
+  value(theSum);
+  itsBuffer += '\n';
+
+  itsBuffer += theName;
+  itsBuffer += "_count";
+  labels(theLabels);
+  itsBuffer += ' ';
+  fmt::format_to(std::back_inserter(itsBuffer), "{}", count);
+  itsBuffer += '\n';
+}
+
+}  // namespace Spine
+}  // namespace SmartMet
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Spine
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Render metrics in the Prometheus text exposition format
+ *
+ * Output is appended to a buffer owned by the caller, which is expected
+ * to reserve it based on the size of the previous scrape. No temporary
+ * strings are created for the samples.
+ *
+ * Usage:
+ *
+ *   PrometheusWriter out(buffer);
+ *   out.family("smartmet_cache_hits_total", "Cache hits", "counter");
+ *   out.sample("smartmet_cache_hits_total", {{"cache", name}}, hits);
+ */
+// ----------------------------------------------------------------------
+
+class PrometheusWriter
+{
+ public:
+  using Labels = std::initializer_list<std::pair<std::string_view, std::string_view>>;
+
+  explicit PrometheusWriter(std::string& theBuffer) : itsBuffer(theBuffer) {}
+
+  // HELP and TYPE lines, type is "counter", "gauge", "histogram", "summary" or "untyped"
+  void family(std::string_view theName, std::string_view theHelp, std::string_view theType);
+
+  void sample(std::string_view theName, Labels theLabels, double theValue);
+  void sample(std::string_view theName, Labels theLabels, std::uint64_t theValue);
+  void sample(std::string_view theName, Labels theLabels, std::int64_t theValue);
+
+  // The _bucket, _sum and _count samples of a histogram. The counts are
+  // given for each bound and last for the values above all bounds, they
+  // are accumulated into the le buckets here.
+  void histogram(std::string_view theName,
+                 Labels theLabels,
+                 const std::vector<double>& theBounds,
+                 const std::vector<std::uint64_t>& theCounts,
+                 double theSum);
+
+  std::string& buffer() { return itsBuffer; }
+
+ private:
+  void labels(Labels theLabels, std::string_view theLe = {});
+  void value(double theValue);
+
+  std::string& itsBuffer;
+};
+
+}  // namespace Spine
+}  // namespace SmartMet
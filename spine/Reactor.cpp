@@ -12,8 +12,12 @@
 #include "FmiApiKey.h"
 #include "HostInfo.h"
 #include "MallocStats.h"
+#include "MemoryGovernor.h"
 #include "Names.h"
 #include "Options.h"
+#include "PrometheusWriter.h"
+#include "ProfiledMutex.h"
+#include "Profiler.h"
 #include "SmartMet.h"
 #include "SmartMetEngine.h"
 
@@ -165,7 +169,10 @@ Reactor::~Reactor()
 // ----------------------------------------------------------------------
 
 Reactor::Reactor(Options& options)
-    : ContentHandlerMap(options), itsOptions(options), itsInitTasks(new Fmi::AsyncTaskGroup)
+    : ContentHandlerMap(options),
+      itsOptions(options),
+      itsInitTasks(new Fmi::AsyncTaskGroup),
+      itsCircuitBreakers(options.circuitbreaker)
 {
   if (instance.exchange(this))
   {
@@ -282,6 +289,50 @@ Reactor::Reactor(Options& options)
         std::bind(&Reactor::requestServiceStats, this, std::placeholders::_2),
         "Request service stats");
 
+    addAdminTableRequestHandler(
+        NoTarget{},
+        "latencystats",
+        AdminRequestAccess::Private,
+        std::bind(&Reactor::requestLatencyStats, this, std::placeholders::_2),
+        "Request latency percentiles per handler and status class (window=minute|hour|day)");
+
+    addAdminTableRequestHandler(
+        NoTarget{},
+        "phasestats",
+        AdminRequestAccess::Private,
+        std::bind(&Reactor::requestPhaseStats, this, std::placeholders::_2),
+        "Request phase (queue, handler, stream and plugin defined) totals per handler");
+
+#ifdef SMARTMET_SPINE_LOCK_PROFILING
+    addAdminTableRequestHandler(
+        NoTarget{},
+        "lockstats",
+        AdminRequestAccess::Private,
+        std::bind(&Reactor::requestLockStats, this, std::placeholders::_2),
+        "Named lock acquisitions, wait times and maximum hold times, most contended first");
+#endif
+
+    addAdminTableRequestHandler(
+        NoTarget{},
+        "memorygovernor",
+        AdminRequestAccess::Private,
+        std::bind(&Reactor::requestMemoryGovernor, this, std::placeholders::_2),
+        "Memory pressure and the latest cache shrink decisions of the memory governor");
+
+    addAdminTableRequestHandler(
+        NoTarget{},
+        "backendload",
+        AdminRequestAccess::Private,
+        std::bind(&Reactor::requestBackendLoad, this, std::placeholders::_2),
+        "Get backend load statistics (in-flight requests, latency and error rate EWMA)");
+
+    addAdminTableRequestHandler(
+        NoTarget{},
+        "circuitbreakers",
+        AdminRequestAccess::Private,
+        std::bind(&Reactor::requestCircuitBreakers, this, std::placeholders::_2),
+        "Get backend circuit breaker states");
+
     addAdminTableRequestHandler(
         NoTarget{},
         "engineinfo",
@@ -311,6 +362,22 @@ Reactor::Reactor(Options& options)
         "Allocator stats (jemalloc / mimalloc). Optional `opts` query "
         "parameter is passed verbatim to jemalloc's malloc_stats_print "
         "(default \"J\" = JSON output)");
+
+    addAdminCustomRequestHandler(
+        NoTarget{},
+        "metrics",
+        AdminRequestAccess::Private,
+        std::bind(&Reactor::requestMetrics, this, std::placeholders::_2, std::placeholders::_3),
+        "Request counters, latencies, active requests and cache statistics in Prometheus text "
+        "format");
+
+    addAdminCustomRequestHandler(
+        NoTarget{},
+        "profile",
+        AdminRequestAccess::RequiresAuthentication,
+        std::bind(&Reactor::requestProfile, this, std::placeholders::_2, std::placeholders::_3),
+        "Sample the CPU usage of all threads for `seconds` (default 10) at `frequency` Hz "
+        "(default 99) and return folded stacks for flame graphs");
   }
   catch (...)
   {
@@ -372,15 +439,30 @@ void Reactor::init()
 
     setLogging(itsOptions.defaultlogging);
 
-    // Start OTel cache-statistics metrics export if configured
+    // Start OTel metrics export if configured
     if (itsOptions.otel.enabled && itsOptions.otel.metrics_interval_s > 0)
     {
-      itsOTelMetrics = std::make_unique<OTelMetricsExporter>(
-          itsOptions.otel,
-          [this]() { return getCacheStats(); });
+      OTelMetricsExporter::Callbacks callbacks;
+      callbacks.cacheStats = [this]() { return getCacheStats(); };
+      callbacks.load = [this]()
+      {
+        OTelMetricsExporter::LoadStatus status;
+        status.active_requests = itsActiveRequests.size();
+        status.active_requests_limit = itsActiveRequestsLimit;
+        status.high_load = itsHighLoadFlag;
+        return status;
+      };
+      callbacks.serviceStats = [this]() { return getServiceStats("all"); };
+      callbacks.backends = [this]() { return getBackendRequestStatus(); };
+      callbacks.memory = []() { return getMemoryStats(); };
+
+      itsOTelMetrics = std::make_unique<OTelMetricsExporter>(itsOptions.otel, std::move(callbacks));
       itsOTelMetrics->start();
     }
 
+    // Start shrinking registered caches under memory pressure
+    MemoryGovernor::instance().start(itsOptions.memorygovernor);
+
     itsInitializing = false;
 
     initDone();
@@ -638,6 +720,7 @@ void Reactor::removeActiveRequest(std::size_t theKey, HTTP::Status theStatusCode
 void Reactor::startBackendRequest(const std::string& theHost, int thePort)
 {
   itsActiveBackends.start(theHost, thePort);
+  itsBackendLoad.start(theHost, thePort);
 }
 
 // ----------------------------------------------------------------------
@@ -649,6 +732,7 @@ void Reactor::startBackendRequest(const std::string& theHost, int thePort)
 void Reactor::stopBackendRequest(const std::string& theHost, int thePort)
 {
   itsActiveBackends.stop(theHost, thePort);
+  itsBackendLoad.stop(theHost, thePort);
 }
 
 // ----------------------------------------------------------------------
@@ -660,6 +744,7 @@ void Reactor::stopBackendRequest(const std::string& theHost, int thePort)
 void Reactor::resetBackendRequest(const std::string& theHost, int thePort)
 {
   itsActiveBackends.reset(theHost, thePort);
+  itsBackendLoad.reset(theHost, thePort);
 }
 
 // ----------------------------------------------------------------------
@@ -671,6 +756,8 @@ void Reactor::resetBackendRequest(const std::string& theHost, int thePort)
 void Reactor::removeBackendRequests(const std::string& theHost, int thePort)
 {
   itsActiveBackends.remove(theHost, thePort);
+  itsBackendLoad.remove(theHost, thePort);
+  itsCircuitBreakers.remove(theHost, thePort);
 }
 
 // ----------------------------------------------------------------------
@@ -684,6 +771,85 @@ ActiveBackends::Status Reactor::getBackendRequestStatus() const
   return itsActiveBackends.status();
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Choose the less loaded of two random backends
+ *
+ * Returns the index of the chosen candidate, or nothing if there are none.
+ */
+// ----------------------------------------------------------------------
+
+std::optional<std::size_t> Reactor::pickBackend(const BackendLoadTracker::Backends& theCandidates)
+{
+  if (!itsCircuitBreakers.enabled())
+    return itsBackendLoad.pick(theCandidates);
+
+  // Drop backends whose circuit breaker refuses requests, remembering the original indexes
+
+  BackendLoadTracker::Backends available;
+  std::vector<std::size_t> indexes;
+  for (std::size_t i = 0; i < theCandidates.size(); i++)
+  {
+    const auto& backend = theCandidates[i];
+    if (itsCircuitBreakers.available(backend.first, backend.second))
+    {
+      available.push_back(backend);
+      indexes.push_back(i);
+    }
+  }
+
+  // Admit the request. The breaker may still refuse if another request took the
+  // last probe slot meanwhile, in which case we try the remaining candidates.
+
+  while (true)
+  {
+    auto choice = itsBackendLoad.pick(available);
+    if (!choice)
+      return {};
+
+    const auto& backend = available[*choice];
+    if (itsCircuitBreakers.allow(backend.first, backend.second))
+      return indexes[*choice];
+
+    const auto offset = static_cast<std::ptrdiff_t>(*choice);
+    available.erase(available.begin() + offset);
+    indexes.erase(indexes.begin() + offset);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get the load statistics of the backends
+ */
+// ----------------------------------------------------------------------
+
+BackendLoadTracker::Status Reactor::getBackendLoadStatus() const
+{
+  return itsBackendLoad.status();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether the circuit breaker of a backend lets a request through
+ */
+// ----------------------------------------------------------------------
+
+bool Reactor::isBackendAvailable(const std::string& theHost, int thePort)
+{
+  return itsCircuitBreakers.allow(theHost, thePort);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get the states of the backend circuit breakers
+ */
+// ----------------------------------------------------------------------
+
+BackendCircuitBreaker::Status Reactor::getBackendCircuitBreakerStatus() const
+{
+  return itsCircuitBreakers.status();
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief List the names of the loaded plugins
@@ -1189,6 +1355,11 @@ void Reactor::callBackendConnectionFinishedHooks(
 {
   try
   {
+    // A connection which finishes while still streaming was cut short
+    const bool error = (theStatus != HTTP::ContentStreamer::StreamerStatus::EXIT_OK);
+    itsBackendLoad.finished(theHostName, thePort, error);
+    itsCircuitBreakers.record(theHostName, thePort, error);
+
     ReadLock lock(itsHookMutex);
 
     for (auto& pair : itsBackendConnectionFinishedHooks)
@@ -1277,6 +1448,9 @@ void Reactor::shutdown_impl()
     // which matters because plugins may still log during their own shutdown.
     HostInfo::shutdown();
 
+    // Caches are about to be destroyed, no point in shrinking them
+    MemoryGovernor::instance().stop();
+
     //---------------------------------------------------------------------------------------------
     // Perform preliminary cleanup of base class ContentHandlerMap to avoid some objects
     // staying around after plugins and engines have been deleted.
@@ -1674,6 +1848,19 @@ std::string average_and_format(long total_microsecs, unsigned long requests)
     throw Fmi::Exception::Trace(BCP, "Operation failed!");
   }
 }
+
+// Average heap allocation per request in kilobytes. The counters are
+// available only with jemalloc.
+std::string average_kilobytes(std::uint64_t total_bytes, unsigned long requests)
+{
+  static const bool available = (getMallocAllocator() == "jemalloc");
+  if (!available || requests == 0)
+    return "Not available";
+
+  std::stringstream ss;
+  ss << std::setprecision(4) << total_bytes / (1024.0 * requests);
+  return ss.str();
+}
 }  // namespace
 
 std::unique_ptr<Table> Reactor::requestLastRequests(const HTTP::Request& theRequest) const
@@ -1859,11 +2046,11 @@ try
     const auto firstValidTime = Fmi::SecondClock::local_time() - Fmi::Minutes(minutes);
     for (const auto& req : std::get<1>(currentRequests))
     {
-      auto firstConsidered = std::find_if(req.second.begin(),
-                                          req.second.end(),
-                                          [&firstValidTime](const LR& cmp)
-                                          { return cmp.getRequestEndTime() > firstValidTime; });
-      for (auto it = firstConsidered; it != req.second.end(); ++it)
+      // Skip old records without rebuilding the full request objects
+      auto it = req.second.begin();
+      while (it != req.second.end() && it.getRequestEndTime() <= firstValidTime)
+        ++it;
+      for (; it != req.second.end(); ++it)
         snapshot.emplace_back(req.first, *it);
     }
   }  // currentRequests destructed; LogRange pins released.
@@ -2019,92 +2206,58 @@ std::unique_ptr<Table> Reactor::requestCacheStats(const HTTP::Request& theReques
 std::unique_ptr<Table> Reactor::requestServiceStats(const HTTP::Request& theRequest) const
 try
 {
-  // AverageCPUMs added at the end so existing JSON consumers that
-  // ignored unknown columns continue to work unchanged. The
-  // smartmet-monitor Heap / Services panel reads the new column to
-  // expose CPU-bound vs wait-bound handlers at a glance.
+  // AverageCPUMs and AverageAllocKB added at the end so existing JSON
+  // consumers that ignored unknown columns continue to work unchanged.
+  // The smartmet-monitor Heap / Services panel reads the new columns to
+  // expose CPU-bound vs wait-bound and allocation heavy handlers at a
+  // glance.
   const std::vector<std::string> headers{"Handler",
                                          "LastMinute",
                                          "LastHour",
                                          "Last24Hours",
                                          "AverageDuration",
-                                         "AverageCPUMs"};
+                                         "AverageCPUMs",
+                                         "AverageAllocKB"};
   std::unique_ptr<Table> statsTable = std::make_unique<Table>();
   statsTable->setTitle("Service statistics");
   statsTable->setNames(headers);
 
+  // The counters are pre-aggregated per handler, hence this is cheap
+  // and works whether request logging is enabled or not.
   std::string pluginName = Spine::optional_string(theRequest.getParameter("plugin"), "all");
-  auto currentRequests =
-      getLoggedRequests(pluginName);  // This is type tuple<bool,LogRange,DateTime>
-
-  auto currentTime = Fmi::MicrosecClock::local_time();
+  const auto serviceStats = getServiceStats(pluginName);
 
   std::size_t row = 0;
-  unsigned long total_minute = 0;
-  unsigned long total_hour = 0;
-  unsigned long total_day = 0;
-  long global_microsecs = 0;
-  long global_cpu_microsecs = 0;
-
-  for (const auto& reqpair : std::get<1>(currentRequests))
-  {
-    // Lets calculate how many hits we have in minute,hour and day and since start
-    unsigned long inMinute = 0;
-    unsigned long inHour = 0;
-    unsigned long inDay = 0;
-    long total_microsecs = 0;
-    long total_cpu_microsecs = 0;
-    // We go from newest to oldest
-
-    for (const auto& item : reqpair.second)
-    {
-      auto sinceDuration = currentTime - item.getRequestEndTime();
-      auto accessDuration = item.getAccessDuration();
-      auto cpuDuration = item.getCpuDuration();
+  ServiceStats::Summary total;
 
-      total_microsecs += accessDuration.total_microseconds();
-      total_cpu_microsecs += cpuDuration.total_microseconds();
-
-      global_microsecs += accessDuration.total_microseconds();
-      global_cpu_microsecs += cpuDuration.total_microseconds();
-
-      if (sinceDuration < Fmi::Hours(24))
-      {
-        ++inDay;
-        ++total_day;
-        if (sinceDuration < Fmi::Hours(1))
-        {
-          ++inHour;
-          ++total_hour;
-          if (sinceDuration < Fmi::Minutes(1))
-          {
-            ++inMinute;
-            ++total_minute;
-          }
-        }
-      }
-    }
+  for (const auto& item : serviceStats)
+  {
+    const auto& stats = item.second;
+    total += stats;
 
     std::size_t column = 0;
 
-    statsTable->set(column, row, reqpair.first);
+    statsTable->set(column, row, item.first);
     ++column;
 
-    statsTable->set(column, row, Fmi::to_string(inMinute));
+    statsTable->set(column, row, Fmi::to_string(stats.last_minute));
     ++column;
 
-    statsTable->set(column, row, Fmi::to_string(inHour));
+    statsTable->set(column, row, Fmi::to_string(stats.last_hour));
     ++column;
 
-    statsTable->set(column, row, Fmi::to_string(inDay));
+    statsTable->set(column, row, Fmi::to_string(stats.last_day));
     ++column;
 
-    std::string msecs = average_and_format(total_microsecs, inDay);
+    std::string msecs = average_and_format(stats.day_microseconds, stats.last_day);
     statsTable->set(column, row, msecs);
     ++column;
 
-    std::string cpu_msecs = average_and_format(total_cpu_microsecs, inDay);
+    std::string cpu_msecs = average_and_format(stats.day_cpu_microseconds, stats.last_day);
     statsTable->set(column, row, cpu_msecs);
+    ++column;
+
+    statsTable->set(column, row, average_kilobytes(stats.day_allocated_bytes, stats.last_day));
 
     ++row;
   }
@@ -2115,21 +2268,58 @@ try
   statsTable->set(column, row, "Total requests");
   ++column;
 
-  statsTable->set(column, row, Fmi::to_string(total_minute));
+  statsTable->set(column, row, Fmi::to_string(total.last_minute));
   ++column;
 
-  statsTable->set(column, row, Fmi::to_string(total_hour));
+  statsTable->set(column, row, Fmi::to_string(total.last_hour));
   ++column;
 
-  statsTable->set(column, row, Fmi::to_string(total_day));
+  statsTable->set(column, row, Fmi::to_string(total.last_day));
   ++column;
 
-  std::string msecs = average_and_format(global_microsecs, total_day);
+  std::string msecs = average_and_format(total.day_microseconds, total.last_day);
   statsTable->set(column, row, msecs);
   ++column;
 
-  std::string cpu_msecs = average_and_format(global_cpu_microsecs, total_day);
+  std::string cpu_msecs = average_and_format(total.day_cpu_microseconds, total.last_day);
   statsTable->set(column, row, cpu_msecs);
+  ++column;
+
+  statsTable->set(column, row, average_kilobytes(total.day_allocated_bytes, total.last_day));
+
+  return statsTable;
+}
+catch (...)
+{
+  throw Fmi::Exception::Trace(BCP, "Operation failed!");
+}
+
+std::unique_ptr<Table> Reactor::requestPhaseStats(const HTTP::Request& theRequest) const
+try
+{
+  const std::vector<std::string> headers{"Handler", "Phase", "Requests", "TotalMs", "AverageMs"};
+  std::unique_ptr<Table> statsTable = std::make_unique<Table>();
+  statsTable->setTitle("Request phases");
+  statsTable->setNames(headers);
+
+  std::string pluginName = Spine::optional_string(theRequest.getParameter("plugin"), "all");
+  const auto phaseStats = getPhaseStats(pluginName);
+
+  std::size_t row = 0;
+  for (const auto& handler : phaseStats)
+  {
+    for (const auto& phase : handler.second)
+    {
+      std::size_t column = 0;
+      statsTable->set(column++, row, handler.first);
+      statsTable->set(column++, row, phase.first);
+      statsTable->set(column++, row, Fmi::to_string(phase.second.count));
+      statsTable->set(column++, row, Fmi::to_string("%.1f", phase.second.microseconds / 1000.0));
+      statsTable->set(
+          column++, row, average_and_format(phase.second.microseconds, phase.second.count));
+      ++row;
+    }
+  }
 
   return statsTable;
 }
@@ -2138,6 +2328,262 @@ catch (...)
   throw Fmi::Exception::Trace(BCP, "Operation failed!");
 }
 
+std::unique_ptr<Table> Reactor::requestLockStats(const HTTP::Request& /* theRequest */) const
+try
+{
+  const std::vector<std::string> headers{"Lock",
+                                         "Instances",
+                                         "Exclusive",
+                                         "Shared",
+                                         "Contended",
+                                         "Contention%",
+                                         "TotalWaitMs",
+                                         "WaitP50Us",
+                                         "WaitP99Us",
+                                         "MaxWaitUs",
+                                         "MaxHoldUs"};
+  std::unique_ptr<Table> statsTable = std::make_unique<Table>();
+  statsTable->setTitle("Lock contention");
+  statsTable->setNames(headers);
+
+  std::size_t row = 0;
+  for (const auto& stats : LockStats::summaries())
+  {
+    const auto acquisitions = stats.exclusive + stats.shared;
+    std::size_t column = 0;
+    statsTable->set(column++, row, stats.name);
+    statsTable->set(column++, row, Fmi::to_string(stats.instances));
+    statsTable->set(column++, row, Fmi::to_string(stats.exclusive));
+    statsTable->set(column++, row, Fmi::to_string(stats.shared));
+    statsTable->set(column++, row, Fmi::to_string(stats.contended));
+    statsTable->set(
+        column++,
+        row,
+        Fmi::to_string("%.2f", acquisitions > 0 ? 100.0 * stats.contended / acquisitions : 0.0));
+    statsTable->set(column++, row, Fmi::to_string("%.3f", stats.total_wait_ns / 1e6));
+    statsTable->set(column++, row, Fmi::to_string("%.3f", stats.wait_p50_ns / 1e3));
+    statsTable->set(column++, row, Fmi::to_string("%.3f", stats.wait_p99_ns / 1e3));
+    statsTable->set(column++, row, Fmi::to_string("%.3f", stats.max_wait_ns / 1e3));
+    statsTable->set(column++, row, Fmi::to_string("%.3f", stats.max_hold_ns / 1e3));
+    ++row;
+  }
+
+  return statsTable;
+}
+catch (...)
+{
+  throw Fmi::Exception::Trace(BCP, "Operation failed!");
+}
+
+std::unique_ptr<Table> Reactor::requestMemoryGovernor(const HTTP::Request& /* theRequest */) const
+try
+{
+  auto& governor = MemoryGovernor::instance();
+  const auto pressure = governor.measure();
+
+  const std::vector<std::string> headers{
+      "Time", "Reason", "Cache", "SizeMB", "HitRate%", "RequestedMB", "ReleasedMB"};
+  std::unique_ptr<Table> statsTable = std::make_unique<Table>();
+  statsTable->setTitle(
+      fmt::format("Memory governor {}: RSS {} MB, limit {} MB, PSI some {:.2f}% full {:.2f}%",
+                  governor.options().enabled ? "enabled" : "disabled",
+                  pressure.rss / 1024 / 1024,
+                  pressure.limit / 1024 / 1024,
+                  pressure.psi_some,
+                  pressure.psi_full));
+  statsTable->setNames(headers);
+
+  std::size_t row = 0;
+  for (const auto& decision : governor.history())
+  {
+    std::size_t column = 0;
+    statsTable->set(column++, row, Fmi::to_iso_extended_string(decision.time));
+    statsTable->set(column++, row, decision.reason);
+    statsTable->set(column++, row, decision.cache);
+    statsTable->set(column++, row, Fmi::to_string("%.1f", decision.bytes / 1048576.0));
+    statsTable->set(column++, row, Fmi::to_string("%.1f", 100 * decision.hit_rate));
+    statsTable->set(column++, row, Fmi::to_string("%.1f", decision.requested / 1048576.0));
+    statsTable->set(column++, row, Fmi::to_string("%.1f", decision.released / 1048576.0));
+    ++row;
+  }
+
+  return statsTable;
+}
+catch (...)
+{
+  throw Fmi::Exception::Trace(BCP, "Operation failed!");
+}
+
+std::unique_ptr<Table> Reactor::requestLatencyStats(const HTTP::Request& theRequest) const
+try
+{
+  const std::string windowName = Spine::optional_string(theRequest.getParameter("window"), "hour");
+
+  LatencyStats::Window window;
+  if (windowName == "minute")
+    window = LatencyStats::Window::Minute;
+  else if (windowName == "hour")
+    window = LatencyStats::Window::Hour;
+  else if (windowName == "day")
+    window = LatencyStats::Window::Day;
+  else
+    throw Fmi::Exception(BCP, "Unknown latency window, expected minute, hour or day")
+        .addParameter("window", windowName);
+
+  const std::vector<std::string> headers{"Handler",
+                                         "Status",
+                                         "Requests",
+                                         "P50",
+                                         "P95",
+                                         "P99",
+                                         "Max",
+                                         "CpuP50",
+                                         "CpuP95",
+                                         "CpuP99",
+                                         "CpuMax"};
+  std::unique_ptr<Table> statsTable = std::make_unique<Table>();
+  statsTable->setTitle("Latency percentiles (ms) for the last " + windowName);
+  statsTable->setNames(headers);
+
+  std::string pluginName = Spine::optional_string(theRequest.getParameter("plugin"), "all");
+  const auto latencyStats = getLatencyStats(pluginName, window);
+
+  std::size_t row = 0;
+  auto add_row =
+      [&statsTable, &row](const std::string& handler,
+                          const std::string& status,
+                          const LatencyStats::Snapshot& snapshot)
+  {
+    const auto ms = [](std::chrono::microseconds us)
+    { return Fmi::to_string("%.3f", us.count() / 1000.0); };
+
+    std::size_t column = 0;
+    statsTable->set(column++, row, handler);
+    statsTable->set(column++, row, status);
+    statsTable->set(column++, row, Fmi::to_string(snapshot.wall.count()));
+    statsTable->set(column++, row, ms(snapshot.wall.percentile(0.50)));
+    statsTable->set(column++, row, ms(snapshot.wall.percentile(0.95)));
+    statsTable->set(column++, row, ms(snapshot.wall.percentile(0.99)));
+    statsTable->set(column++, row, ms(snapshot.wall.max()));
+    statsTable->set(column++, row, ms(snapshot.cpu.percentile(0.50)));
+    statsTable->set(column++, row, ms(snapshot.cpu.percentile(0.95)));
+    statsTable->set(column++, row, ms(snapshot.cpu.percentile(0.99)));
+    statsTable->set(column++, row, ms(snapshot.cpu.max()));
+    ++row;
+  };
+
+  // All status classes of a handler first, then each class separately
+  for (const auto& item : latencyStats)
+  {
+    LatencyStats::Snapshot all;
+    for (const auto& status : item.second)
+      all += status.second;
+    if (all.wall.count() == 0)
+      continue;
+
+    add_row(item.first, "all", all);
+    for (const auto& status : item.second)
+      if (status.second.wall.count() > 0)
+        add_row(item.first, status.first, status.second);
+  }
+
+  return statsTable;
+}
+catch (...)
+{
+  throw Fmi::Exception::Trace(BCP, "Operation failed!");
+}
+
+
+std::unique_ptr<Table> Reactor::requestBackendLoad(const HTTP::Request& /* theRequest */) const
+try
+{
+  const std::vector<std::string> headers{
+      "Host", "Port", "InFlight", "LatencyMs", "ErrorRate", "Requests", "Errors", "Score"};
+  std::unique_ptr<Table> table = std::make_unique<Table>();
+  table->setTitle("Backend load");
+  table->setNames(headers);
+
+  std::size_t row = 0;
+  for (const auto& load : itsBackendLoad.status())
+  {
+    std::size_t column = 0;
+    table->set(column++, row, load.host);
+    table->set(column++, row, Fmi::to_string(load.port));
+    table->set(column++, row, Fmi::to_string(load.inflight));
+    table->set(column++, row, Fmi::to_string("%.1f", load.latency_ms));
+    table->set(column++, row, Fmi::to_string("%.3f", load.error_rate));
+    table->set(column++, row, Fmi::to_string(load.requests));
+    table->set(column++, row, Fmi::to_string(load.errors));
+    table->set(column++, row, Fmi::to_string("%.1f", load.score));
+    ++row;
+  }
+
+  return table;
+}
+catch (...)
+{
+  throw Fmi::Exception::Trace(BCP, "Operation failed!");
+}
+
+
+std::unique_ptr<Table> Reactor::requestCircuitBreakers(const HTTP::Request& /* theRequest */) const
+try
+{
+  const std::vector<std::string> headers{"Host",
+                                         "Port",
+                                         "State",
+                                         "Seconds",
+                                         "InFlight",
+                                         "Admitted",
+                                         "ConsecutiveFailures",
+                                         "Probes",
+                                         "ProbeSuccesses",
+                                         "Failures",
+                                         "Trips"};
+  std::unique_ptr<Table> table = std::make_unique<Table>();
+  table->setTitle(std::string("Backend circuit breakers") +
+                  (itsCircuitBreakers.enabled() ? "" : " (disabled)"));
+  table->setNames(headers);
+
+  const auto inflight = itsActiveBackends.status();
+
+  std::size_t row = 0;
+  for (const auto& info : itsCircuitBreakers.status())
+  {
+    int active = 0;
+    auto host = inflight.find(info.host);
+    if (host != inflight.end())
+    {
+      auto port = host->second.find(info.port);
+      if (port != host->second.end())
+        active = port->second;
+    }
+
+    const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(info.age).count();
+
+    std::size_t column = 0;
+    table->set(column++, row, info.host);
+    table->set(column++, row, Fmi::to_string(info.port));
+    table->set(column++, row, BackendCircuitBreaker::stateName(info.state));
+    table->set(column++, row, Fmi::to_string(seconds));
+    table->set(column++, row, Fmi::to_string(active));
+    table->set(column++, row, Fmi::to_string(info.admitted));
+    table->set(column++, row, Fmi::to_string(info.consecutive_failures));
+    table->set(column++, row, Fmi::to_string(info.probes));
+    table->set(column++, row, Fmi::to_string(info.probe_successes));
+    table->set(column++, row, Fmi::to_string(info.failures));
+    table->set(column++, row, Fmi::to_string(info.trips));
+    ++row;
+  }
+
+  return table;
+}
+catch (...)
+{
+  throw Fmi::Exception::Trace(BCP, "Operation failed!");
+}
+
 
 std::unique_ptr<Table> Reactor::requestEngineInfo(const HTTP::Request& theRequest) const
 try
@@ -2277,6 +2723,157 @@ catch (...)
   throw Fmi::Exception::Trace(BCP, "Operation failed!");
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Profile the server for the requested number of seconds
+ *
+ * The response can be passed directly to flamegraph.pl.
+ */
+// ----------------------------------------------------------------------
+
+void Reactor::requestProfile(const HTTP::Request& theRequest, HTTP::Response& theResponse) const
+try
+{
+  const auto seconds = Spine::optional_unsigned_long(theRequest.getParameter("seconds"), 10);
+  const auto frequency = Spine::optional_unsigned_long(theRequest.getParameter("frequency"), 99);
+
+  if (seconds == 0 || seconds > static_cast<unsigned long>(Profiler::max_duration.count()))
+    throw Fmi::Exception(BCP, "Invalid seconds parameter")
+        .addParameter("max", Fmi::to_string(Profiler::max_duration.count()));
+  if (frequency == 0 || frequency > Profiler::max_frequency)
+    throw Fmi::Exception(BCP, "Invalid frequency parameter")
+        .addParameter("max", Fmi::to_string(Profiler::max_frequency));
+
+  auto result = Profiler::profile(std::chrono::seconds(seconds), frequency);
+
+  theResponse.setHeader("Content-Type", "text/plain; charset=utf-8");
+  theResponse.setHeader("X-Profile-Samples", Fmi::to_string(result.samples));
+  theResponse.setHeader("X-Profile-Dropped", Fmi::to_string(result.dropped));
+  theResponse.setContent(std::make_shared<std::string>(std::move(result.folded)));
+  theResponse.setStatus(HTTP::Status::ok);
+}
+catch (...)
+{
+  throw Fmi::Exception::Trace(BCP, "Operation failed!");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Render spine metrics in Prometheus text format
+ *
+ * The response buffer is reserved based on the size of the previous
+ * scrape and handed to the response without copying, hence frequent
+ * scraping allocates only once per request.
+ */
+// ----------------------------------------------------------------------
+
+void Reactor::requestMetrics(const HTTP::Request& /* theRequest */,
+                             HTTP::Response& theResponse) const
+try
+{
+  auto buffer = std::make_shared<std::string>();
+  const std::size_t hint = itsMetricsSizeHint;
+  buffer->reserve(hint + hint / 4);
+
+  PrometheusWriter out(*buffer);
+
+  // Request counters since server start
+
+  const auto serviceStats = getServiceStats("all");
+
+  out.family("smartmet_requests_total", "Requests handled since server start", "counter");
+  for (const auto& item : serviceStats)
+    out.sample("smartmet_requests_total", {{"handler", item.first}}, item.second.total);
+
+  // Latency histograms since server start. Their _sum and _count give
+  // the total time and requests per status class.
+
+  const auto latencyCumulatives = getLatencyCumulatives("all");
+
+  std::vector<double> bounds;
+  for (auto bound : LatencyHistogram::cumulative_bounds)
+    bounds.push_back(bound / 1e6);
+  std::vector<std::uint64_t> counts;
+
+  const auto write_histograms = [&](const char* name, const char* help, bool cpu)
+  {
+    out.family(name, help, "histogram");
+    for (const auto& item : latencyCumulatives)
+      for (const auto& status : item.second)
+      {
+        const auto& cumulative = (cpu ? status.second.cpu : status.second.wall);
+        counts.assign(cumulative.counts.begin(), cumulative.counts.end());
+        out.histogram(name,
+                      {{"handler", item.first}, {"status_class", status.first}},
+                      bounds,
+                      counts,
+                      cumulative.sum.count() / 1e6);
+      }
+  };
+
+  write_histograms("smartmet_request_duration_seconds",
+                   "Request wall clock time since server start",
+                   false);
+  write_histograms("smartmet_request_cpu_seconds",
+                   "Request handler thread CPU time since server start",
+                   true);
+
+  // Active requests and throttling
+
+  out.family("smartmet_active_requests", "Requests currently being handled", "gauge");
+  out.sample("smartmet_active_requests", {}, std::uint64_t(itsActiveRequests.size()));
+
+  out.family("smartmet_active_requests_limit",
+             "Current limit for active requests before the load is considered high",
+             "gauge");
+  out.sample("smartmet_active_requests_limit", {}, std::uint64_t(itsActiveRequestsLimit));
+
+  out.family("smartmet_high_load", "1 if the server is currently refusing requests", "gauge");
+  out.sample("smartmet_high_load", {}, std::uint64_t(itsHighLoadFlag ? 1 : 0));
+
+  // Engine, plugin and spine internal caches
+
+  const auto cacheStats = getCacheStats();
+
+  const auto write_cache = [&](const char* name, const char* help, const char* type, auto field)
+  {
+    out.family(name, help, type);
+    for (const auto& item : cacheStats)
+      out.sample(name, {{"cache", item.first}}, std::uint64_t(field(item.second)));
+  };
+
+  write_cache("smartmet_cache_size",
+              "Current number of cache entries",
+              "gauge",
+              [](const auto& stat) { return stat.size; });
+  write_cache("smartmet_cache_max_size",
+              "Configured cache capacity",
+              "gauge",
+              [](const auto& stat) { return stat.maxsize; });
+  write_cache("smartmet_cache_hits_total",
+              "Cache hits since start",
+              "counter",
+              [](const auto& stat) { return stat.hits; });
+  write_cache("smartmet_cache_misses_total",
+              "Cache misses since start",
+              "counter",
+              [](const auto& stat) { return stat.misses; });
+  write_cache("smartmet_cache_inserts_total",
+              "Cache inserts since start",
+              "counter",
+              [](const auto& stat) { return stat.inserts; });
+
+  itsMetricsSizeHint = buffer->size();
+
+  theResponse.setHeader("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+  theResponse.setContent(buffer);
+  theResponse.setStatus(HTTP::Status::ok);
+}
+catch (...)
+{
+  throw Fmi::Exception::Trace(BCP, "Operation failed!");
+}
+
 namespace
 {
 // This is a static variable to hold the original terminate handler
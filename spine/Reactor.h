@@ -14,6 +14,8 @@
 
 #include "ActiveBackends.h"
 #include "ActiveRequests.h"
+#include "BackendCircuitBreaker.h"
+#include "BackendLoadTracker.h"
 #include "ConfigBase.h"
 #include "HTTP.h"
 #include "HandlerView.h"
@@ -91,6 +93,20 @@ class Reactor final : public ContentHandlerMap
   void removeBackendRequests(const std::string& theHost, int thePort);
   ActiveBackends::Status getBackendRequestStatus() const;
 
+  // Backend load tracking for least-loaded routing. The tracker is fed from the
+  // backend request counters above and from callBackendConnectionFinishedHooks.
+  // The hooks pass no latency, so the time since the oldest unfinished
+  // startBackendRequest of that backend is used instead.
+  // Backends whose circuit breaker is open are never picked.
+  std::optional<std::size_t> pickBackend(const BackendLoadTracker::Backends& theCandidates);
+  BackendLoadTracker::Status getBackendLoadStatus() const;
+
+  // Backend circuit breakers. isBackendAvailable and pickBackend admit the request,
+  // reserving a probe slot when the breaker is half-open. Only admitted requests are
+  // counted when they finish, so one of them must be called before each request.
+  bool isBackendAvailable(const std::string& theHost, int thePort);
+  BackendCircuitBreaker::Status getBackendCircuitBreakerStatus() const;
+
   // Only construct with options
   explicit Reactor(Options& options);
 
@@ -225,6 +241,17 @@ class Reactor final : public ContentHandlerMap
 
   std::unique_ptr<Table> requestServiceStats(const HTTP::Request& theRequest) const;
 
+  std::unique_ptr<Table> requestLatencyStats(const HTTP::Request& theRequest) const;
+
+  std::unique_ptr<Table> requestPhaseStats(const HTTP::Request& theRequest) const;
+
+  std::unique_ptr<Table> requestLockStats(const HTTP::Request& theRequest) const;
+  std::unique_ptr<Table> requestMemoryGovernor(const HTTP::Request& theRequest) const;
+
+  std::unique_ptr<Table> requestBackendLoad(const HTTP::Request& theRequest) const;
+
+  std::unique_ptr<Table> requestCircuitBreakers(const HTTP::Request& theRequest) const;
+
   std::unique_ptr<Table> requestEngineInfo(const HTTP::Request& theRequest) const;
 
   std::unique_ptr<Table> requestPluginInfo(const HTTP::Request& theRequest) const;
@@ -236,6 +263,10 @@ class Reactor final : public ContentHandlerMap
   // panel parses it. See MallocStats.h for the option-string syntax.
   std::string requestMallocStats(const HTTP::Request& theRequest) const;
 
+  void requestMetrics(const HTTP::Request& theRequest, HTTP::Response& theResponse) const;
+
+  void requestProfile(const HTTP::Request& theRequest, HTTP::Response& theResponse) const;
+
   /**
    * @brief Install handler for cases when std::terminate is called
    *
@@ -291,7 +322,7 @@ class Reactor final : public ContentHandlerMap
 
   std::map<std::string, ClientConnectionFinishedHook> itsClientConnectionFinishedHooks;
 
-  mutable MutexType itsHookMutex;
+  mutable NamedMutexType itsHookMutex{"Reactor::hooks"};
   mutable boost::mutex itsInitMutex;
 
   using PluginList = std::list<std::shared_ptr<DynamicPlugin> >;
@@ -324,6 +355,10 @@ class Reactor final : public ContentHandlerMap
 
   ActiveBackends itsActiveBackends;
 
+  BackendLoadTracker itsBackendLoad;
+
+  BackendCircuitBreaker itsCircuitBreakers;
+
   std::size_t itsEngineCount = 0;
   std::size_t itsPluginCount = 0;
 
@@ -339,6 +374,9 @@ class Reactor final : public ContentHandlerMap
   // OTel cache-statistics periodic metrics export (null when disabled)
   std::unique_ptr<OTelMetricsExporter> itsOTelMetrics;
 
+  // Size of the previous ?what=metrics response, used to preallocate the next one
+  mutable std::atomic<std::size_t> itsMetricsSizeHint{65536};
+
   /* [[noreturn]] */ void cleanLog();
 
   std::function<void()> shutdownTimedOutCallback;
@@ -0,0 +1,63 @@
+#include "RequestArena.h"
+#include <vector>
+
+namespace SmartMet
+{
+namespace Spine
+{
+namespace
+{
+std::vector<std::unique_ptr<std::byte[]>>& block_pool()
+{
+  thread_local std::vector<std::unique_ptr<std::byte[]>> pool;
+  return pool;
+}
+
+std::unique_ptr<std::byte[]> acquire_block()
+{
+  auto& pool = block_pool();
+  if (pool.empty())
+    return std::unique_ptr<std::byte[]>(new std::byte[RequestArena::block_size]);
+  auto block = std::move(pool.back());
+  pool.pop_back();
+  return block;
+}
+
+}  // namespace
+
+RequestArena::RequestArena(std::pmr::memory_resource* theUpstream)
+    : itsBlock(acquire_block()), itsResource(itsBlock.get(), block_size, theUpstream)
+{
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Release the memory and return the initial block to the pool
+ *
+ * The pool belongs to the destroying thread, which need not be the
+ * one which created the arena.
+ */
+// ----------------------------------------------------------------------
+
+RequestArena::~RequestArena()
+{
+  try
+  {
+    itsResource.release();
+    auto& pool = block_pool();
+    if (pool.size() < max_pooled_blocks)
+      pool.push_back(std::move(itsBlock));
+  }
+  catch (...)
+  {
+    // The block is simply freed
+  }
+}
+
+std::size_t RequestArena::pooledBlocks()
+{
+  return block_pool().size();
+}
+
+}  // namespace Spine
+}  // namespace SmartMet
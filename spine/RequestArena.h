@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+namespace SmartMet
+{
+namespace Spine
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Monotonic memory resource for allocations living as long as a request
+ *
+ * Allocations are pointer bumps into an initial block, deallocation is
+ * a no-op and all memory is released at once when the arena is
+ * destroyed. Should the initial block run out, further blocks are
+ * requested from the upstream resource.
+ *
+ * The initial blocks are recycled through a small per-thread pool, so
+ * that a server thread handling request after request does not
+ * allocate them again.
+ *
+ * The arena is not thread safe.
+ */
+// ----------------------------------------------------------------------
+
+class RequestArena
+{
+ public:
+  static constexpr std::size_t block_size = 64 * 1024;
+  static constexpr std::size_t max_pooled_blocks = 4;
+
+  explicit RequestArena(
+      std::pmr::memory_resource* theUpstream = std::pmr::get_default_resource());
+  ~RequestArena();
+
+  RequestArena(const RequestArena&) = delete;
+  RequestArena& operator=(const RequestArena&) = delete;
+
+  std::pmr::memory_resource* resource() noexcept { return &itsResource; }
+
+  // Number of initial blocks pooled by the calling thread
+  static std::size_t pooledBlocks();
+
+ private:
+  std::unique_ptr<std::byte[]> itsBlock;
+  std::pmr::monotonic_buffer_resource itsResource;
+};
+
+}  // namespace Spine
+}  // namespace SmartMet
@@ -0,0 +1,368 @@
+#include "RequestLog.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstring>
+#include <limits>
+
+namespace SmartMet
+{
+namespace Spine
+{
+namespace
+{
+// Fmi::Microseconds takes an int, split to avoid overflows
+Fmi::TimeDuration to_duration(std::int64_t theMicroseconds)
+{
+  return Fmi::Seconds(static_cast<int>(theMicroseconds / 1000000)) +
+         Fmi::Microseconds(static_cast<int>(theMicroseconds % 1000000));
+}
+
+// Maximum number of distinct interned strings
+constexpr std::size_t max_interned = 1024;
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Fixed size record for one request
+ *
+ * Must stay trivially constructible so that allocating the ring does
+ * not touch the memory until records are actually written.
+ */
+// ----------------------------------------------------------------------
+
+struct RequestLog::Record
+{
+  std::int64_t end_time;         // microseconds since itsEpoch
+  std::int64_t access_duration;  // microseconds
+  std::int64_t cpu_duration;     // microseconds
+  std::uint64_t content_length;
+  std::uint64_t text_offset;  // arena offset of URI, ETag, API key and a textual IP
+  std::uint32_t uri_length;
+  std::uint16_t etag_length;
+  std::uint16_t apikey_length;
+  std::uint8_t ip[16];
+  std::uint8_t ip_family;  // AF_INET, AF_INET6 or zero for an IP in the arena
+  std::uint8_t ip_length;  // length of an IP in the arena
+  std::uint16_t method;
+  std::uint16_t version;
+  std::uint16_t status;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Interned strings
+ *
+ * The slots never move, hence readers may access strings which have
+ * been published before the record referring to them without locking.
+ * Index zero is the empty string, which is also used if the pool is full.
+ */
+// ----------------------------------------------------------------------
+
+class RequestLog::StringPool
+{
+ public:
+  StringPool() : itsStrings(new std::string[max_interned]) { itsIndexes.emplace("", 0); }
+
+  std::uint16_t intern(const std::string& theString)
+  {
+    auto pos = itsIndexes.find(theString);
+    if (pos != itsIndexes.end())
+      return pos->second;
+
+    if (itsSize >= max_interned)
+      return 0;
+
+    const auto index = static_cast<std::uint16_t>(itsSize++);
+    itsStrings[index] = theString;
+    itsIndexes.emplace(theString, index);
+    return index;
+  }
+
+  const std::string& get(std::uint16_t theIndex) const { return itsStrings[theIndex]; }
+
+  std::size_t size() const { return itsSize; }
+
+  std::size_t bytes() const
+  {
+    std::size_t ret = max_interned * sizeof(std::string);
+    for (std::size_t i = 0; i < itsSize; i++)
+      ret += 2 * itsStrings[i].capacity();  // once in the slot, once in the index
+    return ret;
+  }
+
+ private:
+  std::unique_ptr<std::string[]> itsStrings;
+  std::size_t itsSize = 1;
+  std::unordered_map<std::string, std::uint16_t> itsIndexes;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Construct an empty log, the rings are allocated on first use
+ */
+// ----------------------------------------------------------------------
+
+RequestLog::RequestLog(std::size_t theCapacity, std::size_t theTextCapacity)
+    : itsCapacity(std::max<std::size_t>(theCapacity, 1)),
+      itsTextCapacity(std::max<std::size_t>(theTextCapacity, 4096)),
+      itsStrings(std::make_unique<StringPool>()),
+      itsEpoch(Fmi::MicrosecClock::local_time())
+{
+}
+
+RequestLog::~RequestLog() = default;
+
+const RequestLog::Record& RequestLog::record(Position thePos) const
+{
+  return itsRecords[thePos % itsCapacity];
+}
+
+std::string RequestLog::text(std::uint64_t theOffset, std::size_t theLength) const
+{
+  // Strings never wrap around the end of the arena
+  return {itsText.get() + theOffset % itsTextCapacity, theLength};
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remove the oldest record
+ */
+// ----------------------------------------------------------------------
+
+void RequestLog::evict()
+{
+  ++itsTail;
+  ++itsOverwritten;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append a request
+ */
+// ----------------------------------------------------------------------
+
+bool RequestLog::append(const std::string& theURI,
+                        const Fmi::DateTime& theEndTime,
+                        const Fmi::TimeDuration& theAccessDuration,
+                        const Fmi::TimeDuration& theCpuDuration,
+                        const std::string& theStatus,
+                        const std::string& theIP,
+                        const std::string& theMethod,
+                        const std::string& theVersion,
+                        std::size_t theContentLength,
+                        const std::string& theETag,
+                        const std::string& theApiKey,
+                        bool theEvictionAllowed)
+{
+  try
+  {
+    // Binary IP if it can be formatted back to the same string
+    std::uint8_t ip[16] = {0};
+    std::uint8_t ip_family = 0;
+    const int family = (theIP.find(':') == std::string::npos ? AF_INET : AF_INET6);
+    if (inet_pton(family, theIP.c_str(), ip) == 1)
+    {
+      char buffer[INET6_ADDRSTRLEN];
+      if (inet_ntop(family, ip, buffer, sizeof(buffer)) != nullptr && theIP == buffer)
+        ip_family = static_cast<std::uint8_t>(family);
+    }
+
+    // Truncate abnormally long strings so that a single request cannot flush the arena.
+    // The fractions sum to less than one, so the record always fits in the arena.
+    const std::size_t field_capacity = itsTextCapacity / 16;
+    const std::size_t uri_length = std::min(theURI.size(), itsTextCapacity / 8);
+    const std::size_t etag_length = std::min<std::size_t>(
+        {theETag.size(), field_capacity, std::numeric_limits<std::uint16_t>::max()});
+    const std::size_t apikey_length = std::min<std::size_t>(
+        {theApiKey.size(), field_capacity, std::numeric_limits<std::uint16_t>::max()});
+    const std::size_t ip_length =
+        (ip_family != 0 ? 0
+                        : std::min<std::size_t>({theIP.size(),
+                                                 field_capacity,
+                                                 std::numeric_limits<std::uint8_t>::max()}));
+    const std::size_t length = uri_length + etag_length + apikey_length + ip_length;
+
+    // Handlers which never log anything do not reserve any memory
+    if (!itsRecords)
+    {
+      itsRecords.reset(new Record[itsCapacity]);
+      itsText.reset(new char[itsTextCapacity]);
+    }
+
+    // Strings must not wrap around the end of the arena
+    std::uint64_t offset = itsTextHead;
+    const auto phys = offset % itsTextCapacity;
+    if (phys + length > itsTextCapacity)
+      offset += itsTextCapacity - phys;
+
+    // Make room for the new record
+    while (!empty() && (size() >= itsCapacity ||
+                        offset + length - record(itsTail).text_offset > itsTextCapacity))
+    {
+      if (!theEvictionAllowed)
+      {
+        ++itsDropped;
+        return false;
+      }
+      evict();
+    }
+
+    auto& rec = itsRecords[itsHead % itsCapacity];
+    rec.end_time = (theEndTime - itsEpoch).total_microseconds();
+    rec.access_duration = theAccessDuration.total_microseconds();
+    rec.cpu_duration = theCpuDuration.total_microseconds();
+    rec.content_length = theContentLength;
+    rec.text_offset = offset;
+    rec.uri_length = static_cast<std::uint32_t>(uri_length);
+    rec.etag_length = static_cast<std::uint16_t>(etag_length);
+    rec.apikey_length = static_cast<std::uint16_t>(apikey_length);
+    std::memcpy(rec.ip, ip, sizeof(ip));
+    rec.ip_family = ip_family;
+    rec.ip_length = static_cast<std::uint8_t>(ip_length);
+    rec.method = itsStrings->intern(theMethod);
+    rec.version = itsStrings->intern(theVersion);
+    rec.status = itsStrings->intern(theStatus);
+
+    char* ptr = itsText.get() + offset % itsTextCapacity;
+    std::memcpy(ptr, theURI.data(), uri_length);
+    ptr += uri_length;
+    std::memcpy(ptr, theETag.data(), etag_length);
+    ptr += etag_length;
+    std::memcpy(ptr, theApiKey.data(), apikey_length);
+    ptr += apikey_length;
+    std::memcpy(ptr, theIP.data(), ip_length);
+
+    itsTextHead = offset + length;
+    ++itsHead;
+    return true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+bool RequestLog::append(const LoggedRequest& theRequest, bool theEvictionAllowed)
+{
+  return append(theRequest.getRequestString(),
+                theRequest.getRequestEndTime(),
+                theRequest.getAccessDuration(),
+                theRequest.getCpuDuration(),
+                theRequest.getStatus(),
+                theRequest.getIP(),
+                theRequest.getMethod(),
+                theRequest.getVersion(),
+                theRequest.getContentLength(),
+                theRequest.getETag(),
+                theRequest.getApiKey(),
+                theEvictionAllowed);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Rebuild a request from its record
+ */
+// ----------------------------------------------------------------------
+
+LoggedRequest RequestLog::get(Position thePos) const
+{
+  try
+  {
+    const auto& rec = record(thePos);
+
+    auto offset = rec.text_offset;
+    std::string uri = text(offset, rec.uri_length);
+    offset += rec.uri_length;
+    std::string etag = text(offset, rec.etag_length);
+    offset += rec.etag_length;
+    std::string apikey = text(offset, rec.apikey_length);
+    offset += rec.apikey_length;
+
+    std::string ip;
+    if (rec.ip_family == 0)
+      ip = text(offset, rec.ip_length);
+    else
+    {
+      char buffer[INET6_ADDRSTRLEN];
+      if (inet_ntop(rec.ip_family, rec.ip, buffer, sizeof(buffer)) != nullptr)
+        ip = buffer;
+    }
+
+    return {std::move(uri),
+            itsEpoch + to_duration(rec.end_time),
+            to_duration(rec.access_duration),
+            to_duration(rec.cpu_duration),
+            itsStrings->get(rec.status),
+            std::move(ip),
+            itsStrings->get(rec.method),
+            itsStrings->get(rec.version),
+            rec.content_length,
+            std::move(etag),
+            std::move(apikey)};
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+Fmi::DateTime RequestLog::getRequestEndTime(Position thePos) const
+{
+  return itsEpoch + to_duration(record(thePos).end_time);
+}
+
+Fmi::TimeDuration RequestLog::getAccessDuration(Position thePos) const
+{
+  return to_duration(record(thePos).access_duration);
+}
+
+Fmi::TimeDuration RequestLog::getCpuDuration(Position thePos) const
+{
+  return to_duration(record(thePos).cpu_duration);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remove records which ended at or before the given time
+ */
+// ----------------------------------------------------------------------
+
+void RequestLog::purge(const Fmi::DateTime& theMinTime)
+{
+  const auto limit = (theMinTime - itsEpoch).total_microseconds();
+  while (!empty() && record(itsTail).end_time <= limit)
+    ++itsTail;
+}
+
+void RequestLog::clear()
+{
+  itsTail = itsHead;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Memory usage and counters
+ */
+// ----------------------------------------------------------------------
+
+RequestLog::Statistics RequestLog::getStatistics() const
+{
+  Statistics stats;
+  stats.records = size();
+  stats.capacity = itsCapacity;
+  stats.text_bytes = (empty() ? 0 : itsTextHead - record(itsTail).text_offset);
+  stats.text_capacity = itsTextCapacity;
+  stats.interned = itsStrings->size();
+  stats.used_bytes = stats.records * sizeof(Record) + stats.text_bytes + itsStrings->bytes();
+  stats.reserved_bytes = itsStrings->bytes();
+  if (itsRecords)
+    stats.reserved_bytes += itsCapacity * sizeof(Record) + itsTextCapacity;
+  stats.dropped = itsDropped;
+  stats.overwritten = itsOverwritten;
+  return stats;
+}
+
+}  // namespace Spine
+}  // namespace SmartMet
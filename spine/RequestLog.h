@@ -0,0 +1,128 @@
+#pragma once
+
+#include "LoggedRequest.h"
+#include <macgyver/DateTime.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace SmartMet
+{
+namespace Spine
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Compact in-memory log of handled requests
+ *
+ * Requests are stored as fixed size records in a ring allocated when the
+ * first request is appended. Method, HTTP version and status are
+ * interned, IP addresses are stored in binary form and the URI, ETag and
+ * API key are copied into a fixed size text arena which is also used as
+ * a ring. Hence appending a request does no memory allocations once the
+ * interned strings have been seen.
+ *
+ * When either ring is full the oldest records are overwritten, unless
+ * the caller forbids it because readers are iterating over the log. In
+ * that case the new request is dropped instead. The access log is fed
+ * separately and does not lose such requests.
+ *
+ * Records are addressed by a monotonically increasing position so that
+ * positions stay valid until the record is removed. The class is not
+ * synchronized, HandlerView protects it with its logging mutex. Readers
+ * may access records between begin() and end() without the mutex as long
+ * as eviction has been disabled for the duration.
+ */
+// ----------------------------------------------------------------------
+
+class RequestLog
+{
+ public:
+  using Position = std::uint64_t;
+
+  struct Statistics
+  {
+    std::size_t records = 0;        // records currently in the log
+    std::size_t capacity = 0;       // maximum number of records
+    std::size_t text_bytes = 0;     // arena bytes used by current records
+    std::size_t text_capacity = 0;  // arena size
+    std::size_t interned = 0;       // number of interned strings
+    std::size_t used_bytes = 0;     // memory used by current records
+    std::size_t reserved_bytes = 0; // allocated memory
+    std::uint64_t dropped = 0;      // requests dropped since readers blocked eviction
+    std::uint64_t overwritten = 0;  // records evicted to make room for new ones
+  };
+
+  RequestLog(std::size_t theCapacity, std::size_t theTextCapacity);
+  ~RequestLog();
+
+  RequestLog(const RequestLog& other) = delete;
+  RequestLog(RequestLog&& other) = delete;
+  RequestLog& operator=(const RequestLog& other) = delete;
+  RequestLog& operator=(RequestLog&& other) = delete;
+
+  // Returns false if the request was dropped
+  bool append(const std::string& theURI,
+              const Fmi::DateTime& theEndTime,
+              const Fmi::TimeDuration& theAccessDuration,
+              const Fmi::TimeDuration& theCpuDuration,
+              const std::string& theStatus,
+              const std::string& theIP,
+              const std::string& theMethod,
+              const std::string& theVersion,
+              std::size_t theContentLength,
+              const std::string& theETag,
+              const std::string& theApiKey,
+              bool theEvictionAllowed);
+
+  bool append(const LoggedRequest& theRequest, bool theEvictionAllowed);
+
+  Position begin() const { return itsTail; }
+  Position end() const { return itsHead; }
+  std::size_t size() const { return itsHead - itsTail; }
+  bool empty() const { return itsHead == itsTail; }
+
+  // Rebuild a full request object
+  LoggedRequest get(Position thePos) const;
+
+  // Cheap accessors which do not allocate
+  Fmi::DateTime getRequestEndTime(Position thePos) const;
+  Fmi::TimeDuration getAccessDuration(Position thePos) const;
+  Fmi::TimeDuration getCpuDuration(Position thePos) const;
+
+  // Remove records which ended at or before the given time
+  void purge(const Fmi::DateTime& theMinTime);
+
+  // Remove all records
+  void clear();
+
+  Statistics getStatistics() const;
+
+ private:
+  struct Record;
+  class StringPool;
+
+  const Record& record(Position thePos) const;
+  std::string text(std::uint64_t theOffset, std::size_t theLength) const;
+  void evict();
+
+  std::size_t itsCapacity;
+  std::size_t itsTextCapacity;
+  std::unique_ptr<Record[]> itsRecords;
+  std::unique_ptr<char[]> itsText;
+
+  Position itsHead = 0;
+  Position itsTail = 0;
+  std::uint64_t itsTextHead = 0;  // absolute offset of the next free arena byte
+
+  std::unique_ptr<StringPool> itsStrings;
+
+  // Times are stored as microseconds since this moment
+  Fmi::DateTime itsEpoch;
+
+  std::uint64_t itsDropped = 0;
+  std::uint64_t itsOverwritten = 0;
+};
+
+}  // namespace Spine
+}  // namespace SmartMet
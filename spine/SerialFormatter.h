@@ -8,6 +8,7 @@
 
 #include "Table.h"
 #include "TableFormatter.h"
+#include <list>
 
 namespace SmartMet
 {
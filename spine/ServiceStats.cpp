@@ -0,0 +1,159 @@
+#include "ServiceStats.h"
+
+namespace SmartMet
+{
+namespace Spine
+{
+namespace
+{
+std::int64_t seconds_since_epoch(ServiceStats::Clock::time_point theTime)
+{
+  return std::chrono::duration_cast<std::chrono::seconds>(theTime.time_since_epoch()).count();
+}
+
+// Sum the buckets of the given periods (last - N, last]
+template <typename Buckets>
+void sum(const Buckets& theBuckets,
+         std::int64_t theLastPeriod,
+         std::uint64_t& theCount,
+         std::int64_t* theMicroseconds = nullptr,
+         std::int64_t* theCpuMicroseconds = nullptr,
+         std::uint64_t* theAllocatedBytes = nullptr)
+{
+  const auto n = static_cast<std::int64_t>(theBuckets.size());
+  for (const auto& bucket : theBuckets)
+  {
+    const auto period = bucket.period.load(std::memory_order_acquire);
+    if (period > theLastPeriod - n && period <= theLastPeriod)
+    {
+      theCount += bucket.count.load(std::memory_order_relaxed);
+      if (theMicroseconds)
+        *theMicroseconds += bucket.microseconds.load(std::memory_order_relaxed);
+      if (theCpuMicroseconds)
+        *theCpuMicroseconds += bucket.cpu_microseconds.load(std::memory_order_relaxed);
+      if (theAllocatedBytes)
+        *theAllocatedBytes += bucket.allocated_bytes.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+}  // namespace
+
+ServiceStats::Summary& ServiceStats::Summary::operator+=(const Summary& theOther)
+{
+  last_minute += theOther.last_minute;
+  last_hour += theOther.last_hour;
+  last_day += theOther.last_day;
+  day_microseconds += theOther.day_microseconds;
+  day_cpu_microseconds += theOther.day_cpu_microseconds;
+  day_allocated_bytes += theOther.day_allocated_bytes;
+  total += theOther.total;
+  total_allocated_bytes += theOther.total_allocated_bytes;
+  return *this;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add a request to a bucket, resetting it first if it is for an older period
+ */
+// ----------------------------------------------------------------------
+
+void ServiceStats::Bucket::add(std::int64_t thePeriod,
+                               std::int64_t theDuration,
+                               std::int64_t theCpuDuration,
+                               std::uint64_t theAllocatedBytes)
+{
+  auto old_period = period.load(std::memory_order_acquire);
+  while (old_period < thePeriod)
+  {
+    if (period.compare_exchange_weak(old_period, thePeriod, std::memory_order_acq_rel))
+    {
+      count.store(0, std::memory_order_relaxed);
+      microseconds.store(0, std::memory_order_relaxed);
+      cpu_microseconds.store(0, std::memory_order_relaxed);
+      allocated_bytes.store(0, std::memory_order_relaxed);
+      break;
+    }
+  }
+
+  // A delayed update for a period which has already been recycled
+  if (old_period > thePeriod)
+    return;
+
+  count.fetch_add(1, std::memory_order_relaxed);
+  microseconds.fetch_add(theDuration, std::memory_order_relaxed);
+  cpu_microseconds.fetch_add(theCpuDuration, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(theAllocatedBytes, std::memory_order_relaxed);
+}
+
+template <std::size_t N>
+void ServiceStats::add(std::array<Bucket, N>& theBuckets,
+                       std::int64_t thePeriod,
+                       std::int64_t theDuration,
+                       std::int64_t theCpuDuration,
+                       std::uint64_t theAllocatedBytes)
+{
+  theBuckets[thePeriod % N].add(thePeriod, theDuration, theCpuDuration, theAllocatedBytes);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Count a finished request
+ */
+// ----------------------------------------------------------------------
+
+void ServiceStats::add(std::chrono::microseconds theDuration,
+                       std::chrono::microseconds theCpuDuration,
+                       std::uint64_t theAllocatedBytes)
+{
+  add(theDuration, theCpuDuration, Clock::now(), theAllocatedBytes);
+}
+
+void ServiceStats::add(std::chrono::microseconds theDuration,
+                       std::chrono::microseconds theCpuDuration,
+                       Clock::time_point theTime,
+                       std::uint64_t theAllocatedBytes)
+{
+  const auto second = seconds_since_epoch(theTime);
+  const auto us = theDuration.count();
+  const auto cpu_us = theCpuDuration.count();
+
+  add(itsSeconds, second, us, cpu_us, theAllocatedBytes);
+  add(itsMinutes, second / 60, us, cpu_us, theAllocatedBytes);
+  add(itsHours, second / 3600, us, cpu_us, theAllocatedBytes);
+
+  itsTotal.fetch_add(1, std::memory_order_relaxed);
+  itsTotalAllocatedBytes.fetch_add(theAllocatedBytes, std::memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Summarize the last minute, hour and day
+ */
+// ----------------------------------------------------------------------
+
+ServiceStats::Summary ServiceStats::summary() const
+{
+  return summary(Clock::now());
+}
+
+ServiceStats::Summary ServiceStats::summary(Clock::time_point theTime) const
+{
+  const auto second = seconds_since_epoch(theTime);
+
+  Summary ret;
+  sum(itsSeconds, second, ret.last_minute);
+  sum(itsMinutes, second / 60, ret.last_hour);
+  sum(itsHours,
+      second / 3600,
+      ret.last_day,
+      &ret.day_microseconds,
+      &ret.day_cpu_microseconds,
+      &ret.day_allocated_bytes);
+  ret.total = itsTotal.load(std::memory_order_relaxed);
+  ret.total_allocated_bytes = itsTotalAllocatedBytes.load(std::memory_order_relaxed);
+  return ret;
+}
+
+}  // namespace Spine
+}  // namespace SmartMet
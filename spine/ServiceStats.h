@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace SmartMet
+{
+namespace Spine
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Pre-aggregated request counters of a single handler
+ *
+ * Requests are counted into rolling per-second, per-minute and per-hour
+ * buckets, so that the last minute, hour and 24 hours can be summarized
+ * in O(buckets) without walking the request log. The windows are bucket
+ * aligned, for example the last hour consists of the current minute and
+ * the 59 minutes before it.
+ *
+ * Updates are lock free. A bucket is reset by the first thread which
+ * notices it belongs to an older period, hence a request racing with the
+ * reset may occasionally be lost. That is acceptable for statistics.
+ *
+ * The request count since server start is kept as well for monitoring
+ * systems which compute rates themselves.
+ */
+// ----------------------------------------------------------------------
+
+class ServiceStats
+{
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Summary
+  {
+    std::uint64_t last_minute = 0;
+    std::uint64_t last_hour = 0;
+    std::uint64_t last_day = 0;
+    std::int64_t day_microseconds = 0;      // total wall clock time of last_day requests
+    std::int64_t day_cpu_microseconds = 0;  // total CPU time of last_day requests
+    std::uint64_t day_allocated_bytes = 0;  // total heap allocations of last_day requests
+    std::uint64_t total = 0;                // requests since server start
+    std::uint64_t total_allocated_bytes = 0;
+
+    Summary& operator+=(const Summary& theOther);
+  };
+
+  void add(std::chrono::microseconds theDuration,
+           std::chrono::microseconds theCpuDuration,
+           std::uint64_t theAllocatedBytes = 0);
+  void add(std::chrono::microseconds theDuration,
+           std::chrono::microseconds theCpuDuration,
+           Clock::time_point theTime,
+           std::uint64_t theAllocatedBytes = 0);
+
+  Summary summary() const;
+  Summary summary(Clock::time_point theTime) const;
+
+ private:
+  struct Bucket
+  {
+    std::atomic<std::int64_t> period{-1};  // second, minute or hour number the bucket is for
+    std::atomic<std::uint64_t> count{0};
+    std::atomic<std::int64_t> microseconds{0};
+    std::atomic<std::int64_t> cpu_microseconds{0};
+    std::atomic<std::uint64_t> allocated_bytes{0};
+
+    void add(std::int64_t thePeriod,
+             std::int64_t theDuration,
+             std::int64_t theCpuDuration,
+             std::uint64_t theAllocatedBytes);
+  };
+
+  template <std::size_t N>
+  static void add(std::array<Bucket, N>& theBuckets,
+                  std::int64_t thePeriod,
+                  std::int64_t theDuration,
+                  std::int64_t theCpuDuration,
+                  std::uint64_t theAllocatedBytes);
+
+  std::array<Bucket, 60> itsSeconds;
+  std::array<Bucket, 60> itsMinutes;
+  std::array<Bucket, 24> itsHours;
+
+  std::atomic<std::uint64_t> itsTotal{0};
+  std::atomic<std::uint64_t> itsTotalAllocatedBytes{0};
+};
+
+}  // namespace Spine
+}  // namespace SmartMet
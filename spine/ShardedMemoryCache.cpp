@@ -0,0 +1,288 @@
+#include "ShardedMemoryCache.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+#include <thread>
+
+namespace SmartMet
+{
+namespace Spine
+{
+namespace
+{
+std::size_t default_shards()
+{
+  const std::size_t cpus = std::max(1U, std::thread::hardware_concurrency());
+  std::size_t n = 1;
+  while (n < cpus && n < 64)
+    n *= 2;
+  return n;
+}
+
+std::size_t value_size(const ShardedMemoryCache::ValueType& theValue)
+{
+  return theValue ? theValue->size() : 0;
+}
+
+}  // namespace
+
+void ShardedMemoryCache::Shard::updateOldest()
+{
+  oldest.store(lru.empty() ? UINT64_MAX : lru.back().stamp, std::memory_order_relaxed);
+}
+
+ShardedMemoryCache::ShardedMemoryCache(std::size_t theMaxBytes, std::size_t theShards)
+    : itsMaxBytes(theMaxBytes)
+{
+  try
+  {
+    std::size_t n = 1;
+    const auto wanted = (theShards > 0 ? theShards : default_shards());
+    while (n < wanted)
+      n *= 2;
+    itsMask = n - 1;
+    itsShards = std::vector<Shard>(n);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find a value and mark it most recently used
+ */
+// ----------------------------------------------------------------------
+
+ShardedMemoryCache::ValueType ShardedMemoryCache::find(KeyType theKey)
+{
+  try
+  {
+    auto& s = shard(theKey);
+    std::lock_guard<std::mutex> lock(s.mutex);
+
+    auto pos = s.index.find(theKey);
+    if (pos == s.index.end())
+    {
+      ++s.misses;
+      return {};
+    }
+
+    ++s.hits;
+    auto it = pos->second;
+    it->stamp = ++itsClock;
+    s.lru.splice(s.lru.begin(), s.lru, it);
+    s.updateOldest();
+    return it->value;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Insert a new value, evicting the least recently used entries
+ *        of all shards until the budget is met
+ */
+// ----------------------------------------------------------------------
+
+bool ShardedMemoryCache::insert(KeyType theKey, const ValueType& theValue, Items& theEvicted)
+{
+  try
+  {
+    const auto bytes = value_size(theValue);
+    if (bytes > itsMaxBytes)
+      return false;
+
+    {
+      auto& s = shard(theKey);
+      std::lock_guard<std::mutex> lock(s.mutex);
+
+      if (s.index.find(theKey) != s.index.end())
+        return false;
+
+      s.lru.push_front(Entry{theKey, theValue, ++itsClock});
+      s.index.emplace(theKey, s.lru.begin());
+      ++s.inserts;
+      s.updateOldest();
+    }
+
+    // Concurrent inserters may both evict, overshooting the budget
+    // downwards by a few entries, which is harmless.
+
+    auto total = itsBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    while (total > itsMaxBytes && evictOldest(theEvicted))
+      total = itsBytes.load(std::memory_order_relaxed);
+
+    return true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remove a value
+ */
+// ----------------------------------------------------------------------
+
+bool ShardedMemoryCache::remove(KeyType theKey)
+{
+  try
+  {
+    auto& s = shard(theKey);
+    std::lock_guard<std::mutex> lock(s.mutex);
+
+    auto pos = s.index.find(theKey);
+    if (pos == s.index.end())
+      return false;
+
+    itsBytes.fetch_sub(value_size(pos->second->value), std::memory_order_relaxed);
+    s.lru.erase(pos->second);
+    s.index.erase(pos);
+    s.updateOldest();
+    return true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Index of the shard whose least recently used entry is the
+ *        oldest one, or the number of shards if all are empty
+ */
+// ----------------------------------------------------------------------
+
+std::size_t ShardedMemoryCache::oldestShard() const
+{
+  std::size_t ret = itsShards.size();
+  auto oldest = UINT64_MAX;
+  for (std::size_t i = 0; i < itsShards.size(); i++)
+  {
+    const auto stamp = itsShards[i].oldest.load(std::memory_order_relaxed);
+    if (stamp < oldest)
+    {
+      oldest = stamp;
+      ret = i;
+    }
+  }
+  return ret;
+}
+
+bool ShardedMemoryCache::oldestKey(KeyType& theKey) const
+{
+  const auto i = oldestShard();
+  if (i == itsShards.size())
+    return false;
+
+  const auto& s = itsShards[i];
+  std::lock_guard<std::mutex> lock(s.mutex);
+  if (s.lru.empty())
+    return false;
+  theKey = s.lru.back().key;
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Evict the tail of the shard holding the oldest entry
+ */
+// ----------------------------------------------------------------------
+
+bool ShardedMemoryCache::evictOldest(Items& theEvicted)
+{
+  while (true)
+  {
+    const auto i = oldestShard();
+    if (i == itsShards.size())
+      return false;
+
+    auto& victim = itsShards[i];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+
+    // Retry if another thread got here first
+    if (victim.lru.empty())
+      continue;
+
+    auto& entry = victim.lru.back();
+    itsBytes.fetch_sub(value_size(entry.value), std::memory_order_relaxed);
+    theEvicted.emplace_back(entry.key, std::move(entry.value));
+    victim.index.erase(entry.key);
+    victim.lru.pop_back();
+    ++victim.evictions;
+    victim.updateOldest();
+    return true;
+  }
+}
+
+std::size_t ShardedMemoryCache::evict(std::size_t theBytes, Items& theEvicted)
+{
+  std::size_t released = 0;
+  while (released < theBytes && evictOldest(theEvicted))
+    released += value_size(theEvicted.back().second);
+  return released;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return the contents in LRU order
+ *
+ * The shards are locked one at a time, hence the result is not an
+ * atomic snapshot while other threads modify the cache.
+ */
+// ----------------------------------------------------------------------
+
+ShardedMemoryCache::Items ShardedMemoryCache::getContent() const
+{
+  try
+  {
+    std::vector<std::pair<std::uint64_t, std::pair<KeyType, ValueType>>> entries;
+    for (const auto& s : itsShards)
+    {
+      std::lock_guard<std::mutex> lock(s.mutex);
+      for (const auto& entry : s.lru)
+        entries.emplace_back(entry.stamp, std::make_pair(entry.key, entry.value));
+    }
+
+    std::sort(entries.begin(),
+              entries.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    Items ret;
+    ret.reserve(entries.size());
+    for (auto& entry : entries)
+      ret.push_back(std::move(entry.second));
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+ShardedMemoryCache::Statistics ShardedMemoryCache::statistics() const
+{
+  Statistics ret;
+  ret.maxsize = itsMaxBytes;
+  ret.size = itsBytes.load(std::memory_order_relaxed);
+  for (const auto& s : itsShards)
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    ret.entries += s.lru.size();
+    ret.inserts += s.inserts;
+    ret.hits += s.hits;
+    ret.misses += s.misses;
+    ret.evictions += s.evictions;
+  }
+  return ret;
+}
+
+}  // namespace Spine
+}  // namespace SmartMet
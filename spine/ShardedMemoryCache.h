@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Spine
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Byte budgeted memory cache split into independently locked shards
+ *
+ * Each shard is an LRU list protected by its own mutex, the byte budget
+ * is shared by all shards and accounted atomically. Entries are stamped
+ * from a global counter whenever they are inserted or found, and each
+ * shard publishes the stamp of its least recently used entry. Eviction
+ * removes the tail of the shard with the oldest stamp, hence entries
+ * are evicted in (nearly) global LRU order and a single value may use
+ * the whole budget.
+ *
+ * At most one shard lock is held at a time.
+ */
+// ----------------------------------------------------------------------
+
+class ShardedMemoryCache
+{
+ public:
+  using KeyType = std::size_t;
+  using ValueType = std::shared_ptr<std::string>;
+  using Items = std::vector<std::pair<KeyType, ValueType>>;
+
+  struct Statistics
+  {
+    std::size_t maxsize = 0;  // byte budget
+    std::size_t size = 0;     // bytes in use
+    std::size_t entries = 0;
+    std::size_t inserts = 0;
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+    std::size_t evictions = 0;
+  };
+
+  // Zero shards selects a power of two based on the number of CPUs
+  explicit ShardedMemoryCache(std::size_t theMaxBytes, std::size_t theShards = 0);
+
+  ShardedMemoryCache(const ShardedMemoryCache&) = delete;
+  ShardedMemoryCache& operator=(const ShardedMemoryCache&) = delete;
+
+  ValueType find(KeyType theKey);
+
+  // Evicted entries are appended to theEvicted in LRU order. Returns false
+  // if the key was already cached or the value exceeds the whole budget.
+  bool insert(KeyType theKey, const ValueType& theValue, Items& theEvicted);
+
+  // Remove a value, returns false if the key was not cached
+  bool remove(KeyType theKey);
+
+  // Evict least recently used entries until at least theBytes have been
+  // released or the cache is empty. Returns the bytes released.
+  std::size_t evict(std::size_t theBytes, Items& theEvicted);
+
+  // Contents in LRU order, the least recently used first
+  Items getContent() const;
+
+  Statistics statistics() const;
+
+  std::size_t shards() const { return itsShards.size(); }
+  std::size_t bytes() const { return itsBytes.load(std::memory_order_relaxed); }
+  std::size_t maxBytes() const { return itsMaxBytes; }
+
+  // The key which would be evicted next, false if the cache is empty
+  bool oldestKey(KeyType& theKey) const;
+
+ private:
+  struct Entry
+  {
+    KeyType key;
+    ValueType value;
+    std::uint64_t stamp;
+  };
+
+  struct alignas(64) Shard
+  {
+    mutable std::mutex mutex;
+    std::list<Entry> lru;  // most recently used first
+    std::unordered_map<KeyType, std::list<Entry>::iterator> index;
+    std::atomic<std::uint64_t> oldest{UINT64_MAX};  // stamp of lru.back()
+    std::size_t inserts = 0;
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+    std::size_t evictions = 0;
+
+    void updateOldest();
+  };
+
+  Shard& shard(KeyType theKey) { return itsShards[(theKey * 0x9E3779B97F4A7C15ULL >> 32) & itsMask]; }
+
+  std::size_t oldestShard() const;
+  bool evictOldest(Items& theEvicted);
+
+  const std::size_t itsMaxBytes;
+  std::size_t itsMask = 0;
+  std::vector<Shard> itsShards;
+  std::atomic<std::size_t> itsBytes{0};
+  std::atomic<std::uint64_t> itsClock{0};
+};
+
+}  // namespace Spine
+}  // namespace SmartMet
@@ -0,0 +1,946 @@
+#include "SharedMemoryCache.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Spine
+{
+namespace
+{
+const char cache_magic[8] = {'S', 'M', 'S', 'H', 'M', 'C', 0, 0};
+const std::uint32_t cache_version = 2;
+
+// Allocation unit, the smallest block
+const std::size_t unit_size = 64;
+const std::size_t block_header_size = 32;
+const std::size_t max_classes = 32;
+const std::size_t alignment = 4096;
+
+// Number of slots a key may be stored in
+const std::size_t probe_window = 16;
+
+// Blocks scanned for a victim when a size class is exhausted
+const std::size_t max_evict_scan = 4096;
+
+// Pages inspected and collection rounds when moving a page to another class
+const std::size_t max_rebalance_pages = 4;
+const std::size_t rebalance_evicted_pages = 4;
+const int max_reclaim_rounds = 8;
+
+// Slot entry: block index + 1 | 16 bit generation | 16 bit key tag
+std::uint64_t make_entry(std::uint32_t theIndex, std::uint32_t theGeneration, std::uint64_t theKey)
+{
+  return (std::uint64_t(theIndex) + 1) | (std::uint64_t(theGeneration & 0xffff) << 32) |
+         (theKey & 0xffff000000000000ULL);
+}
+
+std::uint32_t entry_index(std::uint64_t theEntry)
+{
+  return static_cast<std::uint32_t>(theEntry & 0xffffffff) - 1;
+}
+
+std::uint32_t entry_generation(std::uint64_t theEntry)
+{
+  return (theEntry >> 32) & 0xffff;
+}
+
+bool entry_tag_matches(std::uint64_t theEntry, std::uint64_t theKey)
+{
+  return ((theEntry ^ theKey) & 0xffff000000000000ULL) == 0;
+}
+
+// Page descriptor: generation << 8 | class + 1, zero for an unassigned page
+std::uint32_t make_page(std::uint32_t theGeneration, unsigned int theClass)
+{
+  return (theGeneration << 8) | (theClass + 1);
+}
+
+bool page_assigned(std::uint32_t thePage)
+{
+  return (thePage & 0xff) != 0;
+}
+
+unsigned int page_class(std::uint32_t thePage)
+{
+  return (thePage & 0xff) - 1;
+}
+
+// The keys are hash values already, but not necessarily well mixed
+std::size_t slot_hash(std::uint64_t theKey)
+{
+  theKey ^= theKey >> 33;
+  theKey *= 0xff51afd7ed558ccdULL;
+  theKey ^= theKey >> 33;
+  return theKey;
+}
+
+std::size_t round_up(std::size_t theValue, std::size_t theMultiple)
+{
+  return (theValue + theMultiple - 1) / theMultiple * theMultiple;
+}
+
+std::size_t power_of_two(std::size_t theValue)
+{
+  std::size_t ret = 1;
+  while (ret < theValue)
+    ret <<= 1;
+  return ret;
+}
+
+// Shared between processes, hence steady clock seconds
+std::uint32_t now()
+{
+  return static_cast<std::uint32_t>(
+      std::chrono::duration_cast<std::chrono::seconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+std::filesystem::path cache_path(const std::string& theName)
+{
+  if (theName.find('/') != std::string::npos)
+    return theName;
+  return std::filesystem::path("/dev/shm") / theName;
+}
+
+// Releases a lock on the file. The lock must be released explicitly,
+// since the descriptor and the mapping keep the file open.
+struct FileLock
+{
+  int fd;
+  ~FileLock() { flock(fd, LOCK_UN); }
+};
+
+}  // namespace
+
+struct SharedMemoryCache::Header
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t classes;
+  std::uint64_t slots;
+  std::uint64_t page_size;
+  std::uint64_t pages;
+  std::uint64_t slot_offset;
+  std::uint64_t page_offset;
+  std::uint64_t data_offset;
+  std::atomic<std::uint64_t> next_page;
+  std::atomic<std::uint64_t> clock_hand;
+  std::atomic<std::uint64_t> page_hand;
+  std::atomic<std::uint64_t> free_lists[max_classes];     // ABA counter | block index + 1
+  std::atomic<std::uint64_t> evicted_units[max_classes];  // since the class last got a page
+};
+
+struct SharedMemoryCache::Slot
+{
+  std::atomic<std::uint64_t> entry;
+  std::atomic<std::uint32_t> access;
+  std::uint32_t reserved;
+};
+
+struct SharedMemoryCache::Block
+{
+  std::atomic<std::uint64_t> key;
+  std::atomic<std::uint32_t> generation;  // incremented when freed
+  std::atomic<std::uint32_t> next;        // free list link, index + 1
+  std::atomic<std::uint32_t> size;
+  std::uint32_t cls;  // set when the page is assigned to a class
+  std::uint64_t reserved;
+
+  char* data() { return reinterpret_cast<char*>(this) + block_header_size; }
+};
+
+struct SharedMemoryCache::Page
+{
+  std::atomic<std::uint32_t> state;  // see make_page
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "Shared memory atomics must be lock free");
+
+SharedMemoryCache::SharedMemoryCache(const std::string& theName,
+                                     std::size_t theBytes,
+                                     std::size_t theSlots,
+                                     std::size_t thePageSize)
+    : itsPath(cache_path(theName)), itsStartTime(Fmi::MicrosecClock::universal_time())
+{
+  try
+  {
+    if (thePageSize < alignment || power_of_two(thePageSize) != thePageSize)
+      throw Fmi::Exception(BCP, "Shared memory cache page size must be a power of two >= 4096")
+          .addParameter("Page size", std::to_string(thePageSize));
+
+    while (true)
+    {
+      // The descriptor is kept open for locking while pages are moved
+      itsFd = ::open(itsPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+      if (itsFd < 0)
+        throw Fmi::Exception(BCP, "Failed to open shared memory cache")
+            .addParameter("Path", itsPath.string())
+            .addParameter("Error", std::strerror(errno));
+
+      int fd = -1;
+      try
+      {
+        // Only one process initializes the file. The lock is released by
+        // the kernel even if the process dies.
+        if (flock(itsFd, LOCK_EX) != 0)
+          throw Fmi::Exception(BCP, "Failed to lock shared memory cache")
+              .addParameter("Path", itsPath.string())
+              .addParameter("Error", std::strerror(errno));
+
+        FileLock lock{itsFd};
+
+        // Retry if another process replaced the file while we waited for the lock
+        struct stat fd_st;
+        struct stat path_st;
+        if (fstat(itsFd, &fd_st) == 0 && ::stat(itsPath.c_str(), &path_st) == 0 &&
+            fd_st.st_dev == path_st.st_dev && fd_st.st_ino == path_st.st_ino)
+          fd = attach(itsFd, theBytes, theSlots, thePageSize);
+      }
+      catch (...)
+      {
+        ::close(itsFd);
+        itsFd = -1;
+        throw;
+      }
+
+      if (fd == itsFd)
+        break;
+
+      ::close(itsFd);
+      itsFd = fd;
+      if (fd >= 0)
+        break;
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+SharedMemoryCache::~SharedMemoryCache()
+{
+  if (itsMemory != nullptr)
+    munmap(itsMemory, itsMappedSize);
+  if (itsFd >= 0)
+    ::close(itsFd);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Map an existing cache, or initialize a new one
+ *
+ * An existing file is used only if its header is complete and its
+ * geometry matches the file size. Otherwise a new cache is built in a
+ * separate file which is then renamed over the old one. Processes still
+ * attached to the old file, e.g. during a rolling restart across a
+ * version change, keep using it undisturbed until they restart.
+ *
+ * Returns the descriptor of the mapped file, which is theFd unless a
+ * new file was created. The caller must hold a lock on theFd.
+ */
+// ----------------------------------------------------------------------
+
+int SharedMemoryCache::attach(int theFd,
+                              std::size_t theBytes,
+                              std::size_t theSlots,
+                              std::size_t thePageSize)
+{
+  struct stat st;
+  if (fstat(theFd, &st) != 0)
+    throw Fmi::Exception(BCP, "Failed to stat shared memory cache")
+        .addParameter("Path", itsPath.string());
+
+  const auto file_size = static_cast<std::size_t>(st.st_size);
+
+  Header old;
+  if (file_size >= sizeof(Header) &&
+      pread(theFd, &old, sizeof(Header), 0) == static_cast<ssize_t>(sizeof(Header)) &&
+      std::memcmp(old.magic, cache_magic, sizeof(cache_magic)) == 0 &&
+      old.version == cache_version && old.classes <= max_classes && old.page_size >= alignment &&
+      power_of_two(old.page_size) == old.page_size && power_of_two(old.slots) == old.slots &&
+      old.slot_offset >= sizeof(Header) &&
+      old.page_offset >= old.slot_offset + old.slots * sizeof(Slot) &&
+      old.data_offset >= old.page_offset + old.pages * sizeof(Page) &&
+      old.data_offset + old.pages * old.page_size == file_size)
+  {
+    void* ptr = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, theFd, 0);
+    if (ptr == MAP_FAILED)
+      throw Fmi::Exception(BCP, "Failed to map shared memory cache")
+          .addParameter("Path", itsPath.string())
+          .addParameter("Error", std::strerror(errno));
+
+    itsMemory = static_cast<char*>(ptr);
+    itsMappedSize = file_size;
+    itsHeader = reinterpret_cast<Header*>(itsMemory);
+    itsSlots = reinterpret_cast<Slot*>(itsMemory + itsHeader->slot_offset);
+    itsPages = reinterpret_cast<Page*>(itsMemory + itsHeader->page_offset);
+    itsData = itsMemory + itsHeader->data_offset;
+    return theFd;
+  }
+
+  const std::size_t pages = theBytes / thePageSize;
+  if (pages == 0)
+    throw Fmi::Exception(BCP, "Shared memory cache must hold at least one page")
+        .addParameter("Bytes", std::to_string(theBytes))
+        .addParameter("Page size", std::to_string(thePageSize));
+
+  if (pages * thePageSize / unit_size >= 0xffffffffULL)
+    throw Fmi::Exception(BCP, "Shared memory cache is too large")
+        .addParameter("Bytes", std::to_string(theBytes));
+
+  const std::size_t slots = power_of_two(
+      std::max<std::size_t>(probe_window, theSlots > 0 ? theSlots : pages * thePageSize / 4096));
+
+  const std::size_t slot_offset = round_up(sizeof(Header), alignment);
+  const std::size_t page_offset = slot_offset + round_up(slots * sizeof(Slot), alignment);
+  const std::size_t data_offset = page_offset + round_up(pages * sizeof(Page), alignment);
+  const std::size_t total_size = data_offset + pages * thePageSize;
+
+  // Only the holder of the lock on the current file writes the new one,
+  // a leftover from a process which died meanwhile is truncated. The
+  // file is all zeros after truncation.
+  const auto new_path = itsPath.string() + ".new";
+  const int fd = ::open(new_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd < 0)
+    throw Fmi::Exception(BCP, "Failed to create shared memory cache")
+        .addParameter("Path", new_path)
+        .addParameter("Error", std::strerror(errno));
+
+  void* ptr = MAP_FAILED;
+  if (ftruncate(fd, static_cast<off_t>(total_size)) == 0)
+    ptr = mmap(nullptr, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+  if (ptr == MAP_FAILED)
+  {
+    const int err = errno;
+    ::close(fd);
+    ::unlink(new_path.c_str());
+    throw Fmi::Exception(BCP, "Failed to size and map shared memory cache")
+        .addParameter("Path", new_path)
+        .addParameter("Error", std::strerror(err));
+  }
+
+  itsMemory = static_cast<char*>(ptr);
+  itsMappedSize = total_size;
+
+  // The rest of the file is zero, which is a valid initial state for
+  // the slots, pages and blocks
+  itsHeader = new (itsMemory) Header();
+  itsHeader->version = cache_version;
+  itsHeader->classes = 0;
+  while ((unit_size << itsHeader->classes) <= thePageSize)
+    ++itsHeader->classes;
+  itsHeader->slots = slots;
+  itsHeader->page_size = thePageSize;
+  itsHeader->pages = pages;
+  itsHeader->slot_offset = slot_offset;
+  itsHeader->page_offset = page_offset;
+  itsHeader->data_offset = data_offset;
+
+  itsSlots = reinterpret_cast<Slot*>(itsMemory + slot_offset);
+  itsPages = reinterpret_cast<Page*>(itsMemory + page_offset);
+  itsData = itsMemory + data_offset;
+
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(itsHeader->magic, cache_magic, sizeof(cache_magic));
+
+  // Publish the complete cache
+  if (::rename(new_path.c_str(), itsPath.c_str()) != 0)
+  {
+    const int err = errno;
+    munmap(itsMemory, itsMappedSize);
+    itsMemory = nullptr;
+    itsHeader = nullptr;
+    ::close(fd);
+    ::unlink(new_path.c_str());
+    throw Fmi::Exception(BCP, "Failed to replace shared memory cache")
+        .addParameter("Path", itsPath.string())
+        .addParameter("Error", std::strerror(err));
+  }
+
+  return fd;
+}
+
+void SharedMemoryCache::unlink(const std::string& theName)
+{
+  std::error_code ec;
+  const auto path = cache_path(theName);
+  std::filesystem::remove(path, ec);
+  std::filesystem::remove(path.string() + ".new", ec);
+}
+
+std::size_t SharedMemoryCache::maxValueSize() const
+{
+  return itsHeader->page_size - block_header_size;
+}
+
+SharedMemoryCache::Block* SharedMemoryCache::block(std::uint32_t theIndex) const
+{
+  static_assert(sizeof(Block) == block_header_size, "Unexpected block header size");
+  return reinterpret_cast<Block*>(itsData + std::size_t(theIndex) * unit_size);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Lock-free stack of free blocks per size class
+ *
+ * The head carries a counter incremented on every change, so that a
+ * block popped and pushed back meanwhile cannot corrupt the list.
+ */
+// ----------------------------------------------------------------------
+
+std::uint32_t SharedMemoryCache::pop(unsigned int theClass)
+{
+  auto& head = itsHeader->free_lists[theClass];
+  auto old = head.load(std::memory_order_acquire);
+  while ((old & 0xffffffff) != 0)
+  {
+    const auto index = static_cast<std::uint32_t>(old & 0xffffffff) - 1;
+    const auto next = block(index)->next.load(std::memory_order_relaxed);
+    const auto counter = (old >> 32) + 1;
+    if (head.compare_exchange_weak(old, (counter << 32) | next, std::memory_order_acquire))
+      return index + 1;
+  }
+  return 0;
+}
+
+void SharedMemoryCache::push(unsigned int theClass, std::uint32_t theIndex)
+{
+  auto& head = itsHeader->free_lists[theClass];
+  auto old = head.load(std::memory_order_relaxed);
+  while (true)
+  {
+    block(theIndex)->next.store(static_cast<std::uint32_t>(old & 0xffffffff),
+                                std::memory_order_relaxed);
+    const auto counter = (old >> 32) + 1;
+    if (head.compare_exchange_weak(
+            old, (counter << 32) | (std::uint64_t(theIndex) + 1), std::memory_order_release))
+      return;
+  }
+}
+
+// Assign a new page to the class
+bool SharedMemoryCache::refill(unsigned int theClass)
+{
+  auto page = itsHeader->next_page.load(std::memory_order_relaxed);
+  do
+  {
+    if (page >= itsHeader->pages)
+      return false;
+  } while (!itsHeader->next_page.compare_exchange_weak(page, page + 1));
+
+  assign(page, theClass);
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Divide a page into free blocks of the class
+ *
+ * The page generation is changed first, so that readers still copying
+ * a block of the previous class notice the page being reused.
+ */
+// ----------------------------------------------------------------------
+
+void SharedMemoryCache::assign(std::size_t thePage, unsigned int theClass)
+{
+  auto& state = itsPages[thePage].state;
+  const auto generation = (state.load(std::memory_order_relaxed) >> 8) + 1;
+  state.store(make_page(generation, theClass), std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  const std::size_t page_units = itsHeader->page_size / unit_size;
+  const std::size_t block_units = std::size_t(1) << theClass;
+  const auto first = thePage * page_units;
+
+  for (std::size_t i = 0; i < page_units; i += block_units)
+  {
+    const auto index = static_cast<std::uint32_t>(first + i);
+    auto* b = block(index);
+    b->key.store(0, std::memory_order_relaxed);
+    b->cls = theClass;
+    push(theClass, index);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Move a page from another class to the given class
+ *
+ * Pages are inspected in CLOCK order. The values in the page are evicted
+ * and its blocks are collected from the free list of its class. Blocks
+ * being inserted by other processes are waited for a few rounds, after
+ * which the page is given up on.
+ *
+ * Only one process moves pages at a time. The lock is a flock on the
+ * cache file, which the kernel releases even if the process dies.
+ */
+// ----------------------------------------------------------------------
+
+bool SharedMemoryCache::rebalance(unsigned int theClass)
+{
+  std::unique_lock<std::mutex> lock(itsRebalanceMutex, std::try_to_lock);
+  if (!lock.owns_lock() || flock(itsFd, LOCK_EX | LOCK_NB) != 0)
+    return false;
+
+  FileLock file_lock{itsFd};
+
+  const auto used = std::min<std::size_t>(itsHeader->pages, itsHeader->next_page.load());
+  if (used == 0)
+    return false;
+
+  for (std::size_t i = 0; i < std::min(max_rebalance_pages, used); i++)
+  {
+    const auto page = itsHeader->page_hand.fetch_add(1, std::memory_order_relaxed) % used;
+    const auto state = itsPages[page].state.load(std::memory_order_acquire);
+    if (!page_assigned(state) || page_class(state) == theClass)
+      continue;
+
+    if (reclaim(page, page_class(state)))
+    {
+      assign(page, theClass);
+      ++itsRebalances;
+      return true;
+    }
+  }
+  return false;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Take all blocks of a page out of use
+ *
+ * Returns false if some blocks could not be collected, in which case the
+ * collected blocks are returned to the free list.
+ */
+// ----------------------------------------------------------------------
+
+bool SharedMemoryCache::reclaim(std::size_t thePage, unsigned int theClass)
+{
+  const std::size_t page_units = itsHeader->page_size / unit_size;
+  const std::size_t block_units = std::size_t(1) << theClass;
+  const std::size_t count = page_units / block_units;
+  const auto first = static_cast<std::uint32_t>(thePage * page_units);
+  const auto last = static_cast<std::uint32_t>(first + page_units);
+
+  std::vector<bool> collected(count, false);
+  std::size_t ncollected = 0;
+  std::vector<std::uint32_t> others;
+
+  for (int round = 0; round < max_reclaim_rounds && ncollected < count; round++)
+  {
+    if (round > 0)
+      std::this_thread::yield();
+
+    // Free the blocks referenced by slots
+    for (std::size_t i = 0; i < count; i++)
+      if (!collected[i])
+        unpublish(static_cast<std::uint32_t>(first + i * block_units));
+
+    // Take over the whole free list. Concurrent pops fail since the ABA
+    // counter changes, concurrent pushes go to the new empty list.
+    auto& head = itsHeader->free_lists[theClass];
+    auto old = head.load(std::memory_order_acquire);
+    while (!head.compare_exchange_weak(
+        old, ((old >> 32) + 1) << 32, std::memory_order_acquire))
+    {
+    }
+
+    others.clear();
+    for (auto next = static_cast<std::uint32_t>(old & 0xffffffff); next != 0;)
+    {
+      const auto index = next - 1;
+      next = block(index)->next.load(std::memory_order_relaxed);
+      if (index >= first && index < last)
+      {
+        const auto pos = (index - first) / block_units;
+        if (!collected[pos])
+        {
+          collected[pos] = true;
+          ++ncollected;
+        }
+      }
+      else
+        others.push_back(index);
+    }
+
+    for (auto index : others)
+      push(theClass, index);
+  }
+
+  if (ncollected == count)
+    return true;
+
+  for (std::size_t i = 0; i < count; i++)
+    if (collected[i])
+      push(theClass, static_cast<std::uint32_t>(first + i * block_units));
+  return false;
+}
+
+// Remove the slot referring to the block, if any
+void SharedMemoryCache::unpublish(std::uint32_t theIndex)
+{
+  const auto key = block(theIndex)->key.load(std::memory_order_relaxed);
+  const auto mask = itsHeader->slots - 1;
+  const auto start = slot_hash(key);
+
+  for (std::size_t i = 0; i < probe_window; i++)
+  {
+    auto& slot = itsSlots[(start + i) & mask];
+    auto entry = slot.entry.load(std::memory_order_acquire);
+    if (entry != 0 && entry_index(entry) == theIndex &&
+        slot.entry.compare_exchange_strong(entry, 0, std::memory_order_acq_rel))
+    {
+      release(theIndex);
+      ++itsEvictions;
+      return;
+    }
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Free a block no longer referenced by any slot
+ *
+ * The generation is changed first so that readers still copying the
+ * block notice the block being reused.
+ */
+// ----------------------------------------------------------------------
+
+void SharedMemoryCache::release(std::uint32_t theIndex)
+{
+  auto* b = block(theIndex);
+  b->generation.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  push(b->cls, theIndex);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Evict one block of the given class in CLOCK order
+ *
+ * A slot accessed during the last second gets a second chance.
+ */
+// ----------------------------------------------------------------------
+
+bool SharedMemoryCache::evict(unsigned int theClass)
+{
+  const auto mask = itsHeader->slots - 1;
+  const auto t = now();
+
+  for (std::size_t i = 0; i < std::min<std::size_t>(max_evict_scan, 2 * itsHeader->slots); i++)
+  {
+    auto& slot = itsSlots[itsHeader->clock_hand.fetch_add(1, std::memory_order_relaxed) & mask];
+    auto entry = slot.entry.load(std::memory_order_acquire);
+    if (entry == 0 || block(entry_index(entry))->cls != theClass)
+      continue;
+
+    if (slot.access.load(std::memory_order_relaxed) + 1 >= t)
+    {
+      slot.access.store(0, std::memory_order_relaxed);
+      continue;
+    }
+
+    if (slot.entry.compare_exchange_strong(entry, 0, std::memory_order_acq_rel))
+    {
+      release(entry_index(entry));
+      ++itsEvictions;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns block index + 1, zero on failure
+std::uint32_t SharedMemoryCache::allocate(std::size_t theSize)
+{
+  const std::size_t bytes = theSize + block_header_size;
+  unsigned int cls = 0;
+  while ((unit_size << cls) < bytes)
+    ++cls;
+  if (cls >= itsHeader->classes)
+    return 0;
+
+  // Retries are bounded, other processes may grab the freed blocks
+  for (int attempt = 0; attempt < 8; attempt++)
+  {
+    const auto index = pop(cls);
+    if (index != 0)
+      return index;
+
+    if (refill(cls))
+      continue;
+
+    if (evict(cls))
+    {
+      // Once the class has evicted a few pages worth of blocks it takes a
+      // page from the other classes, hence pages follow the insert volume.
+      const std::size_t limit = rebalance_evicted_pages * itsHeader->page_size / unit_size;
+      const std::size_t block_units = std::size_t(1) << cls;
+      auto& evicted = itsHeader->evicted_units[cls];
+      if (evicted.fetch_add(block_units, std::memory_order_relaxed) + block_units >= limit)
+      {
+        evicted.store(0, std::memory_order_relaxed);
+        rebalance(cls);
+      }
+      continue;
+    }
+
+    // No blocks of the class in use, a page must be taken from the others
+    if (!rebalance(cls))
+      return 0;
+    itsHeader->evicted_units[cls].store(0, std::memory_order_relaxed);
+  }
+  return 0;
+}
+
+// Verify the entry refers to the key, the tag alone may collide
+bool SharedMemoryCache::matches(std::uint64_t theEntry, KeyType theKey) const
+{
+  if (!entry_tag_matches(theEntry, theKey))
+    return false;
+  const auto* b = block(entry_index(theEntry));
+  return ((b->generation.load(std::memory_order_acquire) & 0xffff) ==
+              entry_generation(theEntry) &&
+          b->key.load(std::memory_order_relaxed) == theKey);
+}
+
+SharedMemoryCache::ValueType SharedMemoryCache::find(KeyType theKey) const
+{
+  try
+  {
+    const auto mask = itsHeader->slots - 1;
+    const auto start = slot_hash(theKey);
+    const std::size_t page_units = itsHeader->page_size / unit_size;
+    const std::size_t max_units = itsHeader->pages * page_units;
+
+    for (std::size_t i = 0; i < probe_window; i++)
+    {
+      auto& slot = itsSlots[(start + i) & mask];
+      const auto entry = slot.entry.load(std::memory_order_acquire);
+      if (entry == 0 || !entry_tag_matches(entry, theKey))
+        continue;
+
+      const auto index = entry_index(entry);
+      if (index >= max_units)
+        continue;
+
+      // The page may be moved to another class while we read
+      const auto& page = itsPages[index / page_units];
+      const auto state = page.state.load(std::memory_order_acquire);
+      if (!page_assigned(state))
+        continue;
+      const auto cls = page_class(state);
+      if (cls >= itsHeader->classes || (index % page_units) % (std::size_t(1) << cls) != 0)
+        continue;
+
+      auto* b = block(index);
+      const auto generation = b->generation.load(std::memory_order_acquire);
+      if ((generation & 0xffff) != entry_generation(entry) ||
+          b->key.load(std::memory_order_relaxed) != theKey)
+        continue;
+
+      // Sanity checks against a block being reused while read
+      const auto size = b->size.load(std::memory_order_relaxed);
+      if (size + block_header_size > (unit_size << cls))
+        continue;
+
+      auto ret = std::make_shared<std::string>(b->data(), size);
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (b->generation.load(std::memory_order_relaxed) != generation ||
+          page.state.load(std::memory_order_relaxed) != state)
+        continue;
+
+      slot.access.store(now(), std::memory_order_relaxed);
+      ++itsHits;
+      return ret;
+    }
+
+    ++itsMisses;
+    return {};
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Insert a value, replacing the old value of the key if any
+ *
+ * The value is written to a private block first, which is then
+ * published by a CAS on a slot in the window of the key. Concurrent
+ * inserts of the same key may both succeed, in which case either value
+ * may be found.
+ */
+// ----------------------------------------------------------------------
+
+bool SharedMemoryCache::insert(KeyType theKey, std::string_view theValue)
+{
+  try
+  {
+    if (theValue.size() > maxValueSize())
+    {
+      ++itsFailures;
+      return false;
+    }
+
+    const auto allocated = allocate(theValue.size());
+    if (allocated == 0)
+    {
+      ++itsFailures;
+      return false;
+    }
+
+    const auto index = allocated - 1;
+    auto* b = block(index);
+    b->key.store(theKey, std::memory_order_relaxed);
+    b->size.store(static_cast<std::uint32_t>(theValue.size()), std::memory_order_relaxed);
+    std::memcpy(b->data(), theValue.data(), theValue.size());
+
+    const auto new_entry =
+        make_entry(index, b->generation.load(std::memory_order_relaxed), theKey);
+
+    const auto mask = itsHeader->slots - 1;
+    const auto start = slot_hash(theKey);
+
+    for (int attempt = 0; attempt < 4; attempt++)
+    {
+      Slot* existing = nullptr;
+      Slot* empty = nullptr;
+      Slot* oldest = nullptr;
+      std::uint64_t existing_entry = 0;
+      std::uint64_t oldest_entry = 0;
+      std::uint32_t oldest_access = 0;
+
+      for (std::size_t i = 0; i < probe_window && !existing; i++)
+      {
+        auto& slot = itsSlots[(start + i) & mask];
+        const auto entry = slot.entry.load(std::memory_order_acquire);
+        if (entry == 0)
+        {
+          if (!empty)
+            empty = &slot;
+        }
+        else if (matches(entry, theKey))
+        {
+          existing = &slot;
+          existing_entry = entry;
+        }
+        else
+        {
+          const auto access = slot.access.load(std::memory_order_relaxed);
+          if (!oldest || access < oldest_access)
+          {
+            oldest = &slot;
+            oldest_entry = entry;
+            oldest_access = access;
+          }
+        }
+      }
+
+      Slot* target = (existing ? existing : (empty ? empty : oldest));
+      auto expected = (existing ? existing_entry : (empty ? 0 : oldest_entry));
+
+      if (target->entry.compare_exchange_strong(expected, new_entry, std::memory_order_acq_rel))
+      {
+        target->access.store(now(), std::memory_order_relaxed);
+        if (expected != 0)
+        {
+          release(entry_index(expected));
+          if (!existing)
+            ++itsEvictions;
+        }
+        ++itsInserts;
+        return true;
+      }
+    }
+
+    // Lost too many races, give up
+    release(index);
+    ++itsFailures;
+    return false;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+bool SharedMemoryCache::remove(KeyType theKey)
+{
+  try
+  {
+    const auto mask = itsHeader->slots - 1;
+    const auto start = slot_hash(theKey);
+
+    bool ret = false;
+    for (std::size_t i = 0; i < probe_window; i++)
+    {
+      auto& slot = itsSlots[(start + i) & mask];
+      auto entry = slot.entry.load(std::memory_order_acquire);
+      if (entry != 0 && matches(entry, theKey) &&
+          slot.entry.compare_exchange_strong(entry, 0, std::memory_order_acq_rel))
+      {
+        release(entry_index(entry));
+        ret = true;
+      }
+    }
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+SharedMemoryCache::Statistics SharedMemoryCache::statistics() const
+{
+  Statistics ret;
+  ret.slots = itsHeader->slots;
+  for (std::size_t i = 0; i < itsHeader->slots; i++)
+    if (itsSlots[i].entry.load(std::memory_order_relaxed) != 0)
+      ++ret.used_slots;
+  ret.page_size = itsHeader->page_size;
+  ret.pages = itsHeader->pages;
+  ret.used_pages = std::min<std::size_t>(itsHeader->pages, itsHeader->next_page.load());
+  ret.hits = itsHits;
+  ret.misses = itsMisses;
+  ret.inserts = itsInserts;
+  ret.evictions = itsEvictions;
+  ret.rebalances = itsRebalances;
+  ret.failures = itsFailures;
+  return ret;
+}
+
+Fmi::Cache::CacheStats SharedMemoryCache::getCacheStats() const
+{
+  const auto stats = statistics();
+  Fmi::Cache::CacheStats ret;
+  ret.starttime = itsStartTime;
+  ret.maxsize = stats.slots;
+  ret.size = stats.used_slots;
+  ret.inserts = stats.inserts;
+  ret.hits = stats.hits;
+  ret.misses = stats.misses;
+  return ret;
+}
+
+}  // namespace Spine
+}  // namespace SmartMet
@@ -0,0 +1,159 @@
+// ======================================================================
+/*!
+ * \brief Cache shared by all server processes on one node
+ *
+ * The cache lives in a memory mapped file, by default in /dev/shm, so
+ * that it survives the restart of any single process. It consists of a
+ * fixed size hash table and a slab allocator for the values:
+ *
+ *  - Each slot is a single 64 bit word holding the block index, the
+ *    block generation and a tag of the key, and is updated with CAS.
+ *    A key may be stored in any slot of a small probe window.
+ *  - The data area is divided into pages, which are assigned on demand
+ *    to size classes of powers of two. Free blocks of each class are
+ *    kept in a lock-free stack.
+ *  - Readers copy the value and then verify that neither the block nor
+ *    the page generation changed, i.e. the block was not freed and the
+ *    page was not moved to another class meanwhile.
+ *
+ * No locks are held in shared memory, hence a process dying in the
+ * middle of an operation cannot block the others. It may leak memory
+ * though: normally the block being inserted, but a process dying while
+ * moving a page leaks the free list of the class it had taken over, or
+ * the page being divided into blocks. Leaked memory is recovered only
+ * when the cache file is recreated.
+ *
+ * When the window of a key is full the least recently accessed slot is
+ * replaced. When a size class runs out of blocks, blocks of the same
+ * class are evicted in CLOCK order. A class which has no blocks in use,
+ * or which has evicted a few pages worth of blocks, takes a page from
+ * the other classes. Moving pages is serialized by a flock on the file.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <macgyver/CacheStats.h>
+#include <macgyver/DateTime.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace SmartMet
+{
+namespace Spine
+{
+class SharedMemoryCache
+{
+ public:
+  using KeyType = std::size_t;
+  using ValueType = std::shared_ptr<std::string>;
+
+  // Sizes are those of the shared cache, the counters those of this process
+  struct Statistics
+  {
+    std::size_t slots = 0;
+    std::size_t used_slots = 0;
+    std::size_t page_size = 0;
+    std::size_t pages = 0;
+    std::size_t used_pages = 0;
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+    std::size_t inserts = 0;
+    std::size_t evictions = 0;
+    std::size_t rebalances = 0;  // pages moved to another class
+    std::size_t failures = 0;    // inserts which did not fit
+  };
+
+  static constexpr std::size_t default_page_size = 1024 * 1024;
+
+  /*
+   * ----------------------------------------
+   * Constructor
+   * - theName is a file name in /dev/shm or
+   *   a full path to the file
+   * - theBytes is the size of the data area
+   * - theSlots is the number of hash slots,
+   *   zero selects one per 4 kB of data
+   * - thePageSize limits the value size
+   *
+   * An existing cache is attached to as is,
+   * in which case the sizes are taken from
+   * the existing file.
+   * ----------------------------------------
+   */
+  SharedMemoryCache(const std::string& theName,
+                    std::size_t theBytes,
+                    std::size_t theSlots = 0,
+                    std::size_t thePageSize = default_page_size);
+
+  ~SharedMemoryCache();
+
+  SharedMemoryCache(const SharedMemoryCache& other) = delete;
+  SharedMemoryCache& operator=(const SharedMemoryCache& other) = delete;
+
+  ValueType find(KeyType theKey) const;
+
+  // Returns false if the value could not be stored
+  bool insert(KeyType theKey, std::string_view theValue);
+
+  bool remove(KeyType theKey);
+
+  // Largest value which can be stored
+  std::size_t maxValueSize() const;
+
+  const std::filesystem::path& path() const { return itsPath; }
+
+  Statistics statistics() const;
+  Fmi::Cache::CacheStats getCacheStats() const;
+
+  // Remove the backing file. Attached processes keep their mapping.
+  static void unlink(const std::string& theName);
+
+ private:
+  struct Header;
+  struct Slot;
+  struct Page;
+  struct Block;
+
+  int attach(int theFd, std::size_t theBytes, std::size_t theSlots, std::size_t thePageSize);
+
+  Block* block(std::uint32_t theIndex) const;
+  std::uint32_t allocate(std::size_t theSize);
+  std::uint32_t pop(unsigned int theClass);
+  void push(unsigned int theClass, std::uint32_t theIndex);
+  bool refill(unsigned int theClass);
+  void assign(std::size_t thePage, unsigned int theClass);
+  bool rebalance(unsigned int theClass);
+  bool reclaim(std::size_t thePage, unsigned int theClass);
+  void unpublish(std::uint32_t theIndex);
+  void release(std::uint32_t theIndex);
+  bool evict(unsigned int theClass);
+  bool matches(std::uint64_t theEntry, KeyType theKey) const;
+
+  std::filesystem::path itsPath;
+  int itsFd = -1;
+  char* itsMemory = nullptr;
+  std::size_t itsMappedSize = 0;
+  Header* itsHeader = nullptr;
+  Slot* itsSlots = nullptr;
+  Page* itsPages = nullptr;
+  char* itsData = nullptr;
+  Fmi::DateTime itsStartTime;
+
+  mutable std::atomic<std::size_t> itsHits{0};
+  mutable std::atomic<std::size_t> itsMisses{0};
+  std::atomic<std::size_t> itsInserts{0};
+  std::atomic<std::size_t> itsEvictions{0};
+  std::atomic<std::size_t> itsRebalances{0};
+  std::atomic<std::size_t> itsFailures{0};
+  std::mutex itsRebalanceMutex;
+};
+
+}  // namespace Spine
+}  // namespace SmartMet
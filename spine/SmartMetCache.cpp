@@ -1,5 +1,8 @@
 #include "SmartMetCache.h"
 #include <macgyver/Exception.h>
+#include <algorithm>
+#include <iostream>
+#include <iterator>
 #include <vector>
 
 namespace SmartMet
@@ -8,16 +11,28 @@ namespace Spine
 {
 SmartMetCache::SmartMetCache(std::size_t memoryCacheSize,
                              std::size_t fileCacheSize,
-                             const fs::path& cacheDirectory)
-    : itsMemoryCache(memoryCacheSize), itsShutdownRequested(false)
+                             const fs::path& cacheDirectory,
+                             std::size_t memoryCacheShards,
+                             std::size_t fileWriterThreads,
+                             std::size_t maxPendingWriteBytes)
+    : itsMemoryCache(memoryCacheSize, memoryCacheShards),
+      itsStartTime(Fmi::MicrosecClock::universal_time()),
+      itsMaxPendingBytes(maxPendingWriteBytes > 0 ? maxPendingWriteBytes : memoryCacheSize),
+      itsShutdownRequested(false)
 {
   try
   {
+    itsWriteStats.maxbytes = itsMaxPendingBytes;
+
     if (fileCacheSize > 0)
     {
-      itsFileCache.reset(new Fmi::Cache::FileCache(cacheDirectory, fileCacheSize));
-      itsFileThread = std::make_unique<std::thread>(&SmartMetCache::operateFileCache, this);
+      itsFileCache = std::make_unique<SmartMetFileCache>(cacheDirectory, fileCacheSize);
+      for (std::size_t i = 0; i < std::max<std::size_t>(1, fileWriterThreads); i++)
+        itsFileThreads.emplace_back(&SmartMetCache::operateFileCache, this);
     }
+
+    // Files or shared values may have been compressed by another process
+    itsCompressor = std::make_unique<CacheCompressor>(3, false, dictionaryFile());
   }
   catch (...)
   {
@@ -32,11 +47,18 @@ SmartMetCache::~SmartMetCache()
     {
       std::unique_lock<std::mutex> theLock(itsMutex);
       itsShutdownRequested = true;
-      itsCondition.notify_one();
+      itsCondition.notify_all();
     }
 
-    if (itsFileThread && itsFileThread->joinable())
-      itsFileThread->join();
+    for (auto& thread : itsFileThreads)
+      if (thread.joinable())
+        thread.join();
+
+    if (itsPrewarmThread.joinable())
+      itsPrewarmThread.join();
+
+    if (itsWarmRestart)
+      persist();
   }
   catch (...)
   {
@@ -48,32 +70,104 @@ SmartMetCache::ValueType SmartMetCache::find(KeyType hash)
 {
   try
   {
+    if (itsSketch)
+      itsSketch->increment(hash);
+
     // First search the in-memory cache
     auto memresult = itsMemoryCache.find(hash);
 
     if (memresult)
-      return *memresult;
+      return decodeHit(hash, memresult);
 
-    // Next try the file cache
+    // Then the cache shared with the other processes
+
+    auto sharedresult = findShared(hash);
+
+    if (sharedresult)
+      return decode(sharedresult);
 
     if (!itsFileCache)
       return {};
 
+    // Next try the entries waiting to be written. They are no longer
+    // queued, hence they are stored again.
+
+    auto entry = findPendingWrite(hash);
+
+    if (entry)
+    {
+      store(hash, entry);
+      return decode(entry);
+    }
+
+    // And finally the file cache
+
     auto fileresult = itsFileCache->find(hash);
 
     if (!fileresult)
       return {};
 
-    // Promote result to memcache and return
-    auto entry = std::make_shared<std::string>(std::move(*fileresult));
+    entry = std::make_shared<std::string>(fileresult.file->view());
 
-    std::vector<std::pair<KeyType, ValueType>> evictedItems;
-    itsMemoryCache.insert(hash, entry, evictedItems);
+    if (fileresult.hits >= itsPromotionThreshold && (!itsSketch || admit(hash, entry)))
+      promote(hash, entry);
 
-    if (!evictedItems.empty())
-      queueFileWrites(evictedItems);
+    return decode(entry);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+SmartMetCache::View SmartMetCache::findView(KeyType hash, bool acceptZstd)
+{
+  try
+  {
+    if (itsSketch)
+      itsSketch->increment(hash);
+
+    auto memresult = itsMemoryCache.find(hash);
+
+    if (memresult)
+    {
+      std::string_view frame;
+      if (acceptZstd && CacheCompressor::plainFrame(*memresult, frame))
+        return View(memresult, frame, "zstd");
+      auto value = decodeHit(hash, memresult);
+      return (value ? View(value) : View());
+    }
+
+    auto sharedresult = findShared(hash);
+
+    if (sharedresult)
+      return decodeView(sharedresult, *sharedresult, acceptZstd);
+
+    if (!itsFileCache)
+      return {};
+
+    auto entry = findPendingWrite(hash);
 
-    return entry;
+    if (entry)
+    {
+      store(hash, entry);
+      return decodeView(entry, *entry, acceptZstd);
+    }
+
+    auto fileresult = itsFileCache->find(hash);
+
+    if (!fileresult)
+      return {};
+
+    // Only frequently used files are worth copying into memory
+    if (fileresult.hits >= itsPromotionThreshold)
+    {
+      entry = std::make_shared<std::string>(fileresult.file->view());
+      if (!itsSketch || admit(hash, entry))
+        promote(hash, entry);
+    }
+
+    return decodeView(fileresult.file, fileresult.file->view(), acceptZstd);
   }
   catch (...)
   {
@@ -81,17 +175,241 @@ SmartMetCache::ValueType SmartMetCache::find(KeyType hash)
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Insert a value into the memory cache, queueing evicted entries
+ */
+// ----------------------------------------------------------------------
+
+void SmartMetCache::promote(KeyType hash, const ValueType& value)
+{
+  std::vector<std::pair<KeyType, ValueType>> evictedItems;
+  if (itsMemoryCache.insert(hash, value, evictedItems) && itsDecodedCache)
+    itsDecodedCache->remove(hash);
+
+  if (!evictedItems.empty() && itsFileCache)
+    queueFileWrites(evictedItems);
+}
+
 void SmartMetCache::insert(KeyType hash, const ValueType& data)
 {
   try
   {
-    // Insert into in-memory cache
+    if (itsSketch)
+      itsSketch->increment(hash);
+
+    const auto value = (itsCompression ? itsCompressor->compress(*data) : data);
+
+    // Each process trains its own dictionary, hence values shared with
+    // the other processes must be decodable without it
+    if (itsSharedCache)
+    {
+      if (CacheCompressor::usesDictionary(*value))
+        itsSharedCache->insert(hash, *itsCompressor->compress(*data, false));
+      else
+        itsSharedCache->insert(hash, *value);
+    }
+
+    store(hash, value);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Insert into the memory cache if admitted, otherwise queue the
+ *        value directly for the file cache
+ */
+// ----------------------------------------------------------------------
+
+void SmartMetCache::store(KeyType hash, const ValueType& value)
+{
+  if (itsSketch && !admit(hash, value))
+  {
+    ++itsRejections;
+    if (itsFileCache)
+      queueFileWrites({{hash, value}});
+    return;
+  }
+
+  promote(hash, value);
+}
+
+void SmartMetCache::enableAdmission(std::size_t expectedEntries)
+{
+  try
+  {
+    itsSketch = std::make_unique<FrequencySketch>(expectedEntries);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief TinyLFU admission test
+ *
+ * Inserts fitting the budget are always admitted. Otherwise the new key
+ * must be more frequent than the least recently used entry, so that a
+ * sweep over keys seen once cannot flush the frequently used ones.
+ * Only the first victim is compared, a large value may evict more.
+ */
+// ----------------------------------------------------------------------
+
+bool SmartMetCache::admit(KeyType hash, const ValueType& value) const
+{
+  if (itsMemoryCache.bytes() + value->size() <= itsMemoryCache.maxBytes())
+    return true;
+
+  KeyType victim = 0;
+  if (!itsMemoryCache.oldestKey(victim))
+    return true;
+
+  return itsSketch->frequency(hash) > itsSketch->frequency(victim);
+}
+
+void SmartMetCache::enableCompression(int level, bool dictionary, std::size_t decodedBytes)
+{
+  try
+  {
+    itsCompressor = std::make_unique<CacheCompressor>(level, dictionary, dictionaryFile());
+    itsCompression = true;
+    if (decodedBytes == 0)
+      decodedBytes = itsMemoryCache.maxBytes() / 8;
+    itsDecodedCache = std::make_unique<ShardedMemoryCache>(decodedBytes, itsMemoryCache.shards());
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+fs::path SmartMetCache::dictionaryFile() const
+{
+  if (!itsFileCache)
+    return {};
+  return itsFileCache->directory() / "zstd.dict";
+}
+
+void SmartMetCache::enableSharedMemory(const std::string& theName, std::size_t theBytes)
+{
+  try
+  {
+    itsSharedCache = std::make_unique<SharedMemoryCache>(theName, theBytes);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+SharedMemoryCache::Statistics SmartMetCache::getSharedMemoryStats() const
+{
+  if (!itsSharedCache)
+    return {};
+  return itsSharedCache->statistics();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find a value in the shared memory tier, promoting hits to the
+ *        memory cache
+ *
+ * A value this process cannot decode is a miss. It must not be promoted,
+ * since the memory cache would then refuse the decodable value.
+ */
+// ----------------------------------------------------------------------
+
+SmartMetCache::ValueType SmartMetCache::findShared(KeyType hash)
+{
+  if (!itsSharedCache)
+    return {};
+
+  auto entry = itsSharedCache->find(hash);
+  if (!entry || !itsCompressor->decodable(*entry))
+    return {};
+
+  if (!itsSketch || admit(hash, entry))
+    promote(hash, entry);
+  return entry;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Decode a stored value, nullptr if it cannot be decoded
+ */
+// ----------------------------------------------------------------------
+
+SmartMetCache::ValueType SmartMetCache::decode(const ValueType& stored) const
+{
+  if (!CacheCompressor::encoded(*stored))
+    return stored;
+  return itsCompressor->decompress(*stored);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Decode a memory cache hit, reusing the previous decompression
+ *        of the value if it is still cached
+ */
+// ----------------------------------------------------------------------
+
+SmartMetCache::ValueType SmartMetCache::decodeHit(KeyType hash, const ValueType& stored)
+{
+  if (!itsDecodedCache || !CacheCompressor::encoded(*stored))
+    return decode(stored);
+
+  auto value = itsDecodedCache->find(hash);
+  if (value)
+    return value;
+
+  value = decode(stored);
+  if (value)
+  {
     std::vector<std::pair<KeyType, ValueType>> evictedItems;
+    itsDecodedCache->insert(hash, value, evictedItems);
+  }
+  return value;
+}
 
-    itsMemoryCache.insert(hash, data, evictedItems);
+// ----------------------------------------------------------------------
+/*!
+ * \brief View of a stored value, passing plain zstd frames through as
+ *        is if the client accepts them
+ */
+// ----------------------------------------------------------------------
 
-    if (!evictedItems.empty() && itsFileCache)
-      queueFileWrites(evictedItems);
+SmartMetCache::View SmartMetCache::decodeView(std::shared_ptr<const void> owner,
+                                              std::string_view stored,
+                                              bool acceptZstd) const
+{
+  if (!CacheCompressor::encoded(stored))
+    return View(std::move(owner), stored, {});
+
+  std::string_view frame;
+  if (acceptZstd && CacheCompressor::plainFrame(stored, frame))
+    return View(std::move(owner), frame, "zstd");
+
+  auto value = itsCompressor->decompress(stored);
+  if (!value)
+    return {};
+  return View(value);
+}
+
+CacheCompressor::Statistics SmartMetCache::getCompressionStats() const
+{
+  try
+  {
+    if (!itsCompression)
+      return {};
+    auto ret = itsCompressor->statistics();
+    ret.effective_capacity = static_cast<std::size_t>(itsMemoryCache.maxBytes() * ret.ratio);
+    return ret;
   }
   catch (...)
   {
@@ -99,16 +417,140 @@ void SmartMetCache::insert(KeyType hash, const ValueType& data)
   }
 }
 
-std::vector<std::pair<SmartMetCache::KeyType, SmartMetCache::ValueType>> SmartMetCache::getContent()
+void SmartMetCache::enableWarmRestart(std::size_t prewarmBytes, std::size_t flushBytes)
+{
+  try
+  {
+    if (!itsFileCache)
+      return;
+
+    itsWarmRestart = true;
+    itsFlushBytes = flushBytes;
+
+    const auto bytes = (prewarmBytes > 0 ? prewarmBytes : itsMemoryCache.maxBytes());
+    itsPrewarmThread = std::thread(&SmartMetCache::prewarm, this, bytes);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Load the most recently used files into memory
+ *
+ * The hottest entries are inserted last so that they end up most
+ * recently used in memory too. Entries inserted by requests meanwhile
+ * are not replaced.
+ */
+// ----------------------------------------------------------------------
+
+void SmartMetCache::prewarm(std::size_t bytes)
+{
+  try
+  {
+    const auto index = itsFileCache->getIndex();
+
+    auto first = index.end();
+    std::size_t total = 0;
+    while (first != index.begin() && total + std::prev(first)->second <= bytes)
+    {
+      --first;
+      total += first->second;
+    }
+
+    for (auto it = first; it != index.end() && !itsShutdownRequested; ++it)
+    {
+      auto file = itsFileCache->read(it->first);
+      if (!file)
+        continue;
+
+      std::vector<std::pair<KeyType, ValueType>> evictedItems;
+      if (itsMemoryCache.insert(it->first, std::make_shared<std::string>(file->view()), evictedItems))
+        ++itsPrewarmed;
+
+      if (!evictedItems.empty())
+        queueFileWrites(evictedItems);
+    }
+  }
+  catch (...)
+  {
+    Fmi::Exception exception(BCP, "Cache prewarming failed!", nullptr);
+    std::cerr << exception.getStackTrace();
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Save the file cache index for the next process
+ *
+ * Called after the writer threads have stopped. Memory entries already
+ * on disk are touched in LRU order, so the index ends with them in the
+ * same recency order, and prewarming picks them first. Values not yet
+ * on disk are written only up to the flush budget, the most recently
+ * used first, so that shutdown does not dump the whole memory cache.
+ */
+// ----------------------------------------------------------------------
+
+void SmartMetCache::persist()
 {
   try
   {
-    std::vector<std::pair<KeyType, ValueType>> results;
+    // Queued writes are older than the memory entries, hence this is
+    // the recency order
+    std::vector<std::pair<KeyType, ValueType>> items;
+    if (itsFlushBytes > 0)
+    {
+      std::unique_lock<std::mutex> theLock(itsMutex);
+      for (const auto& item : itsWriteQueue)
+      {
+        auto pos = itsPendingWrites.find(item.first);
+        if (pos != itsPendingWrites.end() && pos->second.seq == item.second)
+          items.emplace_back(item.first, pos->second.value);
+      }
+    }
+
+    const auto memory = itsMemoryCache.getContent();
+    items.insert(items.end(), memory.begin(), memory.end());
+
+    std::vector<bool> flush(items.size(), false);
+    std::size_t budget = itsFlushBytes;
+    for (auto i = items.size(); i > 0 && budget > 0; --i)
+    {
+      const auto& item = items[i - 1];
+      if (item.second->size() <= budget && !itsFileCache->contains(item.first))
+      {
+        flush[i - 1] = true;
+        budget -= item.second->size();
+      }
+    }
+
+    for (std::size_t i = 0; i < items.size(); i++)
+    {
+      if (flush[i])
+        itsFileCache->insert(items[i].first, *items[i].second);
+      else
+        itsFileCache->touch(items[i].first);
+    }
+
+    itsFileCache->saveIndex();
+  }
+  catch (...)
+  {
+    std::cerr << Fmi::Exception::Trace(BCP, "Failed to save cache for a warm restart!")
+                     .getStackTrace();
+  }
+}
 
-    auto content = itsMemoryCache.getContent();
+std::vector<std::pair<SmartMetCache::KeyType, SmartMetCache::ValueType>> SmartMetCache::getContent()
+{
+  try
+  {
+    auto results = itsMemoryCache.getContent();
 
-    for (const auto& item : content)
-      results.emplace_back(std::make_pair(item.itsKey, item.itsValue));
+    for (auto& item : results)
+      item.second = decode(item.second);
 
     if (itsFileCache)
       for (const auto& item : itsFileCache->getContent())
@@ -122,32 +564,92 @@ std::vector<std::pair<SmartMetCache::KeyType, SmartMetCache::ValueType>> SmartMe
   }
 }
 
+Fmi::Cache::CacheStats SmartMetCache::getMemoryCacheStats() const
+{
+  try
+  {
+    const auto stats = itsMemoryCache.statistics();
+
+    Fmi::Cache::CacheStats ret;
+    ret.starttime = itsStartTime;
+    ret.maxsize = stats.maxsize;
+    ret.size = stats.size;
+    ret.inserts = stats.inserts;
+    ret.hits = stats.hits;
+    ret.misses = stats.misses;
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write queued entries to the file cache in batches
+ *
+ * Entries being written stay in the pending map so that find() can
+ * still see them, they are removed once written unless a newer value
+ * for the same key was queued meanwhile.
+ */
+// ----------------------------------------------------------------------
+
 void SmartMetCache::operateFileCache()
 {
   try
   {
+    std::vector<std::pair<KeyType, PendingWrite>> batch;
+
     while (!itsShutdownRequested)
     {
       std::unique_lock<std::mutex> theLock(itsMutex);
-      if (itsPendingWrites.empty())
-      {
-        // Wait for something to write
-        itsCondition.wait(theLock);
-      }
+      itsCondition.wait(theLock,
+                        [this] { return itsShutdownRequested || !itsWriteQueue.empty(); });
 
       if (itsShutdownRequested)
         return;
 
-      std::pair<KeyType, ValueType> back(
-          itsPendingWrites.back());  // We need local copy here to increase locking granularity
-      itsPendingWrites.pop_back();
+      batch.clear();
+      while (!itsWriteQueue.empty() && batch.size() < write_batch_size)
+      {
+        const auto item = itsWriteQueue.front();
+        itsWriteQueue.pop_front();
+
+        auto pos = itsPendingWrites.find(item.first);
+        if (pos == itsPendingWrites.end() || pos->second.seq != item.second)
+          continue;  // stale
+
+        pos->second.inflight = true;
+        batch.emplace_back(item.first, pos->second);
+      }
+
+      if (batch.empty())
+        continue;
 
-      theLock.unlock();  // No longer operating on the stack.
+      if (!itsWriteQueue.empty())
+        itsCondition.notify_one();
+
+      theLock.unlock();  // No longer operating on the queue
 
       // This also performs filecache cleanup if needed
-      itsFileCache->insert(back.first, *back.second);
+      for (const auto& item : batch)
+        itsFileCache->insert(item.first, *item.second.value);
 
       // Above might fail, but so what. Show must go on.
+
+      theLock.lock();
+      ++itsWriteStats.batches;
+      for (const auto& item : batch)
+      {
+        ++itsWriteStats.written;
+        auto pos = itsPendingWrites.find(item.first);
+        if (pos != itsPendingWrites.end() && pos->second.seq == item.second.seq)
+        {
+          itsWriteStats.bytes -= item.second.value->size();
+          itsPendingWrites.erase(pos);
+        }
+      }
     }
   }
   catch (...)
@@ -165,11 +667,30 @@ void SmartMetCache::queueFileWrites(const std::vector<std::pair<KeyType, ValueTy
     std::unique_lock<std::mutex> theLock(itsMutex);
     for (const auto& entry_pair : items)
     {
-      // Insert this entry into the pending writes queue
-      itsPendingWrites.emplace_front(entry_pair.first, entry_pair.second);
+      const auto seq = ++itsWriteSeq;
+      auto& pending = itsPendingWrites[entry_pair.first];
+
+      // A queued older value for the same key is replaced, its queue
+      // position becomes stale. A value being written is not counted.
+      if (pending.value)
+      {
+        if (!pending.inflight)
+          ++itsWriteStats.merged;
+        itsWriteStats.bytes -= pending.value->size();
+      }
+
+      pending.value = entry_pair.second;
+      pending.seq = seq;
+      pending.inflight = false;
+      itsWriteStats.bytes += pending.value->size();
+      ++itsWriteStats.queued;
+
+      itsWriteQueue.emplace_back(entry_pair.first, seq);
     }
 
-    // Notify disk flusher
+    dropPendingWrites();
+
+    // Notify a disk flusher, it will wake up another one if needed
     itsCondition.notify_one();
   }
   catch (...)
@@ -178,12 +699,102 @@ void SmartMetCache::queueFileWrites(const std::vector<std::pair<KeyType, ValueTy
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Drop the oldest queued entries until within the byte bound
+ *
+ * Called with itsMutex locked. Entries being written are not dropped.
+ */
+// ----------------------------------------------------------------------
+
+void SmartMetCache::dropPendingWrites()
+{
+  while (itsWriteStats.bytes > itsMaxPendingBytes && !itsWriteQueue.empty())
+  {
+    const auto item = itsWriteQueue.front();
+    itsWriteQueue.pop_front();
+
+    auto pos = itsPendingWrites.find(item.first);
+    if (pos == itsPendingWrites.end() || pos->second.seq != item.second)
+      continue;  // stale
+
+    itsWriteStats.bytes -= pos->second.value->size();
+    ++itsWriteStats.dropped;
+    itsPendingWrites.erase(pos);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find an entry waiting to be written
+ *
+ * A queued entry is removed since it will be promoted to the memory
+ * cache, an entry being written is left for the writer to finish.
+ */
+// ----------------------------------------------------------------------
+
+SmartMetCache::ValueType SmartMetCache::findPendingWrite(KeyType hash)
+{
+  std::unique_lock<std::mutex> theLock(itsMutex);
+
+  auto pos = itsPendingWrites.find(hash);
+  if (pos == itsPendingWrites.end())
+    return {};
+
+  ++itsWriteStats.hits;
+  auto value = pos->second.value;
+  if (!pos->second.inflight)
+  {
+    itsWriteStats.bytes -= value->size();
+    itsPendingWrites.erase(pos);
+  }
+  return value;
+}
+
+SmartMetCache::WriteQueueStats SmartMetCache::getWriteQueueStats() const
+{
+  std::unique_lock<std::mutex> theLock(itsMutex);
+  auto ret = itsWriteStats;
+  ret.depth = itsPendingWrites.size();
+  return ret;
+}
+
+std::size_t SmartMetCache::shrink(std::size_t theBytes)
+{
+  try
+  {
+    // Decompressed copies are the cheapest to drop
+    std::vector<std::pair<KeyType, ValueType>> evictedItems;
+    auto released = (itsDecodedCache ? itsDecodedCache->evict(theBytes, evictedItems) : 0);
+    evictedItems.clear();
+
+    if (released < theBytes)
+      released += itsMemoryCache.evict(theBytes - released, evictedItems);
+
+    // Values queued for writing stay in memory until written, only the
+    // net change counts as released
+    if (!evictedItems.empty() && itsFileCache)
+    {
+      const auto before = getWriteQueueStats().bytes;
+      queueFileWrites(evictedItems);
+      const auto after = getWriteQueueStats().bytes;
+      if (after > before)
+        released -= std::min(released, after - before);
+    }
+
+    return released;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 void SmartMetCache::shutdown()
 {
   std::unique_lock<std::mutex> theLock(itsMutex);
   itsShutdownRequested = true;
-  if (itsFileThread)
-    itsCondition.notify_one();
+  itsCondition.notify_all();
 }
 
 }  // namespace Spine
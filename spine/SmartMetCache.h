@@ -1,14 +1,24 @@
 #pragma once
 #include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <deque>
 #include <filesystem>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
+#include "CacheCompressor.h"
+#include "FrequencySketch.h"
+#include "ShardedMemoryCache.h"
+#include "SharedMemoryCache.h"
+#include "SmartMetFileCache.h"
+#include <boost/shared_array.hpp>
 #include <macgyver/Cache.h>
+#include <macgyver/DateTime.h>
 
 namespace SmartMet
 {
@@ -37,17 +47,93 @@ class SmartMetCache
   using ValueType = std::shared_ptr<std::string>;
 
  public:
+  /*
+   * ----------------------------------------
+   * Statistics of the queue of evicted
+   * entries waiting to be written to disk
+   * ----------------------------------------
+   */
+  struct WriteQueueStats
+  {
+    std::size_t depth = 0;     // entries waiting or being written
+    std::size_t bytes = 0;     // bytes waiting or being written
+    std::size_t maxbytes = 0;  // queue bound in bytes
+    std::size_t queued = 0;    // entries queued
+    std::size_t merged = 0;    // entries replaced by a newer value for the same key
+    std::size_t dropped = 0;   // entries dropped since the queue was full
+    std::size_t hits = 0;      // finds served from the queue
+    std::size_t written = 0;   // entries written to the file cache
+    std::size_t batches = 0;   // write batches
+  };
+
+  /*
+   * ----------------------------------------
+   * Reference counted view of a cached value,
+   * either in memory or in a mapped cache file
+   * ----------------------------------------
+   */
+  class View
+  {
+   public:
+    View() = default;
+    explicit View(const std::shared_ptr<const std::string>& theValue)
+        : itsOwner(theValue), itsData(*theValue)
+    {
+    }
+    explicit View(const std::shared_ptr<const MappedFile>& theFile)
+        : itsOwner(theFile), itsData(theFile->view())
+    {
+    }
+    View(std::shared_ptr<const void> theOwner, std::string_view theData, std::string_view theEncoding)
+        : itsOwner(std::move(theOwner)), itsData(theData), itsEncoding(theEncoding)
+    {
+    }
+
+    explicit operator bool() const { return !!itsOwner; }
+    std::string_view data() const { return itsData; }
+    std::size_t size() const { return itsData.size(); }
+
+    // Content-Encoding of the data, empty if not encoded
+    std::string_view encoding() const { return itsEncoding; }
+
+    // Zero-copy content for HTTP::Response::setContent(array, size). The
+    // array keeps the view alive, its contents must not be modified.
+    boost::shared_array<char> array() const
+    {
+      auto owner = itsOwner;
+      return boost::shared_array<char>(const_cast<char*>(itsData.data()), [owner](char*) {});
+    }
+
+   private:
+    std::shared_ptr<const void> itsOwner;
+    std::string_view itsData;
+    std::string_view itsEncoding;
+  };
+
+  static constexpr std::size_t write_batch_size = 32;
+
   /*
     ----------------------------------------
     * Constructor
-    * - memoryCacheSize is memory cache size in entries
+    * - memoryCacheSize is memory cache size in bytes
     * - fileCacheSize is file cache size in bytes
     * - cacheDirectory is cache directory in filesystem
+    * - memoryCacheShards is the number of memory cache shards,
+    *   zero selects it based on the number of CPUs
+    * - fileWriterThreads is the number of threads writing
+    *   evicted entries to the file cache. With more than one
+    *   thread the file cache insertion order is not preserved.
+    * - maxPendingWriteBytes bounds the write queue, zero
+    *   selects the memory cache size. The oldest entries
+    *   are dropped when the queue is full.
     * ----------------------------------------
     */
   SmartMetCache(std::size_t memoryCacheSize,
                 std::size_t fileCacheSize,
-                const fs::path& cacheDirectory);
+                const fs::path& cacheDirectory,
+                std::size_t memoryCacheShards = 0,
+                std::size_t fileWriterThreads = 1,
+                std::size_t maxPendingWriteBytes = 0);
 
   ~SmartMetCache();
 
@@ -63,6 +149,96 @@ class SmartMetCache
    */
   ValueType find(KeyType hash);
 
+  /*
+   * ----------------------------------------
+   * Find key in cache without copying file
+   * cache hits, which are memory mapped.
+   * If acceptZstd is set, compressed values
+   * may be returned as is with encoding zstd.
+   * ----------------------------------------
+   */
+  View findView(KeyType hash, bool acceptZstd = false);
+
+  /*
+   * ----------------------------------------
+   * File cache hits are promoted to memory
+   * once a file has been hit this many times
+   * since it was written. The default is 1.
+   * ----------------------------------------
+   */
+  void setFilePromotionThreshold(std::size_t theHits) { itsPromotionThreshold = theHits; }
+
+  /*
+   * ----------------------------------------
+   * Enable TinyLFU admission to the memory
+   * cache. An insert which would cause an
+   * eviction is admitted only if the new key
+   * has been accessed more often than the
+   * entry to be evicted, rejected entries go
+   * directly to the file cache. Must be
+   * called before the cache is used.
+   * ----------------------------------------
+   */
+  void enableAdmission(std::size_t expectedEntries);
+
+  // Number of inserts rejected by the admission filter
+  std::size_t getAdmissionRejections() const { return itsRejections; }
+
+  /*
+   * ----------------------------------------
+   * Enable warm restarts. On destruction the
+   * file cache index is saved for the next
+   * process, with the memory cache entries
+   * already on disk marked most recently
+   * used. At most flushBytes of memory cache
+   * entries and pending writes not yet on
+   * disk are written too, the most recently
+   * used first. This call also starts
+   * prewarming the memory cache in the
+   * background from the most recently used
+   * files, up to prewarmBytes (zero selects
+   * the memory cache size). Requires a file
+   * cache, must be called before the cache
+   * is used.
+   * ----------------------------------------
+   */
+  void enableWarmRestart(std::size_t prewarmBytes = 0, std::size_t flushBytes = 0);
+
+  // Number of entries loaded into memory by prewarming so far
+  std::size_t getPrewarmedEntries() const { return itsPrewarmed; }
+
+  /*
+   * ----------------------------------------
+   * Enable zstd compression of the values in
+   * both tiers, optionally with a dictionary
+   * trained from the first values. Recently
+   * hit values are also kept decompressed in
+   * a cache of decodedBytes, zero selects 1/8
+   * of the memory cache size. Must be called
+   * before the cache is used.
+   * Compressed values are decoded even if
+   * compression is not enabled.
+   * ----------------------------------------
+   */
+  void enableCompression(int level = 3, bool dictionary = true, std::size_t decodedBytes = 0);
+
+  CacheCompressor::Statistics getCompressionStats() const;
+
+  /*
+   * ----------------------------------------
+   * Enable a shared memory tier between the
+   * memory and file caches, shared by all
+   * processes on the node using the same
+   * name. New values are inserted into it,
+   * and hits are promoted to the memory
+   * cache. Must be called before the cache
+   * is used.
+   * ----------------------------------------
+   */
+  void enableSharedMemory(const std::string& theName, std::size_t theBytes);
+
+  SharedMemoryCache::Statistics getSharedMemoryStats() const;
+
   /*
    *----------------------------------------
    * Insert new entry into the cache
@@ -82,31 +258,89 @@ class SmartMetCache
 
   void shutdown();
 
-  Fmi::Cache::CacheStats getMemoryCacheStats() const { return itsMemoryCache.statistics(); }
+  // Move least recently used memory entries to the file cache (or drop
+  // them without one) until theBytes are evicted. Returns the bytes
+  // released, which excludes values still waiting in the write queue.
+  // Suitable as a MemoryGovernor shrink function.
+  std::size_t shrink(std::size_t theBytes);
+
+  Fmi::Cache::CacheStats getMemoryCacheStats() const;
   Fmi::Cache::CacheStats getFileCacheStats() const
   {
     return (itsFileCache ? itsFileCache->statistics() : Fmi::Cache::CacheStats());
   }
+  WriteQueueStats getWriteQueueStats() const;
 
  private:
+  // A queued write. The queue holds (key,seq) pairs, pairs whose
+  // sequence number no longer matches the pending entry are stale.
+  struct PendingWrite
+  {
+    ValueType value;
+    std::uint64_t seq = 0;
+    bool inflight = false;
+  };
+
   void operateFileCache();
 
   void queueFileWrites(const std::vector<std::pair<KeyType, ValueType>>& items);
 
-  // NumShards=1: the memory cache uses byte-based sizing (BufferSizeFunction) and
-  // feeds evicted items to the file cache, which requires deterministic LRU ordering.
-  // Sharding would split the capacity across shards, silently rejecting values that
-  // exceed the tiny per-shard limit.
-  Fmi::Cache::Cache<KeyType, ValueType, BufferSizeFunction, 1> itsMemoryCache;
+  ValueType findPendingWrite(KeyType hash);
+
+  ValueType findShared(KeyType hash);
+
+  void store(KeyType hash, const ValueType& value);
+
+  void promote(KeyType hash, const ValueType& value);
+
+  bool admit(KeyType hash, const ValueType& value) const;
+
+  void prewarm(std::size_t bytes);
+
+  fs::path dictionaryFile() const;
+  ValueType decode(const ValueType& stored) const;
+  ValueType decodeHit(KeyType hash, const ValueType& stored);
+  View decodeView(std::shared_ptr<const void> owner, std::string_view stored, bool acceptZstd) const;
+
+  void persist();
+
+  void dropPendingWrites();
+
+  // The shards share a single byte budget and evict in global LRU order,
+  // so the file cache still receives the least recently used items first.
+  ShardedMemoryCache itsMemoryCache;
+  Fmi::DateTime itsStartTime;
+
+  std::unique_ptr<SmartMetFileCache> itsFileCache;
+  std::atomic<std::size_t> itsPromotionThreshold{1};
+
+  std::unique_ptr<FrequencySketch> itsSketch;
+  std::atomic<std::size_t> itsRejections{0};
+
+  // The compressor always exists for decoding stored values, but new
+  // values are compressed only if compression is enabled
+  std::unique_ptr<CacheCompressor> itsCompressor;
+  bool itsCompression = false;
+  std::unique_ptr<ShardedMemoryCache> itsDecodedCache;
+
+  std::unique_ptr<SharedMemoryCache> itsSharedCache;
 
-  std::unique_ptr<Fmi::Cache::FileCache> itsFileCache;
+  bool itsWarmRestart = false;
+  std::size_t itsFlushBytes = 0;
+  std::thread itsPrewarmThread;
+  std::atomic<std::size_t> itsPrewarmed{0};
 
-  std::deque<std::pair<KeyType, ValueType>> itsPendingWrites;
+  // Evicted entries not yet written to the file cache, in FIFO order
+  std::unordered_map<KeyType, PendingWrite> itsPendingWrites;
+  std::deque<std::pair<KeyType, std::uint64_t>> itsWriteQueue;
+  std::uint64_t itsWriteSeq = 0;
+  std::size_t itsMaxPendingBytes;
+  WriteQueueStats itsWriteStats;
 
-  std::unique_ptr<std::thread> itsFileThread;
+  std::vector<std::thread> itsFileThreads;
 
-  // This guards the itsPendingWrites stack
-  std::mutex itsMutex;  // For condition variable, shared mutex won't do.
+  // This guards the pending writes and their statistics
+  mutable std::mutex itsMutex;  // For condition variable, shared mutex won't do.
 
   std::condition_variable itsCondition;
   std::atomic<bool> itsShutdownRequested{false};
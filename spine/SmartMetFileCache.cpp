@@ -0,0 +1,472 @@
+#include "SmartMetFileCache.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <tuple>
+
+namespace SmartMet
+{
+namespace Spine
+{
+namespace fs = std::filesystem;
+
+namespace
+{
+// Files being written have this in their name
+const char* temp_marker = ".tmp";
+
+// Index snapshot: magic, version, entry count and (key,size) pairs
+const char* index_file = "index.snapshot";
+const char index_magic[4] = {'S', 'M', 'C', 'I'};
+const std::uint32_t index_version = 1;
+
+bool parse_key(const std::string& theName, std::size_t& theKey)
+{
+  if (theName.size() != 16)
+    return false;
+  std::size_t key = 0;
+  for (char ch : theName)
+  {
+    key <<= 4;
+    if (ch >= '0' && ch <= '9')
+      key |= static_cast<std::size_t>(ch - '0');
+    else if (ch >= 'a' && ch <= 'f')
+      key |= static_cast<std::size_t>(ch - 'a' + 10);
+    else
+      return false;
+  }
+  theKey = key;
+  return true;
+}
+
+bool is_digit(char ch)
+{
+  return (ch >= '0' && ch <= '9');
+}
+
+// Subdirectories created by this class
+bool is_subdirectory_name(const std::string& theName)
+{
+  const auto hex = [](char ch) { return is_digit(ch) || (ch >= 'a' && ch <= 'f'); };
+  return (theName.size() == 2 && hex(theName[0]) && hex(theName[1]));
+}
+
+// Fmi::Cache::FileCache stored key 123456 as 12/3456
+bool is_legacy_name(const std::string& theDir, const std::string& theName)
+{
+  return (std::all_of(theDir.begin(), theDir.end(), is_digit) && !theName.empty() &&
+          std::all_of(theName.begin(), theName.end(), is_digit));
+}
+
+void remove_files(const std::vector<fs::path>& theFiles)
+{
+  std::error_code ec;
+  for (const auto& file : theFiles)
+    fs::remove(file, ec);
+}
+
+}  // namespace
+
+SmartMetFileCache::SmartMetFileCache(const fs::path& theDirectory, std::size_t theMaxSize)
+    : itsDirectory(theDirectory),
+      itsMaxSize(theMaxSize),
+      itsStartTime(Fmi::MicrosecClock::universal_time())
+{
+  try
+  {
+    fs::create_directories(itsDirectory);
+    load();
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Failed to initialize file cache")
+        .addParameter("Directory", itsDirectory.string());
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Files are spread into 256 subdirectories by the low byte of the key
+ */
+// ----------------------------------------------------------------------
+
+fs::path SmartMetFileCache::filename(KeyType theKey) const
+{
+  char dir[3];
+  char name[17];
+  std::snprintf(dir, sizeof(dir), "%02x", static_cast<unsigned>(theKey & 0xff));
+  std::snprintf(name, sizeof(name), "%016zx", theKey);
+  return itsDirectory / dir / name;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Index the files of a previous process, removing partial ones
+ *
+ * Only the 256 subdirectories created by this class are scanned. Files
+ * left there by the Fmi::Cache::FileCache used earlier, whose two digit
+ * directories are a subset of them, would never be found nor counted
+ * against the size limit, and are removed. Anything else, including
+ * files directly in the cache directory and other subdirectories, is
+ * left alone in case the directory is shared.
+ */
+// ----------------------------------------------------------------------
+
+void SmartMetFileCache::load()
+{
+  if (loadIndex())
+    return;
+
+  std::vector<std::tuple<fs::file_time_type, KeyType, std::size_t>> files;
+  std::vector<fs::path> garbage;
+
+  for (const auto& subdir : fs::directory_iterator(itsDirectory))
+  {
+    std::error_code ec;
+    const auto dirname = subdir.path().filename().string();
+    if (!is_subdirectory_name(dirname) || !subdir.is_directory(ec))
+      continue;
+
+    for (const auto& entry : fs::directory_iterator(subdir.path()))
+    {
+      if (!entry.is_regular_file(ec))
+        continue;
+
+      const auto name = entry.path().filename().string();
+      KeyType key = 0;
+      if (parse_key(name, key))
+      {
+        if (entry.path() == filename(key))
+          files.emplace_back(entry.last_write_time(ec), key, entry.file_size(ec));
+        else
+          garbage.push_back(entry.path());
+      }
+      else if (name.find(temp_marker) != std::string::npos || is_legacy_name(dirname, name))
+        garbage.push_back(entry.path());
+    }
+  }
+
+  remove_files(garbage);
+
+  std::sort(files.begin(), files.end());
+
+  {
+    WriteLock lock(itsMutex);
+    for (const auto& file : files)
+      add(std::get<1>(file), std::get<2>(file));
+    garbage = cleanup();
+  }
+  remove_files(garbage);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Load and remove the index snapshot. Returns false if there is
+ *        no valid snapshot.
+ */
+// ----------------------------------------------------------------------
+
+bool SmartMetFileCache::loadIndex()
+{
+  const auto file = itsDirectory / index_file;
+
+  std::error_code ec;
+  if (!fs::exists(file, ec))
+    return false;
+
+  std::vector<std::pair<std::uint64_t, std::uint64_t>> entries;
+  bool ok = false;
+  {
+    std::ifstream in(file, std::ios::binary);
+    char magic[4];
+    std::uint32_t version = 0;
+    std::uint64_t count = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    in.read(reinterpret_cast<char*>(&count), sizeof(count));
+
+    const auto expected_size = sizeof(magic) + sizeof(version) + sizeof(count) + count * 16;
+    if (in && std::equal(magic, magic + 4, index_magic) && version == index_version &&
+        fs::file_size(file, ec) == expected_size)
+    {
+      entries.resize(count);
+      in.read(reinterpret_cast<char*>(entries.data()),
+              static_cast<std::streamsize>(count * sizeof(entries[0])));
+      ok = !!in;
+    }
+  }
+
+  fs::remove(file, ec);
+
+  if (!ok)
+    return false;
+
+  std::vector<fs::path> garbage;
+  {
+    WriteLock lock(itsMutex);
+    for (const auto& entry : entries)
+      add(entry.first, entry.second);
+    garbage = cleanup();
+  }
+  remove_files(garbage);
+  return true;
+}
+
+bool SmartMetFileCache::saveIndex() const
+{
+  try
+  {
+    const auto index = getIndex();
+
+    const auto file = itsDirectory / index_file;
+    auto tmp = file;
+    tmp += temp_marker;
+
+    std::error_code ec;
+    {
+      std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+      const std::uint64_t count = index.size();
+      out.write(index_magic, sizeof(index_magic));
+      out.write(reinterpret_cast<const char*>(&index_version), sizeof(index_version));
+      out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+      for (const auto& entry : index)
+      {
+        const std::uint64_t key = entry.first;
+        const std::uint64_t size = entry.second;
+        out.write(reinterpret_cast<const char*>(&key), sizeof(key));
+        out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+      }
+      if (!out)
+      {
+        fs::remove(tmp, ec);
+        return false;
+      }
+    }
+
+    fs::rename(tmp, file, ec);
+    if (ec)
+    {
+      fs::remove(tmp, ec);
+      return false;
+    }
+    return true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add a key as the most recently used one. Caller holds the lock.
+ */
+// ----------------------------------------------------------------------
+
+void SmartMetFileCache::add(KeyType theKey, std::size_t theSize)
+{
+  auto pos = itsIndex.find(theKey);
+  if (pos != itsIndex.end())
+  {
+    itsSize -= pos->second->size;
+    itsLru.erase(pos->second);
+    itsIndex.erase(pos);
+  }
+
+  itsLru.push_front(Entry{theKey, theSize, 0});
+  itsIndex.emplace(theKey, itsLru.begin());
+  itsSize += theSize;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remove least recently used files until within the size limit.
+ *        Caller holds the lock.
+ *
+ * The files are only renamed to temporary names, which is cheap. The
+ * caller removes the returned files once the lock has been released,
+ * since removing large files may take a while.
+ */
+// ----------------------------------------------------------------------
+
+std::vector<fs::path> SmartMetFileCache::cleanup()
+{
+  std::vector<fs::path> ret;
+  while (itsSize > itsMaxSize && !itsLru.empty())
+  {
+    const auto& entry = itsLru.back();
+    const auto file = filename(entry.key);
+    auto tmp = file;
+    tmp += temp_marker + std::to_string(++itsTempCounter);
+    std::error_code ec;
+    fs::rename(file, tmp, ec);
+    if (!ec)
+      ret.push_back(tmp);
+    itsSize -= entry.size;
+    itsIndex.erase(entry.key);
+    itsLru.pop_back();
+  }
+  return ret;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write a value to disk. Returns false if writing failed.
+ */
+// ----------------------------------------------------------------------
+
+bool SmartMetFileCache::insert(KeyType theKey, std::string_view theValue)
+{
+  try
+  {
+    const auto file = filename(theKey);
+
+    std::error_code ec;
+    fs::create_directories(file.parent_path(), ec);
+
+    auto tmp = file;
+    tmp += temp_marker + std::to_string(++itsTempCounter);
+
+    {
+      std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+      out.write(theValue.data(), static_cast<std::streamsize>(theValue.size()));
+      if (!out)
+      {
+        fs::remove(tmp, ec);
+        return false;
+      }
+    }
+
+    fs::rename(tmp, file, ec);
+    if (ec)
+    {
+      fs::remove(tmp, ec);
+      return false;
+    }
+
+    std::vector<fs::path> garbage;
+    {
+      WriteLock lock(itsMutex);
+      add(theKey, theValue.size());
+      ++itsInserts;
+      garbage = cleanup();
+    }
+    remove_files(garbage);
+    return true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Map a cached file and mark it most recently used
+ *
+ * The file is mapped without holding the lock. Should it have been
+ * removed meanwhile, the access is counted as a miss.
+ */
+// ----------------------------------------------------------------------
+
+SmartMetFileCache::Hit SmartMetFileCache::find(KeyType theKey)
+{
+  try
+  {
+    Hit hit;
+    {
+      WriteLock lock(itsMutex);
+      auto pos = itsIndex.find(theKey);
+      if (pos == itsIndex.end())
+      {
+        ++itsMisses;
+        return hit;
+      }
+      itsLru.splice(itsLru.begin(), itsLru, pos->second);
+      hit.hits = ++pos->second->hits;
+      ++itsHits;
+    }
+
+    hit.file = MappedFile::open(filename(theKey));
+
+    if (!hit.file)
+    {
+      WriteLock lock(itsMutex);
+      --itsHits;
+      ++itsMisses;
+      std::error_code ec;
+      auto pos = itsIndex.find(theKey);
+      if (pos != itsIndex.end() && !fs::exists(filename(theKey), ec))
+      {
+        itsSize -= pos->second->size;
+        itsLru.erase(pos->second);
+        itsIndex.erase(pos);
+      }
+    }
+
+    return hit;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+std::shared_ptr<const MappedFile> SmartMetFileCache::read(KeyType theKey) const
+{
+  return MappedFile::open(filename(theKey));
+}
+
+bool SmartMetFileCache::contains(KeyType theKey) const
+{
+  ReadLock lock(itsMutex);
+  return itsIndex.find(theKey) != itsIndex.end();
+}
+
+bool SmartMetFileCache::touch(KeyType theKey)
+{
+  WriteLock lock(itsMutex);
+  auto pos = itsIndex.find(theKey);
+  if (pos == itsIndex.end())
+    return false;
+  itsLru.splice(itsLru.begin(), itsLru, pos->second);
+  return true;
+}
+
+std::vector<std::pair<SmartMetFileCache::KeyType, std::size_t>> SmartMetFileCache::getIndex() const
+{
+  ReadLock lock(itsMutex);
+  std::vector<std::pair<KeyType, std::size_t>> ret;
+  ret.reserve(itsLru.size());
+  for (auto it = itsLru.rbegin(); it != itsLru.rend(); ++it)
+    ret.emplace_back(it->key, it->size);
+  return ret;
+}
+
+std::vector<SmartMetFileCache::KeyType> SmartMetFileCache::getContent() const
+{
+  ReadLock lock(itsMutex);
+  std::vector<KeyType> ret;
+  ret.reserve(itsLru.size());
+  for (auto it = itsLru.rbegin(); it != itsLru.rend(); ++it)
+    ret.push_back(it->key);
+  return ret;
+}
+
+Fmi::Cache::CacheStats SmartMetFileCache::statistics() const
+{
+  ReadLock lock(itsMutex);
+  Fmi::Cache::CacheStats ret;
+  ret.starttime = itsStartTime;
+  ret.maxsize = itsMaxSize;
+  ret.size = itsSize;
+  ret.inserts = itsInserts;
+  ret.hits = itsHits;
+  ret.misses = itsMisses;
+  return ret;
+}
+
+}  // namespace Spine
+}  // namespace SmartMet
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "Thread.h"
+#include <macgyver/Cache.h>
+#include <macgyver/DateTime.h>
+#include <atomic>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Spine
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Size limited filesystem tier of SmartMetCache
+ *
+ * Each value is stored as is in its own file so that hits can be
+ * memory mapped instead of read. Files are written to a temporary
+ * name and renamed into place, so readers never see partial files.
+ *
+ * An in-memory index keeps the files in LRU order of access. When
+ * the total size exceeds the limit the least recently used files are
+ * removed.
+ *
+ * The index can be saved into a snapshot when the cache is no longer
+ * written to. At startup the snapshot is loaded and removed, so that a
+ * crash before the next save cannot leave a stale snapshot behind.
+ * Without a snapshot the files left by a previous process are indexed
+ * in modification time order, and files in other layouts are removed.
+ */
+// ----------------------------------------------------------------------
+
+class SmartMetFileCache
+{
+ public:
+  using KeyType = std::size_t;
+
+  struct Hit
+  {
+    std::shared_ptr<const MappedFile> file;
+    std::size_t hits = 0;  // hits since the file was written, including this one
+
+    explicit operator bool() const { return !!file; }
+  };
+
+  SmartMetFileCache(const std::filesystem::path& theDirectory, std::size_t theMaxSize);
+
+  SmartMetFileCache(const SmartMetFileCache&) = delete;
+  SmartMetFileCache& operator=(const SmartMetFileCache&) = delete;
+
+  bool insert(KeyType theKey, std::string_view theValue);
+
+  Hit find(KeyType theKey);
+
+  // Map a file without counting an access
+  std::shared_ptr<const MappedFile> read(KeyType theKey) const;
+
+  // Test whether a file is cached without counting an access
+  bool contains(KeyType theKey) const;
+
+  // Mark a file most recently used, false if it is not cached
+  bool touch(KeyType theKey);
+
+  // Keys in LRU order, the least recently used first
+  std::vector<KeyType> getContent() const;
+
+  // Keys and sizes in LRU order, the least recently used first
+  std::vector<std::pair<KeyType, std::size_t>> getIndex() const;
+
+  // Save the index for the next process. Returns false on failure.
+  bool saveIndex() const;
+
+  Fmi::Cache::CacheStats statistics() const;
+
+  const std::filesystem::path& directory() const { return itsDirectory; }
+
+ private:
+  struct Entry
+  {
+    KeyType key;
+    std::size_t size;
+    std::size_t hits;
+  };
+
+  std::filesystem::path filename(KeyType theKey) const;
+  void load();
+  bool loadIndex();
+  void add(KeyType theKey, std::size_t theSize);
+  std::vector<std::filesystem::path> cleanup();
+
+  const std::filesystem::path itsDirectory;
+  const std::size_t itsMaxSize;
+  const Fmi::DateTime itsStartTime;
+
+  mutable NamedMutexType itsMutex{"SmartMetFileCache"};
+  std::list<Entry> itsLru;  // most recently used first
+  std::unordered_map<KeyType, std::list<Entry>::iterator> itsIndex;
+  std::size_t itsSize = 0;
+  std::size_t itsInserts = 0;
+  std::size_t itsHits = 0;
+  std::size_t itsMisses = 0;
+
+  std::atomic<std::size_t> itsTempCounter{0};
+};
+
+}  // namespace Spine
+}  // namespace SmartMet
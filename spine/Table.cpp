@@ -6,7 +6,11 @@
 
 #include "Table.h"
 #include <macgyver/Exception.h>
+#include <macgyver/LocalDateTime.h>
+#include <macgyver/TimeFormatter.h>
+#include <macgyver/TimeZonePtr.h>
 #include <macgyver/TypeName.h>
+#include <macgyver/ValueFormatter.h>
 #include <sstream>
 #include <stdexcept>
 
@@ -20,6 +24,74 @@ namespace
   const std::vector<std::string> empty_names;
 }
 
+// A cell is stored in the column in its original type. Strings and
+// times are kept in separate vectors of the column, so that the cell
+// itself stays small and trivially copyable.
+struct Table::Cell
+{
+  enum class Type : std::uint8_t
+  {
+    Empty,  // never set
+    Missing,
+    String,
+    Double,
+    Integer,
+    Time
+  };
+
+  union
+  {
+    double d;
+    std::int64_t i;
+    std::size_t index;  // to strings or times
+  };
+  std::uint32_t formatter = 0;  // index to the value or time formatters
+  std::int16_t precision = 0;
+  Type type = Type::Empty;
+
+  Cell() : i(0) {}
+};
+
+struct Table::TimeValue
+{
+  Fmi::LocalDateTime time;
+  std::optional<Fmi::TimeZonePtr> zone;
+};
+
+struct Table::Column
+{
+  explicit Column(std::pmr::memory_resource* theResource)
+      : cells(theResource), strings(theResource), times(theResource), formatted(theResource)
+  {
+  }
+
+  // Cells start from the first row set in this column
+  std::size_t first = 0;
+  std::pmr::vector<Cell> cells;
+  std::pmr::vector<std::string> strings;
+  std::pmr::vector<TimeValue> times;
+  bool typed = false;  // any values other than strings
+
+  // Typed cells formatted once when the table is frozen
+  mutable std::pmr::vector<std::string> formatted;
+
+  const Cell* find(std::size_t theRow) const
+  {
+    if (theRow < first || theRow - first >= cells.size())
+      return nullptr;
+    return &cells[theRow - first];
+  }
+};
+
+Table::Table() : itsColumns(itsResource) {}
+
+Table::Table(std::pmr::memory_resource* theResource)
+    : itsResource(theResource), itsColumns(theResource)
+{
+}
+
+Table::~Table() = default;
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Test if the table is empty
@@ -28,7 +100,59 @@ namespace
 
 bool Table::empty() const
 {
-  return itsList.empty();
+  return itsColumns.empty();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Access a cell for setting, updating the array bounds
+ */
+// ----------------------------------------------------------------------
+
+Table::Cell& Table::cell(std::size_t theColumn, std::size_t theRow)
+{
+  if (itsBuildingDone)
+    throw Fmi::Exception(BCP, "Cannot set new values in Table once get has been called");
+
+  // Recalculate array bounds
+
+  if (itsColumns.empty())
+  {
+    itsMinI = itsMaxI = theColumn;
+    itsMinJ = itsMaxJ = theRow;
+  }
+  else
+  {
+    itsMinI = std::min(itsMinI, theColumn);
+    itsMaxI = std::max(itsMaxI, theColumn);
+    itsMinJ = std::min(itsMinJ, theRow);
+    itsMaxJ = std::max(itsMaxJ, theRow);
+  }
+
+  while (itsColumns.size() <= theColumn)
+    itsColumns.emplace_back(itsResource);
+
+  auto& column = itsColumns[theColumn];
+  auto& cells = column.cells;
+  if (cells.empty())
+    column.first = theRow;
+  else if (theRow < column.first)
+  {
+    cells.insert(cells.begin(), column.first - theRow, Cell());
+    column.first = theRow;
+  }
+
+  const auto pos = theRow - column.first;
+  if (cells.size() <= pos)
+    cells.resize(pos + 1);
+
+  auto& c = cells[pos];
+
+  // Release the string of a value overwritten by another type
+  if (c.type == Cell::Type::String)
+    std::string().swap(column.strings[c.index]);
+
+  return c;
 }
 
 // ----------------------------------------------------------------------
@@ -41,27 +165,125 @@ void Table::set(std::size_t theColumn, std::size_t theRow, const std::string& th
 {
   try
   {
-    if (itsBuildingDone)
-      throw Fmi::Exception(BCP, "Cannot set new values in Table once get has been called");
-
-    // Recalculate array bounds
+    auto& c = cell(theColumn, theRow);
+    auto& strings = itsColumns[theColumn].strings;
 
-    if (itsList.empty())
+    // Reuse the string of an overwritten value
+    if (c.type == Cell::Type::String)
+      strings[c.index] = theValue;
+    else
     {
-      itsMinI = itsMaxI = theColumn;
-      itsMinJ = itsMaxJ = theRow;
+      c.index = strings.size();
+      c.type = Cell::Type::String;
+      strings.push_back(theValue);
     }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void Table::setValueFormatter(const Fmi::ValueFormatter& theFormatter)
+{
+  try
+  {
+    // A visitor is often created per value with the same formatter
+    if (&theFormatter == itsValueFormatterSource &&
+        theFormatter.missing() == itsValueFormatters.back()->missing())
+      return;
+
+    // Cells already set keep using the previous formatter
+    itsValueFormatters.push_back(std::make_shared<const Fmi::ValueFormatter>(theFormatter));
+    itsValueFormatterSource = &theFormatter;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void Table::setDouble(std::size_t theColumn, std::size_t theRow, double theValue, int thePrecision)
+{
+  try
+  {
+    if (itsValueFormatters.empty())
+      throw Fmi::Exception(BCP, "Table value formatter must be set before setting numbers");
+
+    auto& c = cell(theColumn, theRow);
+    itsColumns[theColumn].typed = true;
+    c.d = theValue;
+    c.precision = static_cast<std::int16_t>(thePrecision);
+    c.formatter = static_cast<std::uint32_t>(itsValueFormatters.size() - 1);
+    c.type = Cell::Type::Double;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void Table::setInteger(std::size_t theColumn, std::size_t theRow, std::int64_t theValue)
+{
+  try
+  {
+    auto& c = cell(theColumn, theRow);
+    itsColumns[theColumn].typed = true;
+    c.i = theValue;
+    c.type = Cell::Type::Integer;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void Table::setMissing(std::size_t theColumn, std::size_t theRow)
+{
+  try
+  {
+    if (itsValueFormatters.empty())
+      throw Fmi::Exception(BCP, "Table value formatter must be set before setting missing values");
+
+    auto& c = cell(theColumn, theRow);
+    c.formatter = static_cast<std::uint32_t>(itsValueFormatters.size() - 1);
+    c.type = Cell::Type::Missing;
+    itsColumns[theColumn].typed = true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void Table::setTime(std::size_t theColumn,
+                    std::size_t theRow,
+                    const Fmi::LocalDateTime& theTime,
+                    const std::shared_ptr<Fmi::TimeFormatter>& theFormatter,
+                    const std::optional<Fmi::TimeZonePtr>& theTimeZone)
+{
+  try
+  {
+    if (!theFormatter)
+      throw Fmi::Exception(BCP, "Table time values require a time formatter");
+
+    auto& c = cell(theColumn, theRow);
+    auto& column = itsColumns[theColumn];
+    column.typed = true;
+
+    if (c.type == Cell::Type::Time)
+      column.times[c.index] = TimeValue{theTime, theTimeZone};
     else
     {
-      itsMinI = std::min(itsMinI, theColumn);
-      itsMaxI = std::max(itsMaxI, theColumn);
-      itsMinJ = std::min(itsMinJ, theRow);
-      itsMaxJ = std::max(itsMaxJ, theRow);
+      c.index = column.times.size();
+      c.type = Cell::Type::Time;
+      column.times.push_back(TimeValue{theTime, theTimeZone});
     }
 
-    // Save the element
-
-    itsList.emplace_back(element(theColumn, theRow, theValue));
+    // Consecutive values normally share the formatter
+    if (itsTimeFormatters.empty() || itsTimeFormatters.back() != theFormatter)
+      itsTimeFormatters.push_back(theFormatter);
+    c.formatter = static_cast<std::uint32_t>(itsTimeFormatters.size() - 1);
   }
   catch (...)
   {
@@ -81,7 +303,7 @@ const std::string& Table::get(std::size_t theColumn, std::size_t theRow) const
   {
     // Cannot extract values from empty data
 
-    if (itsList.empty())
+    if (itsColumns.empty())
       throw Fmi::Exception(BCP, "Table::get does not work for empty tables");
 
     // We expect user to use mini() etc in loops to make sure loops are OK
@@ -102,19 +324,24 @@ const std::string& Table::get(std::size_t theColumn, std::size_t theRow) const
       throw exception;
     }
 
-    // First call to get? Build array from list and disable further set calls
+    // First call to get? Disable further set calls
 
-    if (!itsBuildingDone)
-      build_array();
+    freeze();
 
-    // Calculate position in itsArray
+    const auto& column = itsColumns[theColumn];
+    const auto* c = column.find(theRow);
+    if (c == nullptr)
+      return itsEmptyValue;
 
-    const std::size_t i = theColumn - itsMinI;
-    const std::size_t j = theRow - itsMinJ;
-    const std::size_t w = itsMaxI - itsMinI + 1;
-    const std::size_t pos = j * w + i;
-
-    return *itsArray[pos];
+    switch (c->type)
+    {
+      case Cell::Type::Empty:
+        return itsEmptyValue;
+      case Cell::Type::String:
+        return column.strings[c->index];
+      default:
+        return column.formatted[theRow - column.first];
+    }
   }
   catch (...)
   {
@@ -134,7 +361,7 @@ std::string Table::get(std::size_t theColumn,
 {
   try
   {
-    if (not itsList.empty() and not((theColumn >= itsMinI) and (theColumn <= itsMaxI)))
+    if (not itsColumns.empty() and not((theColumn >= itsMinI) and (theColumn <= itsMaxI)))
     {
       return missing_text;
     }
@@ -150,37 +377,33 @@ std::string Table::get(std::size_t theColumn,
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Build the quick access array into strings
+ * \brief Format the typed values and disable set
+ *
+ * This is done only once, so that concurrent readers see an immutable
+ * table. Untyped columns need no formatting.
  */
 // ----------------------------------------------------------------------
 
-void Table::build_array() const
+void Table::freeze() const
 {
   try
   {
     if (itsBuildingDone)
       return;
 
-    // Initialize all elements to nullptr. The array is still
-    // of size 0 at this point, so resize will initialize
-    // everything.
-
-    const std::size_t w = itsMaxI - itsMinI + 1;
-    const std::size_t h = itsMaxJ - itsMinJ + 1;
-    const std::size_t sz = w * h;
-
-    itsArray.resize(sz, &itsEmptyValue);
-
-    // Assign pointers to valid array elements, the
-    // rest will still point to empty
-
-    for (const element& e : itsList)
-    {
-      const std::size_t pos = (e.j - itsMinJ) * w + (e.i - itsMinI);
-      itsArray[pos] = &(e.value);
-    }
-
-    itsBuildingDone = true;
+    std::call_once(itsFreezeFlag,
+                   [this]()
+                   {
+                     for (const auto& column : itsColumns)
+                     {
+                       if (!column.typed)
+                         continue;
+                       column.formatted.resize(column.cells.size());
+                       for (std::size_t j = 0; j < column.cells.size(); j++)
+                         column.formatted[j] = format(column, column.cells[j]);
+                     }
+                     itsBuildingDone = true;
+                   });
   }
   catch (...)
   {
@@ -188,6 +411,37 @@ void Table::build_array() const
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Format a typed value
+ */
+// ----------------------------------------------------------------------
+
+std::string Table::format(const Column& theColumn, const Cell& theCell) const
+{
+  switch (theCell.type)
+  {
+    case Cell::Type::Missing:
+      return itsValueFormatters[theCell.formatter]->missing();
+    case Cell::Type::Double:
+      return itsValueFormatters[theCell.formatter]->format(theCell.d, theCell.precision);
+    case Cell::Type::Integer:
+      return std::to_string(theCell.i);
+    case Cell::Type::Time:
+    {
+      const auto& t = theColumn.times[theCell.index];
+      const auto& formatter = itsTimeFormatters[theCell.formatter];
+      if (t.zone)
+        return formatter->format(t.time.local_time_in(*t.zone));
+      return formatter->format(t.time.utc_time());
+    }
+    case Cell::Type::Empty:
+    case Cell::Type::String:
+      break;
+  }
+  return {};
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Return column indices
@@ -198,11 +452,10 @@ Table::Indexes Table::columns() const
 {
   try
   {
-    if (!itsBuildingDone)
-      build_array();
+    freeze();
 
     Indexes ret;
-    if (itsList.empty())
+    if (itsColumns.empty())
       return ret;
 
     for (std::size_t i = itsMinI; i <= itsMaxI; i++)
@@ -226,11 +479,10 @@ Table::Indexes Table::rows() const
 {
   try
   {
-    if (!itsBuildingDone)
-      build_array();
+    freeze();
 
     Indexes ret;
-    if (itsList.empty())
+    if (itsColumns.empty())
       return ret;
 
     for (std::size_t j = itsMinJ, row = 0, nRows = 0; j <= itsMaxJ; j++, row++)
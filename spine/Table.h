@@ -6,13 +6,24 @@
 
 #pragma once
 
-#include <list>
+#include <atomic>
+#include <cstdint>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <optional>
 #include <set>
 #include <string>
 #include <vector>
 
+namespace Fmi
+{
+class LocalDateTime;
+class TimeFormatter;
+class TimeZonePtr;
+class ValueFormatter;
+}  // namespace Fmi
+
 namespace SmartMet
 {
 namespace Spine
@@ -20,13 +31,45 @@ namespace Spine
 class Table
 {
  public:
-  Table() = default;
+  Table();
+
+  // Cell storage is allocated from the given resource, for example
+  // HTTP::Request::getMemoryResource() for a table formatted into the response
+  explicit Table(std::pmr::memory_resource* theResource);
+
+  ~Table();
+
   Table(const Table& other) = delete;
   Table(Table&& other) = delete;
   Table& operator=(const Table& other) = delete;
   Table& operator=(Table&& other) = delete;
 
   void set(std::size_t theColumn, std::size_t theRow, const std::string& theValue);
+
+  // Typed values are stored as is and formatted only when the table is
+  // output. Numbers and missing values are formatted with the value
+  // formatter most recently set before setDouble or setMissing is used.
+  // The formatter is copied, unless the same object with the same missing
+  // value text was set last. Formatters must hence not be modified
+  // otherwise while the table is being filled.
+  void setValueFormatter(const Fmi::ValueFormatter& theFormatter);
+  bool hasValueFormatter() const { return !itsValueFormatters.empty(); }
+  std::size_t valueFormatterCount() const { return itsValueFormatters.size(); }
+
+  void setDouble(std::size_t theColumn, std::size_t theRow, double theValue, int thePrecision);
+  void setInteger(std::size_t theColumn, std::size_t theRow, std::int64_t theValue);
+  void setMissing(std::size_t theColumn, std::size_t theRow);
+
+  // The formatter and time zone are stored for each value. Without a time
+  // zone the time is formatted in UTC.
+  void setTime(std::size_t theColumn,
+               std::size_t theRow,
+               const Fmi::LocalDateTime& theTime,
+               const std::shared_ptr<Fmi::TimeFormatter>& theFormatter,
+               const std::optional<Fmi::TimeZonePtr>& theTimeZone);
+
+  // Typed values are all formatted on first access, after which set is
+  // disabled. Concurrent access is safe once the table has been filled.
   const std::string& get(std::size_t theColumn, std::size_t theRow) const;
   std::string get(std::size_t theColumn, std::size_t theRow, const std::string& missing_text) const;
 
@@ -60,7 +103,13 @@ class Table
   const std::string getDefaultFormat() const;
 
  private:
-  void build_array() const;
+  struct Cell;
+  struct Column;
+  struct TimeValue;
+
+  Cell& cell(std::size_t theColumn, std::size_t theRow);
+  void freeze() const;
+  std::string format(const Column& theColumn, const Cell& theCell) const;
 
   struct Metadata
   {
@@ -89,19 +138,6 @@ class Table
 
   Metadata& getMutableMetadata();
 
-  // Elements are stored like this into a list
-  struct element
-  {
-    std::size_t i = 0;
-    std::size_t j = 0;
-    std::string value;
-
-    element(std::size_t theI, std::size_t theJ, std::string theValue)
-        : i(theI), j(theJ), value(std::move(theValue))
-    {
-    }
-  };
-
   // array limits
   std::size_t itsMinI = 0;
   std::size_t itsMaxI = 0;
@@ -110,14 +146,18 @@ class Table
 
   std::string itsMissingText;
 
-  // list of all elements
-  std::list<element> itsList;
+  // Typed columns indexed by column number, their cells by row number
+  std::pmr::memory_resource* itsResource = std::pmr::get_default_resource();
+  std::pmr::vector<Column> itsColumns;
 
-  // built when first get is done, and set will be disabled
-  mutable std::vector<const std::string*> itsArray;
+  // Formatters referred to by the typed cells
+  std::vector<std::shared_ptr<const Fmi::ValueFormatter>> itsValueFormatters;
+  const Fmi::ValueFormatter* itsValueFormatterSource = nullptr;  // of the last copy
+  std::vector<std::shared_ptr<Fmi::TimeFormatter>> itsTimeFormatters;
 
   // false if get has not been accessed yet
-  mutable bool itsBuildingDone = false;
+  mutable std::atomic<bool> itsBuildingDone{false};
+  mutable std::once_flag itsFreezeFlag;
 
   const std::string itsEmptyValue;
 
@@ -1,13 +1,78 @@
 // ======================================================================
 
 #include "TableFormatter.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
 
 namespace SmartMet
 {
 namespace Spine
 {
+namespace
+{
+// Formats the whole string on the first call
+class StringCursor : public TableFormatter::Cursor
+{
+ public:
+  StringCursor(const TableFormatter& theFormatter,
+               const Table& theTable,
+               const TableFormatter::Names& theNames,
+               const HTTP::Request& theReq,
+               const TableFormatterOptions& theConfig)
+      : itsFormatter(theFormatter),
+        itsTable(theTable),
+        itsNames(theNames),
+        itsRequest(theReq),
+        itsConfig(theConfig)
+  {
+  }
+
+  bool next(std::string& theOutput, std::size_t theChunkSize) override
+  {
+    if (!itsFormatted)
+    {
+      itsResult = itsFormatter.format(itsTable, itsNames, itsRequest, itsConfig);
+      itsFormatted = true;
+    }
+
+    const auto n = std::min(theChunkSize, itsResult.size() - itsPos);
+    theOutput.append(itsResult, itsPos, n);
+    itsPos += n;
+    return itsPos < itsResult.size();
+  }
+
+ private:
+  const TableFormatter& itsFormatter;
+  const Table& itsTable;
+  const TableFormatter::Names& itsNames;
+  const HTTP::Request& itsRequest;
+  const TableFormatterOptions& itsConfig;
+  std::string itsResult;
+  std::size_t itsPos = 0;
+  bool itsFormatted = false;
+};
+
+}  // namespace
+
 // Defined here to avoid a weak vtable
 TableFormatter::~TableFormatter() = default;
+TableFormatter::Cursor::~Cursor() = default;
+
+std::unique_ptr<TableFormatter::Cursor> TableFormatter::cursor(
+    const Table& theTable,
+    const Names& theNames,
+    const HTTP::Request& theReq,
+    const TableFormatterOptions& theConfig) const
+{
+  try
+  {
+    return std::make_unique<StringCursor>(*this, theTable, theNames, theReq, theConfig);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
 
 }  // namespace Spine
 }  // namespace SmartMet
@@ -6,6 +6,7 @@
 
 #pragma once
 #include <iosfwd>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -26,15 +27,36 @@ class TableFormatter
  public:
   using Names = std::vector<std::string>;
 
+  static const std::size_t default_minimum_size = 8191;
+  static const std::size_t default_chunk_size = 65536;
+
+  // Formats the output on demand. Each call of next() appends whole rows
+  // to the output until at least the given number of bytes has been
+  // appended, and returns false once the output is complete. Hence the
+  // memory needed does not depend on the size of the table. The table,
+  // names, request and options must outlive the cursor.
+  class Cursor
+  {
+   public:
+    virtual ~Cursor();
+    virtual bool next(std::string& theOutput, std::size_t theChunkSize) = 0;
+  };
+
   virtual ~TableFormatter();
   virtual std::string format(const Table& theTable,
                              const Names& theNames,
                              const HTTP::Request& theReq,
                              const TableFormatterOptions& theConfig) const = 0;
 
-  virtual std::string mimetype() const = 0;
+  // Formatters which do not format incrementally return a cursor which
+  // formats the whole string on the first call and then hands it out
+  // in chunks.
+  virtual std::unique_ptr<Cursor> cursor(const Table& theTable,
+                                         const Names& theNames,
+                                         const HTTP::Request& theReq,
+                                         const TableFormatterOptions& theConfig) const;
 
-  static const std::size_t default_minimum_size = 8191;
+  virtual std::string mimetype() const = 0;
 
 };  // class TableFormatter
 
@@ -0,0 +1,84 @@
+// ======================================================================
+
+#include "TableStreamer.h"
+#include "Table.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+#include <iostream>
+
+namespace SmartMet
+{
+namespace Spine
+{
+TableStreamer::TableStreamer(std::shared_ptr<const TableFormatter> theFormatter,
+                             std::shared_ptr<const Table> theTable,
+                             TableFormatter::Names theNames,
+                             const HTTP::Request& theRequest,
+                             TableFormatterOptions theConfig,
+                             std::size_t theChunkSize)
+    : itsFormatter(std::move(theFormatter)),
+      itsTable(std::move(theTable)),
+      itsNames(std::move(theNames)),
+      itsRequest(theRequest),
+      itsConfig(std::move(theConfig)),
+      itsChunkSize(std::max<std::size_t>(1, theChunkSize))
+{
+  try
+  {
+    if (!itsFormatter || !itsTable)
+      throw Fmi::Exception(BCP, "TableStreamer requires a formatter and a table");
+
+    // Formatting continues after the handler has returned, hence the
+    // copy must not share the arena of the original request
+    itsRequest.detachMemoryResource();
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Format the next chunk
+ *
+ * Formatting errors are reported via the status, since the headers
+ * have already been sent.
+ */
+// ----------------------------------------------------------------------
+
+std::string TableStreamer::getChunk()
+{
+  try
+  {
+    if (!itsDone)
+    {
+      if (!itsCursor)
+        itsCursor = itsFormatter->cursor(*itsTable, itsNames, itsRequest, itsConfig);
+
+      std::string chunk;
+      chunk.reserve(itsChunkSize);
+      itsDone = !itsCursor->next(chunk, itsChunkSize);
+      if (itsDone)
+        itsCursor.reset();
+
+      if (!chunk.empty())
+        return chunk;
+    }
+
+    if (getStatus() != StreamerStatus::EXIT_ERROR)
+      setStatus(StreamerStatus::EXIT_OK);
+  }
+  catch (...)
+  {
+    std::cerr << Fmi::Exception::Trace(BCP, "Table streaming failed!").getStackTrace();
+    itsDone = true;
+    itsCursor.reset();
+    setStatus(StreamerStatus::EXIT_ERROR);
+  }
+
+  return {};
+}
+
+}  // namespace Spine
+}  // namespace SmartMet
@@ -0,0 +1,67 @@
+// ======================================================================
+/*!
+ * \brief Streams a formatted table into an HTTP response
+ *
+ * The table is formatted on demand: each getChunk() call formats the
+ * next rows via a TableFormatter::Cursor. Hence the first bytes reach
+ * the client before the whole table has been formatted, formatting
+ * proceeds only as fast as the client reads, and no thread or queue is
+ * needed.
+ *
+ * Usage:
+ *
+ *   auto table = std::make_shared<Spine::Table>();
+ *   ...
+ *   theResponse.setContent(std::make_shared<Spine::TableStreamer>(
+ *       formatter, table, names, theRequest, config));
+ *
+ * The table must not be allocated from the request arena, since the
+ * request may end before the table has been formatted.
+ */
+// ======================================================================
+
+#pragma once
+
+#include "HTTP.h"
+#include "TableFormatter.h"
+#include "TableFormatterOptions.h"
+#include <memory>
+#include <string>
+
+namespace SmartMet
+{
+namespace Spine
+{
+class Table;
+
+class TableStreamer : public HTTP::ContentStreamer
+{
+ public:
+  TableStreamer(std::shared_ptr<const TableFormatter> theFormatter,
+                std::shared_ptr<const Table> theTable,
+                TableFormatter::Names theNames,
+                const HTTP::Request& theRequest,
+                TableFormatterOptions theConfig,
+                std::size_t theChunkSize = TableFormatter::default_chunk_size);
+
+  TableStreamer(const TableStreamer& other) = delete;
+  TableStreamer& operator=(const TableStreamer& other) = delete;
+
+  // Formats the next chunk of about the given size. An empty chunk
+  // signals the end, the status tells whether formatting succeeded.
+  std::string getChunk() override;
+
+ private:
+  std::shared_ptr<const TableFormatter> itsFormatter;
+  std::shared_ptr<const Table> itsTable;
+  TableFormatter::Names itsNames;
+  HTTP::Request itsRequest;
+  TableFormatterOptions itsConfig;
+  std::size_t itsChunkSize;
+
+  std::unique_ptr<TableFormatter::Cursor> itsCursor;
+  bool itsDone = false;
+};
+
+}  // namespace Spine
+}  // namespace SmartMet
@@ -8,11 +8,23 @@ namespace Spine
 {
 /* TableVisitor */
 
+// Numbers are stored typed and formatted with a copy of our value
+// formatter when the table is output
+void TableVisitor::useValueFormatter()
+{
+  if (!itsValueFormatterSet)
+  {
+    itsTable.setValueFormatter(itsValueFormatter);
+    itsValueFormatterSet = true;
+  }
+}
+
 void TableVisitor::operator()(const None& /* none */)
 {
   try
   {
-    itsTable.set(itsCurrentColumn, itsCurrentRow++, itsValueFormatter.missing());
+    useValueFormatter();
+    itsTable.setMissing(itsCurrentColumn, itsCurrentRow++);
   }
   catch (...)
   {
@@ -36,15 +48,15 @@ void TableVisitor::operator()(double d)
 {
   try
   {
+    useValueFormatter();
+
     if (d == static_cast<double>(kFloatMissing))
     {
-      itsTable.set(itsCurrentColumn, itsCurrentRow++, itsValueFormatter.missing());
+      itsTable.setMissing(itsCurrentColumn, itsCurrentRow++);
       return;
     }
 
-    itsTable.set(itsCurrentColumn,
-                 itsCurrentRow++,
-                 itsValueFormatter.format(d, itsPrecisions[itsCurrentColumn]));
+    itsTable.setDouble(itsCurrentColumn, itsCurrentRow++, d, itsPrecisions[itsCurrentColumn]);
   }
   catch (...)
   {
@@ -56,7 +68,7 @@ void TableVisitor::operator()(int i)
 {
   try
   {
-    itsTable.set(itsCurrentColumn, itsCurrentRow++, std::to_string(i));
+    itsTable.setInteger(itsCurrentColumn, itsCurrentRow++, i);
   }
   catch (...)
   {
@@ -97,26 +109,22 @@ void TableVisitor::operator()(const Fmi::LocalDateTime& ldt)
 {
   try
   {
-    std::string res;
-
     if (ldt.is_not_a_date_time())
-      res = itsValueFormatter.missing();
+    {
+      useValueFormatter();
+      itsTable.setMissing(itsCurrentColumn, itsCurrentRow++);
+    }
     else if (itsTimeFormatter != nullptr)
     {
-      if (itsTimeZonePtr)
-        res = itsTimeFormatter->format(ldt.local_time_in(*itsTimeZonePtr));
-      else
-        res = itsTimeFormatter->format(ldt.utc_time());
+      itsTable.setTime(itsCurrentColumn, itsCurrentRow++, ldt, itsTimeFormatter, itsTimeZonePtr);
     }
     else
     {
       // Fall back to stream formatting
       std::ostringstream ss;
       ss << ldt;
-      res = ss.str();
+      itsTable.set(itsCurrentColumn, itsCurrentRow++, ss.str());
     }
-
-    itsTable.set(itsCurrentColumn, itsCurrentRow++, res);
   }
   catch (...)
   {
@@ -24,6 +24,9 @@ class TableVisitor
   std::shared_ptr<Fmi::TimeFormatter> itsTimeFormatter;
   std::optional<Fmi::TimeZonePtr> itsTimeZonePtr;
   LonLatFormat itsLonLatFormat;
+  bool itsValueFormatterSet = false;
+
+  void useValueFormatter();
 
  public:
   TableVisitor(Table& table,
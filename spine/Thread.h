@@ -8,13 +8,34 @@
 
 #include <boost/thread.hpp>
 
+#ifdef SMARTMET_SPINE_LOCK_PROFILING
+#include "ProfiledMutex.h"
+#endif
+
 namespace SmartMet
 {
 namespace Spine
 {
-// scoped read/write lock types
+// Spine's own mutexes are named, e.g. NamedMutexType itsMutex{"FileCache"},
+// so that their contention is reported under that name when spine is
+// compiled with SMARTMET_SPINE_LOCK_PROFILING. Otherwise MutexType stays
+// boost::shared_mutex and the name is ignored. Plugins may use either.
 
+#ifdef SMARTMET_SPINE_LOCK_PROFILING
+using MutexType = ProfiledMutex;
+using NamedMutexType = ProfiledMutex;
+#else
 using MutexType = boost::shared_mutex;
+
+class NamedMutexType : public MutexType
+{
+ public:
+  explicit NamedMutexType(const char* /* theName */) {}
+};
+#endif
+
+// scoped read/write lock types
+
 using ReadLock = boost::shared_lock<MutexType>;
 using WriteLock = boost::unique_lock<MutexType>;
 using UpgradeReadLock = boost::upgrade_lock<MutexType>;
@@ -39,49 +39,90 @@ std::set<std::string> parse_xml_attributes(const std::string& theStr)
   }
 }
 
+namespace
+{
 // ----------------------------------------------------------------------
 /*!
- * \brief Format a 2D table
+ * \brief Formats the root element and the rows on demand
  */
 // ----------------------------------------------------------------------
 
-std::string XmlFormatter::format(const Table& theTable,
-                                 const TableFormatter::Names& theNames,
-                                 const HTTP::Request& theReq,
-                                 const TableFormatterOptions& theConfig) const
+class XmlCursor : public TableFormatter::Cursor
+{
+ public:
+  XmlCursor(const Table& theTable,
+            const TableFormatter::Names& theNames,
+            const HTTP::Request& theReq,
+            const TableFormatterOptions& theConfig);
+
+  bool next(std::string& theOutput, std::size_t theChunkSize) override;
+
+ private:
+  enum class Style
+  {
+    Attributes,
+    Tags,
+    Mixed
+  };
+
+  void format_attributes(std::string& out, std::size_t j) const;
+  void format_tags(std::string& out, std::size_t j) const;
+  void format_mixed(std::string& out, std::size_t j) const;
+
+  const Table& itsTable;
+  const TableFormatter::Names& itsNames;
+  const std::string& itsTag;
+  const Table::Indexes itsCols;
+  const Table::Indexes itsRows;
+  Table::Indexes::const_iterator itsRow;
+  Style itsStyle = Style::Attributes;
+  std::set<std::string> itsAttributes;
+  std::string itsMissing = "nan";
+  bool itsStarted = false;
+};
+
+XmlCursor::XmlCursor(const Table& theTable,
+                     const TableFormatter::Names& theNames,
+                     const HTTP::Request& theReq,
+                     const TableFormatterOptions& theConfig)
+    : itsTable(theTable),
+      itsNames(theTable.getNames(theNames, false)),
+      itsTag(theConfig.xmlTag()),
+      itsCols(theTable.columns()),
+      itsRows(theTable.rows()),
+      itsRow(itsRows.begin())
 {
   try
   {
-    std::string out = R"(<?xml version="1.0" encoding="UTF-8" ?>)"
-                      "\n";
-
-    const auto& tag = theConfig.xmlTag();
+    auto missing = theReq.getParameter("missingtext");
+    if (missing)
+      itsMissing = *missing;
 
     std::string style;
     auto givenstyle = theReq.getParameter("xmlstyle");
 
-    const auto& names = theTable.getNames(theNames, false);
-
     if (!givenstyle)
       style = "attributes";
     else
       style = *givenstyle;
 
     if (style == "attributes")
-      out += format_attributes(theTable, names, tag, theReq);
+      itsStyle = Style::Attributes;
     else if (style == "tags")
-      out += format_tags(theTable, names, tag, theReq);
+      itsStyle = Style::Tags;
     else if (style == "mixed")
     {
-      if (theReq.getParameter("attributes"))
-        out += format_mixed(theTable, names, tag, theReq);
+      auto attr = theReq.getParameter("attributes");
+      if (attr)
+      {
+        itsStyle = Style::Mixed;
+        itsAttributes = parse_xml_attributes(*attr);
+      }
       else
-        out += format_tags(theTable, names, tag, theReq);
+        itsStyle = Style::Tags;
     }
     else
       throw Fmi::Exception(BCP, "Unknown xmlstyle '" + style + "'");
-
-    return out;
   }
   catch (...)
   {
@@ -89,57 +130,46 @@ std::string XmlFormatter::format(const Table& theTable,
   }
 }
 
-// ----------------------------------------------------------------------
-/*!
- * \brief Format a 2D table using attributes style
- */
-// ----------------------------------------------------------------------
-
-std::string XmlFormatter::format_attributes(const Table& theTable,
-                                            const TableFormatter::Names& theNames,
-                                            const std::string& theTag,
-                                            const HTTP::Request& theReq) const
+bool XmlCursor::next(std::string& theOutput, std::size_t theChunkSize)
 {
   try
   {
-    std::string out;
-    out.reserve(TableFormatter::default_minimum_size);
-
-    std::string miss;
-    auto missing = theReq.getParameter("missingtext");
-
-    if (!missing)
-      miss = "nan";
-    else
-      miss = *missing;
-
-    const Table::Indexes cols = theTable.columns();
-    const Table::Indexes rows = theTable.rows();
+    std::string& out = theOutput;
+    const auto start = out.size();
 
-    out += '<';
-    out += theTag;
-    out += ">\n";
+    if (!itsStarted)
+    {
+      out += R"(<?xml version="1.0" encoding="UTF-8" ?>)"
+             "\n";
+      out += '<';
+      out += itsTag;
+      out += ">\n";
+      itsStarted = true;
+    }
 
-    for (std::size_t j : rows)
+    for (; itsRow != itsRows.end() && out.size() - start < theChunkSize; ++itsRow)
     {
-      out += "<row";
-      for (std::size_t i : cols)
+      switch (itsStyle)
       {
-        out += ' ';
-        const std::string& name = theNames[i];
-        std::string value = theTable.get(i, j);
-        boost::algorithm::replace_all(value, "\"", "&quot;");  // Escape possible quotes
-        out += name;
-        out += "=\"";
-        out += (value.empty() ? miss : value);
-        out += '"';
+        case Style::Attributes:
+          format_attributes(out, *itsRow);
+          break;
+        case Style::Tags:
+          format_tags(out, *itsRow);
+          break;
+        case Style::Mixed:
+          format_mixed(out, *itsRow);
+          break;
       }
-      out += "/>\n";
     }
+
+    if (itsRow != itsRows.end())
+      return true;
+
     out += "</";
-    out += theTag;
+    out += itsTag;
     out += ">\n";
-    return out;
+    return false;
   }
   catch (...)
   {
@@ -149,145 +179,137 @@ std::string XmlFormatter::format_attributes(const Table& theTable,
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Format a 2D table using tags style
+ * \brief Format a row using attributes style
  */
 // ----------------------------------------------------------------------
 
-std::string XmlFormatter::format_tags(const Table& theTable,
-                                      const TableFormatter::Names& theNames,
-                                      const std::string& theTag,
-                                      const HTTP::Request& theReq) const
+void XmlCursor::format_attributes(std::string& out, std::size_t j) const
 {
-  try
+  out += "<row";
+  for (std::size_t i : itsCols)
   {
-    std::string out;
-    out.reserve(TableFormatter::default_minimum_size);
-
-    std::string miss;
-    auto missing = theReq.getParameter("missingtext");
-
-    if (!missing)
-      miss = "nan";
-    else
-      miss = *missing;
+    out += ' ';
+    const std::string& name = itsNames[i];
+    std::string value = itsTable.get(i, j);
+    boost::algorithm::replace_all(value, "\"", "&quot;");  // Escape possible quotes
+    out += name;
+    out += "=\"";
+    out += (value.empty() ? itsMissing : value);
+    out += '"';
+  }
+  out += "/>\n";
+}
 
-    const Table::Indexes cols = theTable.columns();
-    const Table::Indexes rows = theTable.rows();
+// ----------------------------------------------------------------------
+/*!
+ * \brief Format a row using tags style
+ */
+// ----------------------------------------------------------------------
 
+void XmlCursor::format_tags(std::string& out, std::size_t j) const
+{
+  out += "<row>\n";
+  for (std::size_t i : itsCols)
+  {
+    const std::string& name = itsNames[i];
+    std::string value = itsTable.get(i, j);
+    boost::algorithm::replace_all(value, "\"", "&quot;");  // Escape possible quotes
     out += '<';
-    out += theTag;
+    out += name;
+    out += '>';
+    out += (value.empty() ? itsMissing : value);
+    out += "</";
+    out += name;
     out += ">\n";
+  }
+  out += "</row>\n";
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Format a row using mixed style
+ */
+// ----------------------------------------------------------------------
 
-    for (std::size_t j : rows)
+void XmlCursor::format_mixed(std::string& out, std::size_t j) const
+{
+  out += "<row";
+  for (std::size_t i : itsCols)
+  {
+    const std::string& name = itsNames[i];
+    if (itsAttributes.find(name) != itsAttributes.end())
     {
-      out += "<row>\n";
-      for (std::size_t i : cols)
-      {
-        const std::string& name = theNames[i];
-        std::string value = theTable.get(i, j);
-        boost::algorithm::replace_all(value, "\"", "&quot;");  // Escape possible quotes
-        out += '<';
-        out += name;
-        out += '>';
-        out += (value.empty() ? miss : value);
-        out += "</";
-        out += name;
-        out += ">\n";
-      }
-      out += "</row>\n";
+      std::string value = itsTable.get(i, j);
+      boost::algorithm::replace_all(value, "\"", "&quot;");  // Escape possible quotes
+      out += ' ';
+      out += name;
+      out += "=\"";
+      out += (value.empty() ? itsMissing : value);
+      out += '"';
     }
-    out += "</";
-    out += theTag;
-    out += ">\n";
-    return out;
   }
-  catch (...)
+  out += ">\n";
+
+  for (std::size_t i : itsCols)
   {
-    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+    const std::string& name = itsNames[i];
+    if (itsAttributes.find(name) == itsAttributes.end())
+    {
+      std::string value = itsTable.get(i, j);
+      boost::algorithm::replace_all(value, "\"", "&quot;");  // Escape possible quotes
+      out += '<';
+      out += name;
+      out += '>';
+      out += (value.empty() ? itsMissing : value);
+      out += "</";
+      out += name;
+      out += ">\n";
+    }
   }
+  out += "</row>\n";
 }
 
+}  // namespace
+
 // ----------------------------------------------------------------------
 /*!
- * \brief Format a 2D table using mixed style
+ * \brief Format a 2D table
  */
 // ----------------------------------------------------------------------
 
-std::string XmlFormatter::format_mixed(const Table& theTable,
-                                       const TableFormatter::Names& theNames,
-                                       const std::string& theTag,
-                                       const HTTP::Request& theReq) const
+std::string XmlFormatter::format(const Table& theTable,
+                                 const TableFormatter::Names& theNames,
+                                 const HTTP::Request& theReq,
+                                 const TableFormatterOptions& theConfig) const
 {
   try
   {
     std::string out;
-    out.reserve(TableFormatter::default_minimum_size);
-
-    std::string miss;
-    auto missing = theReq.getParameter("missingtext");
-
-    if (!missing)
-      miss = "nan";
-    else
-      miss = *missing;
-
-    const Table::Indexes cols = theTable.columns();
-    const Table::Indexes rows = theTable.rows();
-
-    std::string attribstring;
-    auto attr = theReq.getParameter("attributes");
-    if (!attr)
-      throw Fmi::Exception(BCP, "attribute list is required in mixed style formatting");
-
-    attribstring = *attr;
-
-    std::set<std::string> atts = parse_xml_attributes(attribstring);
-
-    out += '<';
-    out += theTag;
-    out += ">\n";
+    out.reserve(default_minimum_size);
+    XmlCursor(theTable, theNames, theReq, theConfig).next(out, std::string::npos);
+    return out;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
 
-    for (std::size_t j : rows)
-    {
-      out += "<row";
-      for (std::size_t i : cols)
-      {
-        const std::string& name = theNames[i];
-        if (atts.find(name) != atts.end())
-        {
-          std::string value = theTable.get(i, j);
-          boost::algorithm::replace_all(value, "\"", "&quot;");  // Escape possible quotes
-          out += ' ';
-          out += name;
-          out += "=\"";
-          out += (value.empty() ? miss : value);
-          out += '"';
-        }
-      }
-      out += ">\n";
+// ----------------------------------------------------------------------
+/*!
+ * \brief Format a 2D table on demand
+ */
+// ----------------------------------------------------------------------
 
-      for (std::size_t i : cols)
-      {
-        const std::string& name = theNames[i];
-        if (atts.find(name) == atts.end())
-        {
-          std::string value = theTable.get(i, j);
-          boost::algorithm::replace_all(value, "\"", "&quot;");  // Escape possible quotes
-          out += '<';
-          out += name;
-          out += '>';
-          out += (value.empty() ? miss : value);
-          out += "</";
-          out += name;
-          out += ">\n";
-        }
-      }
-      out += "</row>\n";
-    }
-    out += "</";
-    out += theTag;
-    out += ">\n";
-    return out;
+std::unique_ptr<TableFormatter::Cursor> XmlFormatter::cursor(
+    const Table& theTable,
+    const TableFormatter::Names& theNames,
+    const HTTP::Request& theReq,
+    const TableFormatterOptions& theConfig) const
+{
+  try
+  {
+    return std::make_unique<XmlCursor>(theTable, theNames, theReq, theConfig);
   }
   catch (...)
   {
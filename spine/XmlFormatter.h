@@ -22,23 +22,12 @@ class XmlFormatter : public TableFormatter
                      const HTTP::Request& theReq,
                      const TableFormatterOptions& theConfig) const override;
 
-  std::string mimetype() const override { return "application/xml"; }
-
- private:
-  std::string format_attributes(const Table& theTable,
-                                const TableFormatter::Names& theNames,
-                                const std::string& theTag,
-                                const HTTP::Request& theReq) const;
+  std::unique_ptr<Cursor> cursor(const Table& theTable,
+                                 const TableFormatter::Names& theNames,
+                                 const HTTP::Request& theReq,
+                                 const TableFormatterOptions& theConfig) const override;
 
-  std::string format_tags(const Table& theTable,
-                          const TableFormatter::Names& theNames,
-                          const std::string& theTag,
-                          const HTTP::Request& theReq) const;
-
-  std::string format_mixed(const Table& theTable,
-                           const TableFormatter::Names& theNames,
-                           const std::string& theTag,
-                           const HTTP::Request& theReq) const;
+  std::string mimetype() const override { return "application/xml"; }
 };
 }  // namespace Spine
 }  // namespace SmartMet
@@ -0,0 +1,235 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Regression tests for class AccessLogger
+ */
+// ======================================================================
+
+#include "AccessLogger.h"
+#include <macgyver/DateTime.h>
+#include <regression/tframe.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+using SmartMet::Spine::AccessLogger;
+using SmartMet::Spine::AccessLogOptions;
+using SmartMet::Spine::LoggedRequest;
+
+namespace
+{
+std::string logdir()
+{
+  return "/tmp/" + std::to_string(getuid()) + "/accesslogtest";
+}
+
+LoggedRequest request(int theNumber)
+{
+  return LoggedRequest("/test?n=" + std::to_string(theNumber),
+                       Fmi::MicrosecClock::universal_time(),
+                       Fmi::Milliseconds(5),
+                       Fmi::Milliseconds(1),
+                       "200",
+                       "127.0.0.1",
+                       "GET",
+                       "1.1",
+                       100,
+                       "-",
+                       "-");
+}
+
+// Count lines in all files in the log directory
+std::size_t count_lines()
+{
+  std::size_t count = 0;
+  for (const auto& entry : std::filesystem::directory_iterator(logdir()))
+  {
+    std::ifstream in(entry.path());
+    std::string line;
+    while (std::getline(in, line))
+      ++count;
+  }
+  return count;
+}
+
+std::size_t count_files()
+{
+  std::size_t count = 0;
+  for (const auto& entry : std::filesystem::directory_iterator(logdir()))
+  {
+    (void)entry;
+    ++count;
+  }
+  return count;
+}
+
+}  // namespace
+
+//! Protection against conflicts with global functions
+namespace AccessLoggerTest
+{
+// ----------------------------------------------------------------------
+
+void concurrent()
+{
+  std::filesystem::remove_all(logdir());
+
+  AccessLogOptions options;
+  options.queue_size = 65536;
+  options.flush_interval_ms = 10;
+
+  AccessLogger logger("/test", logdir(), options);
+  logger.start();
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++)
+    threads.emplace_back(
+        [&logger]()
+        {
+          for (int i = 0; i < 10000; i++)
+            logger.log(request(i));
+        });
+
+  for (auto& thread : threads)
+    thread.join();
+
+  logger.stop();
+
+  const auto stats = logger.getStatistics();
+  if (stats.written + stats.dropped != 40000)
+    TEST_FAILED("Written and dropped requests should add up to 40000");
+
+  if (count_lines() != stats.written)
+    TEST_FAILED("Expected " + std::to_string(stats.written) + " lines, got " +
+                std::to_string(count_lines()));
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void drops()
+{
+  std::filesystem::remove_all(logdir());
+
+  AccessLogOptions options;
+  options.queue_size = 16;
+  options.flush_interval_ms = 60000;  // the writer stays asleep until stop()
+
+  AccessLogger logger("/test", logdir(), options);
+  logger.start();
+
+  for (int i = 0; i < 100; i++)
+    logger.log(request(i));
+
+  logger.stop();
+
+  const auto stats = logger.getStatistics();
+  if (stats.dropped == 0)
+    TEST_FAILED("A full queue should drop requests");
+
+  if (stats.written + stats.dropped != 100)
+    TEST_FAILED("Written and dropped requests should add up to 100");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void rotation()
+{
+  std::filesystem::remove_all(logdir());
+
+  AccessLogOptions options;
+  options.queue_size = 65536;
+  options.rotate_size_mb = 1;
+
+  AccessLogger logger("/test", logdir(), options);
+  logger.start();
+
+  // About 100 bytes per line, hence several megabytes in total
+  for (int i = 0; i < 40000; i++)
+    logger.log(request(i));
+
+  logger.stop();
+
+  const auto stats = logger.getStatistics();
+  if (stats.dropped != 0)
+    TEST_FAILED("No requests should have been dropped");
+
+  if (stats.rotations == 0 || count_files() != stats.rotations + 1)
+    TEST_FAILED("Log should have been rotated");
+
+  if (count_lines() != 40000)
+    TEST_FAILED("Rotation lost requests, got " + std::to_string(count_lines()) + " lines");
+
+  std::filesystem::remove_all(logdir());
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+// Requests logged while paused are ignored, the writer thread keeps running
+void pause()
+{
+  std::filesystem::remove_all(logdir());
+
+  AccessLogOptions options;
+  options.flush_interval_ms = 10;
+
+  AccessLogger logger("/test", logdir(), options);
+  logger.start();
+  for (int i = 0; i < 10; i++)
+    logger.log(request(i));
+
+  logger.pause();
+  if (logger.getStatistics().running)
+    TEST_FAILED("Paused logger should not be running");
+
+  for (int i = 0; i < 10; i++)
+    logger.log(request(i));
+
+  logger.start();
+  for (int i = 0; i < 10; i++)
+    logger.log(request(i));
+
+  logger.stop();
+
+  if (count_lines() != 20)
+    TEST_FAILED("Expected 20 lines, got " + std::to_string(count_lines()));
+
+  std::filesystem::remove_all(logdir());
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+class tests : public tframe::tests
+{
+  virtual const char* error_message_prefix() const { return "\n\t"; }
+  void test(void)
+  {
+    TEST(concurrent);
+    TEST(drops);
+    TEST(rotation);
+    TEST(pause);
+  }
+};
+
+}  // namespace AccessLoggerTest
+
+//! The main program
+int main(void)
+{
+  using namespace std;
+  cout << endl << "AccessLogger tester" << endl << "===================" << endl;
+  AccessLoggerTest::tests t;
+  return t.run();
+}
+
+// ======================================================================
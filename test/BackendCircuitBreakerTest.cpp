@@ -0,0 +1,267 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Regression tests for class BackendCircuitBreaker
+ */
+// ======================================================================
+
+#include "BackendCircuitBreaker.h"
+#include <regression/tframe.h>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <thread>
+
+using SmartMet::Spine::BackendCircuitBreaker;
+using State = BackendCircuitBreaker::State;
+
+namespace
+{
+BackendCircuitBreaker::Options options()
+{
+  BackendCircuitBreaker::Options opts;
+  opts.enabled = true;
+  opts.failure_threshold = 3;
+  opts.open_seconds = 1;
+  opts.probes = 1;
+  opts.success_threshold = 2;
+  opts.slow_call_ms = 500;
+  opts.probe_seconds = 1;
+  return opts;
+}
+
+// Admit a call and report its outcome
+void call(BackendCircuitBreaker& theBreaker,
+          bool theError,
+          std::optional<std::chrono::microseconds> theLatency = std::nullopt)
+{
+  if (theBreaker.allow("a", 80))
+    theBreaker.record("a", 80, theError, theLatency);
+}
+
+State state(const BackendCircuitBreaker& theBreaker)
+{
+  auto status = theBreaker.status();
+  if (status.empty())
+    return State::Closed;
+  return status.front().state;
+}
+}  // namespace
+
+//! Protection against conflicts with global functions
+namespace BackendCircuitBreakerTest
+{
+// ----------------------------------------------------------------------
+
+void disabled()
+{
+  BackendCircuitBreaker breaker;
+
+  for (int i = 0; i < 100; i++)
+    breaker.record("a", 80, true);
+
+  if (!breaker.allow("a", 80))
+    TEST_FAILED("A disabled breaker must always allow requests");
+
+  if (!breaker.status().empty())
+    TEST_FAILED("A disabled breaker should not track backends");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void trips()
+{
+  BackendCircuitBreaker breaker(options());
+
+  call(breaker, true);
+  call(breaker, true);
+  call(breaker, false);  // resets the consecutive failure count
+  call(breaker, true);
+  call(breaker, true);
+
+  if (state(breaker) != State::Closed)
+    TEST_FAILED("Breaker should still be closed");
+
+  // Slow responses count as failures
+  call(breaker, false, std::chrono::milliseconds(1000));
+
+  if (state(breaker) != State::Open)
+    TEST_FAILED("Breaker should be open after three consecutive failures");
+
+  if (breaker.allow("a", 80) || breaker.available("a", 80))
+    TEST_FAILED("An open breaker must refuse requests");
+
+  if (!breaker.allow("b", 80))
+    TEST_FAILED("Other backends must not be affected");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void half_open()
+{
+  BackendCircuitBreaker breaker(options());
+
+  for (int i = 0; i < 3; i++)
+    call(breaker, true);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+  if (!breaker.available("a", 80))
+    TEST_FAILED("Breaker should be available for probing after the cool-down");
+
+  if (!breaker.allow("a", 80))
+    TEST_FAILED("First probe should be allowed");
+
+  if (state(breaker) != State::HalfOpen)
+    TEST_FAILED("Breaker should be half-open while probing");
+
+  if (breaker.allow("a", 80))
+    TEST_FAILED("Only one simultaneous probe should be allowed");
+
+  breaker.record("a", 80, false);
+  if (!breaker.allow("a", 80))
+    TEST_FAILED("Second probe should be allowed once the first one finished");
+  breaker.record("a", 80, false);
+
+  if (state(breaker) != State::Closed)
+    TEST_FAILED("Breaker should close after two successful probes");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void failed_probe()
+{
+  BackendCircuitBreaker breaker(options());
+
+  for (int i = 0; i < 3; i++)
+    call(breaker, true);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+  if (!breaker.allow("a", 80))
+    TEST_FAILED("Probe should be allowed after the cool-down");
+
+  breaker.record("a", 80, true);
+
+  if (state(breaker) != State::Open)
+    TEST_FAILED("A failed probe should reopen the breaker");
+
+  if (breaker.status().front().trips != 2)
+    TEST_FAILED("Breaker should have tripped twice");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void unadmitted()
+{
+  BackendCircuitBreaker breaker(options());
+
+  // Outcomes of calls which were never admitted are ignored
+  for (int i = 0; i < 5; i++)
+    breaker.record("a", 80, true);
+
+  if (state(breaker) != State::Closed)
+    TEST_FAILED("Calls not admitted by allow() must not be counted");
+
+  // Late responses to calls sent before the breaker opened are ignored
+  for (int i = 0; i < 3; i++)
+    breaker.allow("a", 80);
+  for (int i = 0; i < 3; i++)
+    call(breaker, true);
+  breaker.record("a", 80, true);
+
+  if (breaker.status().front().failures != 3)
+    TEST_FAILED("Late responses after the breaker opened must be ignored");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void probe_timeout()
+{
+  BackendCircuitBreaker breaker(options());
+
+  for (int i = 0; i < 3; i++)
+    call(breaker, true);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+  if (!breaker.allow("a", 80))
+    TEST_FAILED("Probe should be allowed after the cool-down");
+
+  // The probe never reports back
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+  if (!breaker.available("a", 80))
+    TEST_FAILED("A timed out probe must not block the breaker forever");
+
+  if (breaker.allow("a", 80))
+    TEST_FAILED("A timed out probe should reopen the breaker");
+
+  if (state(breaker) != State::Open || breaker.status().front().trips != 2)
+    TEST_FAILED("Breaker should be open again after the probe timed out");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void slow_calls()
+{
+  BackendCircuitBreaker breaker(options());
+
+  // Without a measured latency the time since admission is used
+  for (int i = 0; i < 3; i++)
+  {
+    if (!breaker.allow("a", 80))
+      TEST_FAILED("Calls should be allowed while the breaker is closed");
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    breaker.record("a", 80, false);
+  }
+
+  if (state(breaker) != State::Open)
+    TEST_FAILED("Slow calls should open the breaker");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+class tests : public tframe::tests
+{
+  virtual const char* error_message_prefix() const { return "\n\t"; }
+  void test(void)
+  {
+    TEST(disabled);
+    TEST(trips);
+    TEST(half_open);
+    TEST(failed_probe);
+    TEST(unadmitted);
+    TEST(probe_timeout);
+    TEST(slow_calls);
+  }
+};
+
+}  // namespace BackendCircuitBreakerTest
+
+//! The main program
+int main(void)
+{
+  using namespace std;
+  cout << endl
+       << "BackendCircuitBreaker tester" << endl
+       << "============================" << endl;
+  BackendCircuitBreakerTest::tests t;
+  return t.run();
+}
+
+// ======================================================================
@@ -0,0 +1,198 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Regression tests for class BackendLoadTracker
+ */
+// ======================================================================
+
+#include "BackendLoadTracker.h"
+#include <regression/tframe.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using SmartMet::Spine::BackendLoadTracker;
+
+//! Protection against conflicts with global functions
+namespace BackendLoadTrackerTest
+{
+// ----------------------------------------------------------------------
+
+void inflight()
+{
+  BackendLoadTracker tracker;
+
+  tracker.start("a", 8080);
+  tracker.start("a", 8080);
+  tracker.start("b", 8080);
+  tracker.stop("a", 8080);
+  tracker.stop("b", 8080);
+  tracker.stop("b", 8080);  // unbalanced stop must not go negative
+
+  auto status = tracker.status();
+  if (status.size() != 2)
+    TEST_FAILED("Expected two backends, got " + std::to_string(status.size()));
+
+  if (status[0].host != "a" || status[0].inflight != 1)
+    TEST_FAILED("Expected one request in flight to backend a");
+
+  if (status[1].host != "b" || status[1].inflight != 0)
+    TEST_FAILED("Expected no requests in flight to backend b");
+
+  tracker.remove("a", 8080);
+  if (tracker.status().size() != 1)
+    TEST_FAILED("Failed to remove backend a");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void ewma()
+{
+  BackendLoadTracker::Options options;
+  options.alpha = 0.5;
+  BackendLoadTracker tracker(options);
+
+  tracker.finished("a", 80, false, std::chrono::microseconds(10000));
+  tracker.finished("a", 80, false, std::chrono::microseconds(20000));
+  tracker.finished("a", 80, true);
+
+  auto status = tracker.status();
+  if (status.size() != 1)
+    TEST_FAILED("Expected one backend");
+
+  const auto& load = status[0];
+  if (load.latency_ms < 14.99 || load.latency_ms > 15.01)
+    TEST_FAILED("Expected latency EWMA 15 ms, got " + std::to_string(load.latency_ms));
+
+  if (load.error_rate < 0.499 || load.error_rate > 0.501)
+    TEST_FAILED("Expected error rate EWMA 0.5, got " + std::to_string(load.error_rate));
+
+  if (load.requests != 3 || load.errors != 1)
+    TEST_FAILED("Incorrect request or error counts");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void pick()
+{
+  BackendLoadTracker tracker;
+
+  if (tracker.pick({}))
+    TEST_FAILED("Picking from an empty candidate list should fail");
+
+  BackendLoadTracker::Backends candidates{{"idle", 80}, {"busy", 80}};
+
+  for (int i = 0; i < 20; i++)
+    tracker.start("busy", 80);
+
+  // With two candidates both are always compared, so the idle one must win
+  for (int i = 0; i < 100; i++)
+  {
+    auto choice = tracker.pick(candidates);
+    if (!choice || *choice != 0)
+      TEST_FAILED("Expected the idle backend to be chosen");
+  }
+
+  // A failing backend must lose even if it is idle
+  for (int i = 0; i < 20; i++)
+    tracker.stop("busy", 80);
+  for (int i = 0; i < 10; i++)
+    tracker.finished("idle", 80, true);
+
+  auto choice = tracker.pick(candidates);
+  if (!choice || *choice != 1)
+    TEST_FAILED("Expected the failing backend to be avoided");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void concurrent()
+{
+  BackendLoadTracker tracker;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; t++)
+    threads.emplace_back(
+        [&tracker, t]()
+        {
+          const std::string host = "host" + std::to_string(t % 2);
+          for (int i = 0; i < 10000; i++)
+          {
+            tracker.start(host, 80);
+            tracker.finished(host, 80, false, std::chrono::microseconds(1000));
+            tracker.stop(host, 80);
+          }
+        });
+
+  for (auto& thread : threads)
+    thread.join();
+
+  for (const auto& load : tracker.status())
+  {
+    if (load.inflight != 0)
+      TEST_FAILED("In-flight count should be zero after all requests finished");
+    if (load.requests != 40000)
+      TEST_FAILED("Expected 40000 requests, got " + std::to_string(load.requests));
+  }
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void measured()
+{
+  BackendLoadTracker tracker;
+
+  // Without a reported latency the time since start() is used
+  tracker.start("a", 80);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  tracker.stop("a", 80);
+  tracker.finished("a", 80, false);
+
+  const auto latency = tracker.status().front().latency_ms;
+  if (latency < 50 || latency > 1000)
+    TEST_FAILED("Expected a latency of about 50 ms, got " + std::to_string(latency));
+
+  // Outcomes without a start have no latency
+  tracker.finished("b", 80, false);
+  if (tracker.status().back().latency_ms != 0)
+    TEST_FAILED("A request which was never started should have no latency");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+class tests : public tframe::tests
+{
+  virtual const char* error_message_prefix() const { return "\n\t"; }
+  void test(void)
+  {
+    TEST(inflight);
+    TEST(ewma);
+    TEST(measured);
+    TEST(pick);
+    TEST(concurrent);
+  }
+};
+
+}  // namespace BackendLoadTrackerTest
+
+//! The main program
+int main(void)
+{
+  using namespace std;
+  cout << endl << "BackendLoadTracker tester" << endl << "=========================" << endl;
+  BackendLoadTrackerTest::tests t;
+  return t.run();
+}
+
+// ======================================================================
@@ -0,0 +1,125 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Regression tests for class CacheCompressor
+ */
+// ======================================================================
+
+#include "CacheCompressor.h"
+#include <regression/tframe.h>
+#include <string>
+#include <unistd.h>
+
+using SmartMet::Spine::CacheCompressor;
+
+//! Protection against conflicts with global functions
+namespace CacheCompressorTest
+{
+// ----------------------------------------------------------------------
+
+std::string document(int i)
+{
+  return "{\"id\":" + std::to_string(i) +
+         ",\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":[" +
+         std::to_string(20 + i % 10) + "," + std::to_string(60 + i % 7) +
+         "]},\"properties\":{\"name\":\"station " + std::to_string(i) +
+         "\",\"temperature\":" + std::to_string(i % 30 - 10) + "}}";
+}
+
+void roundtrip()
+{
+  CacheCompressor compressor(3, false);
+
+  const std::string text(10000, 'a');
+  auto stored = compressor.compress(text);
+  if (stored->size() >= text.size())
+    TEST_FAILED("Repetitive value should compress");
+
+  auto value = compressor.decompress(*stored);
+  if (!value || *value != text)
+    TEST_FAILED("Decompressed value differs from the original");
+
+  std::string_view frame;
+  if (!CacheCompressor::plainFrame(*stored, frame) ||
+      frame.size() != stored->size() - CacheCompressor::header_size)
+    TEST_FAILED("Value should be stored as a plain zstd frame");
+
+  // Incompressible values are stored raw
+  const std::string tiny = "x";
+  stored = compressor.compress(tiny);
+  value = compressor.decompress(*stored);
+  if (!value || *value != tiny || CacheCompressor::plainFrame(*stored, frame))
+    TEST_FAILED("Tiny value should have been stored raw");
+
+  // Values without a header are taken as is
+  value = compressor.decompress("legacy");
+  if (!value || *value != "legacy")
+    TEST_FAILED("Value without a header should be returned as is");
+
+  TEST_PASSED();
+}
+
+void dictionary()
+{
+  const std::string file =
+      "/tmp/" + std::to_string(int(getuid())) + "/cachecompressortest.dict";
+  std::remove(file.c_str());
+
+  std::size_t stored_with_dictionary = 0;
+  {
+    CacheCompressor compressor(3, true, file);
+    for (std::size_t i = 0; i < CacheCompressor::training_samples; i++)
+      compressor.compress(document(int(i)));
+
+    if (compressor.statistics().dictionary_size == 0)
+      TEST_FAILED("Dictionary should have been trained");
+
+    auto stored = compressor.compress(document(1000));
+    stored_with_dictionary = stored->size();
+
+    std::string_view frame;
+    if (CacheCompressor::plainFrame(*stored, frame))
+      TEST_FAILED("Dictionary compressed value cannot be served as a plain frame");
+
+    auto value = compressor.decompress(*stored);
+    if (!value || *value != document(1000))
+      TEST_FAILED("Dictionary compressed value was not decompressed correctly");
+  }
+
+  CacheCompressor plain(3, false);
+  if (plain.compress(document(1000))->size() <= stored_with_dictionary)
+    TEST_FAILED("Dictionary should improve compression of small documents");
+
+  // The next process loads the saved dictionary
+  CacheCompressor compressor(3, true, file);
+  if (compressor.statistics().dictionary_size == 0)
+    TEST_FAILED("Dictionary should have been loaded from " + file);
+
+  std::remove(file.c_str());
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+class tests : public tframe::tests
+{
+  virtual const char* error_message_prefix() const { return "\n\t"; }
+  void test(void)
+  {
+    TEST(roundtrip);
+    TEST(dictionary);
+  }
+};
+
+}  // namespace CacheCompressorTest
+
+//! The main program
+int main(void)
+{
+  using namespace std;
+  cout << endl << "CacheCompressor tester" << endl << "======================" << endl;
+  CacheCompressorTest::tests t;
+  return t.run();
+}
+
+// ======================================================================
@@ -10,8 +10,10 @@
 #include "Table.h"
 #include "TableFormatterOptions.h"
 #include <regression/tframe.h>
+#include <algorithm>
 #include <cmath>
 #include <sstream>
+#include <vector>
 
 template <typename T>
 std::string tostr(const T& theValue)
@@ -165,6 +167,53 @@ void empty()
   TEST_PASSED();
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test formatting on demand in small chunks
+ */
+// ----------------------------------------------------------------------
+
+void cursor()
+{
+  SmartMet::Spine::Table tab;
+  SmartMet::Spine::TableFormatter::Names names{"a", "b"};
+
+  for (int j = 0; j < 100; j++)
+  {
+    tab.set(0, j, tostr(j));
+    tab.set(1, j, "row " + tostr(j));
+  }
+
+  SmartMet::Spine::HTTP::Request req;
+  SmartMet::Spine::CsvFormatter fmt;
+
+  auto cursor = fmt.cursor(tab, names, req, config);
+
+  std::string out;
+  std::size_t chunks = 0;
+  std::size_t largest = 0;
+  bool more = true;
+  while (more)
+  {
+    std::string chunk;
+    more = cursor->next(chunk, 100);
+    largest = std::max(largest, chunk.size());
+    out += chunk;
+    ++chunks;
+  }
+
+  const auto expected = fmt.format(tab, names, req, config);
+  if (out != expected)
+    TEST_FAILED("Result differs:\n" + out + "Expected result:\n" + expected);
+
+  // A chunk ends with the row which fills it
+  if (chunks < 10 || largest > 200)
+    TEST_FAILED("Output should have been formatted in small chunks, got " + tostr(chunks) +
+                " chunks of at most " + tostr(largest) + " bytes");
+
+  TEST_PASSED();
+}
+
 // ----------------------------------------------------------------------
 /*!
  * The actual test suite
@@ -181,6 +230,7 @@ class tests : public tframe::tests
     TEST(format_partial_names_from_table);
     TEST(missingtext);
     TEST(empty);
+    TEST(cursor);
   }
 };
 
@@ -55,7 +55,7 @@ void basic()
 
   FileCache cache;
 
-  if (cache.get(path) != "hello")
+  if (*cache.get(path) != "hello")
     TEST_FAILED("Failed to read back the file contents");
 
   if (cache.last_modified(path) == 0)
@@ -64,15 +64,16 @@ void basic()
   TEST_PASSED();
 }
 
-// Within the check window the file is not re-stat'd, so a modified file
-// keeps returning the previously cached contents and modification time.
+// Without watches the file is not re-stat'd within the check window, so a
+// modified file keeps returning the previously cached contents and
+// modification time.
 void caches_within_window()
 {
   auto path = write_file("window.txt", "A");
 
-  FileCache cache(std::chrono::seconds(3600));
+  FileCache cache(std::chrono::seconds(3600), false);
 
-  if (cache.get(path) != "A")
+  if (*cache.get(path) != "A")
     TEST_FAILED("Failed to read the original contents");
 
   auto mtime = cache.last_modified(path);
@@ -81,7 +82,7 @@ void caches_within_window()
   write_file("window.txt", "B");
   bump_mtime(path, 100);
 
-  if (cache.get(path) != "A")
+  if (*cache.get(path) != "A")
     TEST_FAILED("Contents should still be cached within the check window");
 
   if (cache.last_modified(path) != mtime)
@@ -95,9 +96,9 @@ void refresh_after_expiry()
 {
   auto path = write_file("expiry.txt", "A");
 
-  FileCache cache(std::chrono::seconds(1));
+  FileCache cache(std::chrono::seconds(1), false);
 
-  if (cache.get(path) != "A")
+  if (*cache.get(path) != "A")
     TEST_FAILED("Failed to read the original contents");
 
   auto mtime = cache.last_modified(path);
@@ -108,7 +109,7 @@ void refresh_after_expiry()
   // Wait for the check window to expire
   std::this_thread::sleep_for(std::chrono::milliseconds(1200));
 
-  if (cache.get(path) != "B")
+  if (*cache.get(path) != "B")
     TEST_FAILED("New contents should be seen after the check window expires");
 
   if (cache.last_modified(path) == mtime)
@@ -117,6 +118,182 @@ void refresh_after_expiry()
   TEST_PASSED();
 }
 
+// Watched files are reloaded as soon as they change, regardless of the
+// check window. Contents returned earlier remain valid.
+void watch_invalidates()
+{
+  auto path = write_file("watch.txt", "A");
+
+  FileCache cache(std::chrono::seconds(3600));
+  if (!cache.watching())
+    TEST_FAILED("inotify should be available");
+
+  auto contents = cache.get(path);
+  if (*contents != "A")
+    TEST_FAILED("Failed to read the original contents");
+
+  if (cache.get(path) != contents)
+    TEST_FAILED("An unchanged file should return the same shared contents");
+
+  auto mtime = cache.last_modified(path);
+
+  write_file("watch.txt", "B");
+  bump_mtime(path, 100);
+
+  bool changed = false;
+  for (int i = 0; i < 100 && !changed; i++)
+  {
+    changed = (*cache.get(path) == "B");
+    if (!changed)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  if (!changed)
+    TEST_FAILED("New contents should be seen immediately when watched");
+
+  if (cache.last_modified(path) == mtime)
+    TEST_FAILED("New modification time should be seen immediately when watched");
+
+  if (*contents != "A")
+    TEST_FAILED("Previously returned contents should not change");
+
+  // A missing file is picked up once it is created
+  auto missing = testdir() / "created.txt";
+  std::filesystem::remove(missing);
+  try
+  {
+    cache.get(missing);
+    TEST_FAILED("get() should throw for a missing file");
+  }
+  catch (...)
+  {
+  }
+
+  write_file("created.txt", "C");
+
+  changed = false;
+  for (int i = 0; i < 100 && !changed; i++)
+  {
+    try
+    {
+      changed = (*cache.get(missing) == "C");
+    }
+    catch (...)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+
+  if (!changed)
+    TEST_FAILED("A created file should be seen immediately when watched");
+
+  TEST_PASSED();
+}
+
+// Switching a symbolic link to a directory is not seen by the watch on
+// the old directory, the modification time check catches it.
+void watched_recheck()
+{
+  auto v1 = write_file("v1.txt", "A");
+  auto v2 = write_file("v2.txt", "B");
+  std::filesystem::remove_all(testdir() / "v1");
+  std::filesystem::remove_all(testdir() / "v2");
+  std::filesystem::create_directories(testdir() / "v1");
+  std::filesystem::create_directories(testdir() / "v2");
+  std::filesystem::rename(v1, testdir() / "v1" / "file.txt");
+  std::filesystem::rename(v2, testdir() / "v2" / "file.txt");
+  bump_mtime(testdir() / "v2" / "file.txt", 100);
+
+  auto link = testdir() / "current";
+  std::filesystem::remove(link);
+  std::filesystem::create_directory_symlink("v1", link);
+  auto path = link / "file.txt";
+
+  FileCache cache(std::chrono::seconds(3600));
+  cache.setMaxWatchedCheckAge(std::chrono::seconds(1));
+
+  if (*cache.get(path) != "A")
+    TEST_FAILED("Failed to read the original contents");
+
+  auto tmp = testdir() / "current.tmp";
+  std::filesystem::remove(tmp);
+  std::filesystem::create_directory_symlink("v2", tmp);
+  std::filesystem::rename(tmp, link);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+
+  if (*cache.get(path) != "B")
+    TEST_FAILED("A switched directory should be seen after the watched check age");
+
+  TEST_PASSED();
+}
+
+// The caches share the watches, destroying one must not affect the others
+void shared_watcher()
+{
+  auto path = write_file("shared.txt", "A");
+
+  FileCache cache(std::chrono::seconds(3600));
+  {
+    FileCache other(std::chrono::seconds(3600));
+    if (*other.get(path) != "A")
+      TEST_FAILED("Failed to read the original contents");
+  }
+
+  if (*cache.get(path) != "A")
+    TEST_FAILED("Failed to read the original contents");
+
+  write_file("shared.txt", "B");
+  bump_mtime(path, 100);
+
+  bool changed = false;
+  for (int i = 0; i < 100 && !changed; i++)
+  {
+    changed = (*cache.get(path) == "B");
+    if (!changed)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  if (!changed)
+    TEST_FAILED("New contents should be seen immediately when watched");
+
+  TEST_PASSED();
+}
+
+// Without keeping contents the file is read on every get(), and the
+// version tells when it has changed
+void versions()
+{
+  auto path = write_file("versions.txt", "one");
+  auto missing = testdir() / "versions_missing.txt";
+  std::filesystem::remove(missing);
+
+  FileCache cache(std::chrono::seconds(10), true, false);
+
+  const auto version = cache.version(path);
+  if (version == 0 || cache.version(path) != version)
+    TEST_FAILED("An unchanged file should keep its version");
+
+  if (*cache.get(path) != "one")
+    TEST_FAILED("Failed to read the file contents");
+
+  if (cache.version(missing) != 0)
+    TEST_FAILED("A missing file should have version 0");
+
+  write_file("versions.txt", "two");
+  bump_mtime(path, 10);
+  cache.setMaxCheckAge(std::chrono::seconds(0));
+  cache.setMaxWatchedCheckAge(std::chrono::seconds(0));
+
+  if (cache.version(path) == version)
+    TEST_FAILED("A changed file should get a new version");
+
+  if (*cache.get(path) != "two")
+    TEST_FAILED("Failed to read the changed contents");
+
+  TEST_PASSED();
+}
+
 // last_modified() is reached only after get(); if the file has been removed
 // from disk it must throw, since the product is already incorrect.
 void missing_file_throws()
@@ -157,6 +334,10 @@ class tests : public tframe::tests
     TEST(basic);
     TEST(caches_within_window);
     TEST(refresh_after_expiry);
+    TEST(watch_invalidates);
+    TEST(watched_recheck);
+    TEST(shared_watcher);
+    TEST(versions);
     TEST(missing_file_throws);
   }
 };
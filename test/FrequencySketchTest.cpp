@@ -0,0 +1,89 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Regression tests for class FrequencySketch
+ */
+// ======================================================================
+
+#include "FrequencySketch.h"
+#include <regression/tframe.h>
+#include <string>
+
+using SmartMet::Spine::FrequencySketch;
+
+//! Protection against conflicts with global functions
+namespace FrequencySketchTest
+{
+// ----------------------------------------------------------------------
+
+void increment()
+{
+  FrequencySketch sketch(1000);
+
+  if (sketch.frequency(1) != 0)
+    TEST_FAILED("Unseen key should have zero frequency");
+
+  for (int i = 0; i < 5; i++)
+    sketch.increment(1);
+  sketch.increment(2);
+
+  if (sketch.frequency(1) != 5)
+    TEST_FAILED("Expected frequency 5, got " + std::to_string(sketch.frequency(1)));
+  if (sketch.frequency(2) != 1)
+    TEST_FAILED("Expected frequency 1, got " + std::to_string(sketch.frequency(2)));
+
+  for (int i = 0; i < 100; i++)
+    sketch.increment(1);
+  if (sketch.frequency(1) != FrequencySketch::max_frequency)
+    TEST_FAILED("Counters should saturate at " + std::to_string(FrequencySketch::max_frequency));
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void aging()
+{
+  FrequencySketch sketch(16);
+
+  for (int i = 0; i < 8; i++)
+    sketch.increment(12345);
+
+  // Sweep enough other keys to trigger halving
+  for (std::size_t key = 1000; sketch.resets() == 0 && key < 100000; key++)
+    sketch.increment(key);
+
+  if (sketch.resets() == 0)
+    TEST_FAILED("Counters were never halved");
+  if (sketch.frequency(12345) > 8)
+    TEST_FAILED("Frequency should not grow without increments");
+  if (sketch.frequency(12345) < 4)
+    TEST_FAILED("Halving should leave at least half of the count");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+class tests : public tframe::tests
+{
+  virtual const char* error_message_prefix() const { return "\n\t"; }
+  void test(void)
+  {
+    TEST(increment);
+    TEST(aging);
+  }
+};
+
+}  // namespace FrequencySketchTest
+
+//! The main program
+int main(void)
+{
+  using namespace std;
+  cout << endl << "FrequencySketch tester" << endl << "======================" << endl;
+  FrequencySketchTest::tests t;
+  return t.run();
+}
+
+// ======================================================================
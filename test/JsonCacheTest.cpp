@@ -0,0 +1,167 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Regression tests for class JsonCache
+ */
+// ======================================================================
+
+#include "JsonCache.h"
+#include <regression/tframe.h>
+#include <sys/types.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+using SmartMet::Spine::JsonCache;
+
+namespace
+{
+std::filesystem::path testdir()
+{
+  return std::filesystem::path("/tmp") / std::to_string(int(getuid())) / "bsjsoncachetest";
+}
+
+std::filesystem::path write_file(const std::string& name, const std::string& content)
+{
+  auto path = testdir() / name;
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream out(path.c_str(), std::ios::trunc);
+  out << content;
+  out.close();
+  return path;
+}
+
+// Wait for the cache to see the change
+template <typename Predicate>
+bool wait_for(Predicate thePredicate)
+{
+  for (int i = 0; i < 100; i++)
+  {
+    if (thePredicate())
+      return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+}  // namespace
+
+//! Protection against conflicts with global functions
+namespace JsonCacheTest
+{
+// ----------------------------------------------------------------------
+
+void get()
+{
+  auto path = write_file("get.json", R"({"a": 1})");
+
+  JsonCache cache;
+
+  auto json1 = cache.get(path);
+  if ((*json1)["a"].asInt() != 1)
+    TEST_FAILED("Failed to parse the file");
+
+  if (cache.get(path) != json1)
+    TEST_FAILED("An unchanged file should return the same shared value");
+
+  write_file("get.json", R"({"a": 2})");
+
+  if (!wait_for([&] { return (*cache.get(path))["a"].asInt() == 2; }))
+    TEST_FAILED("Changed file should be parsed again");
+
+  if ((*json1)["a"].asInt() != 1)
+    TEST_FAILED("Previously returned value should not change");
+
+  TEST_PASSED();
+}
+
+// The preprocessed value is shared until any of the files it was built
+// from changes, or a missing include candidate appears
+void preprocessed()
+{
+  const auto root = testdir().string();
+  const auto dir = (testdir() / "products").string();
+
+  std::filesystem::remove(testdir() / "products" / "inc.json");
+  auto path = write_file("products/root.json", R"({"x": "json:inc.json"})");
+  write_file("inc.json", R"({"y": "json:leaf.json"})");
+  write_file("leaf.json", R"(1)");
+
+  JsonCache cache;
+
+  auto json = cache.getPreprocessed(path, root, dir);
+  if ((*json)["x"]["y"].asInt() != 1)
+    TEST_FAILED("Includes were not expanded");
+
+  if (cache.getPreprocessed(path, root, dir) != json)
+    TEST_FAILED("Unchanged files should return the same preprocessed value");
+
+  write_file("leaf.json", R"(2)");
+
+  if (!wait_for([&] { return (*cache.getPreprocessed(path, root, dir))["x"]["y"].asInt() == 2; }))
+    TEST_FAILED("A change in a nested include should invalidate the preprocessed value");
+
+  // An include next to the product takes precedence over the root path
+  write_file("products/inc.json", R"({"y": 3})");
+
+  if (!wait_for([&] { return (*cache.getPreprocessed(path, root, dir))["x"]["y"].asInt() == 3; }))
+    TEST_FAILED("A new include candidate should invalidate the preprocessed value");
+
+  if ((*json)["x"]["y"].asInt() != 1)
+    TEST_FAILED("Previously returned value should not change");
+
+  TEST_PASSED();
+}
+
+// The least recently used values are dropped when the cache is full
+void bounded()
+{
+  auto a = write_file("a.json", R"({"a": 1})");
+  auto b = write_file("b.json", R"({"b": 1})");
+  auto c = write_file("c.json", R"({"c": 1})");
+
+  JsonCache cache(2);
+
+  auto json_a = cache.get(a);
+  auto json_b = cache.get(b);
+  if (cache.get(a) != json_a)
+    TEST_FAILED("Cached value should be shared");
+
+  cache.get(c);
+
+  if (cache.get(a) != json_a)
+    TEST_FAILED("Recently used value should be kept");
+
+  if (cache.get(b) == json_b)
+    TEST_FAILED("Least recently used value should have been dropped");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+class tests : public tframe::tests
+{
+  virtual const char* error_message_prefix() const { return "\n\t"; }
+  void test(void)
+  {
+    TEST(get);
+    TEST(preprocessed);
+    TEST(bounded);
+  }
+};
+
+}  // namespace JsonCacheTest
+
+//! The main program
+int main(void)
+{
+  using namespace std;
+  cout << endl << "JsonCache tester" << endl << "================" << endl;
+  JsonCacheTest::tests t;
+  return t.run();
+}
+
+// ======================================================================
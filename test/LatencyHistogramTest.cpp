@@ -0,0 +1,236 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Regression tests for class LatencyHistogram
+ */
+// ======================================================================
+
+#include "LatencyHistogram.h"
+#include "LatencyStats.h"
+#include <regression/tframe.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using SmartMet::Spine::LatencyHistogram;
+using SmartMet::Spine::LatencyStats;
+using std::chrono::hours;
+using std::chrono::microseconds;
+using std::chrono::minutes;
+using std::chrono::seconds;
+
+//! Protection against conflicts with global functions
+namespace LatencyHistogramTest
+{
+// Start from a round day so that slot boundaries are predictable
+const LatencyHistogram::Clock::time_point t0{hours(24 * 1000)};
+
+// ----------------------------------------------------------------------
+
+void buckets()
+{
+  // Every value must fall into a bucket whose bounds contain it
+  std::int64_t previous = -1;
+  for (std::size_t i = 0; i < LatencyHistogram::bucket_count; i++)
+  {
+    const auto upper = LatencyHistogram::bucketUpperBound(i);
+    if (upper <= previous)
+      TEST_FAILED("Bucket bounds are not increasing at bucket " + std::to_string(i));
+    if (LatencyHistogram::bucketIndex(previous + 1) != i || LatencyHistogram::bucketIndex(upper) != i)
+      TEST_FAILED("Bucket index and bounds disagree at bucket " + std::to_string(i));
+    // relative error at most 1/16
+    if (i >= 16 && (upper - previous) * 16 > previous + 1)
+      TEST_FAILED("Bucket " + std::to_string(i) + " is too wide");
+    previous = upper;
+  }
+
+  if (LatencyHistogram::bucketIndex(-5) != 0)
+    TEST_FAILED("Negative values should go into the first bucket");
+  if (LatencyHistogram::bucketIndex(std::int64_t(1) << 50) != LatencyHistogram::bucket_count - 1)
+    TEST_FAILED("Huge values should go into the last bucket");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void percentiles()
+{
+  LatencyHistogram h;
+
+  // 1..1000 milliseconds
+  for (int i = 1; i <= 1000; i++)
+    h.add(microseconds(i * 1000), t0);
+
+  const auto s = h.snapshot(LatencyHistogram::Window::Minute, t0);
+  if (s.count() != 1000)
+    TEST_FAILED("Expected 1000 values, got " + std::to_string(s.count()));
+  if (s.max() != microseconds(1000000))
+    TEST_FAILED("Wrong maximum " + std::to_string(s.max().count()));
+
+  const std::pair<double, std::int64_t> expected[] = {
+      {0.5, 500000}, {0.95, 950000}, {0.99, 990000}, {1.0, 1000000}};
+
+  for (const auto& p : expected)
+  {
+    const auto value = s.percentile(p.first).count();
+    if (value < p.second || value > p.second + p.second / 16)
+      TEST_FAILED("Percentile " + std::to_string(p.first) + " is " + std::to_string(value) +
+                  ", expected about " + std::to_string(p.second));
+  }
+
+  if (LatencyHistogram::Snapshot().percentile(0.5).count() != 0)
+    TEST_FAILED("Percentile of an empty histogram should be zero");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void windows()
+{
+  LatencyHistogram h;
+
+  h.add(microseconds(100), t0);
+  h.add(microseconds(200), t0 + minutes(30));
+  h.add(microseconds(300), t0 + hours(1) - seconds(30));
+  h.add(microseconds(400), t0 + hours(1));
+
+  const auto now = t0 + hours(1);
+  const auto minute = h.snapshot(LatencyHistogram::Window::Minute, now);
+  const auto hour = h.snapshot(LatencyHistogram::Window::Hour, now);
+  const auto day = h.snapshot(LatencyHistogram::Window::Day, now);
+
+  if (minute.count() != 2 || minute.max() != microseconds(400))
+    TEST_FAILED("Expected 2 values in the last minute, got " + std::to_string(minute.count()));
+  if (hour.count() != 3)
+    TEST_FAILED("Expected 3 values in the last hour, got " + std::to_string(hour.count()));
+  if (day.count() != 4)
+    TEST_FAILED("Expected 4 values in the last day, got " + std::to_string(day.count()));
+
+  // A recycled slot must be reset
+  h.add(microseconds(500), t0 + hours(1) + minutes(1));
+  const auto later = h.snapshot(LatencyHistogram::Window::Minute, t0 + hours(1) + minutes(1));
+  if (later.count() != 1 || later.max() != microseconds(500))
+    TEST_FAILED("Recycled slot was not reset");
+
+  if (h.snapshot(LatencyHistogram::Window::Day, t0 + hours(30)).count() != 0)
+    TEST_FAILED("Old values should have expired");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+// Counts since construction survive the windows
+void cumulative()
+{
+  LatencyHistogram h;
+  h.add(microseconds(1000), t0);  // exactly on the first bound
+  h.add(microseconds(1001), t0);  // second bucket
+  h.add(microseconds(2000), t0 + hours(2));
+  h.add(microseconds(100000000), t0 + hours(48));  // beyond the last bound
+
+  const auto c = h.cumulative();
+  if (c.count != 4)
+    TEST_FAILED("Expected 4 values, got " + std::to_string(c.count));
+  if (c.counts[0] != 1 || c.counts[1] != 2 || c.counts.back() != 1)
+    TEST_FAILED("Values counted into wrong buckets");
+  if (c.sum != microseconds(100004001))
+    TEST_FAILED("Wrong sum " + std::to_string(c.sum.count()));
+
+  if (h.snapshot(LatencyHistogram::Window::Day, t0 + hours(48)).count() != 1)
+    TEST_FAILED("The day window should have only the latest value");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void concurrent()
+{
+  LatencyHistogram h;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; t++)
+    threads.emplace_back(
+        [&h, t]()
+        {
+          for (int i = 0; i < 10000; i++)
+            h.add(microseconds(t * 1000 + i % 100), t0);
+        });
+  for (auto& thread : threads)
+    thread.join();
+
+  const auto s = h.snapshot(LatencyHistogram::Window::Hour, t0);
+  if (s.count() != 80000)
+    TEST_FAILED("Expected 80000 values, got " + std::to_string(s.count()));
+  if (s.max() != microseconds(7099))
+    TEST_FAILED("Wrong maximum " + std::to_string(s.max().count()));
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void statusclasses()
+{
+  LatencyStats stats;
+
+  stats.add(200, microseconds(1000), microseconds(100), t0);
+  stats.add(204, microseconds(2000), microseconds(200), t0);
+  stats.add(404, microseconds(300), microseconds(30), t0);
+  stats.add(0, microseconds(5000), microseconds(500), t0);
+
+  const auto snapshots = stats.snapshot(LatencyStats::Window::Minute, t0);
+  if (snapshots.size() != 3)
+    TEST_FAILED("Expected 3 status classes, got " + std::to_string(snapshots.size()));
+  if (snapshots.count("2xx") == 0 || snapshots.at("2xx").wall.count() != 2)
+    TEST_FAILED("Expected 2 requests in class 2xx");
+  if (snapshots.count("4xx") == 0 || snapshots.at("4xx").cpu.max() != microseconds(30))
+    TEST_FAILED("Wrong CPU time in class 4xx");
+  if (snapshots.count("other") == 0)
+    TEST_FAILED("Missing status class for unknown statuses");
+
+  LatencyStats::Snapshot total;
+  for (const auto& item : snapshots)
+    total += item.second;
+  if (total.wall.count() != 4 || total.wall.max() != microseconds(5000))
+    TEST_FAILED("Merging status classes failed");
+
+  const auto cumulatives = stats.cumulative();
+  if (cumulatives.size() != 3 || cumulatives.at("2xx").wall.count != 2 ||
+      cumulatives.at("2xx").cpu.sum != microseconds(300))
+    TEST_FAILED("Wrong counts since start in class 2xx");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+class tests : public tframe::tests
+{
+  virtual const char* error_message_prefix() const { return "\n\t"; }
+  void test(void)
+  {
+    TEST(buckets);
+    TEST(percentiles);
+    TEST(windows);
+    TEST(cumulative);
+    TEST(concurrent);
+    TEST(statusclasses);
+  }
+};
+
+}  // namespace LatencyHistogramTest
+
+//! The main program
+int main(void)
+{
+  using namespace std;
+  cout << endl << "LatencyHistogram tester" << endl << "=======================" << endl;
+  LatencyHistogramTest::tests t;
+  return t.run();
+}
+
+// ======================================================================
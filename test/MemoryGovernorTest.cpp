@@ -0,0 +1,226 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Regression tests for class MemoryGovernor
+ */
+// ======================================================================
+
+#include "MemoryGovernor.h"
+#include <regression/tframe.h>
+#include <string>
+
+using SmartMet::Spine::MemoryGovernor;
+
+//! Protection against conflicts with global functions
+namespace MemoryGovernorTest
+{
+// A cache which releases whatever is requested
+struct FakeCache
+{
+  std::size_t bytes = 0;
+  Fmi::Cache::CacheStats stats;
+
+  MemoryGovernor::Registration add(MemoryGovernor& theGovernor, const std::string& theName)
+  {
+    return theGovernor.add(
+        theName,
+        [this]() { return bytes; },
+        [this](std::size_t theBytes)
+        {
+          bytes -= theBytes;
+          return theBytes;
+        },
+        [this]() { return stats; });
+  }
+};
+
+// ----------------------------------------------------------------------
+
+void no_pressure()
+{
+  MemoryGovernor governor;
+  FakeCache cache;
+  cache.bytes = 1000;
+  auto registration = cache.add(governor, "cache");
+
+  MemoryGovernor::Pressure pressure;
+  pressure.rss = 800;
+  pressure.limit = 1000;
+
+  if (!governor.relieve(pressure).empty() || cache.bytes != 1000)
+    TEST_FAILED("Nothing should be shrunk below the high watermark");
+
+  pressure.limit = 0;
+  pressure.rss = 1000000;
+  if (!governor.relieve(pressure).empty())
+    TEST_FAILED("Nothing should be shrunk without a limit or PSI pressure");
+
+  TEST_PASSED();
+}
+
+// The excess down to the target is divided by size and hit rate
+void proportional()
+{
+  MemoryGovernor governor;
+
+  FakeCache hot;
+  FakeCache cold;
+  FakeCache big;
+  hot.bytes = 1000;
+  cold.bytes = 1000;
+  big.bytes = 2000;
+
+  auto r1 = hot.add(governor, "hot");
+  auto r2 = cold.add(governor, "cold");
+  auto r3 = big.add(governor, "big");
+
+  // Since registration: hot always hits, cold and big never do
+  hot.stats.hits = 100;
+  cold.stats.misses = 100;
+  big.stats.misses = 100;
+
+  MemoryGovernor::Pressure pressure;
+  pressure.limit = 10000;
+  pressure.rss = 9500;  // excess down to 80% is 1500
+
+  const auto decisions = governor.relieve(pressure);
+  if (decisions.size() != 3)
+    TEST_FAILED("Expected 3 decisions, got " + std::to_string(decisions.size()));
+
+  // Weights 500, 1000 and 2000
+  if (hot.bytes != 1000 - 214 || cold.bytes != 1000 - 428 || big.bytes != 2000 - 857)
+    TEST_FAILED("Unexpected shares: " + std::to_string(1000 - hot.bytes) + " " +
+                std::to_string(1000 - cold.bytes) + " " + std::to_string(2000 - big.bytes));
+
+  if (governor.history().size() != 3 || governor.history().front().released == 0)
+    TEST_FAILED("Decisions should be kept in the history");
+
+  TEST_PASSED();
+}
+
+void psi()
+{
+  MemoryGovernor governor;
+  FakeCache cache;
+  cache.bytes = 1000;
+  auto registration = cache.add(governor, "cache");
+
+  MemoryGovernor::Pressure pressure;
+  pressure.psi_some = 50;
+
+  governor.relieve(pressure);
+  if (cache.bytes != 900)
+    TEST_FAILED("PSI pressure should release 10% of cache memory, got " +
+                std::to_string(1000 - cache.bytes));
+
+  TEST_PASSED();
+}
+
+void unregister()
+{
+  MemoryGovernor governor;
+  FakeCache cache;
+  cache.bytes = 1000;
+  {
+    auto registration = cache.add(governor, "cache");
+  }
+
+  MemoryGovernor::Pressure pressure;
+  pressure.psi_some = 50;
+
+  if (!governor.relieve(pressure).empty() || cache.bytes != 1000)
+    TEST_FAILED("An unregistered cache should not be shrunk");
+
+  TEST_PASSED();
+}
+
+// Released bytes are credited against the RSS until it catches up
+void credit()
+{
+  MemoryGovernor governor;
+  FakeCache cache;
+  cache.bytes = 1000;
+  auto registration = cache.add(governor, "cache");
+
+  MemoryGovernor::Pressure pressure;
+  pressure.limit = 10000;
+  pressure.rss = 9500;
+
+  governor.relieve(pressure);
+  if (cache.bytes != 0)
+    TEST_FAILED("Expected the whole cache to be released, got " +
+                std::to_string(1000 - cache.bytes));
+
+  // The RSS has not dropped yet, the first release is still pending
+  cache.bytes = 1000;
+  if (!governor.relieve(pressure).empty() || cache.bytes != 1000)
+    TEST_FAILED("Memory being released should not be released again");
+
+  // The RSS reflects half of the release
+  pressure.rss = 9000;
+  if (!governor.relieve(pressure).empty())
+    TEST_FAILED("Nothing should be shrunk while the RSS is catching up");
+
+  // The remaining 500 byte credit is subtracted from the RSS
+  cache.bytes = 2000;
+  pressure.rss = 9600;
+  governor.relieve(pressure);
+  if (cache.bytes != 900)
+    TEST_FAILED("Expected 1100 bytes to be released, got " + std::to_string(2000 - cache.bytes));
+
+  TEST_PASSED();
+}
+
+// Callbacks are called without the registry locked
+void callbacks()
+{
+  MemoryGovernor governor;
+  FakeCache other;
+  MemoryGovernor::Registration registration;
+
+  auto first = governor.add(
+      "first",
+      []() { return std::size_t(1000); },
+      [&](std::size_t theBytes)
+      {
+        registration = other.add(governor, "other");
+        return theBytes;
+      });
+
+  MemoryGovernor::Pressure pressure;
+  pressure.psi_some = 50;
+  governor.relieve(pressure);
+
+  registration = MemoryGovernor::Registration();
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+class tests : public tframe::tests
+{
+  virtual const char* error_message_prefix() const { return "\n\t"; }
+  void test(void)
+  {
+    TEST(no_pressure);
+    TEST(proportional);
+    TEST(psi);
+    TEST(unregister);
+    TEST(credit);
+    TEST(callbacks);
+  }
+};
+
+}  // namespace MemoryGovernorTest
+
+//! The main program
+int main(void)
+{
+  using namespace std;
+  cout << endl << "MemoryGovernor tester" << endl << "=====================" << endl;
+  MemoryGovernorTest::tests t;
+  return t.run();
+}
+
+// ======================================================================
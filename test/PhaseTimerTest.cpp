@@ -0,0 +1,126 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Regression tests for class PhaseTimer
+ */
+// ======================================================================
+
+#include "PhaseStats.h"
+#include "PhaseTimer.h"
+#include <regression/tframe.h>
+#include <string>
+#include <thread>
+
+using SmartMet::Spine::PhaseStats;
+using SmartMet::Spine::PhaseTimer;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+//! Protection against conflicts with global functions
+namespace PhaseTimerTest
+{
+// ----------------------------------------------------------------------
+
+void phases()
+{
+  PhaseTimer timer;
+
+  timer.add("queue", microseconds(50));
+  {
+    auto scope = timer.start("handler");
+    std::this_thread::sleep_for(milliseconds(2));
+  }
+  timer.add("queue", microseconds(25));
+
+  const auto phases = timer.phases();
+  if (phases.size() != 2)
+    TEST_FAILED("Expected 2 phases, got " + std::to_string(phases.size()));
+  if (phases[0].name != "queue" || phases[0].duration != microseconds(75))
+    TEST_FAILED("Repeated phases should be summed");
+  if (phases[1].name != "handler" || phases[1].duration < milliseconds(2))
+    TEST_FAILED("Scope did not measure the handler phase");
+
+  // Stopping explicitly records only once
+  auto scope = timer.start("format");
+  scope.stop();
+  scope.stop();
+  if (timer.phases().size() != 3)
+    TEST_FAILED("Explicitly stopped scope was not recorded once");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void servertiming()
+{
+  PhaseTimer timer;
+  timer.add("queue", microseconds(50));
+  timer.add("engine fetch", microseconds(12345));
+
+  const auto header = timer.serverTiming();
+  if (header != "queue;dur=0.050, engine-fetch;dur=12.345")
+    TEST_FAILED("Unexpected Server-Timing value: " + header);
+
+  if (!PhaseTimer().serverTiming().empty())
+    TEST_FAILED("Server-Timing of no phases should be empty");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void stats()
+{
+  PhaseStats stats;
+
+  PhaseTimer timer;
+  timer.add("queue", microseconds(10));
+  timer.add("handler", microseconds(1000));
+  stats.add(timer.phases());
+  stats.add(timer.phases());
+
+  auto totals = stats.totals();
+  if (totals.size() != 2)
+    TEST_FAILED("Expected 2 phases, got " + std::to_string(totals.size()));
+  if (totals["handler"].count != 2 || totals["handler"].microseconds != 2000)
+    TEST_FAILED("Wrong handler totals");
+
+  // Too many distinct names are folded into "other"
+  for (std::size_t i = 0; i < 2 * PhaseStats::max_phases; i++)
+    stats.add({PhaseTimer::Phase{"p" + std::to_string(i), microseconds(1)}});
+
+  totals = stats.totals();
+  if (totals.size() > PhaseStats::max_phases + 1)
+    TEST_FAILED("Phase names were not limited, got " + std::to_string(totals.size()));
+  if (totals.count("other") == 0)
+    TEST_FAILED("Excess phases should be counted as other");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+class tests : public tframe::tests
+{
+  virtual const char* error_message_prefix() const { return "\n\t"; }
+  void test(void)
+  {
+    TEST(phases);
+    TEST(servertiming);
+    TEST(stats);
+  }
+};
+
+}  // namespace PhaseTimerTest
+
+//! The main program
+int main(void)
+{
+  using namespace std;
+  cout << endl << "PhaseTimer tester" << endl << "=================" << endl;
+  PhaseTimerTest::tests t;
+  return t.run();
+}
+
+// ======================================================================
@@ -0,0 +1,108 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Regression tests for class ProfiledMutex
+ */
+// ======================================================================
+
+#include "ProfiledMutex.h"
+#include <boost/thread/locks.hpp>
+#include <regression/tframe.h>
+#include <string>
+#include <thread>
+
+using SmartMet::Spine::LockStats;
+using SmartMet::Spine::ProfiledMutex;
+using std::chrono::milliseconds;
+
+//! Protection against conflicts with global functions
+namespace ProfiledMutexTest
+{
+LockStats::Summary find(const std::string& theName)
+{
+  for (const auto& stats : LockStats::summaries())
+    if (stats.name == theName)
+      return stats;
+  return {};
+}
+
+// ----------------------------------------------------------------------
+
+void counts()
+{
+  {
+    ProfiledMutex mutex("ProfiledMutexTest::counts");
+    {
+      boost::unique_lock<ProfiledMutex> lock(mutex);
+    }
+    for (int i = 0; i < 3; i++)
+      boost::shared_lock<ProfiledMutex> lock(mutex);
+
+    const auto stats = find("ProfiledMutexTest::counts");
+    if (stats.instances != 1)
+      TEST_FAILED("Expected 1 instance, got " + std::to_string(stats.instances));
+    if (stats.exclusive != 1 || stats.shared != 3)
+      TEST_FAILED("Wrong acquisition counts");
+    if (stats.contended != 0 || stats.total_wait_ns != 0)
+      TEST_FAILED("Uncontended locks should not be waited for");
+  }
+
+  if (find("ProfiledMutexTest::counts").instances != 0)
+    TEST_FAILED("Destroyed mutex should not be counted");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void contention()
+{
+  ProfiledMutex mutex("ProfiledMutexTest::contention");
+
+  std::thread holder;
+  {
+    boost::unique_lock<ProfiledMutex> lock(mutex);
+    holder = std::thread([&mutex] { boost::shared_lock<ProfiledMutex> lock(mutex); });
+    std::this_thread::sleep_for(milliseconds(20));
+  }
+  holder.join();
+
+  const auto stats = find("ProfiledMutexTest::contention");
+  if (stats.contended != 1)
+    TEST_FAILED("Expected 1 contended acquisition, got " + std::to_string(stats.contended));
+  if (stats.max_hold_ns < 20000000)
+    TEST_FAILED("Hold time was not measured: " + std::to_string(stats.max_hold_ns));
+  if (stats.max_wait_ns <= 0 || stats.wait_p99_ns > stats.max_wait_ns)
+    TEST_FAILED("Wait time was not measured");
+
+  // The most contended lock is listed first
+  if (LockStats::summaries().front().total_wait_ns != stats.total_wait_ns)
+    TEST_FAILED("Locks should be sorted by total wait time");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+class tests : public tframe::tests
+{
+  virtual const char* error_message_prefix() const { return "\n\t"; }
+  void test(void)
+  {
+    TEST(counts);
+    TEST(contention);
+  }
+};
+
+}  // namespace ProfiledMutexTest
+
+//! The main program
+int main(void)
+{
+  using namespace std;
+  cout << endl << "ProfiledMutex tester" << endl << "====================" << endl;
+  ProfiledMutexTest::tests t;
+  return t.run();
+}
+
+// ======================================================================
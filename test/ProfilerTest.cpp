@@ -0,0 +1,171 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Regression tests for class Profiler
+ */
+// ======================================================================
+
+#include "Profiler.h"
+#include <regression/tframe.h>
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using SmartMet::Spine::Profiler;
+using std::chrono::milliseconds;
+
+//! Protection against conflicts with global functions
+namespace ProfilerTest
+{
+std::atomic<bool> spinning{false};
+volatile double sink = 0;
+
+__attribute__((noinline)) void profiler_test_busy_loop()
+{
+  while (spinning)
+    for (int i = 0; i < 1000; i++)
+      sink = sink + i * 0.5;
+}
+
+// ----------------------------------------------------------------------
+
+void profile()
+{
+  spinning = true;
+  std::thread busy(profiler_test_busy_loop);
+
+  Profiler::Result result;
+  try
+  {
+    result = Profiler::profile(milliseconds(500), 200);
+  }
+  catch (...)
+  {
+    spinning = false;
+    busy.join();
+    TEST_FAILED("Profiling failed");
+  }
+  spinning = false;
+  busy.join();
+
+  if (Profiler::running())
+    TEST_FAILED("Profiler should not be running after profile() returned");
+  if (result.samples == 0)
+    TEST_FAILED("No samples were taken");
+
+  // Every line must be "frame;frame;... count" and the counts must add up
+  std::istringstream in(result.folded);
+  std::string line;
+  std::size_t total = 0;
+  while (std::getline(in, line))
+  {
+    const auto pos = line.rfind(' ');
+    if (pos == std::string::npos || pos == 0)
+      TEST_FAILED("Invalid folded line: " + line);
+    total += std::strtoul(line.c_str() + pos + 1, nullptr, 10);
+  }
+  if (total == 0 || total > result.samples)
+    TEST_FAILED("Folded counts do not match the number of samples");
+
+  if (result.folded.find("profiler_test_busy_loop") == std::string::npos)
+    TEST_FAILED("The busy function was not seen in the profile:\n" + result.folded);
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void limits()
+{
+  try
+  {
+    Profiler::profile(milliseconds(0));
+    TEST_FAILED("Zero duration should be rejected");
+  }
+  catch (...)
+  {
+  }
+
+  try
+  {
+    Profiler::profile(milliseconds(10), Profiler::max_frequency + 1);
+    TEST_FAILED("Too high frequency should be rejected");
+  }
+  catch (...)
+  {
+  }
+
+  // Only one profile at a time
+  std::thread first([] { Profiler::profile(milliseconds(300)); });
+  std::this_thread::sleep_for(milliseconds(100));
+  bool rejected = false;
+  try
+  {
+    Profiler::profile(milliseconds(10));
+  }
+  catch (...)
+  {
+    rejected = true;
+  }
+  first.join();
+  if (!rejected)
+    TEST_FAILED("Concurrent profiles should be rejected");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void previous_handler(int /* signo */) {}
+
+void restore()
+{
+  struct sigaction action = {};
+  action.sa_handler = &previous_handler;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGPROF, &action, nullptr);
+
+  Profiler::profile(milliseconds(50));
+
+  struct sigaction current = {};
+  sigaction(SIGPROF, nullptr, &current);
+  if (current.sa_handler != &previous_handler)
+    TEST_FAILED("The previous SIGPROF handler should be restored");
+
+  signal(SIGPROF, SIG_DFL);
+  Profiler::profile(milliseconds(50));
+  sigaction(SIGPROF, nullptr, &current);
+  if (current.sa_handler != SIG_DFL)
+    TEST_FAILED("The default SIGPROF action should be restored");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+class tests : public tframe::tests
+{
+  virtual const char* error_message_prefix() const { return "\n\t"; }
+  void test(void)
+  {
+    TEST(profile);
+    TEST(limits);
+    TEST(restore);
+  }
+};
+
+}  // namespace ProfilerTest
+
+//! The main program
+int main(void)
+{
+  using namespace std;
+  cout << endl << "Profiler tester" << endl << "===============" << endl;
+  ProfilerTest::tests t;
+  return t.run();
+}
+
+// ======================================================================
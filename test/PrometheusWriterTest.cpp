@@ -0,0 +1,118 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Regression tests for class PrometheusWriter
+ */
+// ======================================================================
+
+#include "PrometheusWriter.h"
+#include <regression/tframe.h>
+#include <cmath>
+#include <limits>
+#include <string>
+
+using SmartMet::Spine::PrometheusWriter;
+
+//! Protection against conflicts with global functions
+namespace PrometheusWriterTest
+{
+// ----------------------------------------------------------------------
+
+void format()
+{
+  std::string buffer;
+  PrometheusWriter out(buffer);
+
+  out.family("smartmet_requests_total", "Handled requests", "counter");
+  out.sample("smartmet_requests_total", {{"handler", "/timeseries"}}, std::uint64_t(42));
+  out.sample("smartmet_requests_total", {}, std::uint64_t(7));
+  out.family("smartmet_temperature", "Two\nlines", "gauge");
+  out.sample("smartmet_temperature", {{"a", "1"}, {"b", "2"}}, -1.5);
+
+  const std::string expected =
+      "# HELP smartmet_requests_total Handled requests\n"
+      "# TYPE smartmet_requests_total counter\n"
+      "smartmet_requests_total{handler=\"/timeseries\"} 42\n"
+      "smartmet_requests_total 7\n"
+      "# HELP smartmet_temperature Two\\nlines\n"
+      "# TYPE smartmet_temperature gauge\n"
+      "smartmet_temperature{a=\"1\",b=\"2\"} -1.5\n";
+
+  if (buffer != expected)
+    TEST_FAILED("Unexpected output:\n" + buffer);
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void escaping()
+{
+  std::string buffer;
+  PrometheusWriter out(buffer);
+
+  out.sample("x", {{"path", "a\"b\\c\nd"}}, std::int64_t(-3));
+  out.sample("y", {}, std::numeric_limits<double>::infinity());
+  out.sample("z", {}, std::nan(""));
+
+  const std::string expected =
+      "x{path=\"a\\\"b\\\\c\\nd\"} -3\n"
+      "y +Inf\n"
+      "z NaN\n";
+
+  if (buffer != expected)
+    TEST_FAILED("Unexpected output:\n" + buffer);
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void histogram()
+{
+  std::string buffer;
+  PrometheusWriter out(buffer);
+
+  out.family("latency_seconds", "Latency", "histogram");
+  out.histogram("latency_seconds", {{"handler", "/x"}}, {0.001, 2.5}, {3, 0, 2}, 7.25);
+
+  const std::string expected =
+      "# HELP latency_seconds Latency\n"
+      "# TYPE latency_seconds histogram\n"
+      "latency_seconds_bucket{handler=\"/x\",le=\"0.001\"} 3\n"
+      "latency_seconds_bucket{handler=\"/x\",le=\"2.5\"} 3\n"
+      "latency_seconds_bucket{handler=\"/x\",le=\"+Inf\"} 5\n"
+      "latency_seconds_sum{handler=\"/x\"} 7.25\n"
+      "latency_seconds_count{handler=\"/x\"} 5\n";
+
+  if (buffer != expected)
+    TEST_FAILED("Unexpected output:\n" + buffer);
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+class tests : public tframe::tests
+{
+  virtual const char* error_message_prefix() const { return "\n\t"; }
+  void test(void)
+  {
+    TEST(format);
+    TEST(escaping);
+    TEST(histogram);
+  }
+};
+
+}  // namespace PrometheusWriterTest
+
+//! The main program
+int main(void)
+{
+  using namespace std;
+  cout << endl << "PrometheusWriter tester" << endl << "=======================" << endl;
+  PrometheusWriterTest::tests t;
+  return t.run();
+}
+
+// ======================================================================
@@ -0,0 +1,141 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Regression tests for class RequestArena
+ */
+// ======================================================================
+
+#include "RequestArena.h"
+#include "Table.h"
+#include <regression/tframe.h>
+#include <string>
+#include <vector>
+
+using SmartMet::Spine::RequestArena;
+using SmartMet::Spine::Table;
+
+//! Protection against conflicts with global functions
+namespace RequestArenaTest
+{
+// Counts the calls made to the upstream resource
+class CountingResource : public std::pmr::memory_resource
+{
+ public:
+  std::size_t allocations = 0;
+  std::size_t deallocations = 0;
+
+ private:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override
+  {
+    ++allocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+  {
+    ++deallocations;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+  {
+    return this == &other;
+  }
+};
+
+// ----------------------------------------------------------------------
+
+void upstream()
+{
+  CountingResource counter;
+  {
+    RequestArena arena(&counter);
+    std::pmr::vector<int> small(arena.resource());
+    small.resize(1000);
+    if (counter.allocations != 0)
+      TEST_FAILED("Allocations fitting the initial block should not reach upstream");
+
+    std::pmr::vector<char> large(arena.resource());
+    large.resize(2 * RequestArena::block_size);
+    if (counter.allocations == 0)
+      TEST_FAILED("Allocations exceeding the initial block should use upstream");
+  }
+  if (counter.deallocations != counter.allocations)
+    TEST_FAILED("Upstream memory was not released with the arena");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void recycle()
+{
+  {
+    RequestArena arena;
+  }
+  const auto pooled = RequestArena::pooledBlocks();
+  if (pooled == 0)
+    TEST_FAILED("The initial block was not returned to the pool");
+
+  {
+    RequestArena arena;
+    if (RequestArena::pooledBlocks() != pooled - 1)
+      TEST_FAILED("The pooled block was not reused");
+  }
+
+  // The pool size is limited
+  {
+    std::vector<std::unique_ptr<RequestArena>> arenas;
+    for (std::size_t i = 0; i < 2 * RequestArena::max_pooled_blocks; i++)
+      arenas.push_back(std::make_unique<RequestArena>());
+  }
+  if (RequestArena::pooledBlocks() != RequestArena::max_pooled_blocks)
+    TEST_FAILED("Expected " + std::to_string(RequestArena::max_pooled_blocks) +
+                " pooled blocks, got " + std::to_string(RequestArena::pooledBlocks()));
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void table()
+{
+  CountingResource counter;
+  RequestArena arena(&counter);
+  Table tab(arena.resource());
+
+  for (std::size_t j = 0; j < 100; j++)
+    for (std::size_t i = 0; i < 5; i++)
+      tab.set(i, j, std::to_string(i * j));
+
+  if (tab.get(3, 7) != "21" || tab.get(4, 99) != "396")
+    TEST_FAILED("Table built in an arena returned wrong values");
+  if (counter.allocations != 0)
+    TEST_FAILED("Table cells should have been allocated from the initial block");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+class tests : public tframe::tests
+{
+  virtual const char* error_message_prefix() const { return "\n\t"; }
+  void test(void)
+  {
+    TEST(upstream);
+    TEST(recycle);
+    TEST(table);
+  }
+};
+
+}  // namespace RequestArenaTest
+
+//! The main program
+int main(void)
+{
+  using namespace std;
+  cout << endl << "RequestArena tester" << endl << "===================" << endl;
+  RequestArenaTest::tests t;
+  return t.run();
+}
+
+// ======================================================================
@@ -0,0 +1,236 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Regression tests for class RequestLog
+ */
+// ======================================================================
+
+#include "RequestLog.h"
+#include <macgyver/DateTime.h>
+#include <regression/tframe.h>
+#include <algorithm>
+#include <string>
+
+using SmartMet::Spine::LoggedRequest;
+using SmartMet::Spine::RequestLog;
+
+namespace
+{
+bool append(RequestLog& theLog,
+            const std::string& theURI,
+            const std::string& theIP = "127.0.0.1",
+            const Fmi::DateTime& theTime = Fmi::MicrosecClock::local_time(),
+            bool theEvictionAllowed = true)
+{
+  return theLog.append(theURI,
+                       theTime,
+                       Fmi::Milliseconds(1500),
+                       Fmi::Milliseconds(250),
+                       "200",
+                       theIP,
+                       "GET",
+                       "1.1",
+                       12345,
+                       "\"etag\"",
+                       "apikey",
+                       theEvictionAllowed);
+}
+}  // namespace
+
+//! Protection against conflicts with global functions
+namespace RequestLogTest
+{
+// ----------------------------------------------------------------------
+
+void roundtrip()
+{
+  RequestLog log(100, 100000);
+
+  const Fmi::DateTime now = Fmi::MicrosecClock::local_time();
+  append(log, "/foo?bar=1", "192.168.1.2", now);
+  append(log, "/foo?bar=2", "2001:db8::1", now);
+  append(log, "/foo?bar=3", "not-an-ip", now);
+
+  if (log.size() != 3)
+    TEST_FAILED("Expected 3 records, got " + std::to_string(log.size()));
+
+  const char* ips[] = {"192.168.1.2", "2001:db8::1", "not-an-ip"};
+
+  for (auto pos = log.begin(); pos != log.end(); ++pos)
+  {
+    const auto req = log.get(pos);
+    const auto n = pos - log.begin();
+    if (req.getRequestString() != "/foo?bar=" + std::to_string(n + 1))
+      TEST_FAILED("URI mismatch: " + req.getRequestString());
+    if (req.getIP() != ips[n])
+      TEST_FAILED("IP mismatch: " + req.getIP() + " vs " + ips[n]);
+    if (req.getRequestEndTime() != now)
+      TEST_FAILED("End time mismatch");
+    if (req.getAccessDuration() != Fmi::Milliseconds(1500) ||
+        req.getCpuDuration() != Fmi::Milliseconds(250))
+      TEST_FAILED("Duration mismatch");
+    if (req.getStatus() != "200" || req.getMethod() != "GET" || req.getVersion() != "1.1")
+      TEST_FAILED("Interned string mismatch");
+    if (req.getContentLength() != 12345 || req.getETag() != "\"etag\"" ||
+        req.getApiKey() != "apikey")
+      TEST_FAILED("Content length, ETag or API key mismatch");
+  }
+
+  if (log.getStatistics().interned != 4)  // "", "200", "GET", "1.1"
+    TEST_FAILED("Expected 4 interned strings, got " +
+                std::to_string(log.getStatistics().interned));
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void overwrite()
+{
+  // The record ring is the limit
+  RequestLog log(10, 100000);
+  for (int i = 0; i < 25; i++)
+    append(log, "/" + std::to_string(i));
+
+  if (log.size() != 10)
+    TEST_FAILED("Expected 10 records, got " + std::to_string(log.size()));
+  if (log.get(log.begin()).getRequestString() != "/15")
+    TEST_FAILED("Expected the oldest record to be /15");
+  if (log.getStatistics().overwritten != 15)
+    TEST_FAILED("Expected 15 overwritten records");
+
+  // The text arena is the limit
+  RequestLog log2(1000, 4096);
+  const std::string uri(400, 'x');
+  for (int i = 0; i < 100; i++)
+    append(log2, uri + std::to_string(i));
+
+  const auto stats = log2.getStatistics();
+  if (stats.text_bytes > stats.text_capacity)
+    TEST_FAILED("Text arena overflow");
+  if (log2.get(log2.end() - 1).getRequestString() != uri + "99")
+    TEST_FAILED("Last record was corrupted");
+  for (auto pos = log2.begin(); pos != log2.end(); ++pos)
+    if (log2.get(pos).getRequestString().substr(0, 400) != uri)
+      TEST_FAILED("Overwritten text is still referenced");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+// Client supplied strings longer than the smallest arena must be truncated
+void longfields()
+{
+  RequestLog log(10, 0);
+  const auto capacity = log.getStatistics().text_capacity;
+  const std::string uri(capacity, 'u');
+  const std::string etag(3 * capacity, 'e');
+  const std::string apikey(3 * capacity, 'k');
+  const std::string ip(300, 'i');
+
+  for (int i = 0; i < 20; i++)
+    log.append(uri,
+               Fmi::MicrosecClock::local_time(),
+               Fmi::Milliseconds(1),
+               Fmi::Milliseconds(1),
+               "200",
+               ip,
+               "GET",
+               "1.1",
+               0,
+               etag,
+               apikey,
+               true);
+
+  const auto stats = log.getStatistics();
+  if (stats.text_bytes > stats.text_capacity)
+    TEST_FAILED("Text arena overflow");
+  if (log.empty())
+    TEST_FAILED("The last request should have been kept");
+
+  const auto req = log.get(log.end() - 1);
+  if (req.getRequestString() != uri.substr(0, capacity / 8))
+    TEST_FAILED("URI should be truncated to 1/8 of the arena");
+  if (req.getETag() != etag.substr(0, capacity / 16) ||
+      req.getApiKey() != apikey.substr(0, capacity / 16))
+    TEST_FAILED("ETag and API key should be truncated to 1/16 of the arena");
+  if (req.getIP() != ip.substr(0, std::min<std::size_t>(capacity / 16, 255)))
+    TEST_FAILED("IP should be truncated to 1/16 of the arena or 255 bytes");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void drops()
+{
+  RequestLog log(10, 100000);
+  for (int i = 0; i < 10; i++)
+    append(log, "/" + std::to_string(i));
+
+  // Readers are active, the oldest records must not be overwritten
+  if (append(log, "/new", "127.0.0.1", Fmi::MicrosecClock::local_time(), false))
+    TEST_FAILED("Append should fail when eviction is not allowed");
+
+  if (log.get(log.begin()).getRequestString() != "/0")
+    TEST_FAILED("Oldest record should not have been overwritten");
+
+  if (log.getStatistics().dropped != 1)
+    TEST_FAILED("Expected one dropped request");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void purge()
+{
+  RequestLog log(100, 100000);
+
+  const Fmi::DateTime now = Fmi::MicrosecClock::local_time();
+  for (int i = 0; i < 10; i++)
+    append(log, "/" + std::to_string(i), "127.0.0.1", now - Fmi::Minutes(10 - i));
+
+  log.purge(now - Fmi::Minutes(5));
+
+  if (log.size() != 4)
+    TEST_FAILED("Expected 4 records after purge, got " + std::to_string(log.size()));
+
+  if (log.getRequestEndTime(log.begin()) != now - Fmi::Minutes(4))
+    TEST_FAILED("Wrong oldest record after purge");
+
+  log.clear();
+  if (!log.empty())
+    TEST_FAILED("Log should be empty after clear");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+class tests : public tframe::tests
+{
+  virtual const char* error_message_prefix() const { return "\n\t"; }
+  void test(void)
+  {
+    TEST(roundtrip);
+    TEST(overwrite);
+    TEST(longfields);
+    TEST(drops);
+    TEST(purge);
+  }
+};
+
+}  // namespace RequestLogTest
+
+//! The main program
+int main(void)
+{
+  using namespace std;
+  cout << endl << "RequestLog tester" << endl << "=================" << endl;
+  RequestLogTest::tests t;
+  return t.run();
+}
+
+// ======================================================================
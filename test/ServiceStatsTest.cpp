@@ -0,0 +1,131 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Regression tests for class ServiceStats
+ */
+// ======================================================================
+
+#include "ServiceStats.h"
+#include <regression/tframe.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using SmartMet::Spine::ServiceStats;
+using std::chrono::hours;
+using std::chrono::microseconds;
+using std::chrono::minutes;
+using std::chrono::seconds;
+
+//! Protection against conflicts with global functions
+namespace ServiceStatsTest
+{
+// Start from a round day so that bucket boundaries are predictable
+const ServiceStats::Clock::time_point t0{hours(24 * 1000)};
+
+// ----------------------------------------------------------------------
+
+void windows()
+{
+  ServiceStats stats;
+
+  stats.add(microseconds(1000), microseconds(100), t0, 10);  // 2 hours ago
+  stats.add(microseconds(2000), microseconds(200), t0 + hours(2) - minutes(30), 20);
+  stats.add(microseconds(3000), microseconds(300), t0 + hours(2) - seconds(30), 30);
+  stats.add(microseconds(4000), microseconds(400), t0 + hours(2), 40);
+
+  auto s = stats.summary(t0 + hours(2));
+
+  if (s.last_minute != 2)
+    TEST_FAILED("Expected 2 requests in the last minute, got " + std::to_string(s.last_minute));
+  if (s.last_hour != 3)
+    TEST_FAILED("Expected 3 requests in the last hour, got " + std::to_string(s.last_hour));
+  if (s.last_day != 4)
+    TEST_FAILED("Expected 4 requests in the last day, got " + std::to_string(s.last_day));
+  if (s.day_microseconds != 10000 || s.day_cpu_microseconds != 1000)
+    TEST_FAILED("Incorrect duration totals");
+  if (s.day_allocated_bytes != 100)
+    TEST_FAILED("Incorrect allocation total");
+
+  // Everything expires after a day, except the total
+  s = stats.summary(t0 + hours(27));
+  if (s.last_minute != 0 || s.last_hour != 0 || s.last_day != 0)
+    TEST_FAILED("Old requests should have expired");
+  if (s.total != 4)
+    TEST_FAILED("The total should never expire");
+  if (s.total_allocated_bytes != 100)
+    TEST_FAILED("Allocation total should never expire");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void recycle()
+{
+  ServiceStats stats;
+
+  stats.add(microseconds(1000), microseconds(0), t0);
+  // Same second bucket one minute later must be reset first
+  stats.add(microseconds(1000), microseconds(0), t0 + minutes(1));
+
+  const auto s = stats.summary(t0 + minutes(1));
+  if (s.last_minute != 1)
+    TEST_FAILED("Recycled bucket was not reset, got " + std::to_string(s.last_minute));
+  if (s.last_hour != 2)
+    TEST_FAILED("Expected 2 requests in the last hour, got " + std::to_string(s.last_hour));
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void concurrent()
+{
+  ServiceStats stats;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; t++)
+    threads.emplace_back(
+        [&stats]()
+        {
+          for (int i = 0; i < 10000; i++)
+            stats.add(microseconds(10), microseconds(1), t0);
+        });
+  for (auto& thread : threads)
+    thread.join();
+
+  const auto s = stats.summary(t0);
+  if (s.last_minute != 80000 || s.last_day != 80000)
+    TEST_FAILED("Expected 80000 requests, got " + std::to_string(s.last_minute));
+  if (s.day_microseconds != 800000)
+    TEST_FAILED("Incorrect duration total");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+class tests : public tframe::tests
+{
+  virtual const char* error_message_prefix() const { return "\n\t"; }
+  void test(void)
+  {
+    TEST(windows);
+    TEST(recycle);
+    TEST(concurrent);
+  }
+};
+
+}  // namespace ServiceStatsTest
+
+//! The main program
+int main(void)
+{
+  using namespace std;
+  cout << endl << "ServiceStats tester" << endl << "===================" << endl;
+  ServiceStatsTest::tests t;
+  return t.run();
+}
+
+// ======================================================================
@@ -0,0 +1,165 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Regression tests for class ShardedMemoryCache
+ */
+// ======================================================================
+
+#include "ShardedMemoryCache.h"
+#include <regression/tframe.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using SmartMet::Spine::ShardedMemoryCache;
+
+//! Protection against conflicts with global functions
+namespace ShardedMemoryCacheTest
+{
+std::string keys(const ShardedMemoryCache::Items& theItems)
+{
+  std::string ret;
+  for (const auto& item : theItems)
+  {
+    if (!ret.empty())
+      ret += ',';
+    ret += std::to_string(item.first);
+  }
+  return ret;
+}
+
+ShardedMemoryCache::ValueType value(std::size_t theSize)
+{
+  return std::make_shared<std::string>(theSize, 'x');
+}
+
+// ----------------------------------------------------------------------
+
+void budget()
+{
+  ShardedMemoryCache cache(10, 8);
+  ShardedMemoryCache::Items evicted;
+
+  for (std::size_t key = 10; key <= 50; key += 10)
+    cache.insert(key, value(2), evicted);
+  if (!evicted.empty())
+    TEST_FAILED("Nothing should be evicted while within budget");
+
+  for (std::size_t key = 1; key <= 5; key++)
+    cache.insert(key, value(1), evicted);
+
+  if (keys(evicted) != "10,20,30")
+    TEST_FAILED("Expected evictions 10,20,30, got " + keys(evicted));
+
+  const auto stats = cache.statistics();
+  if (stats.size != 9 || stats.entries != 7 || stats.evictions != 3)
+    TEST_FAILED("Wrong statistics, size=" + std::to_string(stats.size) +
+                " entries=" + std::to_string(stats.entries));
+
+  // A value may use the whole budget, but not more
+  if (!cache.insert(100, value(10), evicted) || cache.getContent().size() != 1)
+    TEST_FAILED("A value using the whole budget should evict everything else");
+  if (cache.insert(200, value(11), evicted))
+    TEST_FAILED("A value exceeding the budget should be rejected");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void lru()
+{
+  // Keys spread over the shards are still evicted in global LRU order
+  ShardedMemoryCache cache(3, 16);
+  ShardedMemoryCache::Items evicted;
+
+  for (std::size_t key = 1; key <= 7; key++)
+    cache.insert(key, value(1), evicted);
+  if (keys(evicted) != "1,2,3,4")
+    TEST_FAILED("Expected evictions 1,2,3,4, got " + keys(evicted));
+
+  for (std::size_t key : {7, 6, 5})
+    if (!cache.find(key))
+      TEST_FAILED("Key " + std::to_string(key) + " should have been found");
+  if (cache.find(1))
+    TEST_FAILED("Key 1 should have been evicted");
+
+  evicted.clear();
+  cache.insert(4, value(1), evicted);
+  if (keys(evicted) != "7")
+    TEST_FAILED("Expected eviction of 7, got " + keys(evicted));
+  if (keys(cache.getContent()) != "6,5,4")
+    TEST_FAILED("Expected content 6,5,4, got " + keys(cache.getContent()));
+
+  const auto stats = cache.statistics();
+  if (stats.hits != 3 || stats.misses != 1 || stats.inserts != 8)
+    TEST_FAILED("Wrong hit, miss or insert counts");
+
+  if (!cache.remove(5) || cache.remove(5) || keys(cache.getContent()) != "6,4" || cache.bytes() != 2)
+    TEST_FAILED("Key 5 should have been removed");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void threads()
+{
+  const std::size_t budget = 1000;
+  ShardedMemoryCache cache(budget);
+
+  std::vector<std::thread> workers;
+  for (std::size_t t = 0; t < 8; t++)
+    workers.emplace_back(
+        [&cache, t]
+        {
+          ShardedMemoryCache::Items evicted;
+          for (std::size_t i = 0; i < 10000; i++)
+          {
+            const auto key = (t * 7919 + i * 31) % 2000;
+            if (!cache.find(key))
+              cache.insert(key, value(1 + key % 10), evicted);
+          }
+        });
+  for (auto& worker : workers)
+    worker.join();
+
+  std::size_t bytes = 0;
+  for (const auto& item : cache.getContent())
+    bytes += item.second->size();
+
+  const auto stats = cache.statistics();
+  if (bytes != stats.size)
+    TEST_FAILED("Byte accounting is off: " + std::to_string(bytes) +
+                " != " + std::to_string(stats.size));
+  if (bytes > budget)
+    TEST_FAILED("Budget exceeded: " + std::to_string(bytes));
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+class tests : public tframe::tests
+{
+  virtual const char* error_message_prefix() const { return "\n\t"; }
+  void test(void)
+  {
+    TEST(budget);
+    TEST(lru);
+    TEST(threads);
+  }
+};
+
+}  // namespace ShardedMemoryCacheTest
+
+//! The main program
+int main(void)
+{
+  using namespace std;
+  cout << endl << "ShardedMemoryCache tester" << endl << "=========================" << endl;
+  ShardedMemoryCacheTest::tests t;
+  return t.run();
+}
+
+// ======================================================================
@@ -0,0 +1,313 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Regression tests for class SharedMemoryCache
+ */
+// ======================================================================
+
+#include "SharedMemoryCache.h"
+#include <regression/tframe.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using SmartMet::Spine::SharedMemoryCache;
+
+namespace
+{
+// A plain file behaves like one in /dev/shm, and is cleaned up with the other tests
+std::string testfile()
+{
+  auto dir = std::filesystem::path("/tmp") / std::to_string(int(getuid()));
+  std::filesystem::create_directories(dir);
+  auto file = (dir / "bsshmcachetest").string();
+  SharedMemoryCache::unlink(file);
+  return file;
+}
+
+std::string value(std::size_t theKey, std::size_t theSize)
+{
+  auto ret = std::to_string(theKey) + ":";
+  ret.resize(theSize, char('a' + theKey % 26));
+  return ret;
+}
+
+}  // namespace
+
+//! Protection against conflicts with global functions
+namespace SharedMemoryCacheTest
+{
+// ----------------------------------------------------------------------
+
+void insert_find()
+{
+  SharedMemoryCache cache(testfile(), 1024 * 1024, 0, 64 * 1024);
+
+  if (cache.find(1))
+    TEST_FAILED("Empty cache should not contain anything");
+
+  if (!cache.insert(1, "first") || !cache.insert(2, "second"))
+    TEST_FAILED("Insert failed");
+
+  auto result = cache.find(1);
+  if (!result || *result != "first")
+    TEST_FAILED("Failed to find the first value");
+
+  if (!cache.insert(1, "replaced") || *cache.find(1) != "replaced")
+    TEST_FAILED("Failed to replace the first value");
+
+  if (!cache.remove(2) || cache.find(2))
+    TEST_FAILED("Failed to remove the second value");
+
+  if (cache.insert(3, std::string(cache.maxValueSize() + 1, 'x')))
+    TEST_FAILED("Too large value should be rejected");
+
+  if (!cache.insert(3, std::string(cache.maxValueSize(), 'x')) ||
+      cache.find(3)->size() != cache.maxValueSize())
+    TEST_FAILED("Value of maximum size should be accepted");
+
+  const auto stats = cache.statistics();
+  if (stats.used_slots != 2 || stats.inserts != 4 || stats.failures != 1)
+    TEST_FAILED("Unexpected statistics: used slots " + std::to_string(stats.used_slots) +
+                ", inserts " + std::to_string(stats.inserts) + ", failures " +
+                std::to_string(stats.failures));
+
+  TEST_PASSED();
+}
+
+// Two mappings of the same file act like two processes
+void shared()
+{
+  const auto file = testfile();
+  SharedMemoryCache cache1(file, 1024 * 1024, 0, 64 * 1024);
+  SharedMemoryCache cache2(file, 1024 * 1024, 0, 64 * 1024);
+
+  cache1.insert(1, "one");
+  auto result = cache2.find(1);
+  if (!result || *result != "one")
+    TEST_FAILED("Value inserted via one mapping should be found via the other");
+
+  cache2.insert(1, "uno");
+  if (*cache1.find(1) != "uno")
+    TEST_FAILED("Replaced value should be visible via the other mapping");
+
+  TEST_PASSED();
+}
+
+// Contents survive the process, the geometry of the existing file is kept
+void restart()
+{
+  const auto file = testfile();
+  {
+    SharedMemoryCache cache(file, 1024 * 1024, 0, 64 * 1024);
+    cache.insert(1, "persistent");
+  }
+
+  SharedMemoryCache cache(file, 8 * 1024 * 1024);
+  auto result = cache.find(1);
+  if (!result || *result != "persistent")
+    TEST_FAILED("Value should survive reopening the cache");
+
+  const auto stats = cache.statistics();
+  if (stats.pages != 16 || stats.page_size != 64 * 1024)
+    TEST_FAILED("Existing geometry should be used, got " + std::to_string(stats.pages) +
+                " pages of " + std::to_string(stats.page_size) + " bytes");
+
+  TEST_PASSED();
+}
+
+// An incompatible file is replaced, not rewritten under processes still using it
+void replace()
+{
+  const auto file = testfile();
+  const std::string old_contents(10000, 'x');
+  {
+    std::ofstream out(file);
+    out << old_contents;
+  }
+
+  const int fd = ::open(file.c_str(), O_RDONLY);
+  if (fd < 0)
+    TEST_FAILED("Failed to open the test file");
+
+  SharedMemoryCache cache(file, 1024 * 1024, 0, 64 * 1024);
+  cache.insert(1, "new");
+
+  struct stat st;
+  const bool ok = (fstat(fd, &st) == 0);
+  ::close(fd);
+
+  if (!ok || st.st_size != static_cast<off_t>(old_contents.size()))
+    TEST_FAILED("The old file should not have been modified");
+
+  if (std::filesystem::exists(file + ".new"))
+    TEST_FAILED("The new file should have been renamed");
+
+  SharedMemoryCache cache2(file, 1024 * 1024);
+  auto result = cache2.find(1);
+  if (!result || *result != "new")
+    TEST_FAILED("The new file should be shared via the original name");
+
+  TEST_PASSED();
+}
+
+// A full cache evicts old values instead of failing
+void eviction()
+{
+  SharedMemoryCache cache(testfile(), 64 * 1024, 256, 4096);
+
+  const std::size_t n = 10000;
+  for (std::size_t key = 1; key <= n; key++)
+    cache.insert(key, value(key, 100));
+
+  const auto stats = cache.statistics();
+  if (stats.evictions == 0)
+    TEST_FAILED("Values should have been evicted");
+
+  if (stats.failures > n / 10)
+    TEST_FAILED("Too many failed inserts: " + std::to_string(stats.failures));
+
+  auto result = cache.find(n);
+  if (!result || *result != value(n, 100))
+    TEST_FAILED("The latest value should be found");
+
+  std::size_t found = 0;
+  for (std::size_t key = 1; key <= n; key++)
+  {
+    auto result = cache.find(key);
+    if (result)
+    {
+      ++found;
+      if (*result != value(key, 100))
+        TEST_FAILED("Wrong value for key " + std::to_string(key));
+    }
+  }
+  if (found == 0 || found > 64 * 1024 / 128)
+    TEST_FAILED("Unexpected number of values found: " + std::to_string(found));
+
+  TEST_PASSED();
+}
+
+// Pages taken by small values must be reusable for large ones
+void rebalance()
+{
+  SharedMemoryCache cache(testfile(), 64 * 1024, 1024, 4096);
+
+  for (std::size_t key = 1; key <= 2000; key++)
+    cache.insert(key, value(key, 100));
+
+  std::size_t inserted = 0;
+  for (std::size_t key = 10001; key <= 10100; key++)
+    if (cache.insert(key, value(key, 2000)))
+      ++inserted;
+
+  if (inserted < 90)
+    TEST_FAILED("Only " + std::to_string(inserted) + " of 100 large values were inserted");
+
+  const auto stats = cache.statistics();
+  if (stats.rebalances < 2)
+    TEST_FAILED("Expected pages to be moved between classes, got " +
+                std::to_string(stats.rebalances));
+
+  std::size_t found = 0;
+  for (std::size_t key = 10001; key <= 10100; key++)
+  {
+    auto result = cache.find(key);
+    if (result)
+    {
+      ++found;
+      if (*result != value(key, 2000))
+        TEST_FAILED("Wrong value for key " + std::to_string(key));
+    }
+  }
+  if (found < 10)
+    TEST_FAILED("Large values should get a fair share of the pages, found " +
+                std::to_string(found));
+
+  // Small values which survived must still be intact
+  for (std::size_t key = 1; key <= 2000; key++)
+  {
+    auto result = cache.find(key);
+    if (result && *result != value(key, 100))
+      TEST_FAILED("Wrong small value for key " + std::to_string(key));
+  }
+
+  TEST_PASSED();
+}
+
+// Readers must never see a value of another key or a partial value
+void concurrent()
+{
+  const auto file = testfile();
+  SharedMemoryCache cache1(file, 256 * 1024, 512, 4096);
+  SharedMemoryCache cache2(file, 256 * 1024, 512, 4096);
+
+  std::atomic<bool> failed{false};
+  std::vector<std::thread> threads;
+  for (std::size_t t = 0; t < 4; t++)
+  {
+    threads.emplace_back(
+        [&, t]()
+        {
+          auto& cache = (t % 2 == 0 ? cache1 : cache2);
+          for (std::size_t i = 0; i < 20000; i++)
+          {
+            const std::size_t key = 1 + (i * 7 + t) % 1000;
+            const std::size_t size = 50 + (key * 37) % 3000;
+            if (i % 3 == 0)
+              cache.insert(key, value(key, size));
+            else
+            {
+              auto result = cache.find(key);
+              if (result && *result != value(key, size))
+                failed = true;
+            }
+          }
+        });
+  }
+
+  for (auto& thread : threads)
+    thread.join();
+
+  if (failed)
+    TEST_FAILED("An inconsistent value was found");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+class tests : public tframe::tests
+{
+  virtual const char* error_message_prefix() const { return "\n\t"; }
+  void test(void)
+  {
+    TEST(insert_find);
+    TEST(shared);
+    TEST(restart);
+    TEST(replace);
+    TEST(eviction);
+    TEST(rebalance);
+    TEST(concurrent);
+  }
+};
+
+}  // namespace SharedMemoryCacheTest
+
+//! The main program
+int main(void)
+{
+  using namespace std;
+  cout << endl << "SharedMemoryCache tester" << endl << "========================" << endl;
+  SharedMemoryCacheTest::tests t;
+  return t.run();
+}
+
+// ======================================================================
@@ -0,0 +1,175 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Hit ratio of SmartMetCache with and without TinyLFU admission
+ *
+ * Replays the successful GET requests of a spine access log through a
+ * memory only SmartMetCache, using the request string as the key and
+ * the content length as the value size. Without a log a synthetic
+ * trace is used: requests for a hot set of tiles with Zipf distributed
+ * popularity interleaved with a crawler sweeping a large tile pyramid.
+ *
+ * Usage: SmartMetCacheAdmissionBenchmark [access log or -] [budget MB]
+ */
+// ======================================================================
+
+#include "SmartMetCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using SmartMet::Spine::SmartMetCache;
+
+namespace
+{
+struct Request
+{
+  std::size_t key;
+  std::size_t size;
+};
+
+// host - - [end] "GET /uri HTTP/1.1" status [start] duration length etag apikey
+bool parse(const std::string& theLine, Request& theRequest)
+{
+  const auto q1 = theLine.find('"');
+  const auto q2 = (q1 == std::string::npos ? q1 : theLine.find('"', q1 + 1));
+  if (q2 == std::string::npos)
+    return false;
+
+  const std::string request = theLine.substr(q1 + 1, q2 - q1 - 1);
+  if (request.compare(0, 4, "GET ") != 0)
+    return false;
+  const auto uri = request.substr(4, request.rfind(' ') - 4);
+
+  if (theLine.compare(q2 + 1, 5, " 200 ") != 0)
+    return false;
+
+  const auto pos = theLine.find("] ", q2);
+  if (pos == std::string::npos)
+    return false;
+
+  char* end = nullptr;
+  std::strtoul(theLine.c_str() + pos + 2, &end, 10);   // duration
+  const auto length = std::strtoul(end, nullptr, 10);  // content length
+
+  theRequest.key = std::hash<std::string>()(uri);
+  theRequest.size = std::max(1UL, length);
+  return true;
+}
+
+std::vector<Request> read_trace(const std::string& theFile)
+{
+  std::vector<Request> ret;
+  std::ifstream in(theFile);
+  if (!in)
+  {
+    std::cerr << "Failed to open " << theFile << std::endl;
+    std::exit(1);
+  }
+  std::string line;
+  Request request;
+  while (std::getline(in, line))
+    if (parse(line, request))
+      ret.push_back(request);
+  return ret;
+}
+
+std::vector<Request> synthetic_trace()
+{
+  const std::size_t hot_tiles = 5000;
+  const std::size_t pyramid_tiles = 500000;
+  const std::size_t requests = 1000000;
+  const std::size_t tile_size = 10000;
+
+  std::vector<double> cdf(hot_tiles);
+  double sum = 0;
+  for (std::size_t i = 0; i < hot_tiles; i++)
+    cdf[i] = (sum += 1.0 / (i + 1));
+
+  std::mt19937_64 rng(1);
+  std::uniform_real_distribution<double> uniform(0, sum);
+  std::bernoulli_distribution crawl(0.5);
+
+  std::vector<Request> ret;
+  std::size_t next = 0;
+  for (std::size_t i = 0; i < requests; i++)
+  {
+    if (crawl(rng))
+      ret.push_back({hot_tiles + (next++ % pyramid_tiles), tile_size});
+    else
+    {
+      const auto pos = std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin();
+      ret.push_back({static_cast<std::size_t>(pos), tile_size});
+    }
+  }
+  return ret;
+}
+
+double replay(const std::vector<Request>& theTrace,
+              std::size_t theBudget,
+              bool theAdmission,
+              std::size_t& theRejections)
+{
+  SmartMetCache cache(theBudget, 0, "");
+  if (theAdmission)
+  {
+    std::size_t bytes = 0;
+    for (const auto& request : theTrace)
+      bytes += request.size;
+    cache.enableAdmission(theBudget / std::max<std::size_t>(1, bytes / theTrace.size()));
+  }
+
+  std::size_t hits = 0;
+  for (const auto& request : theTrace)
+  {
+    if (cache.find(request.key))
+      ++hits;
+    else
+      cache.insert(request.key, std::make_shared<std::string>(request.size, 'x'));
+  }
+
+  theRejections = cache.getAdmissionRejections();
+  return 100.0 * hits / theTrace.size();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  const bool synthetic = (argc < 2 || std::string(argv[1]) == "-");
+  const auto trace = (synthetic ? synthetic_trace() : read_trace(argv[1]));
+  const std::size_t budget = (argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20) * 1024 * 1024;
+
+  std::unordered_set<std::size_t> keys;
+  for (const auto& request : trace)
+    keys.insert(request.key);
+
+  std::printf("\nSmartMetCache admission benchmark\n");
+  std::printf("=================================\n");
+  std::printf("%s trace, %zu requests, %zu distinct keys, %zu MB budget\n\n",
+              synthetic ? "synthetic" : argv[1],
+              trace.size(),
+              keys.size(),
+              budget / 1024 / 1024);
+
+  if (trace.empty())
+    return 0;
+
+  std::size_t rejections = 0;
+  const auto lru = replay(trace, budget, false, rejections);
+  const auto tinylfu = replay(trace, budget, true, rejections);
+
+  std::printf("policy    hit%%\n");
+  std::printf("LRU      %5.1f\n", lru);
+  std::printf("TinyLFU  %5.1f  (%zu inserts rejected)\n", tinylfu, rejections);
+  return 0;
+}
+
+// ======================================================================
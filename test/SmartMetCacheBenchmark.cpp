@@ -0,0 +1,142 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Multithreaded benchmark of the SmartMetCache memory tier
+ *
+ * Compares the single lock Fmi::Cache::Cache previously used as the
+ * memory tier with ShardedMemoryCache. Each thread looks up keys from
+ * a skewed distribution and inserts the missing ones, all evictions
+ * are collected as they would be for the file cache.
+ *
+ * Usage: SmartMetCacheBenchmark [operations per thread] [budget MB]
+ */
+// ======================================================================
+
+#include "ShardedMemoryCache.h"
+#include "SmartMetCache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+using SmartMet::Spine::BufferSizeFunction;
+using SmartMet::Spine::ShardedMemoryCache;
+
+namespace
+{
+using KeyType = std::size_t;
+using ValueType = std::shared_ptr<std::string>;
+using Items = std::vector<std::pair<KeyType, ValueType>>;
+
+const std::size_t keyspace = 100000;
+const std::size_t value_size = 2048;
+
+struct Single
+{
+  explicit Single(std::size_t theBytes) : cache(theBytes) {}
+  bool find(KeyType theKey) { return !!cache.find(theKey); }
+  void insert(KeyType theKey, const ValueType& theValue, Items& theEvicted)
+  {
+    cache.insert(theKey, theValue, theEvicted);
+  }
+  Fmi::Cache::Cache<KeyType, ValueType, BufferSizeFunction, 1> cache;
+};
+
+struct Sharded
+{
+  explicit Sharded(std::size_t theBytes) : cache(theBytes) {}
+  bool find(KeyType theKey) { return !!cache.find(theKey); }
+  void insert(KeyType theKey, const ValueType& theValue, Items& theEvicted)
+  {
+    cache.insert(theKey, theValue, theEvicted);
+  }
+  ShardedMemoryCache cache;
+};
+
+struct Result
+{
+  double mops = 0;
+  double hitrate = 0;
+};
+
+template <typename Cache>
+Result run(std::size_t theThreads, std::size_t theOperations, std::size_t theBudget)
+{
+  Cache cache(theBudget);
+  const auto value = std::make_shared<std::string>(value_size, 'x');
+
+  std::vector<std::size_t> hits(theThreads, 0);
+  std::vector<std::thread> workers;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t t = 0; t < theThreads; t++)
+    workers.emplace_back(
+        [&, t]
+        {
+          // Squaring a uniform variate favours the small keys
+          std::mt19937_64 rng(t + 1);
+          std::uniform_real_distribution<double> uniform(0, 1);
+          Items evicted;
+          std::size_t n = 0;
+          for (std::size_t i = 0; i < theOperations; i++)
+          {
+            const double u = uniform(rng);
+            const auto key = static_cast<KeyType>(u * u * keyspace);
+            if (cache.find(key))
+              ++n;
+            else
+              cache.insert(key, value, evicted);
+            evicted.clear();
+          }
+          hits[t] = n;
+        });
+  for (auto& worker : workers)
+    worker.join();
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  std::size_t total_hits = 0;
+  for (auto n : hits)
+    total_hits += n;
+
+  Result ret;
+  ret.mops = theThreads * theOperations / elapsed.count() / 1e6;
+  ret.hitrate = 100.0 * total_hits / (theThreads * theOperations);
+  return ret;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  const std::size_t operations = (argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000);
+  const std::size_t budget = (argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 32) * 1024 * 1024;
+
+  std::printf("\nSmartMetCache memory tier benchmark\n");
+  std::printf("===================================\n");
+  std::printf("%zu operations per thread, %zu MB budget, %zu byte values, %zu keys\n\n",
+              operations,
+              budget / 1024 / 1024,
+              value_size,
+              keyspace);
+  std::printf("threads  single Mops/s  hit%%  sharded Mops/s  hit%%  speedup\n");
+
+  const std::size_t max_threads = std::max(2U, std::thread::hardware_concurrency());
+  for (std::size_t threads = 1; threads <= max_threads; threads *= 2)
+  {
+    const auto single = run<Single>(threads, operations, budget);
+    const auto sharded = run<Sharded>(threads, operations, budget);
+    std::printf("%7zu  %13.2f  %4.1f  %14.2f  %4.1f  %7.2f\n",
+                threads,
+                single.mops,
+                single.hitrate,
+                sharded.mops,
+                sharded.hitrate,
+                sharded.mops / single.mops);
+  }
+  return 0;
+}
+
+// ======================================================================
@@ -7,8 +7,11 @@
 
 #include "SmartMetCache.h"
 #include <chrono>
+#include <filesystem>
+#include <fstream>
 #include <macgyver/AsyncTask.h>
 #include <regression/tframe.h>
+#include <set>
 #include <sys/types.h>
 #include <sstream>
 #include <string>
@@ -203,6 +206,362 @@ void promote()
   // TEST_PASSED();
 }
 
+// Evicted entries must be found while waiting in the write queue, and the
+// queue must drain completely
+void write_queue()
+{
+  uid_t uid = getuid();
+
+  SmartMet::Spine::SmartMetCache cache(
+      4, 1000, "/tmp/" + std::to_string(int(uid)) + "/bscachetest5", 0, 2, 100);
+
+  for (std::size_t key = 1; key <= 50; ++key)
+    cache.insert(key, std::make_shared<std::string>(std::to_string(key % 10)));
+
+  // Queue the same keys again
+  for (std::size_t key = 1; key <= 10; ++key)
+    cache.insert(key, std::make_shared<std::string>(std::to_string(key % 10)));
+
+  for (std::size_t key = 1; key <= 50; ++key)
+  {
+    auto res = cache.find(key);
+    if (!res || *res != std::to_string(key % 10))
+      TEST_FAILED("Key " + tostr(key) + " was lost while being written");
+  }
+
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+
+  const auto stats = cache.getWriteQueueStats();
+  if (stats.depth != 0 || stats.bytes != 0)
+    TEST_FAILED("Write queue did not drain, depth=" + tostr(stats.depth));
+  if (stats.dropped != 0)
+    TEST_FAILED("Nothing should have been dropped");
+  if (stats.written == 0 || stats.batches == 0 || stats.batches > stats.written)
+    TEST_FAILED("Writes were not counted");
+  if (stats.maxbytes != 100)
+    TEST_FAILED("Wrong queue bound " + tostr(stats.maxbytes));
+
+  TEST_PASSED();
+}
+
+bool in_memory(SmartMet::Spine::SmartMetCache& cache, std::size_t key)
+{
+  for (const auto& item : cache.getContent())
+    if (item.first == key && item.second)
+      return true;
+  return false;
+}
+
+// File cache hits are mapped, and promoted to memory only when used often enough
+void view()
+{
+  uid_t uid = getuid();
+
+  SmartMet::Spine::SmartMetCache cache(4, 1000, "/tmp/" + std::to_string(int(uid)) + "/bscachetest6");
+  cache.setFilePromotionThreshold(2);
+
+  for (std::size_t key = 1; key <= 4; ++key)
+    cache.insert(key, std::make_shared<std::string>("v" + std::to_string(key)));
+
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+
+  auto res = cache.findView(1);
+  if (!res || res.data() != "v1")
+    TEST_FAILED("Key 1 should have been found from the file cache");
+  if (std::string(res.array().get(), res.size()) != "v1")
+    TEST_FAILED("Array content does not match the view");
+  if (in_memory(cache, 1))
+    TEST_FAILED("A single file cache hit should not promote the value");
+
+  res = cache.findView(1);
+  if (!res || res.data() != "v1")
+    TEST_FAILED("Key 1 should have been found again");
+  if (!in_memory(cache, 1))
+    TEST_FAILED("The second file cache hit should promote the value");
+
+  res = cache.findView(4);
+  if (!res || res.data() != "v4")
+    TEST_FAILED("Key 4 should have been found from memory");
+
+  TEST_PASSED();
+}
+
+// A sweep over keys seen only once must not flush frequently used keys
+void admission()
+{
+  SmartMet::Spine::SmartMetCache cache(4, 0, "");
+  cache.enableAdmission(100);
+
+  for (std::size_t key = 1; key <= 4; ++key)
+  {
+    cache.insert(key, std::make_shared<std::string>("x"));
+    for (int i = 0; i < 3; i++)
+      cache.find(key);
+  }
+
+  for (std::size_t key = 100; key < 200; ++key)
+    if (!cache.find(key))
+      cache.insert(key, std::make_shared<std::string>("y"));
+
+  for (std::size_t key = 1; key <= 4; ++key)
+    if (!cache.find(key))
+      TEST_FAILED("Frequently used key " + tostr(key) + " was evicted by the sweep");
+
+  if (cache.getAdmissionRejections() != 100)
+    TEST_FAILED("Expected 100 rejections, got " + tostr(cache.getAdmissionRejections()));
+
+  TEST_PASSED();
+}
+
+// The memory contents survive a restart through the file cache
+void warm_restart()
+{
+  uid_t uid = getuid();
+  const std::string dir = "/tmp/" + std::to_string(int(uid)) + "/bscachetest7";
+
+  {
+    SmartMet::Spine::SmartMetCache cache(10, 1000, dir);
+    cache.enableWarmRestart(0, 1000);
+    for (std::size_t key = 1; key <= 8; ++key)
+      cache.insert(key, std::make_shared<std::string>("a" + std::to_string(key)));
+    cache.find(7);
+  }
+
+  SmartMet::Spine::SmartMetCache cache(10, 1000, dir);
+  cache.enableWarmRestart();
+
+  for (int i = 0; i < 100 && cache.getPrewarmedEntries() < 5; i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  std::vector<std::size_t> memory;
+  for (const auto& item : cache.getContent())
+    if (item.second)
+      memory.push_back(item.first);
+
+  const std::vector<std::size_t> correct_order = {4, 5, 6, 8, 7};
+  if (memory != correct_order)
+    TEST_FAILED("The memory cache was not prewarmed in the previous LRU order");
+
+  auto res = cache.find(1);
+  if (!res || *res != "a1")
+    TEST_FAILED("Key 1 should have been found from the file cache");
+
+  TEST_PASSED();
+}
+
+// Without a flush budget only entries already on disk survive the restart
+void warm_restart_index()
+{
+  uid_t uid = getuid();
+  const std::string dir = "/tmp/" + std::to_string(int(uid)) + "/bscachetest12";
+  std::filesystem::remove_all(dir);
+
+  {
+    SmartMet::Spine::SmartMetCache cache(10, 1000, dir);
+    cache.enableWarmRestart();
+    for (std::size_t key = 1; key <= 8; ++key)
+      cache.insert(key, std::make_shared<std::string>("a" + std::to_string(key)));
+
+    for (int i = 0; i < 100 && cache.getWriteQueueStats().written < 3; i++)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  SmartMet::Spine::SmartMetCache cache(10, 1000, dir);
+
+  std::set<std::size_t> files;
+  for (const auto& item : cache.getContent())
+    if (!item.second)
+      files.insert(item.first);
+
+  // Prewarming may have evicted more than the first three entries, but
+  // not the most recent ones
+  if (files.count(1) == 0 || files.count(3) == 0 || files.count(7) > 0 || files.count(8) > 0)
+    TEST_FAILED("Only the evicted entries should have been written");
+
+  TEST_PASSED();
+}
+
+// Files of the old cache layout would never be found nor removed
+void legacy_files()
+{
+  uid_t uid = getuid();
+  const std::filesystem::path dir = "/tmp/" + std::to_string(int(uid)) + "/bscachetest13";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir / "12");
+  std::filesystem::create_directories(dir / "data" / "34");
+  std::ofstream(dir / "12" / "3456789") << "legacy";
+  std::ofstream(dir / "12" / "notes.txt") << "other";
+  std::ofstream(dir / "data" / "34" / "5678") << "other";
+  std::ofstream(dir / "keep") << "owner";
+
+  SmartMet::Spine::SmartMetCache cache(10, 1000, dir);
+
+  if (std::filesystem::exists(dir / "12" / "3456789"))
+    TEST_FAILED("Files of the old layout should have been removed");
+  if (!std::filesystem::exists(dir / "12" / "notes.txt") ||
+      !std::filesystem::exists(dir / "data" / "34" / "5678"))
+    TEST_FAILED("Files in another layout should be kept");
+  if (!std::filesystem::exists(dir / "keep"))
+    TEST_FAILED("Files in the cache directory itself should be kept");
+
+  TEST_PASSED();
+}
+
+void compression()
+{
+  uid_t uid = getuid();
+  SmartMet::Spine::SmartMetCache cache(
+      300, 10000, "/tmp/" + std::to_string(int(uid)) + "/bscachetest8");
+  cache.enableCompression(3, false, 10000);
+
+  std::string json1 = "[";
+  std::string json2 = "[";
+  for (int i = 0; i < 200; i++)
+  {
+    json1 += "{\"name\":\"station\",\"value\":" + std::to_string(i % 10) + "},";
+    json2 += "{\"name\":\"location\",\"value\":" + std::to_string(i % 7) + "},";
+  }
+  json1 += "{}]";
+  json2 += "{}]";
+
+  cache.insert(1, std::make_shared<std::string>(json1));
+
+  auto res = cache.find(1);
+  if (!res || *res != json1)
+    TEST_FAILED("Compressed value was not decompressed correctly");
+
+  if (cache.find(1) != res)
+    TEST_FAILED("Memory cache hits should share the decompressed value");
+
+  auto view = cache.findView(1);
+  if (!view || view.data() != json1 || !view.encoding().empty())
+    TEST_FAILED("View should contain the decompressed value");
+
+  view = cache.findView(1, true);
+  if (!view || view.encoding() != "zstd" || view.size() >= json1.size())
+    TEST_FAILED("View should contain the zstd frame as is");
+
+  // Pushes key 1 to the file cache
+  cache.insert(2, std::make_shared<std::string>(json2));
+
+  res = cache.find(1);
+  if (!res || *res != json1)
+    TEST_FAILED("Key 1 should have been decompressed from the file cache");
+
+  const auto stats = cache.getCompressionStats();
+  if (stats.compressions != 2 || stats.ratio < 10 || stats.effective_capacity < 3000)
+    TEST_FAILED("Compression statistics are wrong, ratio = " + std::to_string(stats.ratio));
+
+  TEST_PASSED();
+}
+
+// Files written compressed must be decoded after compression is disabled
+void compressed_files()
+{
+  uid_t uid = getuid();
+  const std::string dir = "/tmp/" + std::to_string(int(uid)) + "/bscachetest11";
+  std::filesystem::remove_all(dir);
+
+  const std::string json(2000, 'x');
+  {
+    // Room for one compressed value only
+    SmartMet::Spine::SmartMetCache cache(30, 100000, dir);
+    cache.enableCompression(3, false);
+    cache.insert(1, std::make_shared<std::string>(json));
+    cache.insert(2, std::make_shared<std::string>(std::string(2000, 'y')));
+
+    for (int i = 0; i < 100 && cache.getWriteQueueStats().written == 0; i++)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  SmartMet::Spine::SmartMetCache cache(30, 100000, dir);
+  auto res = cache.find(1);
+  if (!res || *res != json)
+    TEST_FAILED("Compressed file should be decoded without compression enabled");
+
+  TEST_PASSED();
+}
+
+// Two caches sharing a memory tier act like two server processes
+void shared_memory()
+{
+  uid_t uid = getuid();
+  const std::string name = "/tmp/" + std::to_string(int(uid)) + "/bscachetest9";
+  SmartMet::Spine::SharedMemoryCache::unlink(name);
+
+  SmartMet::Spine::SmartMetCache cache1(100, 0, "");
+  SmartMet::Spine::SmartMetCache cache2(100, 0, "");
+  cache1.enableSharedMemory(name, 1024 * 1024);
+  cache2.enableSharedMemory(name, 1024 * 1024);
+
+  cache1.insert(1, std::make_shared<std::string>("shared"));
+
+  auto res = cache2.find(1);
+  if (!res || *res != "shared")
+    TEST_FAILED("Value inserted by one cache should be found by the other");
+
+  // The size is in bytes
+  if (cache2.getMemoryCacheStats().size != 6)
+    TEST_FAILED("Shared memory hit should be promoted to the memory cache");
+
+  auto view = cache2.findView(1);
+  if (!view || view.data() != "shared")
+    TEST_FAILED("View of the promoted value is wrong");
+
+  if (cache1.getSharedMemoryStats().inserts != 1 || cache2.getSharedMemoryStats().hits != 1)
+    TEST_FAILED("Shared memory statistics are wrong");
+
+  SmartMet::Spine::SharedMemoryCache::unlink(name);
+  TEST_PASSED();
+}
+
+// Each process trains its own dictionary, the other must still decode shared values
+void shared_dictionary()
+{
+  uid_t uid = getuid();
+  const std::string name = "/tmp/" + std::to_string(int(uid)) + "/bscachetest10";
+  SmartMet::Spine::SharedMemoryCache::unlink(name);
+
+  SmartMet::Spine::SmartMetCache cache1(100000, 0, "");
+  SmartMet::Spine::SmartMetCache cache2(100000, 0, "");
+  cache1.enableSharedMemory(name, 4 * 1024 * 1024);
+  cache2.enableSharedMemory(name, 4 * 1024 * 1024);
+  cache1.enableCompression(3, true);
+  cache2.enableCompression(3, true);
+
+  auto make_value = [](int key)
+  {
+    std::string json = "[";
+    for (int i = 0; i < 20; i++)
+      json += "{\"station\":" + std::to_string(key * 31 + i) + ",\"temperature\":" +
+              std::to_string((key + i) % 40) + "},";
+    return json + "{}]";
+  };
+
+  // Train the dictionary of the first cache only
+  for (int key = 1; key <= 300; key++)
+    cache1.insert(key, std::make_shared<std::string>(make_value(key)));
+
+  // Training runs in the background
+  for (int i = 0; i < 100 && cache1.getCompressionStats().dictionary_size == 0; i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  if (cache1.getCompressionStats().dictionary_size == 0)
+    TEST_FAILED("The first cache should have trained a dictionary");
+
+  cache1.insert(1000, std::make_shared<std::string>(make_value(1000)));
+
+  for (int round = 0; round < 2; round++)
+  {
+    auto res = cache2.find(1000);
+    if (!res || *res != make_value(1000))
+      TEST_FAILED("Shared value should be decodable without the dictionary");
+  }
+
+  SmartMet::Spine::SharedMemoryCache::unlink(name);
+  TEST_PASSED();
+}
+
 // Verify that creating/destroying SmartMetCache works when the task is cancelled
 // while SmartMetCache destructor runs in the cancelled thread
 void cache_in_async_task()
@@ -232,6 +591,16 @@ class tests : public tframe::tests
     TEST(basic);
     TEST(find);
     TEST(promote);
+    TEST(write_queue);
+    TEST(view);
+    TEST(admission);
+    TEST(warm_restart);
+    TEST(warm_restart_index);
+    TEST(legacy_files);
+    TEST(compression);
+    TEST(compressed_files);
+    TEST(shared_memory);
+    TEST(shared_dictionary);
     TEST(cache_in_async_task);
   }
 };
@@ -0,0 +1,177 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Regression tests for class TableStreamer
+ */
+// ======================================================================
+
+#include "TableStreamer.h"
+#include "AsciiFormatter.h"
+#include "CsvFormatter.h"
+#include "HTTP.h"
+#include "JsonFormatter.h"
+#include "Table.h"
+#include "TableFormatterOptions.h"
+#include "XmlFormatter.h"
+#include <regression/tframe.h>
+#include <memory>
+#include <string>
+
+using SmartMet::Spine::TableStreamer;
+using Status = SmartMet::Spine::HTTP::ContentStreamer::StreamerStatus;
+
+namespace
+{
+SmartMet::Spine::TableFormatterOptions config;
+
+std::shared_ptr<SmartMet::Spine::Table> make_table(int theRows)
+{
+  auto table = std::make_shared<SmartMet::Spine::Table>();
+  for (int j = 0; j < theRows; j++)
+  {
+    table->set(0, j, std::to_string(j));
+    table->set(1, j, "row " + std::to_string(j));
+  }
+  return table;
+}
+}  // namespace
+
+//! Protection against conflicts with global functions
+namespace TableStreamerTest
+{
+// ----------------------------------------------------------------------
+
+void stream()
+{
+  auto formatter = std::make_shared<SmartMet::Spine::CsvFormatter>();
+  auto table = make_table(10000);
+  SmartMet::Spine::TableFormatter::Names names{"a", "b"};
+  SmartMet::Spine::HTTP::Request req;
+
+  TableStreamer streamer(formatter, table, names, req, config, 1000);
+
+  std::string out;
+  std::size_t chunks = 0;
+  while (true)
+  {
+    auto chunk = streamer.getChunk();
+    if (chunk.empty())
+      break;
+    if (chunk.size() > 1100)
+      TEST_FAILED("Chunk of " + std::to_string(chunk.size()) + " bytes exceeds the chunk size");
+    out += chunk;
+    ++chunks;
+  }
+
+  if (out != formatter->format(*table, names, req, config))
+    TEST_FAILED("Streamed output differs from the formatted string");
+
+  if (chunks < 100)
+    TEST_FAILED("Expected output in many chunks, got " + std::to_string(chunks));
+
+  if (streamer.getStatus() != Status::EXIT_OK)
+    TEST_FAILED("Status should be EXIT_OK after the last chunk");
+
+  TEST_PASSED();
+}
+
+// The streamed output must match the string output for all styles
+template <typename Formatter>
+void compare(SmartMet::Spine::HTTP::Request& theRequest, const std::string& theStyle)
+{
+  auto formatter = std::make_shared<Formatter>();
+  auto table = std::make_shared<SmartMet::Spine::Table>();
+  for (int j = 0; j < 1000; j++)
+  {
+    table->set(0, j, std::to_string(j % 7));
+    table->set(1, j, std::to_string(j % 3));
+    table->set(2, j, "row " + std::to_string(j));
+  }
+  SmartMet::Spine::TableFormatter::Names names{"a", "b", "c"};
+
+  TableStreamer streamer(formatter, table, names, theRequest, config, 100);
+
+  std::string out;
+  while (true)
+  {
+    auto chunk = streamer.getChunk();
+    if (chunk.empty())
+      break;
+    out += chunk;
+  }
+
+  if (out != formatter->format(*table, names, theRequest, config))
+    TEST_FAILED("Streamed " + theStyle + " output differs from the formatted string");
+}
+
+void styles()
+{
+  SmartMet::Spine::HTTP::Request req;
+  compare<SmartMet::Spine::JsonFormatter>(req, "json");
+  compare<SmartMet::Spine::XmlFormatter>(req, "xml attributes");
+  req.setParameter("attributes", "a,b,a");
+  compare<SmartMet::Spine::JsonFormatter>(req, "grouped json");
+  req.setParameter("xmlstyle", "mixed");
+  compare<SmartMet::Spine::XmlFormatter>(req, "xml mixed");
+  req.setParameter("xmlstyle", "tags");
+  compare<SmartMet::Spine::XmlFormatter>(req, "xml tags");
+  compare<SmartMet::Spine::AsciiFormatter>(req, "ascii");
+  TEST_PASSED();
+}
+
+// The client disconnects before reading everything
+void cancel()
+{
+  auto formatter = std::make_shared<SmartMet::Spine::CsvFormatter>();
+  SmartMet::Spine::HTTP::Request req;
+  {
+    TableStreamer streamer(formatter, make_table(10000), {"a", "b"}, req, config, 1000);
+    if (streamer.getChunk().empty())
+      TEST_FAILED("Expected a chunk");
+  }
+  TEST_PASSED();
+}
+
+void failure()
+{
+  // JSON output requires a name for every column
+  auto formatter = std::make_shared<SmartMet::Spine::JsonFormatter>();
+  SmartMet::Spine::HTTP::Request req;
+  TableStreamer streamer(formatter, make_table(10), {"a"}, req, config);
+
+  while (!streamer.getChunk().empty())
+  {
+  }
+
+  if (streamer.getStatus() != Status::EXIT_ERROR)
+    TEST_FAILED("Status should be EXIT_ERROR after a formatting error");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+class tests : public tframe::tests
+{
+  virtual const char* error_message_prefix() const { return "\n\t"; }
+  void test(void)
+  {
+    TEST(stream);
+    TEST(styles);
+    TEST(cancel);
+    TEST(failure);
+  }
+};
+
+}  // namespace TableStreamerTest
+
+//! The main program
+int main(void)
+{
+  using namespace std;
+  cout << endl << "TableStreamer tester" << endl << "====================" << endl;
+  TableStreamerTest::tests t;
+  return t.run();
+}
+
+// ======================================================================
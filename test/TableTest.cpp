@@ -6,9 +6,17 @@
 // ======================================================================
 
 #include "Table.h"
+#include "TableVisitor.h"
+#include <macgyver/LocalDateTime.h>
+#include <macgyver/TimeFormatter.h>
+#include <macgyver/TimeZonePtr.h>
+#include <macgyver/ValueFormatter.h>
 #include <regression/tframe.h>
+#include <atomic>
 #include <cmath>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 template <typename T>
 std::string tostr(const T& theValue)
@@ -69,6 +77,186 @@ void empty()
   TEST_PASSED();
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test typed values, which are formatted on output
+ */
+// ----------------------------------------------------------------------
+
+void typed()
+{
+  SmartMet::Spine::Table tab;
+  Fmi::ValueFormatterParam param;
+  tab.setValueFormatter(Fmi::ValueFormatter(param));
+
+  tab.setDouble(0, 0, 1.23456, 2);
+  tab.setInteger(1, 0, -42);
+  tab.setMissing(0, 1);
+  tab.set(1, 1, "text");
+  tab.set(2, 0, "replaced");
+  tab.setInteger(2, 0, 7);
+  tab.setDouble(2, 2, 3.5, 1);
+
+  if (tab.get(0, 0) != "1.23")
+    TEST_FAILED("Double formatted as " + tab.get(0, 0));
+  if (tab.get(1, 0) != "-42")
+    TEST_FAILED("Integer formatted as " + tab.get(1, 0));
+  if (tab.get(0, 1) != tab.get(0, 1, "unused") || tab.get(0, 1).empty())
+    TEST_FAILED("Missing value should be formatted with the value formatter");
+  if (tab.get(1, 1) != "text")
+    TEST_FAILED("String value changed to " + tab.get(1, 1));
+  if (tab.get(2, 0) != "7")
+    TEST_FAILED("Overwritten cell should have the last value, got " + tab.get(2, 0));
+  if (!tab.get(0, 2).empty() || tab.get(0, 2, "-") != "-")
+    TEST_FAILED("Unset cell should be empty");
+  if (tab.get(2, 2) != "3.5")
+    TEST_FAILED("Double formatted as " + tab.get(2, 2));
+
+  if (tab.columns().size() != 3 || tab.rows().size() != 3)
+    TEST_FAILED("Table should have 3 columns and 3 rows");
+
+  try
+  {
+    tab.setInteger(0, 0, 1);
+    TEST_FAILED("Setting values after get should fail");
+  }
+  catch (...)
+  {
+  }
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Formatters and time zones apply to the values set with them
+ */
+// ----------------------------------------------------------------------
+
+void formatters()
+{
+  SmartMet::Spine::Table tab;
+
+  Fmi::ValueFormatterParam param1;
+  param1.missingText = "nan";
+  tab.setValueFormatter(Fmi::ValueFormatter(param1));
+  tab.setMissing(0, 0);
+
+  Fmi::ValueFormatterParam param2;
+  param2.missingText = "-";
+  tab.setValueFormatter(Fmi::ValueFormatter(param2));
+  tab.setMissing(0, 1);
+
+  std::shared_ptr<Fmi::TimeFormatter> formatter(Fmi::TimeFormatter::create("iso"));
+  const Fmi::TimeZonePtr helsinki("Europe/Helsinki");
+  const Fmi::TimeZonePtr utc("UTC");
+  const Fmi::LocalDateTime t(Fmi::DateTime(Fmi::Date(2024, 1, 1), Fmi::Hours(12)), utc);
+  tab.setTime(1, 0, t, formatter, helsinki);
+  tab.setTime(1, 1, t, formatter, utc);
+
+  if (tab.get(0, 0) != "nan" || tab.get(0, 1) != "-")
+    TEST_FAILED("Missing values should use the formatter set before them");
+
+  if (tab.get(1, 0) != formatter->format(t.local_time_in(helsinki)) ||
+      tab.get(1, 1) != formatter->format(t.local_time_in(utc)) || tab.get(1, 0) == tab.get(1, 1))
+    TEST_FAILED("Times should use the time zone set with them");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Visitors created per value share the copy of the same formatter
+ */
+// ----------------------------------------------------------------------
+
+void visitors()
+{
+  SmartMet::Spine::Table tab;
+
+  Fmi::ValueFormatterParam param;
+  Fmi::ValueFormatter formatter(param);
+
+  for (unsigned int row = 0; row < 100; row++)
+  {
+    SmartMet::Spine::TableVisitor visitor(tab, formatter, {1}, 0, row);
+    visitor(row * 0.5);
+  }
+
+  if (tab.valueFormatterCount() != 1)
+    TEST_FAILED("Expected one formatter, got " + std::to_string(tab.valueFormatterCount()));
+
+  // Another formatter needs its own copy
+  Fmi::ValueFormatterParam param2;
+  param2.missingText = "-";
+  Fmi::ValueFormatter formatter2(param2);
+  SmartMet::Spine::TableVisitor visitor(tab, formatter2, {1}, 1, 0);
+  visitor(SmartMet::Spine::None());
+
+  if (tab.valueFormatterCount() != 2)
+    TEST_FAILED("Expected a new formatter for another formatter object");
+  if (tab.get(0, 1) != "0.5" || tab.get(1, 0) != "-")
+    TEST_FAILED("Values were not formatted with their own formatter");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Rows need not start from zero
+ */
+// ----------------------------------------------------------------------
+
+void offset()
+{
+  SmartMet::Spine::Table tab;
+  tab.set(0, 1000000, "b");
+  tab.set(0, 999999, "a");
+  tab.setInteger(1, 1000001, 3);
+
+  if (tab.get(0, 999999) != "a" || tab.get(0, 1000000) != "b" || !tab.get(0, 1000001).empty())
+    TEST_FAILED("Wrong values in the first column");
+  if (!tab.get(1, 999999).empty() || tab.get(1, 1000001) != "3")
+    TEST_FAILED("Wrong values in the second column");
+  if (tab.rows().size() != 3)
+    TEST_FAILED("Table should have 3 rows");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief A filled table may be read concurrently
+ */
+// ----------------------------------------------------------------------
+
+void concurrent()
+{
+  SmartMet::Spine::Table tab;
+  Fmi::ValueFormatterParam param;
+  tab.setValueFormatter(Fmi::ValueFormatter(param));
+  for (int j = 0; j < 1000; j++)
+    tab.setDouble(0, j, j + 0.5, 1);
+
+  std::atomic<int> errors{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++)
+    threads.emplace_back(
+        [&]()
+        {
+          for (int j = 0; j < 1000; j++)
+            if (tab.get(0, j) != tostr(j) + ".5")
+              ++errors;
+        });
+  for (auto& thread : threads)
+    thread.join();
+
+  if (errors > 0)
+    TEST_FAILED("Concurrent readers got wrong values");
+
+  TEST_PASSED();
+}
+
 // ----------------------------------------------------------------------
 /*!
  * The actual test suite
@@ -82,6 +270,11 @@ class tests : public tframe::tests
   {
     TEST(basic);
     TEST(empty);
+    TEST(typed);
+    TEST(formatters);
+    TEST(visitors);
+    TEST(offset);
+    TEST(concurrent);
   }
 };
 
@@ -1,7 +1,13 @@
 #include "Plugin.h"
+#include "Convenience.h"
+#include "MallocStats.h"
+#include "RequestArena.h"
+#include "Table.h"
 #include "TableFormatterOptions.h"
 #include "TableFormatterFactory.h"
+#include <chrono>
 #include <functional>
+#include <memory_resource>
 #include <sstream>
 #include <json/json.h>
 
@@ -56,6 +62,18 @@ void Plugin::init()
         throw Fmi::Exception(BCP, "Failed to register test content handler (exact match)");
     }
 
+    if (!itsReactor->addPrivateContentHandler(this,
+            "/arena_benchmark",
+            [this](Reactor& theReactor,
+                const HTTP::Request& theRequest,
+                HTTP::Response& theResponse)
+            {
+                arenaBenchmarkHandler(theReactor, theRequest, theResponse);
+            }))
+    {
+        throw Fmi::Exception(BCP, "Failed to register arena benchmark handler");
+    }
+
     itsReactor->setNoMatchHandler(
         std::bind(&Plugin::nomatchHandler, this, p::_1, p::_2, p::_3),
         "nomatch");
@@ -141,6 +159,104 @@ void Plugin::requestHandler2(
     theResponse.setContent(content.str());
 }
 
+namespace
+{
+// Counts the calls reaching the wrapped resource
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+    explicit CountingResource(std::pmr::memory_resource* upstream) : itsUpstream(upstream) {}
+    std::size_t calls = 0;
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        ++calls;
+        return itsUpstream->allocate(bytes, alignment);
+    }
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+    {
+        ++calls;
+        itsUpstream->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+    std::pmr::memory_resource* itsUpstream;
+};
+}  // namespace
+
+/*
+ * Compare building and formatting a table with the heap and with a request
+ * arena, for example
+ *
+ *   /arena_benchmark?rows=2000&cols=10&repeat=50&format=json&values=numbers
+ *
+ * The values are numbers stored typed or strings. The output lists for
+ * both modes the allocator calls made by the table storage, the bytes
+ * allocated by the thread (jemalloc only) and the average latency. Not
+ * part of the regression tests since the timings vary.
+ */
+void Plugin::arenaBenchmarkHandler(
+    Reactor& theReactor,
+    const HTTP::Request& theRequest,
+    HTTP::Response& theResponse)
+{
+    (void) theReactor;
+    const auto rows = Spine::optional_size(theRequest.getParameter("rows"), 2000);
+    const auto cols = Spine::optional_size(theRequest.getParameter("cols"), 10);
+    const auto repeat = std::max<std::size_t>(1, Spine::optional_size(theRequest.getParameter("repeat"), 50));
+    const auto format = Spine::optional_string(theRequest.getParameter("format"), "json");
+    const bool numbers =
+        (Spine::optional_string(theRequest.getParameter("values"), "numbers") == "numbers");
+
+    std::unique_ptr<TableFormatter> formatter(TableFormatterFactory::create(format));
+    const TableFormatterOptions options;
+
+    std::ostringstream content;
+    content << "mode\tallocator_calls\tthread_bytes\taverage_us\n";
+
+    for (const bool use_arena : {false, true})
+    {
+        CountingResource counter(std::pmr::new_delete_resource());
+        const auto bytes_before = Spine::getThreadAllocatedBytes();
+        const auto start = std::chrono::steady_clock::now();
+
+        for (std::size_t n = 0; n < repeat; n++)
+        {
+            std::unique_ptr<RequestArena> arena;
+            if (use_arena)
+                arena = std::make_unique<RequestArena>(&counter);
+            Table table(use_arena ? arena->resource() : &counter);
+
+            for (std::size_t j = 0; j < rows; j++)
+                for (std::size_t i = 0; i < cols; i++)
+                {
+                    if (numbers)
+                        table.setInteger(i, j, static_cast<std::int64_t>(i * j));
+                    else
+                        table.set(i, j, std::to_string(i * j));
+                }
+
+            std::vector<std::string> names;
+            for (std::size_t i = 0; i < cols; i++)
+                names.push_back("col" + std::to_string(i));
+
+            formatter->format(table, names, theRequest, options);
+        }
+
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+
+        content << (use_arena ? "arena" : "heap") << '\t' << counter.calls << '\t'
+                << (Spine::getThreadAllocatedBytes() - bytes_before) << '\t'
+                << elapsed.count() / repeat << '\n';
+    }
+
+    theResponse.setContent(content.str());
+}
+
 void Plugin::nomatchHandler(
     Reactor&,
     const HTTP::Request&,
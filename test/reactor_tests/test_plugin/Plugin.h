@@ -32,6 +32,10 @@ namespace SmartMet
                             const Spine::HTTP::Request& theRequest,
             Spine::HTTP::Response& theResponse);
 
+        void arenaBenchmarkHandler(Spine::Reactor& theReactor,
+                                   const Spine::HTTP::Request& theRequest,
+                                   Spine::HTTP::Response& theResponse);
+
         void nomatchHandler(Spine::Reactor& theReactor,
                             const Spine::HTTP::Request& theRequest,
                             Spine::HTTP::Response& theResponse);